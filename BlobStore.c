@@ -0,0 +1,1571 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include <string.h>
+#include "Platform.h"
+#include "Hash.h"
+#include "Compress.h"
+#include "BlobStore.h"
+
+#define MIN_BUCKETS         256
+#define MIN_PACK_SIZE       1024            //smallest payload worth packing
+#define SPILL_ALIGN         16              //keeps mapped payloads aligned
+#define SPILL_COMPACT_MIN   (1024 * 1024)   //garbage worth compacting
+#define SPILL_MOVE_SIZE     (64 * 1024)     //compaction copy buffer
+
+typedef struct Blob
+{
+    struct Blob*    next;           //next blob in the same bucket
+    uint64_t        hash;
+    size_t          size;
+    unsigned int    refs;
+    BOOL            interned;       //TRUE once it's in the index
+    BOOL            hashed;         //hash known before interning
+    BYTE*           bytes;          //payload; NULL while spilled or packed
+    HANDLE          block;          //movable block holding bytes, if not
+                                    //part of the blob's own allocation
+    unsigned int    locks;
+    BOOL            spilled;        //TRUE once moved to the spill file
+    BOOL            mapped;         //bytes is a view of the spill file
+    uint64_t        spill_offset;
+    struct Blob*    spill_prev;     //spilled blobs, in file order
+    struct Blob*    spill_next;
+    BYTE*           packed;         //compressed payload, or NULL
+    size_t          packed_size;
+    BOOL            incompressible; //packing was tried and didn't pay
+    struct BlobSource*  source;     //file the payload is still in, or NULL
+    uint64_t        source_offset;
+    struct Blob*    source_prev;    //other blobs still in the same file
+    struct Blob*    source_next;
+}Blob;
+
+//A file payloads are read from lazily (see AllocLazyBlob).  It stays
+//open until every one of them has been read or released.  A mapped
+//source has no file handle, just a view of the file that its blobs
+//point into.
+typedef struct BlobSource
+{
+    HANDLE          file;
+    BYTE*           view;           //the mapped file, or NULL
+    uint64_t        view_size;
+    unsigned int    refs;           //lazy blobs, plus the loader's
+    Blob*           first;          //lazy blobs, in no particular order
+    struct BlobSource*  prev;
+    struct BlobSource*  next;
+}BlobSource;
+
+//Keeps the payload that follows the header suitably aligned
+#define BLOB_HEADER_SIZE    ((sizeof(Blob) + 15) & ~((size_t) 15))
+
+#define GetPayload(blob)    ((BYTE*) (blob) + BLOB_HEADER_SIZE)
+#define IsInline(blob)      ((blob)->bytes == GetPayload(blob))
+#define IsSeparate(size)    (((size) >= MIN_PACK_SIZE) \
+    || ((spill_threshold > 0) && ((size) >= spill_threshold)))
+#define AlignSpill(offset) \
+    (((offset) + SPILL_ALIGN - 1) & ~((uint64_t) SPILL_ALIGN - 1))
+
+static Blob** buckets = NULL;
+static unsigned int bucket_count = 0;
+static BlobStoreStats store_stats = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+static HANDLE spill_file = INVALID_HANDLE_VALUE;
+static size_t spill_threshold = 0;      //0 while spilling is off
+static uint64_t spill_end = 0;
+static Blob* spill_first = NULL;
+static Blob* spill_last = NULL;
+static unsigned int spill_locks = 0;    //spilled blobs brought back
+static unsigned int spill_readers = 0;  //HoldBlob callers
+
+static BlobSource* sources = NULL;
+
+static BOOL GrowIndex();
+static void Unlink(Blob* blob);
+static void SpillBlob(Blob* blob);
+static BOOL UnspillBlob(Blob* blob);
+static void UnlinkSpilled(Blob* blob);
+static void CompactSpillFile();
+static void CloseSpillFile();
+static BOOL ReadPayload(Blob* blob, BYTE* bytes);
+static void AddSource(BlobSource* source);
+static BOOL ReadLazyBlob(Blob* blob);
+static void UnlinkLazy(Blob* blob);
+static void DropSource(BlobSource* source);
+
+
+/*******************************************************************
+** AllocBlob
+** =========
+** Allocates a zero-filled, private blob with one reference.  Fill
+** it in through LockBlob, then pass it to InternBlob so identical
+** payloads can be shared.
+**
+** Payloads big enough to be spilled or packed get a movable block
+** of their own, so it can be freed once they're in the spill file
+** or compressed, or handed to the clipboard by DetachBlob.  The
+** rest share one allocation with the blob.
+**
+** Inputs:
+**      size_t size         - payload size in bytes
+**
+** Outputs:
+**      void*               - the blob, or NULL
+*******************************************************************/
+void* AllocBlob(size_t size)
+{
+    Blob* blob;
+    HANDLE block;
+    void* bytes;
+
+    if(IsSeparate(size))
+    {
+        bytes = AllocMovable(size, &block);
+        return bytes ? AdoptBlob(block, bytes, size, NULL) : NULL;
+    }
+
+    blob = (Blob*) AllocMemory(BLOB_HEADER_SIZE + size);
+
+    if(blob)
+    {
+        blob->bytes = GetPayload(blob);
+        blob->size = size;
+        blob->refs = 1;
+
+        ++store_stats.blobs;
+        ++store_stats.references;
+        store_stats.bytes += size;
+        store_stats.logical_bytes += size;
+    }
+
+    return blob;
+}
+
+
+/*******************************************************************
+** AdoptBlob
+** =========
+** Like AllocBlob, but takes over a movable block that's already
+** filled in instead of allocating one, so a payload built somewhere
+** else (on another thread, say) doesn't have to be copied.  Small
+** payloads are still copied in with the blob and the block freed.
+** A hash worked out along with the payload saves InternBlob from
+** reading it all again.
+**
+** The blob owns the block from here on, even if this fails.
+**
+** Inputs:
+**      HANDLE block        - block from AllocMovable
+**      void* bytes         - its locked memory
+**      size_t size         - payload size in bytes
+**      const uint64_t* hash- HashBytes of the payload with seed 0,
+**                            or NULL if not known
+**
+** Outputs:
+**      void*               - the blob, or NULL
+*******************************************************************/
+void* AdoptBlob(HANDLE block, void* bytes, size_t size,
+    const uint64_t* hash)
+{
+    BOOL separate = IsSeparate(size);
+    Blob* blob = (Blob*) AllocMemory(BLOB_HEADER_SIZE + (separate ? 0 : size));
+
+    if(blob)
+    {
+        if(separate)
+        {
+            blob->bytes = (BYTE*) bytes;
+            blob->block = block;
+        }
+        else
+        {
+            blob->bytes = GetPayload(blob);
+            memcpy(blob->bytes, bytes, size);
+            FreeMovable(block);
+        }
+
+        if(hash)
+        {
+            blob->hash = *hash;
+            blob->hashed = TRUE;
+        }
+
+        blob->size = size;
+        blob->refs = 1;
+
+        ++store_stats.blobs;
+        ++store_stats.references;
+        store_stats.bytes += size;
+        store_stats.logical_bytes += size;
+    }
+    else
+    {
+        FreeMovable(block);
+    }
+
+    return blob;
+}
+
+
+/*******************************************************************
+** InternBlob
+** ==========
+** Publishes a blob from AllocBlob.  If an identical payload is
+** already stored, the new blob is released and the existing one
+** gains a reference instead, so always use the returned blob.
+** Large payloads are moved to the spill file at this point.
+**
+** Inputs:
+**      void* memory        - blob from AllocBlob
+**
+** Outputs:
+**      void*               - blob to keep (may differ from the
+**                            input)
+*******************************************************************/
+void* InternBlob(void* memory)
+{
+    Blob* blob = (Blob*) memory;
+    Blob* match;
+
+    if(!blob)
+    {
+        return NULL;
+    }
+
+    if(blob->interned)
+    {
+        return blob;
+    }
+
+    if(!blob->hashed)
+    {
+        blob->hash = HashBytes(blob->bytes, blob->size, 0);
+    }
+
+    if((store_stats.blobs > bucket_count) && !GrowIndex() && !buckets)
+    {
+        //No index at all; the blob just stays private.
+        return blob;
+    }
+
+    for(match = buckets[blob->hash & (bucket_count - 1)];
+        match; match = match->next)
+    {
+        if((match->hash == blob->hash) && (match->size == blob->size))
+        {
+            //A lazy blob has to be read in to be compared
+            BYTE* match_bytes = (BYTE*) LockBlob(match);
+            BYTE* bytes = match_bytes ? (BYTE*) LockBlob(blob) : NULL;
+            BOOL same = bytes
+                && (memcmp(match_bytes, bytes, blob->size) == 0);
+
+            if(bytes)
+            {
+                UnlockBlob(blob);
+            }
+
+            if(match_bytes)
+            {
+                UnlockBlob(match);
+            }
+
+            if(same)
+            {
+                RetainBlob(match);
+                ReleaseBlob(blob);
+                return match;
+            }
+        }
+    }
+
+    blob->next = buckets[blob->hash & (bucket_count - 1)];
+    buckets[blob->hash & (bucket_count - 1)] = blob;
+    blob->interned = TRUE;
+
+    if((spill_threshold > 0) && (blob->size >= spill_threshold)
+    && blob->bytes && !IsInline(blob) && !blob->source)
+    {
+        SpillBlob(blob);
+    }
+
+    return blob;
+}
+
+
+/*******************************************************************
+** OpenBlobSource
+** ==============
+** Starts reading payloads lazily from a file, for AllocLazyBlob.
+** The source keeps a handle of its own, so the caller can close
+** theirs, and is closed itself once CloseBlobSource has been called
+** and every lazy blob from it has been read or released.
+**
+** The handle must come from OpenFileForReading.  The source's copy
+** shares the file the way the original does, and on Windows a
+** handle that doesn't share deletion keeps the file from being
+** replaced or renamed for as long as any lazy blob is left.
+**
+** Inputs:
+**      HANDLE fhand        - file from OpenFileForReading
+**
+** Outputs:
+**      void*               - the source, or NULL
+*******************************************************************/
+void* OpenBlobSource(HANDLE fhand)
+{
+    BlobSource* source = (BlobSource*) AllocMemory(sizeof(BlobSource));
+
+    if(source)
+    {
+        source->file = DuplicateFileHandle(fhand);
+
+        if(source->file == INVALID_HANDLE_VALUE)
+        {
+            FreeMemory(source);
+            return NULL;
+        }
+
+        AddSource(source);
+    }
+
+    return source;
+}
+
+
+/*******************************************************************
+** MapBlobSource
+** =============
+** Like OpenBlobSource, but maps the start of the file into memory
+** instead, so the payloads of its lazy blobs are never copied: they
+** point straight into the mapping, and take up no private memory.
+** The file is unmapped once CloseBlobSource has been called and
+** every blob from it has been copied out or released.
+**
+** Payloads in a mapping aren't aligned the way allocated ones are.
+**
+** Inputs:
+**      HANDLE fhand        - file open for reading; it needn't stay
+**                            open
+**      uint64_t size       - how much of the file the payloads are in
+**
+** Outputs:
+**      void*               - the source, or NULL if the file can't be
+**                            mapped (it's on a network share that
+**                            doesn't allow it, say, or too big for
+**                            the address space)
+*******************************************************************/
+void* MapBlobSource(HANDLE fhand, uint64_t size)
+{
+    BlobSource* source;
+    BYTE* view;
+
+    if((size == 0) || (size > (size_t) -1))
+    {
+        return NULL;
+    }
+
+    view = (BYTE*) MapFileRange(fhand, 0, (size_t) size);
+
+    if(!view)
+    {
+        return NULL;
+    }
+
+    source = (BlobSource*) AllocMemory(sizeof(BlobSource));
+
+    if(!source)
+    {
+        UnmapFileRange(view, 0, (size_t) size);
+        return NULL;
+    }
+
+    source->file = INVALID_HANDLE_VALUE;
+    source->view = view;
+    source->view_size = size;
+    AddSource(source);
+
+    return source;
+}
+
+
+/*******************************************************************
+** AllocLazyBlob
+** =============
+** Makes a private blob whose payload is still in a file, along
+** with the payload's hash, so it can be interned without being
+** read.  The first LockBlob reads it in for good, unless the source
+** is mapped; then the payload is locked where it is in the mapping,
+** and is only copied out by DetachBlob or LoadLazyBlobs.
+**
+** Inputs:
+**      void* source        - from OpenBlobSource or MapBlobSource
+**      uint64_t offset     - where the payload is in the file
+**      size_t size         - its size
+**      uint64_t hash       - HashBytes of it with seed 0
+**
+** Outputs:
+**      void*               - the blob, or NULL
+*******************************************************************/
+void* AllocLazyBlob(void* source, uint64_t offset, size_t size,
+    uint64_t hash)
+{
+    BlobSource* from = (BlobSource*) source;
+    Blob* blob;
+
+    if(from->view && ((offset > from->view_size)
+        || (size > from->view_size - offset)))
+    {
+        return NULL;
+    }
+
+    blob = (Blob*) AllocMemory(BLOB_HEADER_SIZE);
+
+    if(blob)
+    {
+        blob->source = from;
+        blob->source_offset = offset;
+        blob->source_next = blob->source->first;
+
+        if(blob->source->first)
+        {
+            blob->source->first->source_prev = blob;
+        }
+
+        blob->source->first = blob;
+        ++(blob->source->refs);
+
+        blob->hash = hash;
+        blob->hashed = TRUE;
+        blob->size = size;
+        blob->refs = 1;
+
+        ++store_stats.blobs;
+        ++store_stats.references;
+        store_stats.bytes += size;
+        store_stats.logical_bytes += size;
+
+        if(from->view)
+        {
+            blob->bytes = from->view + offset;
+            store_stats.mapped_bytes += size;
+        }
+        else
+        {
+            store_stats.lazy_bytes += size;
+        }
+    }
+
+    return blob;
+}
+
+
+/*******************************************************************
+** CloseBlobSource
+** ===============
+** Says no more lazy blobs will be made from a source.  The file is
+** closed (or unmapped) now if none are left in it.
+**
+** Inputs:
+**      void* source        - from OpenBlobSource or MapBlobSource;
+**                            NULL is ignored
+*******************************************************************/
+void CloseBlobSource(void* source)
+{
+    if(source)
+    {
+        DropSource((BlobSource*) source);
+    }
+}
+
+
+/*******************************************************************
+** LoadLazyBlobs
+** =============
+** Reads in every payload still in a file, copies out every one in
+** a mapping, and closes the files.  Call it before writing over a
+** file that was loaded from.  Payloads big enough go on to the
+** spill file, as if they'd been interned just now.
+**
+** Inputs:
+**      BOOL mapped         - FALSE to leave mapped files alone, when
+**                            the file to be written isn't one of them
+**
+** Outputs:
+**      BOOL                - FALSE if any payload couldn't be read,
+**                            or is locked in a mapping; its file
+**                            stays open
+*******************************************************************/
+BOOL LoadLazyBlobs(BOOL mapped)
+{
+    BlobSource* source = sources;
+    BlobSource* next;
+    Blob* blob;
+    BOOL success = TRUE;
+
+    while(source)
+    {
+        //Reading the last blob can free the source
+        next = source->next;
+        ++(source->refs);
+
+        while(source->first && success && (mapped || !source->view))
+        {
+            blob = source->first;
+            success = (blob->locks == 0) && ReadLazyBlob(blob);
+
+            if(success && blob->interned && (spill_threshold > 0)
+            && (blob->size >= spill_threshold))
+            {
+                SpillBlob(blob);
+            }
+        }
+
+        DropSource(source);
+        source = next;
+    }
+
+    return success;
+}
+
+
+/*******************************************************************
+** RetainBlob
+** ==========
+** Adds a reference to a blob.
+**
+** Inputs:
+**      void* memory        - the blob
+**
+** Outputs:
+**      void*               - the same blob
+*******************************************************************/
+void* RetainBlob(void* memory)
+{
+    if(memory)
+    {
+        Blob* blob = (Blob*) memory;
+
+        ++(blob->refs);
+        ++store_stats.references;
+        store_stats.logical_bytes += blob->size;
+    }
+
+    return memory;
+}
+
+
+/*******************************************************************
+** ReleaseBlob
+** ===========
+** Drops a reference to a blob, freeing it with the last one.  NULL
+** is ignored.  The blob must not be locked.
+**
+** Inputs:
+**      void* memory        - the blob
+*******************************************************************/
+void ReleaseBlob(void* memory)
+{
+    if(memory)
+    {
+        Blob* blob = (Blob*) memory;
+
+        --store_stats.references;
+        store_stats.logical_bytes -= blob->size;
+
+        if(--(blob->refs) == 0)
+        {
+            if(blob->interned)
+            {
+                Unlink(blob);
+            }
+
+            --store_stats.blobs;
+            store_stats.bytes -= blob->size;
+
+            if(blob->spilled)
+            {
+                UnlinkSpilled(blob);
+            }
+            else if(blob->source)
+            {
+                UnlinkLazy(blob);
+            }
+            else if(blob->packed)
+            {
+                store_stats.packed_bytes -= blob->size;
+                store_stats.packed_size -= blob->packed_size;
+                FreeMemory(blob->packed);
+            }
+            else
+            {
+                FreeMovable(blob->block);
+            }
+
+            FreeMemory(blob);
+
+            //Reclaim the spill file once it's mostly holes
+            if((spill_end - store_stats.spilled_bytes >= SPILL_COMPACT_MIN)
+            && (spill_end - store_stats.spilled_bytes >= spill_end / 2))
+            {
+                CompactSpillFile();
+            }
+        }
+    }
+}
+
+
+/*******************************************************************
+** LockBlob
+** ========
+** Gets at a blob's payload, like GlobalLock.  A spilled payload is
+** mapped back in from the spill file (or read back, if mapping
+** fails) until the matching UnlockBlob; a packed one is unpacked
+** into a buffer that lasts as long.  A lazy one is read in from its
+** file, and stays, unless its file is mapped; then it's already
+** there.  Interned payloads are shared, and must not be written
+** to.
+**
+** Inputs:
+**      void* memory        - the blob
+**
+** Outputs:
+**      void*               - the payload, or NULL if a spilled,
+**                            packed or lazy one couldn't be
+**                            brought back
+**                            (or memory was NULL)
+*******************************************************************/
+void* LockBlob(void* memory)
+{
+    Blob* blob = (Blob*) memory;
+
+    if(!blob)
+    {
+        return NULL;
+    }
+
+    if(!blob->bytes && blob->source && !ReadLazyBlob(blob))
+    {
+        return NULL;
+    }
+
+    if(!blob->bytes)
+    {
+        if(blob->spilled)
+        {
+            blob->bytes = (BYTE*) MapFileRange(spill_file,
+                blob->spill_offset, blob->size);
+            blob->mapped = (blob->bytes != NULL);
+        }
+
+        if(!blob->bytes)
+        {
+            blob->bytes = (BYTE*) AllocMemory(blob->size);
+
+            if(blob->bytes && !ReadPayload(blob, blob->bytes))
+            {
+                FreeMemory(blob->bytes);
+                blob->bytes = NULL;
+            }
+        }
+
+        if(!blob->bytes)
+        {
+            return NULL;
+        }
+
+        if(blob->spilled)
+        {
+            ++spill_locks;
+        }
+    }
+
+    ++(blob->locks);
+
+    return blob->bytes;
+}
+
+
+/*******************************************************************
+** UnlockBlob
+** ==========
+** Balances a successful LockBlob.  A spilled or packed payload is
+** let go again once the last lock is gone.  NULL is ignored.
+**
+** Inputs:
+**      void* memory        - the blob
+*******************************************************************/
+void UnlockBlob(void* memory)
+{
+    Blob* blob = (Blob*) memory;
+
+    if(!blob || (blob->locks == 0) || (--(blob->locks) > 0))
+    {
+        return;
+    }
+
+    if(blob->packed)
+    {
+        FreeMemory(blob->bytes);
+        blob->bytes = NULL;
+    }
+    else if(blob->spilled)
+    {
+        if(blob->mapped)
+        {
+            UnmapFileRange(blob->bytes, blob->spill_offset, blob->size);
+        }
+        else
+        {
+            FreeMemory(blob->bytes);
+        }
+
+        blob->bytes = NULL;
+        blob->mapped = FALSE;
+        --spill_locks;
+    }
+}
+
+
+/*******************************************************************
+** GetBlobHash
+** ===========
+** Returns the content hash of an interned blob, or computes it for
+** a private one.
+**
+** Inputs:
+**      void* memory        - the blob
+**
+** Outputs:
+**      uint64_t            - hash of the payload
+*******************************************************************/
+uint64_t GetBlobHash(void* memory)
+{
+    Blob* blob = (Blob*) memory;
+
+    //Private blobs are never spilled or packed, so their bytes are
+    //at hand unless they're lazy, and then the hash came with them
+    return (blob->interned || blob->source) ? blob->hash
+        : HashBytes(blob->bytes, blob->size, 0);
+}
+
+
+/*******************************************************************
+** CompressBlob
+** ============
+** Packs an interned payload in place, for items that are no longer
+** in use.  LockBlob unpacks it again on demand.  Small, spilled and
+** locked payloads are left alone, as are those that don't shrink
+** by at least an eighth; a payload found not to shrink isn't tried
+** again.
+**
+** Inputs:
+**      void* memory        - the blob
+**
+** Outputs:
+**      BOOL                - TRUE if the payload is now packed
+*******************************************************************/
+BOOL CompressBlob(void* memory)
+{
+    Blob* blob = (Blob*) memory;
+    BYTE* buffer;
+    size_t packed_size;
+
+    if(!blob || blob->packed)
+    {
+        return (blob != NULL);
+    }
+
+    if(!blob->interned || blob->spilled || blob->source
+    || blob->incompressible || (blob->locks > 0) || IsInline(blob)
+    || (blob->size < MIN_PACK_SIZE))
+    {
+        return FALSE;
+    }
+
+    buffer = (BYTE*) AllocMemory(blob->size - blob->size / 8);
+
+    if(!buffer)
+    {
+        return FALSE;
+    }
+
+    packed_size = CompressBytes(blob->bytes, blob->size,
+        buffer, blob->size - blob->size / 8);
+
+    if(packed_size > 0)
+    {
+        //Trim the buffer down to what was used
+        blob->packed = (BYTE*) AllocMemory(packed_size);
+
+        if(blob->packed)
+        {
+            memcpy(blob->packed, buffer, packed_size);
+            blob->packed_size = packed_size;
+
+            FreeMovable(blob->block);
+            blob->block = NULL;
+            blob->bytes = NULL;
+
+            store_stats.packed_bytes += blob->size;
+            store_stats.packed_size += packed_size;
+        }
+    }
+    else
+    {
+        blob->incompressible = TRUE;
+    }
+
+    FreeMemory(buffer);
+
+    return (blob->packed != NULL);
+}
+
+
+/*******************************************************************
+** HoldBlob
+** ========
+** Keeps hold of a payload where it is, so it can be got at
+** somewhere else, like another thread, without the blob store (see
+** GetHeldBytes).  Nothing is read from disk or unpacked: a payload
+** in memory is locked, a packed one left packed, and one still in
+** the file it was loaded from, or in the spill file, left there.
+** Whichever it is stays as it is until ReleaseHeldBlob, even if the
+** blob is released in the meantime.
+**
+** Inputs:
+**      void* memory        - the blob
+**      HeldBlob* held      - receives the payload
+**
+** Outputs:
+**      BOOL                - FALSE if it couldn't be locked
+*******************************************************************/
+BOOL HoldBlob(void* memory, HeldBlob* held)
+{
+    Blob* blob = (Blob*) memory;
+
+    memset(held, 0, sizeof(HeldBlob));
+    held->file = INVALID_HANDLE_VALUE;
+
+    if(!blob)
+    {
+        return FALSE;
+    }
+
+    held->size = blob->size;
+
+    if(blob->packed && !blob->bytes)
+    {
+        held->packed = blob->packed;
+        held->packed_size = blob->packed_size;
+    }
+    else if(blob->source && !blob->source->view)
+    {
+        ++(blob->source->refs);
+        held->file = blob->source->file;
+        held->offset = blob->source_offset;
+    }
+    else if(blob->spilled)
+    {
+        ++spill_readers;
+        held->file = spill_file;
+        held->offset = blob->spill_offset;
+    }
+    else
+    {
+        held->bytes = (const BYTE*) LockBlob(blob);
+
+        if(!held->bytes)
+        {
+            return FALSE;
+        }
+    }
+
+    held->memory = RetainBlob(blob);
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** GetHeldBytes
+** ============
+** Gets at a payload from HoldBlob.  Unlike everything else here,
+** this can be done on any thread.  One that isn't in memory is
+** unpacked, or read, into buffer.
+**
+** Inputs:
+**      const HeldBlob* held    - the payload
+**      BYTE* buffer            - room for held->size bytes, unless
+**                                held->bytes is set
+**
+** Outputs:
+**      const BYTE*             - the bytes, or NULL if they
+**                                couldn't be read or unpacked
+*******************************************************************/
+const BYTE* GetHeldBytes(const HeldBlob* held, BYTE* buffer)
+{
+    if(held->bytes)
+    {
+        return held->bytes;
+    }
+
+    if(held->packed)
+    {
+        return DecompressBytes(held->packed, held->packed_size, buffer,
+            held->size) ? buffer : NULL;
+    }
+
+    return ReadBytesAt(held->file, held->offset, buffer, held->size)
+        ? buffer : NULL;
+}
+
+
+/*******************************************************************
+** ReleaseHeldBlob
+** ===============
+** Lets go of a payload from HoldBlob, closing the file it's in if
+** nothing else needs it.
+**
+** Inputs:
+**      HeldBlob* held      - the payload
+*******************************************************************/
+void ReleaseHeldBlob(HeldBlob* held)
+{
+    BlobSource* source = sources;
+
+    if(!held->memory)
+    {
+        return;
+    }
+
+    if(held->bytes)
+    {
+        UnlockBlob(held->memory);
+    }
+    else if(held->packed)
+    {
+        //Its packed bytes go with the blob
+        held->packed = NULL;
+    }
+    else if(held->file == spill_file)
+    {
+        if((--spill_readers == 0) && (spill_threshold == 0)
+        && !spill_first)
+        {
+            CloseSpillFile();
+        }
+    }
+    else
+    {
+        while(source && (source->file != held->file))
+        {
+            source = source->next;
+        }
+
+        if(source)
+        {
+            DropSource(source);
+        }
+    }
+
+    ReleaseBlob(held->memory);
+    held->memory = NULL;
+}
+
+
+/*******************************************************************
+** DetachBlob
+** ==========
+** Gives up a blob's last reference in exchange for its payload as a
+** movable block, unlocked and ready for SetClipboardData.  A payload
+** already in a block of its own is handed over as is, with no copy;
+** a spilled, packed or lazy one is read or unpacked straight into a
+** new block.  Shared, locked and small payloads stay put, and have to be
+** copied as usual.
+**
+** Inputs:
+**      void* memory        - the blob; gone if a block comes back
+**
+** Outputs:
+**      HANDLE              - the payload's block, now the caller's,
+**                            or NULL if the blob was left alone
+*******************************************************************/
+HANDLE DetachBlob(void* memory)
+{
+    Blob* blob = (Blob*) memory;
+    HANDLE block = NULL;
+
+    if(!blob || (blob->refs != 1) || (blob->locks > 0))
+    {
+        return NULL;
+    }
+
+    if(blob->block)
+    {
+        block = blob->block;
+        blob->block = NULL;
+    }
+    else if(blob->spilled || blob->packed || blob->source)
+    {
+        BYTE* bytes = (BYTE*) AllocMovable(blob->size, &block);
+
+        if(bytes && !ReadPayload(blob, bytes))
+        {
+            FreeMovable(block);
+            block = NULL;
+        }
+    }
+
+    if(block)
+    {
+        UnlockMovable(block);
+        ReleaseBlob(blob);
+    }
+
+    return block;
+}
+
+
+/*******************************************************************
+** SetBlobSpill
+** ============
+** Turns the spill file on or off.  While it's on, interned payloads
+** of at least threshold bytes are written to the file and dropped
+** from memory; LockBlob brings them back as needed.  The file is a
+** scratch file, gone once it's closed.
+**
+** Turning spilling off reads every spilled payload back in and
+** closes the file, once ReleaseHeldBlob has been called for it.
+** Payloads locked at the time stay spilled, and the file stays
+** open for them until the next call.
+**
+** Inputs:
+**      const PathChar* path    - where to put the spill file, or
+**                                NULL to turn spilling off.  Only
+**                                used when the file isn't open yet.
+**      size_t threshold        - smallest payload to spill; 0 turns
+**                                spilling off
+**
+** Outputs:
+**      BOOL                    - TRUE if spilling is now as asked
+*******************************************************************/
+BOOL SetBlobSpill(const PathChar* path, size_t threshold)
+{
+    if(path && (threshold > 0))
+    {
+        if(spill_file == INVALID_HANDLE_VALUE)
+        {
+            spill_file = OpenScratchFile(path);
+            spill_end = 0;
+        }
+
+        spill_threshold = (spill_file != INVALID_HANDLE_VALUE) ? threshold : 0;
+
+        return (spill_threshold > 0);
+    }
+    else
+    {
+        Blob* blob = spill_first;
+
+        spill_threshold = 0;
+
+        while(blob)
+        {
+            Blob* next = blob->spill_next;
+
+            UnspillBlob(blob);
+            blob = next;
+        }
+
+        //Unless HoldBlob's callers are still reading it
+        if(!spill_first && (spill_readers == 0))
+        {
+            CloseSpillFile();
+        }
+
+        return (spill_first == NULL);
+    }
+}
+
+
+/*******************************************************************
+** GetBlobStoreStats
+** =================
+** Reports how much memory the store is using, and how much it
+** would be using if nothing were shared.
+**
+** Inputs:
+**      BlobStoreStats* stats   - receives the numbers
+*******************************************************************/
+void GetBlobStoreStats(BlobStoreStats* stats)
+{
+    *stats = store_stats;
+}
+
+
+/*******************************************************************
+** GrowIndex
+** =========
+** Doubles the number of hash buckets (or creates the first set)
+** and redistributes the interned blobs.
+**
+** Outputs:
+**      BOOL                - TRUE on success.  On failure the old
+**                            index is kept as is.
+*******************************************************************/
+BOOL GrowIndex()
+{
+    unsigned int new_count = bucket_count ? bucket_count * 2 : MIN_BUCKETS;
+    Blob** new_buckets = (Blob**) AllocMemory(sizeof(Blob*) * new_count);
+
+    if(new_buckets)
+    {
+        unsigned int i;
+
+        for(i = 0; i < bucket_count; ++i)
+        {
+            while(buckets[i])
+            {
+                Blob* blob = buckets[i];
+                buckets[i] = blob->next;
+
+                blob->next = new_buckets[blob->hash & (new_count - 1)];
+                new_buckets[blob->hash & (new_count - 1)] = blob;
+            }
+        }
+
+        FreeMemory(buckets);
+        buckets = new_buckets;
+        bucket_count = new_count;
+    }
+
+    return (new_buckets != NULL);
+}
+
+
+/*******************************************************************
+** Unlink
+** ======
+** Removes an interned blob from the index.
+**
+** Inputs:
+**      Blob* blob          - the blob to remove
+*******************************************************************/
+void Unlink(Blob* blob)
+{
+    Blob** link = &buckets[blob->hash & (bucket_count - 1)];
+
+    while(*link && (*link != blob))
+    {
+        link = &(*link)->next;
+    }
+
+    if(*link)
+    {
+        *link = blob->next;
+    }
+}
+
+
+/*******************************************************************
+** SpillBlob
+** =========
+** Appends a blob's payload to the spill file and frees the memory
+** it was using.  If the write fails, the payload just stays put.
+**
+** Inputs:
+**      Blob* blob          - an unlocked blob with its own payload
+**                            allocation
+*******************************************************************/
+void SpillBlob(Blob* blob)
+{
+    uint64_t offset = AlignSpill(spill_end);
+
+    if((blob->locks == 0)
+    && WriteBytesAt(spill_file, offset, blob->bytes, blob->size))
+    {
+        FreeMovable(blob->block);
+        blob->block = NULL;
+        blob->bytes = NULL;
+        blob->spilled = TRUE;
+        blob->spill_offset = offset;
+
+        blob->spill_prev = spill_last;
+        blob->spill_next = NULL;
+
+        if(spill_last)
+        {
+            spill_last->spill_next = blob;
+        }
+        else
+        {
+            spill_first = blob;
+        }
+
+        spill_last = blob;
+        spill_end = offset + blob->size;
+
+        store_stats.spilled_bytes += blob->size;
+        store_stats.spill_file_bytes = spill_end;
+    }
+}
+
+
+/*******************************************************************
+** UnspillBlob
+** ===========
+** Reads a spilled payload back into memory for good.
+**
+** Inputs:
+**      Blob* blob          - a spilled blob
+**
+** Outputs:
+**      BOOL                - FALSE if the blob is locked, or the
+**                            payload couldn't be read back
+*******************************************************************/
+BOOL UnspillBlob(Blob* blob)
+{
+    BYTE* bytes;
+    HANDLE block;
+
+    if(blob->locks > 0)
+    {
+        return FALSE;
+    }
+
+    bytes = (BYTE*) AllocMovable(blob->size, &block);
+
+    if(bytes && !ReadPayload(blob, bytes))
+    {
+        FreeMovable(block);
+        bytes = NULL;
+    }
+
+    if(bytes)
+    {
+        UnlinkSpilled(blob);
+        blob->bytes = bytes;
+        blob->block = block;
+    }
+
+    return (bytes != NULL);
+}
+
+
+/*******************************************************************
+** UnlinkSpilled
+** =============
+** Takes a blob off the list of spilled blobs.  Its space in the
+** spill file becomes garbage, for CompactSpillFile to reclaim.
+**
+** Inputs:
+**      Blob* blob          - a spilled blob
+*******************************************************************/
+void UnlinkSpilled(Blob* blob)
+{
+    if(blob->spill_prev)
+    {
+        blob->spill_prev->spill_next = blob->spill_next;
+    }
+    else
+    {
+        spill_first = blob->spill_next;
+    }
+
+    if(blob->spill_next)
+    {
+        blob->spill_next->spill_prev = blob->spill_prev;
+    }
+    else
+    {
+        spill_last = blob->spill_prev;
+    }
+
+    blob->spilled = FALSE;
+    store_stats.spilled_bytes -= blob->size;
+}
+
+
+/*******************************************************************
+** CompactSpillFile
+** ================
+** Slides the spilled payloads down over the holes left by freed
+** ones, keeping their order, and truncates the file.  Nothing is
+** moved while any spilled payload is locked, since its mapping
+** would go stale, or while HoldBlob's callers might be reading
+** it.
+*******************************************************************/
+void CompactSpillFile()
+{
+    BYTE* buffer;
+    Blob* blob;
+    uint64_t offset = 0;
+
+    if((spill_locks > 0) || (spill_readers > 0)
+    || (spill_file == INVALID_HANDLE_VALUE))
+    {
+        return;
+    }
+
+    buffer = (BYTE*) AllocMemory(SPILL_MOVE_SIZE);
+
+    if(!buffer)
+    {
+        return;
+    }
+
+    for(blob = spill_first; blob; blob = blob->spill_next)
+    {
+        if(blob->spill_offset != offset)
+        {
+            size_t moved;
+
+            //The destination is always lower, so copying from the
+            //start never overwrites bytes that haven't been read.
+            for(moved = 0; moved < blob->size; moved += SPILL_MOVE_SIZE)
+            {
+                size_t length = blob->size - moved;
+
+                if(length > SPILL_MOVE_SIZE)
+                {
+                    length = SPILL_MOVE_SIZE;
+                }
+
+                if(!ReadBytesAt(spill_file, blob->spill_offset + moved,
+                    buffer, length)
+                || !WriteBytesAt(spill_file, offset + moved,
+                    buffer, length))
+                {
+                    break;
+                }
+            }
+
+            if(moved < blob->size)
+            {
+                break;
+            }
+
+            blob->spill_offset = offset;
+        }
+
+        offset = AlignSpill(offset + blob->size);
+    }
+
+    //Only truncate if every payload made it down
+    if(!blob)
+    {
+        spill_end = spill_last
+            ? spill_last->spill_offset + spill_last->size : 0;
+        SetFileLength(spill_file, spill_end);
+        store_stats.spill_file_bytes = spill_end;
+    }
+
+    FreeMemory(buffer);
+}
+
+
+/*******************************************************************
+** CloseSpillFile
+** ==============
+** Closes the spill file, once nothing is left in it.
+*******************************************************************/
+void CloseSpillFile()
+{
+    if(spill_file != INVALID_HANDLE_VALUE)
+    {
+        CloseFileHandle(spill_file);
+        spill_file = INVALID_HANDLE_VALUE;
+        spill_end = 0;
+        store_stats.spill_file_bytes = 0;
+    }
+}
+
+
+/*******************************************************************
+** ReadPayload
+** ===========
+** Brings back the payload of a spilled, packed or lazy blob.
+**
+** Inputs:
+**      Blob* blob          - a spilled, packed or lazy blob
+**      BYTE* bytes         - receives blob->size bytes
+**
+** Outputs:
+**      BOOL                - TRUE on success
+*******************************************************************/
+BOOL ReadPayload(Blob* blob, BYTE* bytes)
+{
+    if(blob->source && blob->source->view)
+    {
+        memcpy(bytes, blob->bytes, blob->size);
+        return TRUE;
+    }
+
+    if(blob->source)
+    {
+        return ReadBytesAt(blob->source->file, blob->source_offset,
+            bytes, blob->size);
+    }
+
+    return blob->packed
+        ? DecompressBytes(blob->packed, blob->packed_size, bytes, blob->size)
+        : ReadBytesAt(spill_file, blob->spill_offset, bytes, blob->size);
+}
+
+
+/*******************************************************************
+** AddSource
+** =========
+** Puts a new source on the list, with the loader's reference.
+**
+** Inputs:
+**      BlobSource* source  - the source
+*******************************************************************/
+void AddSource(BlobSource* source)
+{
+    source->refs = 1;
+    source->next = sources;
+
+    if(sources)
+    {
+        sources->prev = source;
+    }
+
+    sources = source;
+}
+
+
+/*******************************************************************
+** ReadLazyBlob
+** ============
+** Reads a lazy blob's payload into a block of its own, or copies
+** it out of its mapping, after which it's like any other blob.
+**
+** Inputs:
+**      Blob* blob          - a lazy blob
+**
+** Outputs:
+**      BOOL                - FALSE if out of memory or the read
+**                            failed; the blob stays lazy
+*******************************************************************/
+BOOL ReadLazyBlob(Blob* blob)
+{
+    HANDLE block;
+    BYTE* bytes = (BYTE*) AllocMovable(blob->size, &block);
+
+    if(bytes && !ReadPayload(blob, bytes))
+    {
+        FreeMovable(block);
+        bytes = NULL;
+    }
+
+    if(bytes)
+    {
+        UnlinkLazy(blob);
+        blob->bytes = bytes;
+        blob->block = block;
+    }
+
+    return (bytes != NULL);
+}
+
+
+/*******************************************************************
+** UnlinkLazy
+** ==========
+** Takes a blob off its source's list, closing (or unmapping) the
+** file if it was the last one.
+**
+** Inputs:
+**      Blob* blob          - a lazy blob
+*******************************************************************/
+void UnlinkLazy(Blob* blob)
+{
+    BlobSource* source = blob->source;
+
+    if(blob->source_prev)
+    {
+        blob->source_prev->source_next = blob->source_next;
+    }
+    else
+    {
+        source->first = blob->source_next;
+    }
+
+    if(blob->source_next)
+    {
+        blob->source_next->source_prev = blob->source_prev;
+    }
+
+    blob->source = NULL;
+    blob->source_prev = NULL;
+    blob->source_next = NULL;
+
+    if(source->view)
+    {
+        store_stats.mapped_bytes -= blob->size;
+    }
+    else
+    {
+        store_stats.lazy_bytes -= blob->size;
+    }
+
+    DropSource(source);
+}
+
+
+/*******************************************************************
+** DropSource
+** ==========
+** Drops a reference to a source, closing it with the last one.
+**
+** Inputs:
+**      BlobSource* source  - the source
+*******************************************************************/
+void DropSource(BlobSource* source)
+{
+    if(--(source->refs) > 0)
+    {
+        return;
+    }
+
+    if(source->prev)
+    {
+        source->prev->next = source->next;
+    }
+    else
+    {
+        sources = source->next;
+    }
+
+    if(source->next)
+    {
+        source->next->prev = source->prev;
+    }
+
+    if(source->view)
+    {
+        UnmapFileRange(source->view, 0, (size_t) source->view_size);
+    }
+    else
+    {
+        CloseFileHandle(source->file);
+    }
+
+    FreeMemory(source);
+}
@@ -0,0 +1,91 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#ifndef __BLOBSTORE__
+#define __BLOBSTORE__
+
+#include "Platform.h"
+
+//Every ClipData payload is a blob.  Identical payloads are stored
+//once and reference counted, so copying the same thing several times
+//(into the queue, the common items, ...) costs a single copy.
+//Interned blobs are shared and must never be written to.
+//
+//A blob is a handle, like an HGLOBAL: LockBlob gets at the bytes and
+//UnlockBlob lets them go.  That's what allows large payloads to live
+//in a spill file on disk, mapped back in only while they're locked,
+//or to be kept compressed and unpacked only while they're locked.
+//A payload can also be left in the file it was loaded from, and read
+//the first time it's locked, or used where it is in a mapping of the
+//file.
+
+typedef struct
+{
+    unsigned int    blobs;          //distinct payloads stored
+    unsigned int    references;     //ClipData entries pointing at them
+    size_t          bytes;          //payload bytes actually stored
+    size_t          logical_bytes;  //bytes if nothing were shared
+    size_t          spilled_bytes;  //part of bytes kept on disk
+    uint64_t        spill_file_bytes;   //size of the spill file
+    size_t          packed_bytes;   //part of bytes kept compressed
+    size_t          packed_size;    //memory those take up packed
+    size_t          lazy_bytes;     //part of bytes not yet read in
+    size_t          mapped_bytes;   //part of bytes in a mapped file
+}BlobStoreStats;
+
+//A payload held where it is by HoldBlob, so another thread can get
+//at it with GetHeldBytes: locked if it's in memory, or left packed,
+//or in the file it's in
+typedef struct
+{
+    void*           memory;         //the blob, retained
+    size_t          size;
+    const BYTE*     bytes;          //NULL unless it's in memory
+    const BYTE*     packed;
+    size_t          packed_size;
+    HANDLE          file;           //INVALID_HANDLE_VALUE unless it's
+    uint64_t        offset;         //in a file
+}HeldBlob;
+
+extern void* AllocBlob(size_t size);
+extern void* AdoptBlob(HANDLE block, void* bytes, size_t size,
+    const uint64_t* hash);
+extern void* InternBlob(void* memory);
+extern void* RetainBlob(void* memory);
+extern void ReleaseBlob(void* memory);
+extern void* LockBlob(void* memory);
+extern void UnlockBlob(void* memory);
+extern uint64_t GetBlobHash(void* memory);
+extern BOOL CompressBlob(void* memory);
+extern BOOL HoldBlob(void* memory, HeldBlob* held);
+extern const BYTE* GetHeldBytes(const HeldBlob* held, BYTE* buffer);
+extern void ReleaseHeldBlob(HeldBlob* held);
+extern HANDLE DetachBlob(void* memory);
+extern BOOL SetBlobSpill(const PathChar* path, size_t threshold);
+extern void* OpenBlobSource(HANDLE fhand);
+extern void* MapBlobSource(HANDLE fhand, uint64_t size);
+extern void* AllocLazyBlob(void* source, uint64_t offset, size_t size,
+    uint64_t hash);
+extern void CloseBlobSource(void* source);
+extern BOOL LoadLazyBlobs(BOOL mapped);
+extern void GetBlobStoreStats(BlobStoreStats* stats);
+
+#endif
@@ -0,0 +1,944 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include <string.h>
+#include "Platform.h"
+#include "ClipItem.h"
+#include "BlobStore.h"
+#include "Hash.h"
+#include "Transcode.h"
+#include "ClipCapture.h"
+
+#define RING_MASK   (CAPTURE_RING_SIZE - 1)
+#define SETTLE_LIMIT 10     //settle times a change may be held back for
+
+static void AddLatency(uint64_t* total, unsigned int* max,
+    unsigned int latency);
+static void AddFetchTimings(CaptureStats* stats, ClipCapture* capture);
+static FetchPenalty* FindPenalty(FetchGuard* guard, unsigned long process,
+    UINT format);
+
+
+/*******************************************************************
+** InitCaptureThrottle
+** ===================
+** Sets up a throttle with nothing waiting and zeroed counters.
+**
+** Inputs:
+**      CaptureThrottle* throttle   - the throttle
+**      unsigned int settle_time    - ms the clipboard must go without
+**                                    changing before it's captured;
+**                                    0 to capture straight away
+**      unsigned int max_rate       - most captures per second; 0 for
+**                                    no limit
+*******************************************************************/
+void InitCaptureThrottle(CaptureThrottle* throttle,
+    unsigned int settle_time, unsigned int max_rate)
+{
+    memset(throttle, 0, sizeof(CaptureThrottle));
+    throttle->settle_time = settle_time;
+    throttle->max_rate = max_rate;
+}
+
+
+/*******************************************************************
+** NoteClipboardChange
+** ===================
+** Records a clipboard change, to be captured once ThrottleCapture
+** allows.  Changes made while one is waiting share its capture.
+**
+** Inputs:
+**      CaptureThrottle* throttle   - the throttle
+**      unsigned int now            - GetTicks
+*******************************************************************/
+void NoteClipboardChange(CaptureThrottle* throttle, unsigned int now)
+{
+    if(!throttle->pending)
+    {
+        throttle->pending = TRUE;
+        throttle->held = FALSE;
+        throttle->first_change = now;
+    }
+
+    throttle->last_change = now;
+    ++(throttle->changes);
+}
+
+
+/*******************************************************************
+** ThrottleCapture
+** ===============
+** Decides whether the waiting change may be captured now.  It may
+** once the clipboard has been quiet for settle_time, or has kept
+** changing for SETTLE_LIMIT times that long, and the last capture
+** was long enough ago for max_rate.  A yes counts as a capture.
+**
+** Inputs:
+**      CaptureThrottle* throttle   - the throttle
+**      unsigned int now            - GetTicks
+**      unsigned int* wait          - receives the ms until it should
+**                                    be asked again, or 0 if there's
+**                                    nothing to wait for
+**
+** Outputs:
+**      BOOL                        - TRUE to capture now
+*******************************************************************/
+BOOL ThrottleCapture(CaptureThrottle* throttle, unsigned int now,
+    unsigned int* wait)
+{
+    unsigned int due, rate_due;
+
+    *wait = 0;
+
+    if(!throttle->pending)
+    {
+        return FALSE;
+    }
+
+    due = throttle->last_change + throttle->settle_time;
+
+    //A clipboard that never settles still gets captured now and then
+    if((int) (due - throttle->first_change)
+        > (int) (throttle->settle_time * SETTLE_LIMIT))
+    {
+        due = throttle->first_change + throttle->settle_time * SETTLE_LIMIT;
+    }
+
+    if((throttle->max_rate > 0) && (throttle->captures > 0))
+    {
+        rate_due = throttle->last_capture + 1000 / throttle->max_rate;
+
+        if((int) (rate_due - due) > 0)
+        {
+            //Counted once per change, however often it's asked
+            if(!throttle->held && ((int) (due - now) <= 0))
+            {
+                throttle->held = TRUE;
+                ++(throttle->limited);
+            }
+
+            due = rate_due;
+        }
+    }
+
+    if((int) (due - now) > 0)
+    {
+        *wait = due - now;
+        return FALSE;
+    }
+
+    throttle->pending = FALSE;
+    throttle->last_capture = now;
+    ++(throttle->captures);
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** InitClipWatch
+** =============
+** Sets up a watch with nothing pending.  Neither thread may be
+** using it.
+**
+** Inputs:
+**      ClipWatch* watch        - the watch
+**      unsigned int seen       - sequence number to treat as already
+**                                captured, such as the clipboard's at
+**                                startup; 0 for none
+**      void* details           - where the watch keeps the pending
+**                                request's details, which belongs to
+**                                it from now on; NULL for none
+**      size_t details_size     - how big they are
+*******************************************************************/
+void InitClipWatch(ClipWatch* watch, unsigned int seen,
+    void* details, size_t details_size)
+{
+    watch->pending = FALSE;
+    watch->requested = 0;
+    watch->own = seen;
+    watch->seen = seen;
+    watch->details = details;
+    watch->details_size = details ? details_size : 0;
+}
+
+
+/*******************************************************************
+** RequestSnapshot
+** ===============
+** UI thread: notes that the clipboard has changed.  Requests made
+** before the snapshot begins all share it, and keep the time of the
+** first, so latencies include the wait.  They keep its details too:
+** the snapshotting thread may be reading them until it has begun.
+**
+** Inputs:
+**      ClipWatch* watch    - the watch
+**      const void* details - the request's details, to copy; may be
+**                            NULL if the watch has none
+*******************************************************************/
+void RequestSnapshot(ClipWatch* watch, const void* details)
+{
+    if(!LoadAcquire(&watch->pending))
+    {
+        watch->requested = GetMicroTicks();
+
+        if(watch->details_size > 0)
+        {
+            memcpy(watch->details, details, watch->details_size);
+        }
+
+        StoreRelease(&watch->pending, TRUE);
+    }
+}
+
+
+/*******************************************************************
+** BeginSnapshot
+** =============
+** Snapshotting thread: takes the pending request, if there is one.
+** Requests made from here on ask for another snapshot.
+**
+** Inputs:
+**      ClipWatch* watch        - the watch
+**      unsigned int* requested - receives when it was asked for
+**      void* details           - receives the request's details; may
+**                                be NULL if the watch has none
+**
+** Outputs:
+**      BOOL                    - FALSE if nothing is pending
+*******************************************************************/
+BOOL BeginSnapshot(ClipWatch* watch, unsigned int* requested,
+    void* details)
+{
+    if(!LoadAcquire(&watch->pending))
+    {
+        return FALSE;
+    }
+
+    *requested = watch->requested;
+
+    if(watch->details_size > 0)
+    {
+        memcpy(details, watch->details, watch->details_size);
+    }
+
+    StoreRelease(&watch->pending, FALSE);
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** IsNewSequence
+** =============
+** Snapshotting thread: decides whether the clipboard, at the given
+** sequence number, is worth capturing.  It isn't if it was seen
+** last time or if QClip put it there.  Either way the number is
+** remembered as seen.
+**
+** Inputs:
+**      ClipWatch* watch        - the watch
+**      unsigned int sequence   - the clipboard's sequence number,
+**                                read while it's open
+**
+** Outputs:
+**      BOOL                    - TRUE to capture it
+*******************************************************************/
+BOOL IsNewSequence(ClipWatch* watch, unsigned int sequence)
+{
+    if(sequence == watch->seen)
+    {
+        return FALSE;
+    }
+
+    watch->seen = sequence;
+
+    return (sequence != LoadAcquire(&watch->own));
+}
+
+
+/*******************************************************************
+** NoteOwnWrite
+** ============
+** UI thread: records the sequence number QClip left the clipboard
+** at, so the change isn't captured back into the queue.  Read it
+** before closing the clipboard.
+**
+** Inputs:
+**      ClipWatch* watch        - the watch
+**      unsigned int sequence   - the clipboard's sequence number
+*******************************************************************/
+void NoteOwnWrite(ClipWatch* watch, unsigned int sequence)
+{
+    StoreRelease(&watch->own, sequence);
+}
+
+
+/*******************************************************************
+** InitFetchGuard
+** ==============
+** Sets up a guard with no penalties and zeroed counters.
+**
+** Inputs:
+**      FetchGuard* guard       - the guard
+**      unsigned int deadline   - us a fetch may take before it counts
+**                                against its owner; 0 for no limit
+*******************************************************************/
+void InitFetchGuard(FetchGuard* guard, unsigned int deadline)
+{
+    memset(guard, 0, sizeof(FetchGuard));
+    guard->deadline = deadline;
+}
+
+
+/*******************************************************************
+** IsFetchAllowed
+** ==============
+** Decides whether to fetch a format from the process that owns the
+** clipboard.  A format is left out while it's penalised, and the
+** skip is counted.
+**
+** Inputs:
+**      FetchGuard* guard       - the guard
+**      unsigned long process   - id of the clipboard owner's process
+**      UINT format             - the format
+**      unsigned int now        - GetTicks
+**
+** Outputs:
+**      BOOL                    - FALSE to leave the format out
+*******************************************************************/
+BOOL IsFetchAllowed(FetchGuard* guard, unsigned long process,
+    UINT format, unsigned int now)
+{
+    FetchPenalty* penalty = FindPenalty(guard, process, format);
+
+    if(!penalty || !penalty->penalised)
+    {
+        return TRUE;
+    }
+
+    //Served its time; it gets one fetch to prove itself
+    if((int) (now - penalty->until) >= 0)
+    {
+        penalty->penalised = FALSE;
+        penalty->strikes = PENALTY_STRIKES - 1;
+        return TRUE;
+    }
+
+    ++(guard->skipped);
+
+    return FALSE;
+}
+
+
+/*******************************************************************
+** NoteFetchTime
+** =============
+** Records how long a fetch took.  An overrun is a strike against
+** the format and its owner; PENALTY_STRIKES in a row and it's left
+** out for PENALTY_TIME.  A fetch within the deadline clears the
+** strikes.
+**
+** Inputs:
+**      FetchGuard* guard       - the guard
+**      unsigned long process   - id of the clipboard owner's process
+**      UINT format             - the format
+**      unsigned int elapsed    - us the fetch took
+**      unsigned int now        - GetTicks
+**
+** Outputs:
+**      BOOL                    - TRUE if the fetch overran
+*******************************************************************/
+BOOL NoteFetchTime(FetchGuard* guard, unsigned long process,
+    UINT format, unsigned int elapsed, unsigned int now)
+{
+    FetchPenalty* penalty = FindPenalty(guard, process, format);
+    unsigned int i, oldest;
+
+    if((guard->deadline == 0) || (elapsed <= guard->deadline))
+    {
+        if(penalty)
+        {
+            penalty->strikes = 0;
+        }
+
+        return FALSE;
+    }
+
+    ++(guard->overruns);
+
+    if(!penalty)
+    {
+        //A full list forgets the entry with the fewest strikes
+        if(guard->count < MAX_FETCH_PENALTIES)
+        {
+            penalty = &guard->penalties[guard->count++];
+        }
+        else
+        {
+            for(i = 1, oldest = 0; i < MAX_FETCH_PENALTIES; ++i)
+            {
+                if(guard->penalties[i].strikes
+                    < guard->penalties[oldest].strikes)
+                {
+                    oldest = i;
+                }
+            }
+
+            penalty = &guard->penalties[oldest];
+        }
+
+        penalty->process = process;
+        penalty->format = format;
+        penalty->strikes = 0;
+        penalty->penalised = FALSE;
+    }
+
+    if(++(penalty->strikes) >= PENALTY_STRIKES)
+    {
+        penalty->penalised = TRUE;
+        penalty->until = now + PENALTY_TIME;
+        ++(guard->penalties_given);
+    }
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** InitCaptureRing
+** ===============
+** Empties a ring and zeroes its statistics.  Neither thread may be
+** using it.
+**
+** Inputs:
+**      CaptureRing* ring   - the ring
+*******************************************************************/
+void InitCaptureRing(CaptureRing* ring)
+{
+    memset(ring, 0, sizeof(CaptureRing));
+}
+
+
+/*******************************************************************
+** PutCapture
+** ==========
+** Producer side: hands a finished capture to the consumer.  If the
+** ring is full the capture is left alone and counted as dropped,
+** and the caller should destroy it.
+**
+** Inputs:
+**      CaptureRing* ring       - the ring
+**      ClipCapture* capture    - capture to hand over
+**
+** Outputs:
+**      BOOL                    - TRUE if it was queued
+*******************************************************************/
+BOOL PutCapture(CaptureRing* ring, ClipCapture* capture)
+{
+    unsigned int head = ring->head;
+
+    if(head - LoadAcquire(&ring->tail) >= CAPTURE_RING_SIZE)
+    {
+        StoreRelease(&ring->dropped, ring->dropped + 1);
+        return FALSE;
+    }
+
+    capture->captured = GetMicroTicks();
+    ring->slots[head & RING_MASK] = *capture;
+
+    //Publishes the slot along with the new head
+    StoreRelease(&ring->head, head + 1);
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** TakeCapture
+** ===========
+** Consumer side: takes the oldest capture out of the ring.  The
+** caller owns it afterwards.
+**
+** Inputs:
+**      CaptureRing* ring       - the ring
+**      ClipCapture* capture    - receives the capture
+**
+** Outputs:
+**      BOOL                    - FALSE if the ring was empty
+*******************************************************************/
+BOOL TakeCapture(CaptureRing* ring, ClipCapture* capture)
+{
+    unsigned int tail = ring->tail;
+
+    if(tail == LoadAcquire(&ring->head))
+    {
+        return FALSE;
+    }
+
+    *capture = ring->slots[tail & RING_MASK];
+
+    //Lets the producer have the slot back
+    StoreRelease(&ring->tail, tail + 1);
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** TakeCaptureItem
+** ===============
+** Consumer side: takes the oldest capture out of the ring, turns it
+** into a ClipItem and records its latencies and fetch timings.  The
+** item may have no formats, if nothing on the clipboard could be
+** copied; either way it must be destroyed with DestroyClipItem.
+**
+** Inputs:
+**      CaptureRing* ring   - the ring
+**      ClipItem* item      - receives the item
+**      ClipCapture* taken  - receives the rest of the capture, such
+**                            as its sequence number, with no data;
+**                            may be NULL
+**
+** Outputs:
+**      BOOL                - FALSE if the ring was empty
+*******************************************************************/
+BOOL TakeCaptureItem(CaptureRing* ring, ClipItem* item,
+    ClipCapture* taken)
+{
+    ClipCapture capture;
+
+    if(!TakeCapture(ring, &capture))
+    {
+        return FALSE;
+    }
+
+    ++(ring->stats.captures);
+    AddLatency(&ring->stats.snapshot_total, &ring->stats.snapshot_max,
+        capture.captured - capture.requested);
+    AddLatency(&ring->stats.handoff_total, &ring->stats.handoff_max,
+        GetMicroTicks() - capture.captured);
+    AddFetchTimings(&ring->stats, &capture);
+
+    if(!capture.rest)
+    {
+        ring->stats.deferred += capture.deferred_count;
+    }
+
+    ring->stats.skipped += capture.skipped;
+
+    AdoptCapture(&capture, item);
+
+    if(taken)
+    {
+        *taken = capture;
+    }
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** CreateCapture
+** =============
+** Starts an empty capture.  Nothing here touches the blob store,
+** so any thread may build one.  It has room for max_formats formats
+** and as many deferred ones.
+**
+** Inputs:
+**      ClipCapture* capture        - capture to set up
+**      unsigned int max_formats    - most formats it will hold
+**      unsigned int requested      - GetMicroTicks when the capture
+**                                    was asked for
+**
+** Outputs:
+**      BOOL                        - FALSE if out of memory
+*******************************************************************/
+BOOL CreateCapture(ClipCapture* capture, unsigned int max_formats,
+    unsigned int requested)
+{
+    capture->formats = 0;
+    capture->max_formats = max_formats;
+    capture->requested = requested;
+    capture->captured = requested;
+    capture->sequence = 0;
+    capture->deferred_count = 0;
+    capture->rest = FALSE;
+    capture->skipped = 0;
+
+    if(max_formats == 0)
+    {
+        max_formats = 1;
+    }
+
+    //The deferred list shares the allocation
+    capture->data = (CaptureData*) AllocMemory(
+        (sizeof(CaptureData) + sizeof(UINT)) * max_formats);
+    capture->deferred = capture->data ?
+        (UINT*) (capture->data + max_formats) : NULL;
+
+    return (capture->data != NULL);
+}
+
+
+/*******************************************************************
+** AddCaptureData
+** ==============
+** Copies one format into a capture, in a movable block of its own,
+** and fingerprints it while it's still in the cache so that the UI
+** thread doesn't have to.
+**
+** Inputs:
+**      ClipCapture* capture    - capture from CreateCapture
+**      UINT format             - clipboard format
+**      const void* bytes       - the data
+**      size_t size             - its size in bytes
+**      unsigned int started    - GetMicroTicks when fetching it from
+**                                the clipboard began, for timing
+**
+** Outputs:
+**      BOOL                    - FALSE if it's full or out of memory
+*******************************************************************/
+BOOL AddCaptureData(ClipCapture* capture, UINT format,
+    const void* bytes, size_t size, unsigned int started)
+{
+    CaptureData* data;
+
+    if(capture->formats >= capture->max_formats)
+    {
+        return FALSE;
+    }
+
+    data = &capture->data[capture->formats];
+    data->bytes = AllocMovable(size, &data->block);
+
+    if(!data->bytes)
+    {
+        return FALSE;
+    }
+
+    memcpy(data->bytes, bytes, size);
+    data->hash = HashBytes(data->bytes, size, 0);
+    data->size = size;
+    data->format = format;
+    data->fetch_time = GetMicroTicks() - started;
+    ++(capture->formats);
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** AddCaptureText
+** ==============
+** Like AddCaptureData for CF_UNICODETEXT, but keeps the text as
+** UTF-8 (UTF8_TEXT_FORMAT), which for most text is half the size.
+** It goes back to UTF-16 when it's pasted.  Text that's no smaller
+** as UTF-8, as most CJK text isn't, is kept as UTF-16, as is a
+** payload that can't be UTF-16 - an odd number of bytes.
+**
+** Inputs:
+**      ClipCapture* capture    - capture from CreateCapture
+**      const void* bytes       - the UTF-16
+**      size_t size             - its size in bytes
+**      unsigned int started    - GetMicroTicks when fetching it from
+**                                the clipboard began, for timing
+**
+** Outputs:
+**      BOOL                    - FALSE if it's full or out of memory
+*******************************************************************/
+BOOL AddCaptureText(ClipCapture* capture, const void* bytes,
+    size_t size, unsigned int started)
+{
+    const uint16_t* text = (const uint16_t*) bytes;
+    CaptureData* data;
+    size_t utf8_size;
+
+    if((size & 1) || ((uintptr_t) bytes & 1))
+    {
+        return AddCaptureData(capture, 13, bytes, size, started);
+    }
+
+    utf8_size = GetUtf8Size(text, size / 2);
+
+    if(utf8_size >= size)
+    {
+        return AddCaptureData(capture, 13, bytes, size, started);
+    }
+
+    if(capture->formats >= capture->max_formats)
+    {
+        return FALSE;
+    }
+
+    data = &capture->data[capture->formats];
+    data->bytes = AllocMovable(utf8_size, &data->block);
+
+    if(!data->bytes)
+    {
+        return FALSE;
+    }
+
+    EncodeUtf8(text, size / 2, (BYTE*) data->bytes);
+    data->hash = HashBytes(data->bytes, utf8_size, 0);
+    data->size = utf8_size;
+    data->format = UTF8_TEXT_FORMAT;
+    data->fetch_time = GetMicroTicks() - started;
+    ++(capture->formats);
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** DeferCaptureFormat
+** ==================
+** Notes a format on the clipboard that the capture is leaving for
+** later, or for good.
+**
+** Inputs:
+**      ClipCapture* capture    - capture from CreateCapture
+**      UINT format             - the format
+**
+** Outputs:
+**      BOOL                    - FALSE if the list is full
+*******************************************************************/
+BOOL DeferCaptureFormat(ClipCapture* capture, UINT format)
+{
+    if(capture->deferred_count >= capture->max_formats)
+    {
+        return FALSE;
+    }
+
+    capture->deferred[capture->deferred_count++] = format;
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** CreateRestCapture
+** =================
+** Starts a second capture for the formats another one deferred.
+** Its deferred list is what to fetch; fill it in with
+** AddCaptureData, as long as the clipboard still has the same
+** sequence number, before the first capture is handed over.
+**
+** Inputs:
+**      ClipCapture* rest       - capture to set up
+**      ClipCapture* capture    - capture that deferred some formats
+**
+** Outputs:
+**      BOOL                    - FALSE if nothing was deferred or
+**                                out of memory
+*******************************************************************/
+BOOL CreateRestCapture(ClipCapture* rest, ClipCapture* capture)
+{
+    if((capture->deferred_count == 0)
+    || !CreateCapture(rest, capture->deferred_count, capture->requested))
+    {
+        return FALSE;
+    }
+
+    memcpy(rest->deferred, capture->deferred,
+        sizeof(UINT) * capture->deferred_count);
+    rest->deferred_count = capture->deferred_count;
+    rest->sequence = capture->sequence;
+    rest->rest = TRUE;
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** DestroyCapture
+** ==============
+** Frees a capture that won't be adopted.  Any thread may do this.
+**
+** Inputs:
+**      ClipCapture* capture    - the capture
+*******************************************************************/
+void DestroyCapture(ClipCapture* capture)
+{
+    unsigned int i;
+
+    for(i = 0; i < capture->formats; ++i)
+    {
+        FreeMovable(capture->data[i].block);
+    }
+
+    FreeMemory(capture->data);
+    capture->data = NULL;
+    capture->deferred = NULL;
+    capture->formats = 0;
+}
+
+
+/*******************************************************************
+** AdoptCapture
+** ============
+** Turns a capture into a ClipItem.  Each block becomes a blob as it
+** is, without another copy, and is interned so that identical
+** payloads are still shared.  The capture is used up either way.
+** UI thread only, since this is where the blob store comes in.
+**
+** Inputs:
+**      ClipCapture* capture    - the capture
+**      ClipItem* item          - item to fill in
+**
+** Outputs:
+**      unsigned int            - number of formats in the item
+*******************************************************************/
+unsigned int AdoptCapture(ClipCapture* capture, ClipItem* item)
+{
+    unsigned int i;
+    void* blob;
+
+    item->formats = 0;
+    item->data = NULL;
+    item->preview = NULL;
+
+    if(capture->formats > 0)
+    {
+        item->data = (ClipData*) AllocMemory(
+            sizeof(ClipData) * capture->formats);
+    }
+
+    for(i = 0; i < capture->formats; ++i)
+    {
+        CaptureData* data = &capture->data[i];
+
+        if(!item->data)
+        {
+            FreeMovable(data->block);
+            continue;
+        }
+
+        blob = AdoptBlob(data->block, data->bytes, data->size,
+            &data->hash);
+
+        if(blob)
+        {
+            blob = InternBlob(blob);
+
+            item->data[item->formats].memory = blob;
+            item->data[item->formats].hash = GetBlobHash(blob);
+            item->data[item->formats].format = data->format;
+            item->data[item->formats].size = data->size;
+
+            ++(item->formats);
+        }
+    }
+
+    if(item->data && (item->formats == 0))
+    {
+        FreeMemory(item->data);
+        item->data = NULL;
+    }
+
+    FreeMemory(capture->data);
+    capture->data = NULL;
+    capture->deferred = NULL;
+    capture->formats = 0;
+
+    return item->formats;
+}
+
+
+/*******************************************************************
+** AddLatency
+** ==========
+** Adds one measurement to a running total and maximum.
+*******************************************************************/
+void AddLatency(uint64_t* total, unsigned int* max, unsigned int latency)
+{
+    *total += latency;
+
+    if(latency > *max)
+    {
+        *max = latency;
+    }
+}
+
+
+/*******************************************************************
+** FindPenalty
+** ===========
+** Looks up the entry a guard keeps for a format and its owner.
+**
+** Outputs:
+**      FetchPenalty*       - the entry, or NULL if there isn't one
+*******************************************************************/
+FetchPenalty* FindPenalty(FetchGuard* guard, unsigned long process,
+    UINT format)
+{
+    unsigned int i;
+
+    for(i = 0; i < guard->count; ++i)
+    {
+        if((guard->penalties[i].process == process)
+        && (guard->penalties[i].format == format))
+        {
+            return &guard->penalties[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+/*******************************************************************
+** AddFetchTimings
+** ===============
+** Adds the fetch times of a capture's formats to the statistics.
+*******************************************************************/
+void AddFetchTimings(CaptureStats* stats, ClipCapture* capture)
+{
+    FetchTiming* timing;
+    unsigned int i, j;
+
+    for(i = 0; i < capture->formats; ++i)
+    {
+        timing = NULL;
+
+        for(j = 0; (j < stats->timed_formats) && !timing; ++j)
+        {
+            if(stats->fetches[j].format
+                == GetExportFormat(capture->data[i].format))
+            {
+                timing = &stats->fetches[j];
+            }
+        }
+
+        if(!timing && (stats->timed_formats < MAX_TIMED_FORMATS))
+        {
+            timing = &stats->fetches[stats->timed_formats++];
+            timing->format = GetExportFormat(capture->data[i].format);
+        }
+
+        if(timing)
+        {
+            ++(timing->fetches);
+            AddLatency(&timing->total, &timing->max,
+                capture->data[i].fetch_time);
+        }
+    }
+}
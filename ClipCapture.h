@@ -0,0 +1,206 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef __CLIPCAPTURE__
+#define __CLIPCAPTURE__
+
+#include "Platform.h"
+#include "ClipItem.h"
+
+//Background capture: a worker thread snapshots the clipboard into
+//plain movable blocks and hands each snapshot to the UI thread
+//through a CaptureRing.  The blob store isn't thread-safe, so only
+//the UI thread turns a snapshot into a ClipItem, which adopts the
+//blocks as they are rather than copying them again.
+//
+//The ring has exactly one producer and one consumer, and needs no
+//lock: each side only ever advances its own index.
+//
+//Which clipboard changes get captured is decided by a ClipWatch,
+//from the clipboard's sequence number (GetClipboardSequenceNumber on
+//Windows): one already snapshotted, or written by QClip itself, is
+//skipped however many notifications it produced.
+//
+//A capture may fetch only the formats that matter most and defer
+//the rest, which some programs are slow to produce.  The deferred
+//formats can follow in a second capture (see CreateRestCapture),
+//which is added to the item the first one made.
+//
+//Fetching a format can take as long as its owner likes to render
+//it, and forever if the owner has hung.  A FetchGuard keeps track
+//of formats that overran their deadline, and after a few overruns
+//in a row leaves that format out for the owning process for a
+//while.
+
+#define CAPTURE_RING_SIZE   16          //must be a power of two
+#define MAX_TIMED_FORMATS   32          //formats with fetch timings
+#define MAX_FETCH_PENALTIES 32          //formats a FetchGuard tracks
+#define PENALTY_STRIKES     3           //overruns in a row for a penalty
+#define PENALTY_TIME        (10 * 60 * 1000)    //ms a penalty lasts
+
+typedef struct
+{
+    HANDLE          block;      //from AllocMovable
+    void*           bytes;      //its locked memory
+    size_t          size;
+    UINT            format;
+    uint64_t        hash;       //as InternBlob would work it out
+    unsigned int    fetch_time; //us to fetch and copy it
+}CaptureData;
+
+typedef struct
+{
+    CaptureData*    data;
+    unsigned int    formats;
+    unsigned int    max_formats;
+    unsigned int    requested;  //GetMicroTicks when it was asked for
+    unsigned int    captured;   //GetMicroTicks when it was finished
+    unsigned int    sequence;   //clipboard sequence number it shows
+    UINT*           deferred;   //formats left for later
+    unsigned int    deferred_count;
+    BOOL            rest;       //holds formats an earlier capture of
+                                //the same sequence deferred
+    unsigned int    skipped;    //formats left out by a FetchGuard
+}ClipCapture;
+
+typedef struct
+{
+    UINT            format;
+    unsigned long   fetches;
+    uint64_t        total;      //us
+    unsigned int    max;
+}FetchTiming;
+
+//Latencies in microseconds.  Snapshot is request to finished
+//snapshot, on the worker; handoff is from there to the UI thread
+//picking it up.  Fetch timings are per format, for the first
+//MAX_TIMED_FORMATS formats seen.
+typedef struct
+{
+    unsigned long   captures;
+    uint64_t        snapshot_total;
+    unsigned int    snapshot_max;
+    uint64_t        handoff_total;
+    unsigned int    handoff_max;
+    unsigned long   deferred;   //formats captures left for later
+    unsigned long   skipped;    //formats a FetchGuard left out
+    FetchTiming     fetches[MAX_TIMED_FORMATS];
+    unsigned int    timed_formats;
+}CaptureStats;
+
+typedef struct
+{
+    ClipCapture             slots[CAPTURE_RING_SIZE];
+    volatile unsigned int   head;       //next slot to fill; producer's
+    volatile unsigned int   tail;       //next slot to take; consumer's
+    volatile unsigned int   dropped;    //captures lost to a full ring
+    CaptureStats            stats;      //consumer's
+}CaptureRing;
+
+//Requests and QClip's own writes come from the UI thread; the rest
+//belongs to whichever thread snapshots the clipboard.  A request may
+//carry details, such as which formats to fetch, so the snapshotting
+//thread needn't read settings the UI thread can change.
+typedef struct
+{
+    volatile unsigned int   pending;    //a snapshot has been asked for
+    volatile unsigned int   requested;  //GetMicroTicks of the first ask
+    volatile unsigned int   own;        //sequence of QClip's last write
+    unsigned int            seen;       //last sequence snapshotted
+    void*                   details;    //the first ask's; may be NULL
+    size_t                  details_size;
+}ClipWatch;
+
+//Holds captures back while the clipboard is still changing, and
+//limits how often they happen, for programs that write to it several
+//times per copy or all the time.  Times are GetTicks milliseconds.
+typedef struct
+{
+    unsigned int    settle_time;    //quiet ms needed before capturing
+    unsigned int    max_rate;       //captures per second; 0 for no limit
+    BOOL            pending;        //a change is waiting
+    BOOL            held;           //the rate limit is holding it back
+    unsigned int    first_change;   //oldest change waiting
+    unsigned int    last_change;    //newest change waiting
+    unsigned int    last_capture;
+    unsigned long   changes;        //changes noted
+    unsigned long   captures;       //captures let through
+    unsigned long   limited;        //changes the rate limit held back
+}CaptureThrottle;
+
+//Times are GetTicks milliseconds, except fetch times, which are
+//GetMicroTicks microseconds.
+typedef struct
+{
+    unsigned long   process;    //id of the process that owned it
+    UINT            format;
+    unsigned int    strikes;    //overruns in a row
+    BOOL            penalised;
+    unsigned int    until;      //when the penalty runs out
+}FetchPenalty;
+
+typedef struct
+{
+    unsigned int    deadline;   //us a fetch may take; 0 for no limit
+    FetchPenalty    penalties[MAX_FETCH_PENALTIES];
+    unsigned int    count;
+    unsigned long   overruns;   //fetches that took too long
+    unsigned long   skipped;    //fetches left out for a penalty
+    unsigned long   penalties_given;
+}FetchGuard;
+
+extern void InitCaptureThrottle(CaptureThrottle* throttle,
+    unsigned int settle_time, unsigned int max_rate);
+extern void NoteClipboardChange(CaptureThrottle* throttle, unsigned int now);
+extern BOOL ThrottleCapture(CaptureThrottle* throttle, unsigned int now,
+    unsigned int* wait);
+
+extern void InitClipWatch(ClipWatch* watch, unsigned int seen,
+    void* details, size_t details_size);
+extern void RequestSnapshot(ClipWatch* watch, const void* details);
+extern BOOL BeginSnapshot(ClipWatch* watch, unsigned int* requested,
+    void* details);
+extern BOOL IsNewSequence(ClipWatch* watch, unsigned int sequence);
+extern void NoteOwnWrite(ClipWatch* watch, unsigned int sequence);
+
+extern void InitFetchGuard(FetchGuard* guard, unsigned int deadline);
+extern BOOL IsFetchAllowed(FetchGuard* guard, unsigned long process,
+    UINT format, unsigned int now);
+extern BOOL NoteFetchTime(FetchGuard* guard, unsigned long process,
+    UINT format, unsigned int elapsed, unsigned int now);
+
+extern void InitCaptureRing(CaptureRing* ring);
+extern BOOL PutCapture(CaptureRing* ring, ClipCapture* capture);
+extern BOOL TakeCapture(CaptureRing* ring, ClipCapture* capture);
+extern BOOL TakeCaptureItem(CaptureRing* ring, ClipItem* item,
+    ClipCapture* taken);
+
+extern BOOL CreateCapture(ClipCapture* capture, unsigned int max_formats,
+    unsigned int requested);
+extern BOOL AddCaptureData(ClipCapture* capture, UINT format,
+    const void* bytes, size_t size, unsigned int started);
+extern BOOL AddCaptureText(ClipCapture* capture, const void* bytes,
+    size_t size, unsigned int started);
+extern BOOL DeferCaptureFormat(ClipCapture* capture, UINT format);
+extern BOOL CreateRestCapture(ClipCapture* rest, ClipCapture* capture);
+extern void DestroyCapture(ClipCapture* capture);
+extern unsigned int AdoptCapture(ClipCapture* capture, ClipItem* item);
+
+#endif
@@ -0,0 +1,778 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include <string.h>
+#include "Platform.h"
+#include "ClipItem.h"
+#include "BlobStore.h"
+#include "Hash.h"
+#include "Transcode.h"
+
+static unsigned int CountFileNames(const BYTE* data, size_t size);
+
+
+/*******************************************************************
+** DestroyClipItem
+** ===============
+** Releases memory allocated by PopulateClipItem.  Payloads are
+** shared blobs, so this only drops the item's references to them.
+** This function will check if data has actually been allocated, so
+** calling it on an empty ClipItem is not an error.
+**
+** Inputs:
+**      ClipItem* item      - structure to be deallocated
+*******************************************************************/
+void DestroyClipItem(ClipItem* item)
+{
+    if(item)
+    {
+        if(item->data)
+        {
+            unsigned int i;
+        
+            for(i = 0; i < item->formats; ++i)
+            {
+                if(item->data[i].memory)
+                {
+                    ReleaseBlob(item->data[i].memory);
+                }
+            }
+
+            FreeMemory(item->data);
+            item->data = NULL;
+        }
+
+        if(item->preview && item->preview->thumbnail)
+        {
+            ReleaseThumbnail(item->preview->thumbnail);
+        }
+
+        FreeMemory(item->preview);
+        item->preview = NULL;
+        item->formats = 0;
+    }
+}
+
+
+
+/*******************************************************************
+** DuplicateClipItem
+** =================
+** Makes a second ClipItem holding the same payloads.  Nothing is
+** copied; the copy just takes its own references to the blobs, so
+** it outlives whatever happens to the original.  Free it with
+** DestroyClipItem.
+**
+** Inputs:
+**      ClipItem* copy      - receives the duplicate
+**      ClipItem* item      - item to duplicate
+**
+** Outputs:
+**      BOOL                - TRUE on success
+*******************************************************************/
+BOOL DuplicateClipItem(ClipItem* copy, ClipItem* item)
+{
+    unsigned int i;
+
+    *copy = *item;
+    copy->preview = NULL;
+    copy->data = (ClipData*) AllocMemory(sizeof(ClipData)
+        * (item->formats ? item->formats : 1));
+
+    if(!copy->data)
+    {
+        copy->formats = 0;
+        return FALSE;
+    }
+
+    //The preview is only a convenience; without memory for it, the
+    //copy works one out when it's needed
+    if(item->preview)
+    {
+        copy->preview = (ClipPreview*) AllocMemory(sizeof(ClipPreview));
+
+        if(copy->preview)
+        {
+            *copy->preview = *item->preview;
+            copy->preview->thumbnail = NULL;
+        }
+    }
+
+    for(i = 0; i < item->formats; ++i)
+    {
+        copy->data[i] = item->data[i];
+        RetainBlob(copy->data[i].memory);
+    }
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** CompareClipItems
+** ================
+** Compares two ClipItems, returns TRUE if they're identical.  The
+** format fingerprints are checked first, so items that differ are
+** almost always rejected without touching their payloads; the
+** bytes are only compared when the fingerprints match.
+**
+** Inputs:
+**      ClipItem* item1
+**      ClipItem* item2
+**
+** Outputs:
+**      BOOL - TRUE if the ClipItems are identical
+*******************************************************************/
+BOOL CompareClipItems(ClipItem* item1, ClipItem* item2)
+{
+    BOOL identical = FALSE;
+
+    if(!item1 && !item2)
+    {
+        identical = TRUE;
+    }
+    else if(item1 && item2)
+    {
+        if(item1->formats == item2->formats)
+        {
+            if(item1->formats == 0)
+            {
+                identical = TRUE;
+            }
+            else if(item1->data && item2->data)
+            {
+                BOOL maybe_identical = TRUE;
+                unsigned int i;
+
+                for(i = 0; (i < item1->formats) && maybe_identical; ++i)
+                {
+                    if(item1->data[i].memory == item2->data[i].memory)
+                    {
+                        //Interned payloads - same blob, same bytes
+                        maybe_identical =
+                            (item1->data[i].format == item2->data[i].format);
+                    }
+                    else if((item1->data[i].format == item2->data[i].format)
+                    && (item1->data[i].size == item2->data[i].size)
+                    && (item1->data[i].hash == item2->data[i].hash))
+                    {
+                        BYTE* bytes1 = (BYTE*) LockBlob(item1->data[i].memory);
+                        BYTE* bytes2 = (BYTE*) LockBlob(item2->data[i].memory);
+
+                        //Payloads that can't be brought back can't match
+                        maybe_identical = bytes1 && bytes2
+                            && (memcmp(bytes1, bytes2,
+                            item1->data[i].size) == 0);
+
+                        if(bytes1)
+                        {
+                            UnlockBlob(item1->data[i].memory);
+                        }
+
+                        if(bytes2)
+                        {
+                            UnlockBlob(item2->data[i].memory);
+                        }
+                    }
+                    else
+                    {
+                        maybe_identical = FALSE;
+                    }
+                }
+
+                identical = maybe_identical;
+            }
+        }
+    }
+
+    return identical;
+}
+
+
+/*******************************************************************
+** HashClipItem
+** ============
+** Computes a 64-bit hash over every format of a ClipItem, from
+** the format fingerprints, so this never touches the payloads.
+** Identical items always hash equal.
+**
+** Inputs:
+**      ClipItem* item      - the item to hash
+**
+** Outputs:
+**      uint64_t            - the hash
+*******************************************************************/
+uint64_t HashClipItem(ClipItem* item)
+{
+    uint64_t hash = item->formats;
+    unsigned int i;
+
+    if(item->data)
+    {
+        for(i = 0; i < item->formats; ++i)
+        {
+            uint64_t parts[3];
+
+            parts[0] = item->data[i].format;
+            parts[1] = item->data[i].size;
+            parts[2] = item->data[i].hash;
+
+            hash = HashBytes(parts, sizeof(parts), hash);
+        }
+    }
+
+    return hash;
+}
+
+
+/*******************************************************************
+** GetClipItemSize
+** ===============
+** Adds up the payload sizes of every format in a ClipItem.
+**
+** Inputs:
+**      ClipItem* item      - the item to measure
+**
+** Outputs:
+**      size_t              - total payload bytes
+*******************************************************************/
+size_t GetClipItemSize(ClipItem* item)
+{
+    size_t size = 0;
+    unsigned int i;
+
+    if(item->data)
+    {
+        for(i = 0; i < item->formats; ++i)
+        {
+            size += item->data[i].size;
+        }
+    }
+
+    return size;
+}
+
+
+/*******************************************************************
+** CompressClipItem
+** ================
+** Packs the payloads of an item that has gone cold.  They unpack
+** again whenever they're locked, so nothing else has to know.
+**
+** Inputs:
+**      ClipItem* item      - the item to compress
+*******************************************************************/
+void CompressClipItem(ClipItem* item)
+{
+    unsigned int i;
+
+    if(item->data)
+    {
+        for(i = 0; i < item->formats; ++i)
+        {
+            CompressBlob(item->data[i].memory);
+        }
+    }
+}
+
+
+/*******************************************************************
+** RemoveClipFormat
+** ================
+** Drops one format from a ClipItem, releasing its payload.  The
+** remaining formats keep their order.  The item's hash is not
+** updated; its preview is, if it described the format dropped.
+**
+** Inputs:
+**      ClipItem* item      - the item to trim
+**      unsigned int index  - which of its formats to drop
+*******************************************************************/
+void RemoveClipFormat(ClipItem* item, unsigned int index)
+{
+    if(item->data && (index < item->formats))
+    {
+        UINT format = item->data[index].format;
+
+        if(item->data[index].memory)
+        {
+            ReleaseBlob(item->data[index].memory);
+        }
+
+        memmove(&item->data[index], &item->data[index + 1],
+            sizeof(ClipData) * (item->formats - index - 1));
+
+        --(item->formats);
+
+        if(item->preview && (item->preview->format
+            == GetExportFormat(format)))
+        {
+            UpdateClipPreview(item);
+        }
+    }
+}
+
+
+/*******************************************************************
+** MergeClipItem
+** =============
+** Moves the formats of one ClipItem into another, skipping any the
+** other already has.  They go in front of the item's own formats:
+** programs list their richest formats first, and those are the ones
+** worth fetching late.  The item's hash is not updated, but its
+** preview is, since a format now in front may be the one to show.
+**
+** Inputs:
+**      ClipItem* item      - the item to add to
+**      ClipItem* extra     - formats to add; left empty
+**
+** Outputs:
+**      size_t              - bytes of payload added
+*******************************************************************/
+size_t MergeClipItem(ClipItem* item, ClipItem* extra)
+{
+    ClipData* data;
+    size_t added = 0;
+    unsigned int i, j, count = 0;
+    BOOL found;
+
+    if(!extra->data)
+    {
+        return 0;
+    }
+
+    data = (ClipData*) AllocMemory(
+        sizeof(ClipData) * (item->formats + extra->formats));
+
+    if(data)
+    {
+        for(i = 0; i < extra->formats; ++i)
+        {
+            found = FALSE;
+
+            for(j = 0; (j < item->formats) && !found; ++j)
+            {
+                found = (item->data[j].format == extra->data[i].format);
+            }
+
+            if(!found)
+            {
+                data[count++] = extra->data[i];
+                extra->data[i].memory = NULL;
+                added += extra->data[i].size;
+            }
+        }
+
+        if(item->data)
+        {
+            memcpy(data + count, item->data,
+                sizeof(ClipData) * item->formats);
+            FreeMemory(item->data);
+        }
+
+        item->data = data;
+        item->formats += count;
+
+        if(item->preview && (count > 0))
+        {
+            UpdateClipPreview(item);
+        }
+    }
+
+    DestroyClipItem(extra);
+
+    return added;
+}
+
+
+/*******************************************************************
+** PackClipText
+** ============
+** Keeps a CF_UNICODETEXT payload read back in as UTF-8, just as a
+** capture would have kept it (see AddCaptureText): only if that's
+** smaller.  Any other payload is left as it is, as is one that
+** can't be had.
+**
+** Inputs:
+**      ClipData* data      - the payload
+*******************************************************************/
+void PackClipText(ClipData* data)
+{
+    const uint16_t* text;
+    void* packed = NULL;
+    size_t utf8_size = 0;
+
+    if((data->format != 13) || (data->size & 1))
+    {
+        return;
+    }
+
+    text = (const uint16_t*) LockBlob(data->memory);
+
+    if(text)
+    {
+        utf8_size = GetUtf8Size(text, data->size / 2);
+
+        if(utf8_size < data->size)
+        {
+            packed = AllocBlob(utf8_size);
+        }
+
+        //A new blob is private, so always locks
+        if(packed)
+        {
+            EncodeUtf8(text, data->size / 2, (BYTE*) LockBlob(packed));
+            UnlockBlob(packed);
+        }
+
+        UnlockBlob(data->memory);
+    }
+
+    if(packed)
+    {
+        ReleaseBlob(data->memory);
+        data->memory = InternBlob(packed);
+        data->hash = GetBlobHash(data->memory);
+        data->size = utf8_size;
+        data->format = UTF8_TEXT_FORMAT;
+    }
+}
+
+
+/*******************************************************************
+** GetLogicalSize
+** ==============
+** Works out how much of a clipboard payload is actually data.  The
+** size of a clipboard block is often rounded up, so text is cut
+** after its terminator and a CF_HDROP after the empty name that
+** ends its file list.  Other formats, and payloads that aren't laid
+** out as expected, keep their size.
+**
+** Inputs:
+**      UINT format         - the clipboard format
+**      const void* bytes   - the payload
+**      size_t size         - size of its block
+**
+** Outputs:
+**      size_t              - bytes worth keeping
+*******************************************************************/
+size_t GetLogicalSize(UINT format, const void* bytes, size_t size)
+{
+    const BYTE* data = (const BYTE*) bytes;
+    uint32_t files, wide;
+    size_t i, start;
+
+    switch(format)
+    {
+    case 1:     //CF_TEXT
+    case 7:     //CF_OEMTEXT
+        for(i = 0; i < size; ++i)
+        {
+            if(data[i] == 0)
+            {
+                return i + 1;
+            }
+        }
+        break;
+
+    case 13:    //CF_UNICODETEXT
+        for(i = 0; i + 1 < size; i += 2)
+        {
+            if((data[i] == 0) && (data[i + 1] == 0))
+            {
+                return i + 2;
+            }
+        }
+        break;
+
+    case 15:    //CF_HDROP
+        if(size < HDROP_HEADER_SIZE)
+        {
+            break;
+        }
+
+        memcpy(&files, data + HDROP_FILES_OFFSET, sizeof(files));
+        memcpy(&wide, data + HDROP_WIDE_OFFSET, sizeof(wide));
+
+        if((files < HDROP_HEADER_SIZE) || (files >= size))
+        {
+            break;
+        }
+
+        //Each name ends in a terminator; an empty one ends the list
+        for(i = start = files; i + (wide ? 1 : 0) < size;
+            i += (wide ? 2 : 1))
+        {
+            if((data[i] == 0) && (!wide || (data[i + 1] == 0)))
+            {
+                if(i == start)
+                {
+                    return i + (wide ? 2 : 1);
+                }
+
+                start = i + (wide ? 2 : 1);
+            }
+        }
+        break;
+    }
+
+    return size;
+}
+
+
+/*******************************************************************
+** UpdateClipPreview
+** =================
+** Works out what the popup menu shows for an item, from the first
+** of its formats the popup can describe: up to PREVIEW_TEXT_LENGTH
+** characters of text, the number of files dropped, or a bitmap's
+** dimensions.  Payloads spilled or compressed have to be brought
+** back for it, so it's best done while the item is new.  Any
+** thumbnail the item had is let go, to be made again if needed.
+**
+** Inputs:
+**      ClipItem* item      - the item; its preview is made if it has
+**                            none
+**
+** Outputs:
+**      BOOL                - FALSE if out of memory, or the payload
+**                            couldn't be read; the item is left with
+**                            no preview
+*******************************************************************/
+BOOL UpdateClipPreview(ClipItem* item)
+{
+    ClipPreview* preview = item->preview;
+    ClipData* data = NULL;
+    const BYTE* bytes = NULL;
+    uint16_t unit, bits;
+    size_t i, length;
+
+    if(!preview)
+    {
+        preview = (ClipPreview*) AllocMemory(sizeof(ClipPreview));
+
+        if(!preview)
+        {
+            return FALSE;
+        }
+    }
+    else if(preview->thumbnail)
+    {
+        ReleaseThumbnail(preview->thumbnail);
+    }
+
+    memset(preview, 0, sizeof(ClipPreview));
+    item->preview = NULL;
+
+    //CF_TEXT, CF_UNICODETEXT, CF_DIB, CF_DIBV5 and CF_HDROP
+    for(i = 0; (i < item->formats) && !data; ++i)
+    {
+        switch(item->data[i].format)
+        {
+        case 1:
+        case 13:
+        case UTF8_TEXT_FORMAT:
+        case 8:
+        case 17:
+        case 15:
+            data = &item->data[i];
+            break;
+        }
+    }
+
+    if(data)
+    {
+        bytes = (const BYTE*) LockBlob(data->memory);
+
+        if(!bytes)
+        {
+            FreeMemory(preview);
+            return FALSE;
+        }
+
+        preview->format = GetExportFormat(data->format);
+    }
+
+    switch(data ? data->format : 0)
+    {
+    case 1:     //CF_TEXT
+        for(i = 0; (i < data->size) && (i < PREVIEW_TEXT_LENGTH)
+            && bytes[i]; ++i)
+        {
+            preview->text.ansi[i] = (char) bytes[i];
+        }
+        break;
+
+    case 13:    //CF_UNICODETEXT
+        length = data->size / 2;
+
+        for(i = 0; (i < length) && (i < PREVIEW_TEXT_LENGTH); ++i)
+        {
+            memcpy(&unit, bytes + i * 2, sizeof(unit));
+
+            if(unit == 0)
+            {
+                break;
+            }
+
+            preview->text.wide[i] = unit;
+        }
+
+        //Half a surrogate pair would show as junk
+        if((i > 0) && ((preview->text.wide[i - 1] & 0xFC00) == 0xD800))
+        {
+            preview->text.wide[i - 1] = 0;
+        }
+        break;
+
+    case UTF8_TEXT_FORMAT:
+        //The text stops at its terminator, if it has one in reach
+        DecodeUtf8(bytes, data->size, preview->text.wide,
+            PREVIEW_TEXT_LENGTH);
+        break;
+
+    case 15:    //CF_HDROP
+        preview->files = CountFileNames(bytes, data->size);
+        break;
+
+    case 8:     //CF_DIB
+    case 17:    //CF_DIBV5
+        //BITMAPINFOHEADER: size, width, height, planes, bit count
+        if(data->size >= 16)
+        {
+            memcpy(&preview->width, bytes + 4, sizeof(preview->width));
+            memcpy(&preview->height, bytes + 8, sizeof(preview->height));
+            memcpy(&bits, bytes + 14, sizeof(bits));
+            preview->bits = (unsigned int) bits;
+        }
+        break;
+    }
+
+    if(bytes)
+    {
+        UnlockBlob(data->memory);
+    }
+
+    item->preview = preview;
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** GetItemThumbnail
+** ================
+** Gets the small picture the popup menu shows for a bitmap item,
+** making it the first time it's asked for.  It's kept with the
+** item's preview, and let go when the item is destroyed.
+**
+** Inputs:
+**      ClipItem* item      - the item
+**
+** Outputs:
+**      HANDLE              - the thumbnail, from CreateThumbnail;
+**                            NULL if the item isn't a bitmap or the
+**                            payload couldn't be read
+*******************************************************************/
+HANDLE GetItemThumbnail(ClipItem* item)
+{
+    ClipPreview* preview;
+    const void* bytes;
+    unsigned int i;
+
+    if(!item->preview && !UpdateClipPreview(item))
+    {
+        return NULL;
+    }
+
+    preview = item->preview;
+
+    if(preview->thumbnail
+    || ((preview->format != 8) && (preview->format != 17)))
+    {
+        return preview->thumbnail;
+    }
+
+    for(i = 0; i < item->formats; ++i)
+    {
+        if(item->data[i].format == preview->format)
+        {
+            bytes = LockBlob(item->data[i].memory);
+
+            if(bytes)
+            {
+                preview->thumbnail = CreateThumbnail(bytes,
+                    item->data[i].size);
+                UnlockBlob(item->data[i].memory);
+            }
+
+            break;
+        }
+    }
+
+    return preview->thumbnail;
+}
+
+
+/*******************************************************************
+** CountFileNames
+** ==============
+** Counts the names in a CF_HDROP's file list, which ends at an empty
+** name or the end of the payload, whichever is first.
+**
+** Inputs:
+**      const BYTE* data    - the CF_HDROP
+**      size_t size         - its size
+**
+** Outputs:
+**      unsigned int        - number of names
+*******************************************************************/
+unsigned int CountFileNames(const BYTE* data, size_t size)
+{
+    uint32_t files, wide;
+    unsigned int count = 0;
+    size_t i, start, step;
+
+    if(size < HDROP_HEADER_SIZE)
+    {
+        return 0;
+    }
+
+    memcpy(&files, data + HDROP_FILES_OFFSET, sizeof(files));
+    memcpy(&wide, data + HDROP_WIDE_OFFSET, sizeof(wide));
+    step = wide ? 2 : 1;
+
+    for(i = start = files; (files >= HDROP_HEADER_SIZE)
+        && (i + step <= size); i += step)
+    {
+        if((data[i] == 0) && (!wide || (data[i + 1] == 0)))
+        {
+            if(i == start)
+            {
+                break;
+            }
+
+            ++count;
+            start = i + step;
+        }
+    }
+
+    return count;
+}
@@ -0,0 +1,111 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#ifndef __CLIPITEM__
+#define __CLIPITEM__
+
+#include "Platform.h"
+
+typedef struct
+{
+    void*       memory;     //blob holding the payload; see LockBlob
+    size_t      size;
+    UINT        format;
+    uint64_t    hash;       //fingerprint of memory, set on capture
+}ClipData;
+
+//Characters of text kept for the popup menu
+#define PREVIEW_TEXT_LENGTH 50
+
+//What the popup menu shows for an item, worked out once when it's
+//queued or loaded rather than every time the menu opens.  format is
+//the one described: text (CF_UNICODETEXT for UTF-8 too), CF_HDROP,
+//CF_DIB or CF_DIBV5, or 0 for none of those.
+typedef struct
+{
+    UINT            format;
+    union
+    {
+        uint16_t    wide[PREVIEW_TEXT_LENGTH + 1];  //CF_UNICODETEXT
+        char        ansi[PREVIEW_TEXT_LENGTH + 1];  //CF_TEXT
+    }text;
+    unsigned int    files;      //CF_HDROP: names in the list
+    int32_t         width;      //CF_DIB[V5]: as in the header, so
+    int32_t         height;     //negative for top-down
+    unsigned int    bits;       //bits per pixel
+    HANDLE          thumbnail;  //see GetItemThumbnail; may be NULL
+}ClipPreview;
+
+typedef struct
+{
+    ClipData*       data;       //dynamically allocated array
+    unsigned int    formats;    //number of formats stored
+    uint64_t        hash;       //content hash, set by HashClipItem
+    unsigned int    serial;     //insertion order, set by the queue
+    unsigned int    touched;    //tick count of last use, set by the queue
+    ClipPreview*    preview;    //set by UpdateClipPreview; may be NULL
+}ClipItem;
+
+extern void DestroyClipItem(ClipItem* item);
+extern BOOL DuplicateClipItem(ClipItem* copy, ClipItem* item);
+extern BOOL CompareClipItems(ClipItem* item1, ClipItem* item2);
+extern uint64_t HashClipItem(ClipItem* item);
+extern size_t GetClipItemSize(ClipItem* item);
+extern void CompressClipItem(ClipItem* item);
+extern void RemoveClipFormat(ClipItem* item, unsigned int index);
+extern size_t MergeClipItem(ClipItem* item, ClipItem* extra);
+extern void PackClipText(ClipData* data);
+extern size_t GetLogicalSize(UINT format, const void* bytes, size_t size);
+extern BOOL UpdateClipPreview(ClipItem* item);
+extern HANDLE GetItemThumbnail(ClipItem* item);
+
+//The clipboard backend - Clipboard.c on Windows, or a stand-in
+//when the core is built elsewhere (see bench/BenchClipboard.c).
+extern unsigned int PopulateClipItem(ClipItem* item);
+extern unsigned int CopyToClipboard(ClipItem* item);
+extern unsigned int MoveToClipboard(ClipItem* item);
+extern HANDLE CreateThumbnail(const void* dib, size_t size);
+extern void ReleaseThumbnail(HANDLE thumbnail);
+
+#define IsAppFormat(format) (format >= 0x0C000)
+
+//CF_UNICODETEXT as the queue keeps it, in UTF-8 (see Transcode.h).
+//It's never a clipboard format: the standard ones are all below
+//0x0400 and registered ones start at 0xC000.  Nor is it ever written
+//out: files and journals get the UTF-16 back, so any version of
+//QClip can read them, and PackClipText packs it again when read.
+#define UTF8_TEXT_FORMAT    0x08000
+
+//The format a payload goes back on the clipboard as
+#define GetExportFormat(format) \
+    ((format) == UTF8_TEXT_FORMAT ? 13 : (format))
+
+//CF_TEXT, CF_OEMTEXT, CF_UNICODETEXT and CF_LOCALE, which goes with them
+#define IsTextFormat(format) ((format) == 1 || (format) == 7 \
+    || (format) == 13 || (format) == 16 || (format) == UTF8_TEXT_FORMAT)
+
+//Layout of the DROPFILES header that starts a CF_HDROP: the offset of
+//the file list, then a POINT and a BOOL, then whether it's UTF-16
+#define HDROP_FILES_OFFSET  0
+#define HDROP_WIDE_OFFSET   16
+#define HDROP_HEADER_SIZE   20
+
+#endif
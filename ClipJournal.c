@@ -0,0 +1,1805 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include <string.h>
+#include "Platform.h"
+#include "ClipItem.h"
+#include "ClipQueue.h"
+#include "ClipSerialize.h"
+#include "ClipJournal.h"
+#include "BlobStore.h"
+#include "Hash.h"
+#include "Transcode.h"
+
+//A journal file is a JournalHeader, then records one after another.
+//A record is a JournalRecord, then for a push or added formats a
+//JournalFormat for each format, each followed by the format's name
+//if it's a registered one, then all of the payloads.  The record's
+//check covers its header and formats; each payload is checked
+//against the hash in its JournalFormat.  A crash can leave the last
+//record half written, so replaying stops at the first record that
+//doesn't check out, and the journal is cut short there.  Text the
+//queue keeps as UTF-8 is written as the CF_UNICODETEXT it stands for,
+//like everything else that leaves the queue.
+//
+//Records aren't written as they're added.  They're batched up in
+//memory, with their payloads held where they are rather than copied
+//(see HoldBlob), and written by another thread once
+//JOURNAL_BATCH_SIZE has built up, and on each AutosaveJournal, which
+//has them flushed as well.  A crash loses the records not yet
+//written, no more than an autosave's worth, and CloseJournal has
+//only those to write.
+//
+//The generation ties a journal to the snapshot it applies to (it's
+//kept in the snapshot's file header too).  Compacting saves the
+//snapshot under the next generation before the journal is started
+//again, so a crash in between leaves an old journal that doesn't
+//match the new snapshot, and is ignored rather than replayed twice.
+//
+//AutosaveJournal compacts in the background instead.  The snapshot
+//is taken at some point in the journal, and saved by another thread
+//while the queue goes on changing and records go on being added.
+//The thread writes the records batched up so far before it saves
+//the snapshot, and once it's saved, the journal is started again,
+//empty, for the records added since.  Until then, the journal on
+//disk is a generation behind the snapshot, so the snapshot says how
+//much of the journal it already holds (ClipQueue's journaled), and
+//after a crash in between the rest, if any, is replayed on top of
+//it.
+
+#define JOURNAL_SIGNATURE   0x04a6e1c09
+#define RECORD_SIGNATURE    0x07ec0bd5e
+#define JOURNAL_VERSION     0
+#define JOURNAL_PATH_MAX    1024
+#define JOURNAL_COPY_SIZE   (64 * 1024)
+
+//Records are handed to be written once this much has built up
+#define JOURNAL_BATCH_SIZE  (256 * 1024)
+
+//A journal this many times past the size it's compacted at is saved
+//without waiting for the queue to settle
+#define JOURNAL_OVERDUE     4
+
+//How the thread writing records, and maybe saving a snapshot, is
+//getting on
+#define WORK_RUNNING        1
+#define WORK_DONE           2
+#define WORK_UNSAVED        3       //records written, snapshot not
+#define WORK_FAILED         4       //records not written
+
+//Record types, and what a record's value means for each
+#define RECORD_PUSH         1       //TRUE at the front
+#define RECORD_REMOVE       2
+#define RECORD_MOVE         3       //TRUE to the front
+#define RECORD_ADD_FORMATS  4
+#define RECORD_DROP_FORMAT  5       //which of the item's formats
+#define RECORD_EMPTY        6
+#define RECORD_RESIZE       7       //the new size
+
+//So a damaged format count is caught before anything is allocated
+#define RECORD_FORMATS_MAX  4096
+
+typedef struct
+{
+    unsigned int signature;
+    unsigned int version;
+    unsigned int generation;
+    unsigned int reserved1;
+}JournalHeader;
+
+typedef struct
+{
+    unsigned int signature;
+    unsigned int type;
+    unsigned int offset;            //of the item, from the front
+    unsigned int value;
+    unsigned int formats;
+    unsigned int formats_size;      //bytes of JournalFormats and names
+    unsigned int payload_low;       //bytes of payload after them
+    unsigned int payload_high;
+    unsigned int check_low;         //see CheckRecord
+    unsigned int check_high;
+}JournalRecord;
+
+typedef struct
+{
+    unsigned int format;
+    unsigned int size;
+    unsigned int name_length;       //bytes, terminator included
+    unsigned int hash_low;          //HashBytes of the payload, seed 0
+    unsigned int hash_high;
+    unsigned int reserved1;
+}JournalFormat;
+
+//A payload a batched record carries, and how much of the batch's
+//own bytes go before it
+typedef struct
+{
+    size_t          at;
+    HeldBlob        held;
+}BatchPayload;
+
+//Records waiting to be written: their headers, formats and any text
+//one after another in bytes, with the other payloads held where they
+//are and written in between
+typedef struct
+{
+    BYTE*           bytes;
+    size_t          size;
+    size_t          capacity;
+    BatchPayload*   payloads;
+    unsigned int    count;
+    unsigned int    room;
+    uint64_t        total;          //bytes of records, payloads and all
+    size_t          largest;        //biggest payload not in memory
+}RecordBatch;
+
+//Gathers up small writes, for WriteBatch
+typedef struct
+{
+    HANDLE          file;
+    uint64_t        position;
+    BYTE*           buffer;
+    size_t          used;
+}BatchWriter;
+
+struct ClipJournal
+{
+    HANDLE          file;
+    uint64_t        end;            //where the next record goes
+    uint64_t        written;        //how much of it is in the file
+    unsigned int    generation;
+    BOOL            failed;         //records can't be added; compacting
+                                    //starts the journal again
+    uint64_t        flushed;        //how much of it is surely on disk
+    unsigned int    last_record;    //tick count when the last was added
+    PathChar        journal_path[JOURNAL_PATH_MAX];
+    PathChar        snapshot_path[JOURNAL_PATH_MAX];
+    PathChar        temp_path[JOURNAL_PATH_MAX];
+    JournalStats    stats;
+
+    //Records added since the last were handed to be written, and
+    //those being written
+    RecordBatch     pending;
+    RecordBatch     writing;
+
+    //The thread writing them, whether it's to flush them too, and a
+    //snapshot it's to save once they're written
+    HANDLE          worker;
+    volatile unsigned int work_state;   //WORK_ constant
+    BOOL            flush;
+    QueueSnapshot*  snapshot;
+    unsigned int    saved_generation;   //the snapshot's
+    unsigned int    queue_generation;   //the queue's, before
+};
+
+static BOOL CopyPath(PathChar* copy, const PathChar* path);
+static void ReplayJournal(ClipJournal* journal, ClipQueue* cq,
+    uint64_t start);
+static BOOL ReplayRecord(HANDLE file, uint64_t position,
+    JournalRecord* record, const BYTE* formats, ClipQueue* cq);
+static BOOL ReadRecordItem(HANDLE file, uint64_t position,
+    JournalRecord* record, const BYTE* formats, ClipItem* item);
+static void WriteRecord(ClipQueue* cq, unsigned int type,
+    unsigned int offset, unsigned int value, ClipItem* item);
+static uint64_t CheckRecord(JournalRecord* record, const BYTE* formats);
+static BYTE* ExtendBatch(RecordBatch* batch, size_t size);
+static BOOL AddToBatch(RecordBatch* batch, const void* bytes,
+    size_t size);
+static BOOL HoldInBatch(RecordBatch* batch, void* memory);
+static void ReleaseBatch(RecordBatch* batch);
+static BOOL WriteBatch(HANDLE file, uint64_t position,
+    const RecordBatch* batch);
+static BOOL GatherBytes(BatchWriter* writer, const BYTE* bytes,
+    size_t size);
+static BOOL WritePending(ClipJournal* journal);
+static BOOL SaveSnapshot(ClipJournal* journal, ClipQueue* cq);
+static BOOL StartJournal(ClipJournal* journal);
+static BOOL FlushJournal(ClipJournal* journal);
+static BOOL StartSave(ClipJournal* journal, ClipQueue* cq);
+static BOOL StartWork(ClipJournal* journal, BOOL flush);
+static void WorkInBackground(void* arg);
+static BOOL FinishWork(ClipJournal* journal, ClipQueue* cq);
+static BOOL RestartJournal(ClipJournal* journal);
+
+
+/*******************************************************************
+** OpenJournal
+** ===========
+** Gives a queue a journal.  If asked to, and the journal goes with
+** the queue (just loaded from the snapshot, or new and empty if
+** there was no snapshot), it's replayed first.  So is the end of a
+** journal the snapshot was saved in the middle of, by
+** AutosaveJournal.  Otherwise, and after that, the queue is saved
+** as the snapshot and the journal started again.
+**
+** Inputs:
+**      ClipQueue* cq               - the queue
+**      const PathChar* journal_path    - the journal file
+**      const PathChar* snapshot_path   - where snapshots are saved
+**      const PathChar* temp_path       - where they're saved first,
+**                                        then moved from
+**      BOOL replay                 - TRUE to replay the journal
+**
+** Outputs:
+**      BOOL                        - TRUE if changes are now being
+**                                    recorded; if not, the journal
+**                                    may still come good on
+**                                    CompactJournal
+*******************************************************************/
+BOOL OpenJournal(ClipQueue* cq, const PathChar* journal_path,
+    const PathChar* snapshot_path, const PathChar* temp_path, BOOL replay)
+{
+    ClipJournal* journal;
+    JournalHeader header;
+
+    CloseJournal(cq);
+
+    journal = (ClipJournal*) AllocMemory(sizeof(ClipJournal));
+
+    if(!journal)
+    {
+        return FALSE;
+    }
+
+    journal->file = INVALID_HANDLE_VALUE;
+
+    if(CopyPath(journal->journal_path, journal_path)
+    && CopyPath(journal->snapshot_path, snapshot_path)
+    && CopyPath(journal->temp_path, temp_path))
+    {
+        journal->file = OpenFileForUpdate(journal_path);
+    }
+
+    if(journal->file == INVALID_HANDLE_VALUE)
+    {
+        FreeMemory(journal);
+        return FALSE;
+    }
+
+    //An unreadable journal counts as generation 0, which never
+    //matches a queue's
+    if(ReadBytesAt(journal->file, 0, &header, sizeof(JournalHeader))
+    && (header.signature == JOURNAL_SIGNATURE)
+    && (header.version == JOURNAL_VERSION))
+    {
+        journal->generation = header.generation;
+    }
+
+    if(replay && (journal->generation != 0)
+    && (journal->generation == cq->generation))
+    {
+        ReplayJournal(journal, cq, sizeof(JournalHeader));
+        cq->journal = journal;
+    }
+    else
+    {
+        if(replay && (journal->generation != 0)
+        && (journal->generation + 1 == cq->generation)
+        && (cq->journaled >= sizeof(JournalHeader)))
+        {
+            ReplayJournal(journal, cq, cq->journaled);
+        }
+
+        //Nothing can be added until the snapshot is saved
+        journal->failed = TRUE;
+        cq->journal = journal;
+        CompactJournal(cq, TRUE);
+    }
+
+    cq->journaled = 0;
+
+    return !journal->failed;
+}
+
+
+/*******************************************************************
+** CloseJournal
+** ============
+** Writes out the records not yet written and lets a queue's journal
+** go.  By then, all that's left is what's been added since a batch
+** was last handed to be written, which is soon written; it isn't
+** flushed, any more than saving the queue at exit ever was.  The
+** queue can be destroyed without saving it anywhere, since the
+** snapshot and the journal are enough to load it again.  A snapshot
+** being saved in the background is given up.
+**
+** Inputs:
+**      ClipQueue* cq       - the queue
+**
+** Outputs:
+**      BOOL                - TRUE if the journal is complete; FALSE
+**                            if the queue has none, or changes have
+**                            gone unrecorded, in which case the
+**                            queue needs saving some other way
+*******************************************************************/
+BOOL CloseJournal(ClipQueue* cq)
+{
+    ClipJournal* journal = cq->journal;
+    BOOL success;
+
+    if(!journal)
+    {
+        return FALSE;
+    }
+
+    if(journal->worker)
+    {
+        if(journal->snapshot)
+        {
+            CancelQueueSnapshot(journal->snapshot);
+        }
+
+        FinishWork(journal, cq);
+    }
+
+    success = WritePending(journal);
+
+    CloseFileHandle(journal->file);
+    FreeMemory(journal);
+    cq->journal = NULL;
+
+    return success;
+}
+
+
+/*******************************************************************
+** CompactJournal
+** ==============
+** Saves the queue as the snapshot and starts its journal again.
+** Unless told to, this is only done once the journal has grown past
+** JOURNAL_COMPACT_MIN and the size of the queue itself, or stopped
+** recording; otherwise the journal is just flushed.  This is done
+** there and then, after any save AutosaveJournal has under way has
+** finished, or been given up if the queue is to be saved anyway.
+**
+** Inputs:
+**      ClipQueue* cq       - the queue
+**      BOOL always         - TRUE to compact whatever the size
+**
+** Outputs:
+**      BOOL                - FALSE if the queue has no journal, or
+**                            it couldn't be written
+*******************************************************************/
+BOOL CompactJournal(ClipQueue* cq, BOOL always)
+{
+    ClipJournal* journal = cq->journal;
+    unsigned int generation;
+    BOOL success;
+
+    if(!journal)
+    {
+        return FALSE;
+    }
+
+    if(journal->worker)
+    {
+        if(always && journal->snapshot)
+        {
+            CancelQueueSnapshot(journal->snapshot);
+        }
+
+        FinishWork(journal, cq);
+    }
+
+    if(!always && !journal->failed
+    && ((journal->end < JOURNAL_COMPACT_MIN) || (journal->end < cq->bytes)))
+    {
+        return FlushJournal(journal);
+    }
+
+    //Past whatever the journal on disk was, so it can't be mistaken
+    //for the new one's
+    generation = cq->generation;
+    cq->generation = ((journal->generation > generation)
+        ? journal->generation : generation) + 1;
+
+    success = SaveSnapshot(journal, cq);
+
+    if(success)
+    {
+        //The snapshot holds the records not yet written
+        ReleaseBatch(&journal->pending);
+        journal->generation = cq->generation;
+        ++(journal->stats.compactions);
+
+        success = StartJournal(journal);
+        journal->failed = !success;
+    }
+    else
+    {
+        cq->generation = generation;
+    }
+
+    return success;
+}
+
+
+/*******************************************************************
+** AutosaveJournal
+** ===============
+** Called every few seconds to keep the queue saved.  Like
+** CompactJournal, this compacts the journal once it's grown too
+** big, and otherwise writes and flushes the records added since
+** the last time; but all of that is done by another thread, and the
+** snapshot isn't saved until the queue has gone JOURNAL_QUIET_TIME
+** without a change, unless it's fallen far behind.  Nothing is
+** written if nothing has changed.  A journal that's stopped
+** recording is compacted there and then, since the queue is all
+** there is to save.
+**
+** Inputs:
+**      ClipQueue* cq       - the queue
+**      unsigned int now    - the tick count
+**
+** Outputs:
+**      BOOL                - FALSE if the queue has no journal, or
+**                            it couldn't be written
+*******************************************************************/
+BOOL AutosaveJournal(ClipQueue* cq, unsigned int now)
+{
+    ClipJournal* journal = cq->journal;
+    uint64_t due;
+    BOOL saving;
+
+    if(!journal)
+    {
+        return FALSE;
+    }
+
+    if(journal->worker)
+    {
+        if(LoadAcquire(&journal->work_state) == WORK_RUNNING)
+        {
+            return TRUE;
+        }
+
+        saving = (journal->snapshot != NULL);
+
+        if(!FinishWork(journal, cq) && saving && !journal->failed)
+        {
+            //Older versions of Windows can't replace the snapshot
+            //while payloads are still being read from it, so the
+            //next save goes without them
+            LoadLazyBlobs(FALSE);
+
+            return FALSE;
+        }
+    }
+
+    if(journal->failed)
+    {
+        return CompactJournal(cq, TRUE);
+    }
+
+    due = (cq->bytes > JOURNAL_COMPACT_MIN) ? cq->bytes : JOURNAL_COMPACT_MIN;
+
+    if((journal->end >= due)
+    && ((now - journal->last_record >= JOURNAL_QUIET_TIME)
+    || (journal->end >= JOURNAL_OVERDUE * due)))
+    {
+        return StartSave(journal, cq);
+    }
+
+    return (journal->flushed == journal->end) || StartWork(journal, TRUE);
+}
+
+
+/*******************************************************************
+** GetJournalStats
+** ===============
+** Fills in the stats for a queue's journal; all zero if it has
+** none.
+**
+** Inputs:
+**      ClipQueue* cq           - the queue
+**      JournalStats* stats     - receives the stats
+*******************************************************************/
+void GetJournalStats(ClipQueue* cq, JournalStats* stats)
+{
+    if(cq->journal)
+    {
+        *stats = cq->journal->stats;
+        stats->size = cq->journal->end;
+        stats->unwritten = cq->journal->end - cq->journal->written;
+        stats->writing = cq->journal->worker
+            && (LoadAcquire(&cq->journal->work_state) == WORK_RUNNING);
+        stats->saving = stats->writing && cq->journal->snapshot;
+    }
+    else
+    {
+        memset(stats, 0, sizeof(JournalStats));
+    }
+}
+
+
+/*******************************************************************
+** JournalPush
+** ===========
+** Records an item added to either end of the queue.
+**
+** Inputs:
+**      ClipQueue* cq       - the queue
+**      ClipItem* item      - the item, as queued
+**      BOOL at_front       - TRUE if it went on the front
+*******************************************************************/
+void JournalPush(ClipQueue* cq, ClipItem* item, BOOL at_front)
+{
+    WriteRecord(cq, RECORD_PUSH, 0, at_front, item);
+}
+
+
+/*******************************************************************
+** JournalRemove
+** =============
+** Records an item taken out of the queue.
+**
+** Inputs:
+**      ClipQueue* cq       - the queue
+**      unsigned int offset - where the item was
+*******************************************************************/
+void JournalRemove(ClipQueue* cq, unsigned int offset)
+{
+    WriteRecord(cq, RECORD_REMOVE, offset, 0, NULL);
+}
+
+
+/*******************************************************************
+** JournalMove
+** ===========
+** Records an item moved to either end of the queue.
+**
+** Inputs:
+**      ClipQueue* cq       - the queue
+**      unsigned int offset - where the item was
+**      BOOL to_front       - TRUE if it went to the front
+*******************************************************************/
+void JournalMove(ClipQueue* cq, unsigned int offset, BOOL to_front)
+{
+    WriteRecord(cq, RECORD_MOVE, offset, to_front, NULL);
+}
+
+
+/*******************************************************************
+** JournalAddFormats
+** =================
+** Records formats about to be merged into an item.
+**
+** Inputs:
+**      ClipQueue* cq       - the queue
+**      unsigned int offset - where the item is
+**      ClipItem* extra     - the formats
+*******************************************************************/
+void JournalAddFormats(ClipQueue* cq, unsigned int offset, ClipItem* extra)
+{
+    WriteRecord(cq, RECORD_ADD_FORMATS, offset, 0, extra);
+}
+
+
+/*******************************************************************
+** JournalDropFormat
+** =================
+** Records a format about to be dropped from an item.
+**
+** Inputs:
+**      ClipQueue* cq       - the queue
+**      unsigned int offset - where the item is
+**      unsigned int format - which of its formats
+*******************************************************************/
+void JournalDropFormat(ClipQueue* cq, unsigned int offset,
+    unsigned int format)
+{
+    WriteRecord(cq, RECORD_DROP_FORMAT, offset, format, NULL);
+}
+
+
+/*******************************************************************
+** JournalEmpty
+** ============
+** Records the queue being emptied.
+**
+** Inputs:
+**      ClipQueue* cq       - the queue
+*******************************************************************/
+void JournalEmpty(ClipQueue* cq)
+{
+    WriteRecord(cq, RECORD_EMPTY, 0, 0, NULL);
+}
+
+
+/*******************************************************************
+** JournalResize
+** =============
+** Records the queue's size changing.  Items dropped to make it fit
+** are recorded first, as they go.
+**
+** Inputs:
+**      ClipQueue* cq           - the queue
+**      unsigned int new_size   - the new size
+*******************************************************************/
+void JournalResize(ClipQueue* cq, unsigned int new_size)
+{
+    WriteRecord(cq, RECORD_RESIZE, 0, new_size, NULL);
+}
+
+
+/*******************************************************************
+** CopyPath
+** ========
+** Copies a path into a JOURNAL_PATH_MAX buffer.
+**
+** Inputs:
+**      PathChar* copy          - the buffer
+**      const PathChar* path    - the path
+**
+** Outputs:
+**      BOOL                    - FALSE if it's too long
+*******************************************************************/
+BOOL CopyPath(PathChar* copy, const PathChar* path)
+{
+    unsigned int i;
+
+    for(i = 0; i < JOURNAL_PATH_MAX; ++i)
+    {
+        copy[i] = path[i];
+
+        if(path[i] == 0)
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+
+/*******************************************************************
+** ReplayJournal
+** =============
+** Replays the records in a journal, up to the first one that's
+** damaged, torn or doesn't fit the queue, and cuts the journal off
+** there.  The queue mustn't have the journal yet, or the records
+** would be recorded again.
+**
+** Inputs:
+**      ClipJournal* journal    - the journal
+**      ClipQueue* cq           - the queue it goes with
+**      uint64_t start          - where the first record to replay is
+*******************************************************************/
+void ReplayJournal(ClipJournal* journal, ClipQueue* cq, uint64_t start)
+{
+    JournalRecord record;
+    BYTE* formats;
+    uint64_t length = 0, position = start, payload = 0;
+    BOOL valid = GetFileLength(journal->file, &length);
+
+    while(valid)
+    {
+        formats = NULL;
+
+        valid = ReadBytesAt(journal->file, position, &record,
+                sizeof(JournalRecord))
+            && (record.signature == RECORD_SIGNATURE)
+            && (record.formats <= RECORD_FORMATS_MAX)
+            && (record.formats_size <= record.formats
+                * (sizeof(JournalFormat) + FORMAT_NAME_MAX));
+
+        if(valid && (record.formats_size > 0))
+        {
+            formats = (BYTE*) AllocMemory(record.formats_size);
+
+            valid = (formats != NULL)
+                && ReadBytesAt(journal->file,
+                    position + sizeof(JournalRecord), formats,
+                    record.formats_size);
+        }
+
+        if(valid)
+        {
+            payload = ((uint64_t) record.payload_high << 32)
+                | record.payload_low;
+
+            valid = (CheckRecord(&record, formats)
+                    == (((uint64_t) record.check_high << 32)
+                    | record.check_low))
+                && (position + sizeof(JournalRecord) + record.formats_size
+                    + payload <= length)
+                && ReplayRecord(journal->file,
+                    position + sizeof(JournalRecord) + record.formats_size,
+                    &record, formats, cq);
+        }
+
+        FreeMemory(formats);
+
+        if(valid)
+        {
+            position += sizeof(JournalRecord) + record.formats_size
+                + payload;
+            ++(journal->stats.replayed);
+        }
+    }
+
+    //New records go straight on from the last good one
+    journal->end = position;
+    journal->written = position;
+    journal->flushed = position;
+
+    if(length > position)
+    {
+        journal->stats.discarded = length - position;
+        journal->failed = !SetFileLength(journal->file, position);
+    }
+
+    //The queue may have grown past its size as it was loaded
+    if(cq->count > cq->size)
+    {
+        ResizeQueue(cq, cq->count);
+    }
+}
+
+
+/*******************************************************************
+** ReplayRecord
+** ============
+** Makes the change one record describes, if it fits the queue.
+**
+** Inputs:
+**      HANDLE file             - the journal
+**      uint64_t position       - where the record's payloads start
+**      JournalRecord* record   - the record
+**      const BYTE* formats     - its formats, checked
+**      ClipQueue* cq           - the queue
+**
+** Outputs:
+**      BOOL                    - FALSE if the record doesn't fit the
+**                                queue, its payloads are damaged or
+**                                memory ran out
+*******************************************************************/
+BOOL ReplayRecord(HANDLE file, uint64_t position, JournalRecord* record,
+    const BYTE* formats, ClipQueue* cq)
+{
+    ClipItem item;
+    BOOL success = (record->offset < cq->count);
+
+    switch(record->type)
+    {
+    case RECORD_PUSH:
+        success = ReadRecordItem(file, position, record, formats, &item);
+
+        if(success)
+        {
+            if(IsIndexActive(&cq->index))
+            {
+                item.hash = HashClipItem(&item);
+            }
+
+            success = InsertItem(cq, &item, record->value);
+        }
+        break;
+
+    case RECORD_REMOVE:
+        if(success)
+        {
+            RemoveItemAt(cq, record->offset);
+        }
+        break;
+
+    case RECORD_MOVE:
+        if(success)
+        {
+            MoveItem(cq, record->offset, record->value);
+        }
+        break;
+
+    case RECORD_ADD_FORMATS:
+        success = success
+            && ReadRecordItem(file, position, record, formats, &item);
+
+        if(success)
+        {
+            MergeIntoItem(cq, record->offset, &item);
+        }
+        break;
+
+    case RECORD_DROP_FORMAT:
+        success = success
+            && (record->value < GetItem(cq, record->offset)->formats);
+
+        if(success)
+        {
+            DropItemFormat(cq, record->offset, record->value);
+        }
+        break;
+
+    case RECORD_EMPTY:
+        EmptyQueue(cq);
+        success = TRUE;
+        break;
+
+    case RECORD_RESIZE:
+        success = (record->value > 0) && ResizeQueue(cq, record->value);
+        break;
+
+    default:
+        success = FALSE;
+        break;
+    }
+
+    return success;
+}
+
+
+/*******************************************************************
+** ReadRecordItem
+** ==============
+** Reads the formats carried by a record into a new item.
+**
+** Inputs:
+**      HANDLE file             - the journal
+**      uint64_t position       - where the record's payloads start
+**      JournalRecord* record   - the record
+**      const BYTE* formats     - its formats, checked
+**      ClipItem* item          - receives the item
+**
+** Outputs:
+**      BOOL                    - FALSE if the formats don't add up,
+**                                a payload is damaged or memory ran
+**                                out; nothing is left to destroy
+*******************************************************************/
+BOOL ReadRecordItem(HANDLE file, uint64_t position, JournalRecord* record,
+    const BYTE* formats, ClipItem* item)
+{
+    NameChar name[FORMAT_NAME_MAX+1];
+    JournalFormat entry;
+    size_t used = 0;
+    uint64_t payload = 0;
+    unsigned int j;
+    BOOL fail;
+
+    memset(item, 0, sizeof(ClipItem));
+    item->data = (ClipData*) AllocMemory(sizeof(ClipData) * record->formats);
+    item->formats = record->formats;
+
+    fail = (record->formats > 0) && (item->data == NULL);
+
+    for(j = 0; (j < record->formats) && !fail; ++j)
+    {
+        fail = (used + sizeof(JournalFormat) > record->formats_size);
+
+        if(!fail)
+        {
+            memcpy(&entry, formats + used, sizeof(JournalFormat));
+            used += sizeof(JournalFormat);
+
+            fail = (entry.name_length > FORMAT_NAME_MAX)
+                || (used + entry.name_length > record->formats_size);
+        }
+
+        if(!fail)
+        {
+            if(IsAppFormat(entry.format))
+            {
+                memcpy(name, formats + used, entry.name_length);
+                name[entry.name_length / sizeof(NameChar)] = 0;
+
+                item->data[j].format = RegisterFormatName(name);
+                fail = (item->data[j].format == 0);
+            }
+            else
+            {
+                item->data[j].format = entry.format;
+            }
+
+            used += entry.name_length;
+        }
+
+        if(!fail)
+        {
+            item->data[j].size = entry.size;
+            item->data[j].memory = AllocBlob(entry.size);
+
+            fail = (item->data[j].memory == NULL);
+        }
+
+        if(!fail)
+        {
+            //A new blob is private, so always locks
+            fail = !ReadBytesAt(file, position + payload,
+                LockBlob(item->data[j].memory), entry.size);
+
+            UnlockBlob(item->data[j].memory);
+            payload += entry.size;
+        }
+
+        if(!fail)
+        {
+            item->data[j].memory = InternBlob(item->data[j].memory);
+            item->data[j].hash = GetBlobHash(item->data[j].memory);
+
+            fail = (item->data[j].hash
+                != (((uint64_t) entry.hash_high << 32) | entry.hash_low));
+        }
+
+        if(!fail)
+        {
+            PackClipText(&item->data[j]);
+        }
+    }
+
+    fail = fail || (used != record->formats_size)
+        || (payload != (((uint64_t) record->payload_high << 32)
+            | record->payload_low));
+
+    if(fail)
+    {
+        DestroyClipItem(item);
+    }
+
+    return !fail;
+}
+
+
+/*******************************************************************
+** WriteRecord
+** ===========
+** Adds a record to the end of a queue's journal, batched up to be
+** written later (see StartWork): the header and formats, and any
+** UTF-8 text turned back into UTF-16, are copied into the batch,
+** and the other payloads held where they are.  Nothing is written
+** here.  If the record can't be added whole, the journal stops
+** recording, since nothing after a missing record could be
+** replayed.
+**
+** Inputs:
+**      ClipQueue* cq           - the queue
+**      unsigned int type       - a RECORD_ type
+**      unsigned int offset     - of the item concerned
+**      unsigned int value      - depends on the type
+**      ClipItem* item          - formats to carry, or NULL
+*******************************************************************/
+void WriteRecord(ClipQueue* cq, unsigned int type, unsigned int offset,
+    unsigned int value, ClipItem* item)
+{
+    ClipJournal* journal = cq->journal;
+    NameChar name[FORMAT_NAME_MAX+1];
+    JournalRecord record;
+    JournalFormat entry;
+    BYTE* buffer;
+    const BYTE* bytes;
+    uint16_t* text = NULL;
+    size_t size = sizeof(JournalRecord), units = 0, room;
+    uint64_t payload = 0, check, hash;
+    unsigned int formats = item ? item->formats : 0;
+    unsigned int j, length;
+    BOOL fail;
+
+    if(!journal || journal->failed)
+    {
+        return;
+    }
+
+    //Built in the batch, with room for the longest names there could
+    //be, and cut down to size once it's done
+    room = sizeof(JournalRecord)
+        + formats * (sizeof(JournalFormat) + FORMAT_NAME_MAX);
+    buffer = ExtendBatch(&journal->pending, room);
+    fail = (buffer == NULL);
+
+    memset(&record, 0, sizeof(JournalRecord));
+    memset(&entry, 0, sizeof(JournalFormat));
+
+    for(j = 0; (j < formats) && !fail; ++j)
+    {
+        hash = GetBlobHash(item->data[j].memory);
+
+        entry.format = GetExportFormat(item->data[j].format);
+        entry.size = (unsigned int) item->data[j].size;
+        entry.name_length = 0;
+
+        //An item has one text format at most
+        if(item->data[j].format == UTF8_TEXT_FORMAT)
+        {
+            bytes = (const BYTE*) LockBlob(item->data[j].memory);
+            fail = (bytes == NULL);
+
+            if(!fail)
+            {
+                units = GetUtf16Units(bytes, item->data[j].size);
+                text = (uint16_t*) AllocMemory(units * 2 + 1);
+                fail = (text == NULL);
+
+                if(!fail)
+                {
+                    DecodeUtf8(bytes, item->data[j].size, text, units);
+                }
+
+                UnlockBlob(item->data[j].memory);
+            }
+
+            if(!fail)
+            {
+                hash = HashBytes(text, units * 2, 0);
+                entry.size = (unsigned int) (units * 2);
+            }
+        }
+        entry.hash_low = (unsigned int) hash;
+        entry.hash_high = (unsigned int) (hash >> 32);
+
+        if(IsAppFormat(entry.format))
+        {
+            length = GetFormatName(entry.format, name,
+                FORMAT_NAME_MAX / sizeof(NameChar));
+
+            fail = (length == 0);
+            entry.name_length = (length + 1) * sizeof(NameChar);
+        }
+
+        if(!fail)
+        {
+            memcpy(buffer + size, &entry, sizeof(JournalFormat));
+            memcpy(buffer + size + sizeof(JournalFormat), name,
+                entry.name_length);
+            size += sizeof(JournalFormat) + entry.name_length;
+            payload += entry.size;
+        }
+    }
+
+    if(!fail)
+    {
+        record.signature = RECORD_SIGNATURE;
+        record.type = type;
+        record.offset = offset;
+        record.value = value;
+        record.formats = formats;
+        record.formats_size = (unsigned int) (size - sizeof(JournalRecord));
+        record.payload_low = (unsigned int) payload;
+        record.payload_high = (unsigned int) (payload >> 32);
+
+        check = CheckRecord(&record, buffer + sizeof(JournalRecord));
+        record.check_low = (unsigned int) check;
+        record.check_high = (unsigned int) (check >> 32);
+        memcpy(buffer, &record, sizeof(JournalRecord));
+
+        journal->pending.size -= room - size;
+        journal->pending.total += size;
+
+        for(j = 0; (j < formats) && !fail; ++j)
+        {
+            fail = (item->data[j].format == UTF8_TEXT_FORMAT)
+                ? !AddToBatch(&journal->pending, text, units * 2)
+                : !HoldInBatch(&journal->pending, item->data[j].memory);
+        }
+    }
+
+    FreeMemory(text);
+
+    if(fail)
+    {
+        ReleaseBatch(&journal->pending);
+        journal->failed = TRUE;
+        return;
+    }
+
+    ++(journal->stats.records);
+    journal->stats.bytes += size + payload;
+    journal->end += size + payload;
+    journal->last_record = GetTicks();
+
+    //Once enough has built up, it's handed over to be written, unless
+    //the last batch, or a snapshot, is still being written
+    if(journal->pending.total >= JOURNAL_BATCH_SIZE)
+    {
+        if(journal->worker && !journal->snapshot
+        && (LoadAcquire(&journal->work_state) != WORK_RUNNING))
+        {
+            FinishWork(journal, cq);
+        }
+
+        if(!journal->worker && !journal->failed)
+        {
+            StartWork(journal, FALSE);
+        }
+    }
+}
+
+
+/*******************************************************************
+** CheckRecord
+** ===========
+** Works out the check for a record: a hash of its header, up to the
+** check itself, and its formats.
+**
+** Inputs:
+**      JournalRecord* record   - the record
+**      const BYTE* formats     - its formats
+**
+** Outputs:
+**      uint64_t                - the check
+*******************************************************************/
+uint64_t CheckRecord(JournalRecord* record, const BYTE* formats)
+{
+    uint64_t check = HashBytes(record, offsetof(JournalRecord, check_low),
+        0);
+
+    return record->formats_size
+        ? HashBytes(formats, record->formats_size, check) : check;
+}
+
+
+/*******************************************************************
+** ExtendBatch
+** ===========
+** Makes room on the end of a batch for bytes to be filled in.  They
+** count towards its size, but not its total until they're done.
+**
+** Inputs:
+**      RecordBatch* batch      - the batch
+**      size_t size             - how much room
+**
+** Outputs:
+**      BYTE*                   - the room, good until the batch is
+**                                next extended; NULL if memory ran
+**                                out
+*******************************************************************/
+BYTE* ExtendBatch(RecordBatch* batch, size_t size)
+{
+    size_t capacity = batch->capacity ? batch->capacity : JOURNAL_COPY_SIZE;
+    BYTE* grown;
+
+    if(batch->size + size > batch->capacity)
+    {
+        while(capacity < batch->size + size)
+        {
+            capacity *= 2;
+        }
+
+        grown = (BYTE*) AllocMemory(capacity);
+
+        if(!grown)
+        {
+            return NULL;
+        }
+
+        if(batch->bytes)
+        {
+            memcpy(grown, batch->bytes, batch->size);
+            FreeMemory(batch->bytes);
+        }
+
+        batch->bytes = grown;
+        batch->capacity = capacity;
+    }
+
+    batch->size += size;
+
+    return batch->bytes + batch->size - size;
+}
+
+
+/*******************************************************************
+** AddToBatch
+** ==========
+** Copies bytes onto the end of a batch.
+**
+** Inputs:
+**      RecordBatch* batch      - the batch
+**      const void* bytes       - what to add
+**      size_t size             - how much
+**
+** Outputs:
+**      BOOL                    - FALSE if memory ran out
+*******************************************************************/
+BOOL AddToBatch(RecordBatch* batch, const void* bytes, size_t size)
+{
+    BYTE* room = ExtendBatch(batch, size);
+
+    if(!room)
+    {
+        return FALSE;
+    }
+
+    memcpy(room, bytes, size);
+    batch->total += size;
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** HoldInBatch
+** ===========
+** Adds a payload to the end of a batch, held where it is until the
+** batch is released (see HoldBlob).
+**
+** Inputs:
+**      RecordBatch* batch      - the batch
+**      void* memory            - the payload's blob
+**
+** Outputs:
+**      BOOL                    - FALSE if memory ran out or it
+**                                couldn't be held
+*******************************************************************/
+BOOL HoldInBatch(RecordBatch* batch, void* memory)
+{
+    unsigned int room = batch->room ? batch->room : 64;
+    BatchPayload* grown;
+    BatchPayload* payload;
+
+    if(batch->count == batch->room)
+    {
+        room *= 2;
+        grown = (BatchPayload*) AllocMemory(sizeof(BatchPayload) * room);
+
+        if(!grown)
+        {
+            return FALSE;
+        }
+
+        if(batch->payloads)
+        {
+            memcpy(grown, batch->payloads,
+                sizeof(BatchPayload) * batch->count);
+            FreeMemory(batch->payloads);
+        }
+
+        batch->payloads = grown;
+        batch->room = room;
+    }
+
+    payload = &batch->payloads[batch->count];
+    payload->at = batch->size;
+
+    if(!HoldBlob(memory, &payload->held))
+    {
+        return FALSE;
+    }
+
+    ++(batch->count);
+    batch->total += payload->held.size;
+
+    if(!payload->held.bytes && (payload->held.size > batch->largest))
+    {
+        batch->largest = payload->held.size;
+    }
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** ReleaseBatch
+** ============
+** Lets go of the payloads a batch holds, and empties it.
+**
+** Inputs:
+**      RecordBatch* batch      - the batch
+*******************************************************************/
+void ReleaseBatch(RecordBatch* batch)
+{
+    unsigned int i;
+
+    for(i = 0; i < batch->count; ++i)
+    {
+        ReleaseHeldBlob(&batch->payloads[i].held);
+    }
+
+    FreeMemory(batch->bytes);
+    FreeMemory(batch->payloads);
+    memset(batch, 0, sizeof(RecordBatch));
+}
+
+
+/*******************************************************************
+** WriteBatch
+** ==========
+** Writes a batch of records into the journal, small pieces gathered
+** up into bigger writes.  This can be done on any thread, since it
+** goes nowhere near the queue or the blob store (see GetHeldBytes).
+**
+** Inputs:
+**      HANDLE file                 - the journal
+**      uint64_t position           - where the batch goes
+**      const RecordBatch* batch    - the batch
+**
+** Outputs:
+**      BOOL                        - FALSE if it couldn't all be
+**                                    written
+*******************************************************************/
+BOOL WriteBatch(HANDLE file, uint64_t position, const RecordBatch* batch)
+{
+    BatchWriter writer;
+    BYTE* held = NULL;
+    const BYTE* bytes;
+    size_t done = 0, next;
+    unsigned int i;
+    BOOL fail;
+
+    writer.file = file;
+    writer.position = position;
+    writer.buffer = (BYTE*) AllocMemory(JOURNAL_COPY_SIZE);
+    writer.used = 0;
+
+    fail = (writer.buffer == NULL);
+
+    if(!fail && (batch->largest > 0))
+    {
+        held = (BYTE*) AllocMemory(batch->largest);
+        fail = (held == NULL);
+    }
+
+    //The batch's own bytes up to each payload, then the payload, and
+    //whatever's left after the last
+    for(i = 0; (i <= batch->count) && !fail; ++i)
+    {
+        next = (i < batch->count) ? batch->payloads[i].at : batch->size;
+        fail = !GatherBytes(&writer, batch->bytes + done, next - done);
+        done = next;
+
+        if(!fail && (i < batch->count))
+        {
+            bytes = GetHeldBytes(&batch->payloads[i].held, held);
+            fail = (bytes == NULL)
+                || !GatherBytes(&writer, bytes,
+                    batch->payloads[i].held.size);
+        }
+    }
+
+    fail = fail || ((writer.used > 0)
+        && !WriteBytesAt(file, writer.position, writer.buffer,
+            writer.used));
+
+    FreeMemory(writer.buffer);
+    FreeMemory(held);
+
+    return !fail;
+}
+
+
+/*******************************************************************
+** GatherBytes
+** ===========
+** Adds bytes to what a BatchWriter is gathering up, writing it out
+** when it won't fit.  Anything too big to gather is written there
+** and then.
+**
+** Inputs:
+**      BatchWriter* writer     - the writer
+**      const BYTE* bytes       - what to write
+**      size_t size             - how much; may be 0
+**
+** Outputs:
+**      BOOL                    - FALSE if writing failed
+*******************************************************************/
+BOOL GatherBytes(BatchWriter* writer, const BYTE* bytes, size_t size)
+{
+    if(writer->used + size > JOURNAL_COPY_SIZE)
+    {
+        if(!WriteBytesAt(writer->file, writer->position, writer->buffer,
+            writer->used))
+        {
+            return FALSE;
+        }
+
+        writer->position += writer->used;
+        writer->used = 0;
+    }
+
+    if(size >= JOURNAL_COPY_SIZE)
+    {
+        writer->position += size;
+
+        return WriteBytesAt(writer->file, writer->position - size, bytes,
+            size);
+    }
+
+    if(size > 0)
+    {
+        memcpy(writer->buffer + writer->used, bytes, size);
+        writer->used += size;
+    }
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** WritePending
+** ============
+** Writes the records not yet handed to be written there and then,
+** and lets go of them.  Nothing else may be writing the journal.
+** If they can't be written whole, they're cut off again and the
+** journal stops recording.
+**
+** Inputs:
+**      ClipJournal* journal    - the journal
+**
+** Outputs:
+**      BOOL                    - FALSE if they couldn't be written,
+**                                or the journal had stopped
+**                                recording already
+*******************************************************************/
+BOOL WritePending(ClipJournal* journal)
+{
+    BOOL success = !journal->failed;
+
+    if(success && (journal->pending.total > 0))
+    {
+        success = WriteBatch(journal->file, journal->written,
+            &journal->pending);
+
+        if(success)
+        {
+            journal->written += journal->pending.total;
+        }
+        else
+        {
+            SetFileLength(journal->file, journal->written);
+            journal->failed = TRUE;
+        }
+    }
+
+    ReleaseBatch(&journal->pending);
+
+    return success;
+}
+
+
+/*******************************************************************
+** SaveSnapshot
+** ============
+** Saves the queue to a temporary file, and once that's safely on
+** disk, moves it over the snapshot.  A crash never leaves the
+** snapshot half written.  Payloads still in the old snapshot are
+** read from it as they're saved, and only read in if it can't be
+** replaced while they're there.
+**
+** Inputs:
+**      ClipJournal* journal    - the queue's journal
+**      ClipQueue* cq           - the queue
+**
+** Outputs:
+**      BOOL                    - TRUE if the snapshot was replaced
+*******************************************************************/
+BOOL SaveSnapshot(ClipJournal* journal, ClipQueue* cq)
+{
+    if(SaveQueueToPath(cq, journal->snapshot_path, journal->temp_path))
+    {
+        return TRUE;
+    }
+
+    //Older versions of Windows can't replace a file that's still open
+    return LoadLazyBlobs(FALSE)
+        && SaveQueueToPath(cq, journal->snapshot_path, journal->temp_path);
+}
+
+
+/*******************************************************************
+** StartJournal
+** ============
+** Empties the journal and writes its header, for the generation of
+** the snapshot just saved.
+**
+** Inputs:
+**      ClipJournal* journal    - the journal
+**
+** Outputs:
+**      BOOL                    - TRUE if it's ready for records
+*******************************************************************/
+BOOL StartJournal(ClipJournal* journal)
+{
+    JournalHeader header;
+
+    memset(&header, 0, sizeof(JournalHeader));
+    header.signature = JOURNAL_SIGNATURE;
+    header.version = JOURNAL_VERSION;
+    header.generation = journal->generation;
+
+    journal->end = sizeof(JournalHeader);
+    journal->written = journal->end;
+    journal->flushed = journal->end;
+
+    //Emptied first, so the new header is never seen in front of the
+    //old records
+    return SetFileLength(journal->file, 0)
+        && WriteBytesAt(journal->file, 0, &header, sizeof(JournalHeader))
+        && FlushFile(journal->file);
+}
+
+
+/*******************************************************************
+** FlushJournal
+** ============
+** Writes the records not yet written, there and then, and makes
+** sure everything added since the last flush is on disk.  Nothing
+** else may be writing the journal.
+**
+** Inputs:
+**      ClipJournal* journal    - the journal
+**
+** Outputs:
+**      BOOL                    - FALSE if they couldn't be written
+**                                or flushed
+*******************************************************************/
+BOOL FlushJournal(ClipJournal* journal)
+{
+    if(!WritePending(journal))
+    {
+        return FALSE;
+    }
+
+    if(journal->flushed == journal->end)
+    {
+        return TRUE;
+    }
+
+    if(!FlushFile(journal->file))
+    {
+        return FALSE;
+    }
+
+    journal->flushed = journal->end;
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** StartSave
+** =========
+** Takes a snapshot of the queue, under the next generation, and
+** starts a thread writing the records not yet written, then saving
+** it.  Only the snapshot is taken here, which costs a reference to
+** each payload rather than a copy, and reads nothing from disk:
+** payloads the queue hasn't read in yet are read by the thread.  The
+** queue is free to change as soon as this returns.
+**
+** Inputs:
+**      ClipJournal* journal    - the queue's journal; nothing may be
+**                                writing it
+**      ClipQueue* cq           - the queue
+**
+** Outputs:
+**      BOOL                    - TRUE if the save is under way
+*******************************************************************/
+BOOL StartSave(ClipJournal* journal, ClipQueue* cq)
+{
+    journal->queue_generation = cq->generation;
+
+    //As CompactJournal, and the snapshot holds the journal so far
+    journal->saved_generation = ((journal->generation > cq->generation)
+        ? journal->generation : cq->generation) + 1;
+    cq->generation = journal->saved_generation;
+    cq->journaled = journal->end;
+
+    journal->snapshot = TakeQueueSnapshot(cq);
+    cq->journaled = 0;
+
+    if(journal->snapshot && !StartWork(journal, FALSE))
+    {
+        ReleaseQueueSnapshot(journal->snapshot);
+        journal->snapshot = NULL;
+    }
+
+    if(!journal->snapshot)
+    {
+        cq->generation = journal->queue_generation;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** StartWork
+** =========
+** Hands the records not yet written to a thread to be written, and
+** flushed if asked, along with any snapshot StartSave took.  Records
+** added from now on are batched up again.
+**
+** Inputs:
+**      ClipJournal* journal    - the journal; nothing may be
+**                                writing it
+**      BOOL flush              - TRUE to flush the journal too
+**
+** Outputs:
+**      BOOL                    - TRUE if the thread is under way
+*******************************************************************/
+BOOL StartWork(ClipJournal* journal, BOOL flush)
+{
+    journal->writing = journal->pending;
+    memset(&journal->pending, 0, sizeof(RecordBatch));
+
+    journal->flush = flush;
+    journal->work_state = WORK_RUNNING;
+    journal->worker = StartThread(WorkInBackground, journal);
+
+    if(!journal->worker)
+    {
+        journal->pending = journal->writing;
+        memset(&journal->writing, 0, sizeof(RecordBatch));
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** WorkInBackground
+** ================
+** Thread routine that writes the records StartWork handed over,
+** then saves the snapshot, if there is one, as SaveSnapshot does.
+** It touches nothing but the batch, the snapshot, the files and
+** work_state.
+**
+** Inputs:
+**      void* arg           - the ClipJournal
+*******************************************************************/
+void WorkInBackground(void* arg)
+{
+    ClipJournal* journal = (ClipJournal*) arg;
+    unsigned int state = WORK_DONE;
+
+    if(!WriteBatch(journal->file, journal->written, &journal->writing)
+    || (journal->flush && !FlushFile(journal->file)))
+    {
+        state = WORK_FAILED;
+    }
+    else if(journal->snapshot
+    && !WriteQueueSnapshotToPath(journal->snapshot, journal->snapshot_path,
+        journal->temp_path))
+    {
+        state = WORK_UNSAVED;
+    }
+
+    StoreRelease(&journal->work_state, state);
+}
+
+
+/*******************************************************************
+** FinishWork
+** ==========
+** Waits for the thread StartWork began, and lets go of the records
+** it wrote.  If they couldn't be written, they're cut off again and
+** the journal stops recording.  If a snapshot was saved as well, the
+** journal is started again from where it was taken; if not, it
+** carries on as it was.
+**
+** Inputs:
+**      ClipJournal* journal    - the queue's journal
+**      ClipQueue* cq           - the queue
+**
+** Outputs:
+**      BOOL                    - TRUE if the records were written,
+**                                and any snapshot saved and the
+**                                journal started again
+*******************************************************************/
+BOOL FinishWork(ClipJournal* journal, ClipQueue* cq)
+{
+    unsigned int state;
+    BOOL success;
+
+    JoinThread(journal->worker);
+    journal->worker = NULL;
+
+    state = LoadAcquire(&journal->work_state);
+
+    if(state == WORK_FAILED)
+    {
+        SetFileLength(journal->file, journal->written);
+        journal->failed = TRUE;
+        ReleaseBatch(&journal->pending);
+    }
+    else
+    {
+        journal->written += journal->writing.total;
+
+        if(journal->flush)
+        {
+            journal->flushed = journal->written;
+        }
+    }
+
+    ReleaseBatch(&journal->writing);
+    success = (state == WORK_DONE);
+
+    if(!journal->snapshot)
+    {
+        return success;
+    }
+
+    ReleaseQueueSnapshot(journal->snapshot);
+    journal->snapshot = NULL;
+
+    if(success)
+    {
+        journal->generation = journal->saved_generation;
+        ++(journal->stats.compactions);
+
+        success = RestartJournal(journal);
+    }
+    else if(cq->generation == journal->saved_generation)
+    {
+        //Unless the queue has been replaced in the meantime
+        cq->generation = journal->queue_generation;
+    }
+
+    return success;
+}
+
+
+/*******************************************************************
+** RestartJournal
+** ==============
+** Replaces the journal with an empty one for the snapshot just
+** saved in the background, which holds every record written before
+** it; the records added since are still to be written, and go in
+** the new one.  It's written to the temporary file and moved over
+** the old one, so a crash leaves one or the other.  If it can't be
+** done, the journal stops recording.
+**
+** Inputs:
+**      ClipJournal* journal    - the journal
+**
+** Outputs:
+**      BOOL                    - TRUE if it was started again
+*******************************************************************/
+BOOL RestartJournal(ClipJournal* journal)
+{
+    JournalHeader header;
+    HANDLE fhand = OpenFileForWriting(journal->temp_path);
+    BOOL success = (fhand != INVALID_HANDLE_VALUE);
+
+    memset(&header, 0, sizeof(JournalHeader));
+    header.signature = JOURNAL_SIGNATURE;
+    header.version = JOURNAL_VERSION;
+    header.generation = journal->generation;
+
+    success = success
+        && WriteBytes(fhand, &header, sizeof(JournalHeader))
+        && FlushFile(fhand);
+    CloseFileHandle(fhand);
+
+    if(success)
+    {
+        //Whichever journal is there now is the one to go on with
+        CloseFileHandle(journal->file);
+        success = MoveFileOver(journal->temp_path, journal->journal_path);
+        journal->file = OpenFileForUpdate(journal->journal_path);
+        success = success && (journal->file != INVALID_HANDLE_VALUE);
+    }
+
+    if(success)
+    {
+        journal->end = sizeof(JournalHeader) + journal->end
+            - journal->written;
+        journal->written = sizeof(JournalHeader);
+        journal->flushed = journal->written;
+    }
+    else
+    {
+        journal->failed = TRUE;
+    }
+
+    return success;
+}
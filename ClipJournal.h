@@ -0,0 +1,79 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#ifndef __CLIPJOURNAL__
+#define __CLIPJOURNAL__
+
+#include "Platform.h"
+#include "ClipItem.h"
+#include "ClipQueue.h"
+
+//A journal records every change made to a queue as it's made, so the
+//queue can be saved without writing all of it out each time: a
+//snapshot of the queue is saved now and then (compacting the
+//journal), and at startup the snapshot is loaded and the journal
+//replayed on top of it.  See ClipJournal.c.
+
+//Journals that grow this big are compacted, unless the queue itself
+//is bigger still
+#define JOURNAL_COMPACT_MIN     (1024 * 1024)
+
+//AutosaveJournal waits this long (ms) after the last change before
+//compacting, so a burst of changes is saved once, at the end
+#define JOURNAL_QUIET_TIME      2000
+
+typedef struct ClipJournal ClipJournal;
+
+typedef struct
+{
+    unsigned long   records;        //written since it was opened
+    uint64_t        bytes;          //...and their size
+    uint64_t        size;           //of the journal as it stands
+    uint64_t        unwritten;      //...of it still to be written
+    unsigned int    compactions;
+    unsigned long   replayed;       //records replayed when opened
+    uint64_t        discarded;      //bytes of damaged or torn records
+                                    //cut off the end when opened
+    BOOL            writing;        //records are being written in the
+                                    //background
+    BOOL            saving;         //...and a snapshot saved after them
+}JournalStats;
+
+extern BOOL OpenJournal(ClipQueue* cq, const PathChar* journal_path,
+    const PathChar* snapshot_path, const PathChar* temp_path, BOOL replay);
+extern BOOL CloseJournal(ClipQueue* cq);
+extern BOOL CompactJournal(ClipQueue* cq, BOOL always);
+extern BOOL AutosaveJournal(ClipQueue* cq, unsigned int now);
+extern void GetJournalStats(ClipQueue* cq, JournalStats* stats);
+
+//Called by the queue as it changes; each does nothing if the queue
+//has no journal
+extern void JournalPush(ClipQueue* cq, ClipItem* item, BOOL at_front);
+extern void JournalRemove(ClipQueue* cq, unsigned int offset);
+extern void JournalMove(ClipQueue* cq, unsigned int offset, BOOL to_front);
+extern void JournalAddFormats(ClipQueue* cq, unsigned int offset,
+    ClipItem* extra);
+extern void JournalDropFormat(ClipQueue* cq, unsigned int offset,
+    unsigned int format);
+extern void JournalEmpty(ClipQueue* cq);
+extern void JournalResize(ClipQueue* cq, unsigned int new_size);
+
+#endif
@@ -1,560 +1,1976 @@
-/****************************************************************************
-** QClip
-** Copyright 2006 Aaron Curtis
-**
-** This file is part of QClip.
-**
-** QClip is free software: you can redistribute it and/or modify
-** it under the terms of the GNU General Public License as published by
-** the Free Software Foundation, either version 3 of the License, or
-** (at your option) any later version.
-**
-** QClip is distributed in the hope that it will be useful,
-** but WITHOUT ANY WARRANTY; without even the implied warranty of
-** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
-** GNU General Public License for more details.
-**
-** You should have received a copy of the GNU General Public License
-** along with QClip. If not, see <https://www.gnu.org/licenses/>.
-****************************************************************************/
-
-#include <windows.h>
-#include "ClipQueue.h"
-#include "Clipboard.h"
-#include "QClip.h"
-#include <tchar.h>
-#include <windows.h>
-#include <stdio.h>
-
-#define MIN_DYNAMIC_SIZE 16
-#define MAX_DUPLICATE_TIME 20
-
-static unsigned int CheckDynamicSize(ClipQueue* cq);
-static void EmptyQueue(ClipQueue* cq);
-static BOOL IsDuplicate(ClipQueue* cq, ClipItem* item);
-
-/*******************************************************************
-** PeekAt
-** ======
-** Provides random access to the queue.  Copies a ClipItem to the
-** Windows clipboard from an integer-indexed position.  Does not
-** modify the queue.
-**
-** Inputs:
-**      ClipQueue* cq       - address of the queue.
-**      unsigned int offset - zero-based index in the queue of the
-**                            item to copy (i.e. 0 is cq->front) 
-**
-** Outputs:
-**      unsigned int        - number of formats successfully copied
-**                            (may be zero)
-*******************************************************************/
-unsigned int PeekAt(ClipQueue* cq, unsigned int offset)
-{  
-    if(offset < GetQueueLength(cq))
-    {
-        return CopyToClipboard(GetItem(cq, offset));
-    }
-    else
-    {
-        return 0;
-    }
-}
-
-
-/*******************************************************************
-** PushFront
-** =========
-** Appends a ClipItem from Windows clipboard to the front of the
-** queue, increasing the queue size by one.
-**
-** Inputs:
-**      ClipQueue* cq       - address of the queue.
-*******************************************************************/
-void PushFront(ClipQueue* cq)
-{
-    ClipItem temp_item;
-
-    if(PopulateClipItem(&temp_item) && !IsDuplicate(cq, &temp_item))
-    {
-        CheckDynamicSize(cq);
-
-        cq->front = (cq->front - 1 + cq->size) % cq->size;
-        DestroyClipItem(&cq->clips[cq->front]);
-    
-        cq->clips[cq->front] = temp_item;
-
-        cq->last_item = cq->front;
-        cq->last_time = GetTickCount();
-
-        if(cq->count < cq->size)
-        {
-            ++(cq->count);
-        }
-
-        cq->modified = TRUE;
-    }
-}
-
-
-/*******************************************************************
-** PushBack
-** ========
-** Appends a ClipItem from Windows clipboard to the back of the
-** queue, increasing the queue size by one.
-**
-** Inputs:
-**      ClipQueue* cq       - address of the queue.
-*******************************************************************/
-void PushBack(ClipQueue* cq)
-{
-    ClipItem temp_item;
-
-    if(PopulateClipItem(&temp_item) && !IsDuplicate(cq, &temp_item))
-    {
-        CheckDynamicSize(cq);
-
-        DestroyClipItem(&cq->clips[(cq->front + cq->count) % cq->size]);
-    
-        cq->clips[(cq->front + cq->count) % cq->size] = temp_item;
-
-        cq->last_item = (cq->front + cq->count) % cq->size;
-        cq->last_time = GetTickCount();
-
-        if(cq->count < cq->size)
-        {
-            ++(cq->count);
-        }
-
-        cq->modified = TRUE;
-    }
-}
-
-
-/*******************************************************************
-** PeekFront
-** =========
-** Copies a ClipItem from the front of the queue to the Windows
-** clipboard.  Does not modify the queue.
-**
-** Inputs:
-**      ClipQueue* cq       - address of the queue.
-**
-** Outputs:
-**      unsigned int        - number of formats successfully copied
-**                            (may be zero)
-*******************************************************************/
-unsigned int PeekFront(ClipQueue* cq)
-{
-    if(!IsQueueEmpty(cq))
-    {
-        return CopyToClipboard(GetItem(cq, 0));
-    }
-    else
-    {
-        return 0;
-    }
-}
-
-
-/*******************************************************************
-** PeekBack
-** ========
-** Copies a ClipItem from the back of the queue to the Windows
-** clipboard.  Does not modify the queue.
-**
-** Inputs:
-**      ClipQueue* cq       - address of the queue.
-**
-** Outputs:
-**      unsigned int        - number of formats successfully copied
-**                            (may be zero)
-*******************************************************************/
-unsigned int PeekBack(ClipQueue* cq)
-{
-    if(!IsQueueEmpty(cq))
-    {
-        return CopyToClipboard(GetItem(cq, cq->count - 1));
-    }
-    else
-    {
-        return 0;
-    }
-}
-
-
-/*******************************************************************
-** PopFront
-** ========
-** Moves a ClipItem from the front of the queue to the Windows
-** clipboard.  Decreases the queue size by one.
-**
-** Inputs:
-**      ClipQueue* cq       - address of the queue.
-**
-** Outputs:
-**      unsigned int        - number of formats successfully copied
-**                            (may be zero)
-*******************************************************************/
-unsigned int PopFront(ClipQueue* cq)
-{
-    unsigned int successes = 0;
-
-    if(!IsQueueEmpty(cq))
-    {
-        successes = CopyToClipboard(GetItem(cq, 0));
-
-        DestroyClipItem(&cq->clips[cq->front]);
-        cq->front = (cq->front + 1) % cq->size;
-        --(cq->count);
-
-        cq->modified = TRUE;
-    }
-
-    CheckDynamicSize(cq);
-
-    return successes;
-}
-
-
-
-/*******************************************************************
-** PopBack
-** =======
-** Moves a ClipItem from the back of the queue to the Windows
-** clipboard.  Decreases the queue size by one.
-**
-** Inputs:
-**      ClipQueue* cq       - address of the queue.
-**
-** Outputs:
-**      unsigned int        - number of formats successfully copied
-**                            (may be zero)
-*******************************************************************/
-unsigned int PopBack(ClipQueue* cq)
-{
-    unsigned int successes = 0;
-
-    if(!IsQueueEmpty(cq))
-    {
-        --(cq->count);
-        successes = CopyToClipboard(GetItem(cq, cq->count));
-
-        DestroyClipItem(&cq->clips[(cq->front + cq->count) % cq->size]);
-
-        cq->modified = TRUE;
-    }
-
-    CheckDynamicSize(cq);
-
-    return successes;
-}
-
-
-/*******************************************************************
-** DiscardFront
-** ============
-** Removes the item at the front of the queue.
-**
-** Inputs:
-**      ClipQueue* cq       - address of the queue.
-*******************************************************************/
-void DiscardFront(ClipQueue* cq)
-{
-    if(!IsQueueEmpty(cq))
-    {
-        DestroyClipItem(&cq->clips[cq->front]);
-        cq->front = (cq->front + 1) % cq->size;
-        --(cq->count);
-
-        cq->modified = TRUE;
-    }
-
-    CheckDynamicSize(cq);
-}
-
-
-/*******************************************************************
-** DiscardBack
-** ===========
-** Removes the item at the back of the queue.
-**
-** Inputs:
-**      ClipQueue* cq       - address of the queue.
-*******************************************************************/
-void DiscardBack(ClipQueue* cq)
-{
-    if(!IsQueueEmpty(cq))
-    {
-        --(cq->count);
-
-        DestroyClipItem(&cq->clips[(cq->front + cq->count) % cq->size]);
-
-        cq->modified = TRUE;
-    }
-
-    CheckDynamicSize(cq);
-}
-
-
-
-/*******************************************************************
-** CreateQueue
-** ===========
-** Initializes an existing queue by allocating an empty array of
-** ClipItems, according to queue_size.
-** Be sure to call DestroyQueue.
-**
-** Inputs:
-**      ClipQueue* cq           - address of the queue to
-**                                initialize.
-**      unsigned int queue_size - maximum size of the queue
-**
-** Outputs:
-**      BOOL                    - TRUE if creation succeeded.
-*******************************************************************/
-BOOL CreateQueue(ClipQueue* cq, unsigned int queue_size)
-{
-    InitQueue(cq);
-    cq->size = queue_size;
-    cq->clips = (ClipItem*) HeapAlloc(
-        GetProcessHeap(),
-        HEAP_ZERO_MEMORY,
-        sizeof(ClipItem) * queue_size);
-
-    return (cq->clips != NULL);
-}
-
-
-/*******************************************************************
-** DestroyQueue
-** ============
-** Frees the memory allocated by CreateQueue and destroys any
-** ClipItems contained in the queue.
-**
-** Inputs:
-**      ClipQueue* cq           - address of the queue to
-**                                destroy.
-*******************************************************************/
-void DestroyQueue(ClipQueue* cq)
-{
-    if(cq->clips)
-    {
-        EmptyQueue(cq);
-        HeapFree(GetProcessHeap(), 0, cq->clips);
-    }
-
-    cq->size = 1;
-    cq->count = 0;
-    cq->clips = NULL;
-}
-
-
-/*******************************************************************
-** EmptyQueueAndResize
-** ===================
-** Empties the queue and shrinks it if dynamic sizing is enabled.
-** This function should be called in response to the Empty Queue
-** UI command.
-**
-** Inputs:
-**      ClipQueue* cq           - address of the queue to empty.
-*******************************************************************/
-void EmptyQueueAndResize(ClipQueue* cq)
-{
-    EmptyQueue(cq);
-
-    if(gv.settings.dynamic_queue)
-    {
-        ResizeQueue(cq, MIN_DYNAMIC_SIZE);
-    }
-}
-
-
-/*******************************************************************
-** EmptyQueue
-** ==========
-** Empties the queue and releases all memory used by ClipItems
-** therein.
-**
-** Inputs:
-**      ClipQueue* cq           - address of the queue to empty.
-*******************************************************************/
-void EmptyQueue(ClipQueue* cq)
-{
-    unsigned int i;
-
-    if(GetQueueLength(cq) > 0)
-    {
-        cq->modified = TRUE;
-    }
-
-    if(cq->clips)
-    {
-        for(i = 0; i < cq->size; ++i)
-        {
-            DestroyClipItem(&cq->clips[i]);
-        }
-    }
-
-    cq->front = 0;
-    cq->count = 0;
-}
-
-
-/*******************************************************************
-** InitQueue
-** =========
-** Resets all queue structure values to defaults, e.g. zero length,
-** memory pointing to NULL, etc.
-**
-** Don't call this on queues with allocated memory.
-**
-** Inputs:
-**      ClipQueue* cq       - address of the queue to initialize.
-*******************************************************************/
-void InitQueue(ClipQueue* cq)
-{
-    cq->front       = 0;
-    cq->count       = 0;
-
-    cq->last_item   = 0;
-    cq->last_time   = 0;
-
-    //The size might logically be 0, but we don't want
-    //stuff to crash with divide-by-zero errors...
-    cq->size        = 1;
-    cq->clips       = NULL;
-    cq->modified    = FALSE;
-}
-
-
-/*******************************************************************
-** CheckDynamicSize
-** ================
-** If dynaimc queue sizing is turned on (i.e. unlimited queue),
-** expands the queue when it gets full and shrinks it when it goes
-** under 1/4 capacity.
-**
-** This function should be called before adding and after removing
-** any item to/from the queue.
-**
-** Inputs:
-**      ClipQueue* cq           - address of the queue to resize.
-**
-** Outputs:
-**      unsigned int            - (possibly new) size of the queue.
-*******************************************************************/
-unsigned int CheckDynamicSize(ClipQueue* cq)
-{
-    if(gv.settings.dynamic_queue)
-    {
-        if(cq->count == cq->size)
-        {
-            ResizeQueue(cq, cq->size * 2);
-        }
-        else if(cq->count < cq->size / 4)
-        {
-            if(cq->size > MIN_DYNAMIC_SIZE * 2)
-            {
-                ResizeQueue(cq, cq->size / 2);
-            }
-            else if(cq->size > MIN_DYNAMIC_SIZE)
-            {
-                ResizeQueue(cq, MIN_DYNAMIC_SIZE);
-            }
-        }
-    }
-
-    return cq->size;
-}
-
-
-/*******************************************************************
-** ResizeQueue
-** ===========
-** Reallocates memory for a queue according to a new size.
-** Preserves as many items from the existing queue as possible,
-** starting with the newest (i.e. front).  This function will set
-** the queue size to the new value if successful.
-**
-** Inputs:
-**      ClipQueue* cq           - address of the queue to resize.
-**      unsigned int new_size   - new size of the queue
-**
-** Outputs:
-**      BOOL                    - TRUE if resizing succeeded.
-*******************************************************************/
-BOOL ResizeQueue(ClipQueue* cq, unsigned int new_size)
-{
-    ClipItem* new_clips = HeapAlloc(
-        GetProcessHeap(),
-        HEAP_ZERO_MEMORY,
-        sizeof(ClipItem) * new_size);
-
-    unsigned int old_count = cq->count;
-
-    if(new_clips)
-    {
-        unsigned int i;
-
-        for(i = 0; (i < cq->count) && (i < new_size); ++i)
-        {
-            new_clips[i] = cq->clips[(cq->front + i) % cq->size];
-
-            cq->clips[(cq->front + i) % cq->size].data = NULL;
-            cq->clips[(cq->front + i) % cq->size].formats = 0;
-        }
-
-        DestroyQueue(cq);
-        cq->clips   = new_clips;
-        cq->count   = i;
-        cq->front   = 0;
-        cq->size    = new_size;
-
-        if(i != old_count)
-        {
-            cq->modified = TRUE;
-        }
-    }       
-
-    return (new_clips != NULL);
-}
-
-
-/*******************************************************************
-** IsDuplicate
-** ===========
-** Checks if a new ClipItem is a duplicate of the last one added
-** to a particular queue.
-**
-** Duplicates are only considered if they come within a few ms of
-** each other - the idea is to block programs that inadvertently
-** copy data to the clipboard multiple times.
-**
-** Inputs:
-**      ClipItem* item      - the item to check
-**
-** Outputs:
-**      BOOL                - TRUE if the item is a duplicate
-*******************************************************************/
-BOOL IsDuplicate(ClipQueue* cq, ClipItem* item)
-{
-    BOOL duplicate = FALSE;
-
-    if(cq && cq->modified)
-    {
-        unsigned int now = GetTickCount();
-
-        unsigned int relative_position =
-            (cq->last_item - cq->front + cq->size) % cq->size;
-
-        if((relative_position < cq->count)
-        && (now - cq->last_time < MAX_DUPLICATE_TIME))
-        {
-            duplicate = CompareClipItems(item, cq->clips + cq->last_item);
-        }
-    }
-
-    return duplicate;
-}
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include "Platform.h"
+#include "ClipQueue.h"
+#include "ClipItem.h"
+#include "ClipJournal.h"
+#include <string.h>
+
+#define MIN_DYNAMIC_SIZE 16
+#define MAX_DUPLICATE_TIME 20
+#define MIN_DIRECTORY_SIZE 8
+
+static unsigned int CheckDynamicSize(ClipQueue* cq);
+static BOOL IsDuplicate(ClipQueue* cq, ClipItem* item);
+static BOOL MoveDuplicate(ClipQueue* cq, ClipItem* item, BOOL to_front);
+static void SyncIndex(ClipQueue* cq);
+static void StoreSlot(ClipQueue* cq, ClipItem* slot, ClipItem* item,
+    unsigned int key);
+static void ReleaseSlot(ClipQueue* cq, unsigned int offset);
+static ClipItem* AddFrontSlot(ClipQueue* cq);
+static ClipItem* AddBackSlot(ClipQueue* cq);
+static void RemoveFrontSlot(ClipQueue* cq);
+static void RemoveBackSlot(ClipQueue* cq);
+static void LeaveHole(ClipQueue* cq, unsigned int offset);
+static void CompactQueue(ClipQueue* cq);
+static BOOL AddChunk(ClipQueue* cq, BOOL at_front);
+static void DropChunk(ClipQueue* cq, BOOL at_front);
+static BOOL ResizeDirectory(ClipQueue* cq);
+static unsigned int FindPlace(ClipQueue* cq, unsigned int offset);
+static unsigned int GetKeyOffset(ClipQueue* cq, unsigned int key);
+static void MarkPlace(ClipQueue* cq, unsigned int place, BOOL live);
+static void BuildChunkTree(ClipQueue* cq);
+static unsigned int CountBits(uint64_t bits);
+static BOOL DropCostliestFormat(ClipQueue* cq);
+static unsigned int FindCostliestItem(ClipQueue* cq);
+
+#define GetItemCost(cq, item, size) \
+    ((double) (size) * ((cq)->serial - (item)->serial + 1.0))
+
+//A place counts slots from the start of the front chunk, holes and
+//all.  A key names the same slot by its chunk's directory position
+//instead, so it doesn't change as chunks come and go at the front;
+//that's what the item index holds.
+#define GetPlaceSlot(cq, place) \
+    (&(cq)->chunks[(cq)->first_chunk + ((place) >> QUEUE_CHUNK_SHIFT)] \
+    ->items[(place) & QUEUE_CHUNK_MASK])
+#define IsPlaceLive(cq, place) \
+    (((cq)->chunks[(cq)->first_chunk + ((place) >> QUEUE_CHUNK_SHIFT)] \
+    ->live[((place) & QUEUE_CHUNK_MASK) >> 6] >> ((place) & 63)) & 1)
+#define GetBackPlace(cq)    ((cq)->front + (cq)->count + (cq)->holes - 1)
+#define GetEndPlace(cq, at_front) \
+    ((at_front) ? (cq)->front : GetBackPlace(cq))
+#define GetPlaceKey(cq, place) \
+    ((((cq)->first_chunk + ((place) >> QUEUE_CHUNK_SHIFT) \
+    + (cq)->key_origin) << QUEUE_CHUNK_SHIFT) | ((place) & QUEUE_CHUNK_MASK))
+#define KEY_CHUNK_MASK      (0xFFFFFFFFu >> QUEUE_CHUNK_SHIFT)
+
+#define ClearSlot(slot) \
+    ((slot)->data = NULL, (slot)->formats = 0, (slot)->preview = NULL)
+
+QueuePolicy queue_policy = {1, FALSE, FALSE, 0, 0, 0};
+
+
+/*******************************************************************
+** PeekAt
+** ======
+** Provides random access to the queue.  Copies a ClipItem to the
+** Windows clipboard from an integer-indexed position.  Does not
+** modify the queue, though the item counts as used again.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**      unsigned int offset - zero-based index in the queue of the
+**                            item to copy (i.e. 0 is cq->front) 
+**
+** Outputs:
+**      unsigned int        - number of formats successfully copied
+**                            (may be zero)
+*******************************************************************/
+unsigned int PeekAt(ClipQueue* cq, unsigned int offset)
+{  
+    if(offset < GetQueueLength(cq))
+    {
+        GetItem(cq, offset)->touched = GetTicks();
+        return CopyToClipboard(GetItem(cq, offset));
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+
+/*******************************************************************
+** PushFront
+** =========
+** Appends a ClipItem from Windows clipboard to the front of the
+** queue, increasing the queue size by one.  See PushItemFront.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+*******************************************************************/
+void PushFront(ClipQueue* cq)
+{
+    ClipItem temp_item;
+
+    if(PopulateClipItem(&temp_item))
+    {
+        PushItemFront(cq, &temp_item);
+    }
+}
+
+
+/*******************************************************************
+** PushItemFront
+** =============
+** Appends an already captured ClipItem to the front of the queue,
+** which takes it over.  If duplicates are being moved and the item
+** is already queued, the existing copy moves to the front instead.
+** Older items may then be trimmed to stay within the byte budget,
+** and the item pushed past cold_position is compressed.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**      ClipItem* item      - item to push; left empty afterwards
+*******************************************************************/
+void PushItemFront(ClipQueue* cq, ClipItem* item)
+{
+    ClipItem temp_item = *item;
+
+    item->data = NULL;
+    item->formats = 0;
+    item->preview = NULL;
+
+    if(IsDuplicate(cq, &temp_item))
+    {
+        DestroyClipItem(&temp_item);
+    }
+    else if(!MoveDuplicate(cq, &temp_item, TRUE))
+    {
+        CheckDynamicSize(cq);
+
+        //A full queue loses its back item to make room
+        if(!IsQueueEmpty(cq) && (cq->count >= cq->size))
+        {
+            ReleaseSlot(cq, cq->count - 1);
+            RemoveBackSlot(cq);
+        }
+
+        if(InsertItem(cq, &temp_item, TRUE))
+        {
+            cq->last_time = GetTicks();
+        }
+
+        cq->modified = TRUE;
+    }
+
+    EnforceByteBudget(cq);
+
+    if((queue_policy.cold_position > 0)
+    && (cq->count > queue_policy.cold_position))
+    {
+        CompressClipItem(GetItem(cq, queue_policy.cold_position));
+    }
+}
+
+
+/*******************************************************************
+** AddFormatsToItem
+** ================
+** Adds formats that were fetched late to an item already queued,
+** as long as it's still there.  The byte budget then applies as
+** after a push.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**      unsigned int serial - serial of the item to add to
+**      ClipItem* extra     - the formats; left empty
+**
+** Outputs:
+**      BOOL                - FALSE if the item is gone
+*******************************************************************/
+BOOL AddFormatsToItem(ClipQueue* cq, unsigned int serial, ClipItem* extra)
+{
+    unsigned int offset;
+
+    //Usually the front item, as the formats follow close behind
+    for(offset = 0; offset < cq->count; ++offset)
+    {
+        if(GetItem(cq, offset)->serial == serial)
+        {
+            break;
+        }
+    }
+
+    if(offset == cq->count)
+    {
+        DestroyClipItem(extra);
+        return FALSE;
+    }
+
+    MergeIntoItem(cq, offset, extra);
+    EnforceByteBudget(cq);
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** PushBack
+** ========
+** Appends a ClipItem from Windows clipboard to the back of the
+** queue, increasing the queue size by one.  If duplicates are
+** being moved and the item is already queued, the existing copy
+** moves to the back instead.  Older items may then be trimmed to
+** stay within the byte budget.  If the back is past cold_position,
+** the item is compressed straight away.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+*******************************************************************/
+void PushBack(ClipQueue* cq)
+{
+    ClipItem temp_item;
+
+    if(!PopulateClipItem(&temp_item))
+    {
+        return;
+    }
+
+    if(IsDuplicate(cq, &temp_item))
+    {
+        DestroyClipItem(&temp_item);
+    }
+    else if(!MoveDuplicate(cq, &temp_item, FALSE))
+    {
+        CheckDynamicSize(cq);
+
+        //A full queue loses its front item to make room
+        if(!IsQueueEmpty(cq) && (cq->count >= cq->size))
+        {
+            ReleaseSlot(cq, 0);
+            RemoveFrontSlot(cq);
+        }
+
+        if(InsertItem(cq, &temp_item, FALSE))
+        {
+            cq->last_time = GetTicks();
+        }
+
+        cq->modified = TRUE;
+    }
+    EnforceByteBudget(cq);
+
+    if((queue_policy.cold_position > 0)
+    && (cq->count > queue_policy.cold_position))
+    {
+        CompressClipItem(GetItem(cq, cq->count - 1));
+    }
+}
+
+
+/*******************************************************************
+** PeekFront
+** =========
+** Copies a ClipItem from the front of the queue to the Windows
+** clipboard.  Does not modify the queue, though the item counts as
+** used again.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**
+** Outputs:
+**      unsigned int        - number of formats successfully copied
+**                            (may be zero)
+*******************************************************************/
+unsigned int PeekFront(ClipQueue* cq)
+{
+    if(!IsQueueEmpty(cq))
+    {
+        GetItem(cq, 0)->touched = GetTicks();
+        return CopyToClipboard(GetItem(cq, 0));
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+
+/*******************************************************************
+** PeekBack
+** ========
+** Copies a ClipItem from the back of the queue to the Windows
+** clipboard.  Does not modify the queue, though the item counts as
+** used again.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**
+** Outputs:
+**      unsigned int        - number of formats successfully copied
+**                            (may be zero)
+*******************************************************************/
+unsigned int PeekBack(ClipQueue* cq)
+{
+    if(!IsQueueEmpty(cq))
+    {
+        GetItem(cq, cq->count - 1)->touched = GetTicks();
+        return CopyToClipboard(GetItem(cq, cq->count - 1));
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+
+/*******************************************************************
+** PopFront
+** ========
+** Moves a ClipItem from the front of the queue to the Windows
+** clipboard.  Decreases the queue size by one.  Payloads the item
+** doesn't share are handed over rather than copied.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**
+** Outputs:
+**      unsigned int        - number of formats successfully copied
+**                            (may be zero)
+*******************************************************************/
+unsigned int PopFront(ClipQueue* cq)
+{
+    unsigned int successes = 0;
+
+    if(!IsQueueEmpty(cq))
+    {
+        successes = MoveToClipboard(GetItem(cq, 0));
+
+        ReleaseSlot(cq, 0);
+        RemoveFrontSlot(cq);
+
+        cq->modified = TRUE;
+    }
+
+    CheckDynamicSize(cq);
+
+    return successes;
+}
+
+
+
+/*******************************************************************
+** PopBack
+** =======
+** Moves a ClipItem from the back of the queue to the Windows
+** clipboard.  Decreases the queue size by one.  Payloads the item
+** doesn't share are handed over rather than copied.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**
+** Outputs:
+**      unsigned int        - number of formats successfully copied
+**                            (may be zero)
+*******************************************************************/
+unsigned int PopBack(ClipQueue* cq)
+{
+    unsigned int successes = 0;
+
+    if(!IsQueueEmpty(cq))
+    {
+        successes = MoveToClipboard(GetItem(cq, cq->count - 1));
+
+        ReleaseSlot(cq, cq->count - 1);
+        RemoveBackSlot(cq);
+
+        cq->modified = TRUE;
+    }
+
+    CheckDynamicSize(cq);
+
+    return successes;
+}
+
+
+/*******************************************************************
+** DiscardFront
+** ============
+** Removes the item at the front of the queue.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+*******************************************************************/
+void DiscardFront(ClipQueue* cq)
+{
+    if(!IsQueueEmpty(cq))
+    {
+        ReleaseSlot(cq, 0);
+        RemoveFrontSlot(cq);
+
+        cq->modified = TRUE;
+    }
+
+    CheckDynamicSize(cq);
+}
+
+
+/*******************************************************************
+** DiscardBack
+** ===========
+** Removes the item at the back of the queue.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+*******************************************************************/
+void DiscardBack(ClipQueue* cq)
+{
+    if(!IsQueueEmpty(cq))
+    {
+        ReleaseSlot(cq, cq->count - 1);
+        RemoveBackSlot(cq);
+
+        cq->modified = TRUE;
+    }
+
+    CheckDynamicSize(cq);
+}
+
+
+
+/*******************************************************************
+** CreateQueue
+** ===========
+** Initializes an existing queue that can hold up to queue_size
+** ClipItems.  Storage is added in chunks as items arrive.
+** Be sure to call DestroyQueue.
+**
+** Inputs:
+**      ClipQueue* cq           - address of the queue to
+**                                initialize.
+**      unsigned int queue_size - maximum size of the queue
+**
+** Outputs:
+**      BOOL                    - TRUE if creation succeeded.
+*******************************************************************/
+BOOL CreateQueue(ClipQueue* cq, unsigned int queue_size)
+{
+    InitQueue(cq);
+    cq->size = queue_size;
+    cq->chunks = (QueueChunk**) AllocMemory(
+        sizeof(QueueChunk*) * MIN_DIRECTORY_SIZE);
+    cq->chunk_tree = (unsigned int*) AllocMemory(
+        sizeof(unsigned int) * (MIN_DIRECTORY_SIZE + 1));
+
+    if(cq->chunks && cq->chunk_tree)
+    {
+        cq->directory_size = MIN_DIRECTORY_SIZE;
+        cq->first_chunk = MIN_DIRECTORY_SIZE / 2;
+    }
+    else
+    {
+        FreeMemory(cq->chunks);
+        FreeMemory(cq->chunk_tree);
+        cq->chunks = NULL;
+        cq->chunk_tree = NULL;
+    }
+
+    return (cq->chunks != NULL);
+}
+
+
+/*******************************************************************
+** DestroyQueue
+** ============
+** Frees the memory allocated by CreateQueue and destroys any
+** ClipItems contained in the queue.  Its journal, if it has one,
+** is closed first.
+**
+** Inputs:
+**      ClipQueue* cq           - address of the queue to
+**                                destroy.
+*******************************************************************/
+void DestroyQueue(ClipQueue* cq)
+{
+    //Destroying the queue isn't a change to record
+    CloseJournal(cq);
+
+    if(cq->chunks)
+    {
+        EmptyQueue(cq);
+        FreeMemory(cq->chunks);
+    }
+
+    FreeMemory(cq->spare_chunk);
+    FreeMemory(cq->chunk_tree);
+
+    cq->size = 1;
+    cq->count = 0;
+    cq->chunks = NULL;
+    cq->spare_chunk = NULL;
+    cq->chunk_tree = NULL;
+    cq->directory_size = 0;
+}
+
+
+/*******************************************************************
+** EmptyQueueAndResize
+** ===================
+** Empties the queue and shrinks it if dynamic sizing is enabled.
+** This function should be called in response to the Empty Queue
+** UI command.
+**
+** Inputs:
+**      ClipQueue* cq           - address of the queue to empty.
+*******************************************************************/
+void EmptyQueueAndResize(ClipQueue* cq)
+{
+    EmptyQueue(cq);
+
+    if(queue_policy.dynamic_queue)
+    {
+        ResizeQueue(cq, MIN_DYNAMIC_SIZE);
+    }
+}
+
+
+/*******************************************************************
+** EmptyQueue
+** ==========
+** Empties the queue and releases all memory used by ClipItems
+** therein.  Unlike EmptyQueueAndResize, the size stays as it is.
+**
+** Inputs:
+**      ClipQueue* cq           - address of the queue to empty.
+*******************************************************************/
+void EmptyQueue(ClipQueue* cq)
+{
+    unsigned int i, j;
+
+    if(GetQueueLength(cq) > 0)
+    {
+        JournalEmpty(cq);
+        cq->modified = TRUE;
+    }
+
+    //Cheaper to drop the whole index than to empty it one item
+    //at a time; it gets rebuilt on the next push if needed.
+    DestroyItemIndex(&cq->index);
+
+    //A chunk at a time, so holes don't slow this down
+    for(i = 0; i < cq->chunk_count; ++i)
+    {
+        QueueChunk* chunk = cq->chunks[cq->first_chunk + i];
+
+        for(j = 0; j < QUEUE_CHUNK_ITEMS; ++j)
+        {
+            if((chunk->live[j >> 6] >> (j & 63)) & 1)
+            {
+                DestroyClipItem(&chunk->items[j]);
+            }
+        }
+
+        memset(chunk->live, 0, sizeof(chunk->live));
+        chunk->count = 0;
+    }
+
+    while(cq->chunk_count > 0)
+    {
+        DropChunk(cq, FALSE);
+    }
+
+    if(cq->chunk_tree)
+    {
+        memset(cq->chunk_tree, 0,
+            sizeof(unsigned int) * (cq->directory_size + 1));
+    }
+
+    cq->first_chunk = cq->directory_size / 2;
+    cq->front = 0;
+    cq->count = 0;
+    cq->holes = 0;
+    cq->bytes = 0;
+}
+
+
+/*******************************************************************
+** InitQueue
+** =========
+** Resets all queue structure values to defaults, e.g. zero length,
+** memory pointing to NULL, etc.
+**
+** Don't call this on queues with allocated memory.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue to initialize.
+*******************************************************************/
+void InitQueue(ClipQueue* cq)
+{
+    cq->chunks          = NULL;
+    cq->directory_size  = 0;
+    cq->first_chunk     = 0;
+    cq->chunk_count     = 0;
+    cq->spare_chunk     = NULL;
+    cq->chunk_tree      = NULL;
+    cq->key_origin      = 0;
+
+    cq->front       = 0;
+    cq->count       = 0;
+    cq->holes       = 0;
+
+    cq->last_time   = 0;
+
+    cq->size        = 1;
+    cq->modified    = FALSE;
+
+    cq->bytes       = 0;
+    cq->serial      = 0;
+
+    cq->journal     = NULL;
+    cq->generation  = 0;
+    cq->journaled   = 0;
+
+    InitItemIndex(&cq->index);
+}
+
+
+/*******************************************************************
+** CheckDynamicSize
+** ================
+** If dynaimc queue sizing is turned on (i.e. unlimited queue),
+** expands the queue when it gets full and shrinks it when it goes
+** under 1/4 capacity.
+**
+** This function should be called before adding and after removing
+** any item to/from the queue.
+**
+** Inputs:
+**      ClipQueue* cq           - address of the queue to resize.
+**
+** Outputs:
+**      unsigned int            - (possibly new) size of the queue.
+*******************************************************************/
+unsigned int CheckDynamicSize(ClipQueue* cq)
+{
+    if(queue_policy.dynamic_queue)
+    {
+        if(cq->count == cq->size)
+        {
+            ResizeQueue(cq, cq->size * 2);
+        }
+        else if(cq->count < cq->size / 4)
+        {
+            if(cq->size > MIN_DYNAMIC_SIZE * 2)
+            {
+                ResizeQueue(cq, cq->size / 2);
+            }
+            else if(cq->size > MIN_DYNAMIC_SIZE)
+            {
+                ResizeQueue(cq, MIN_DYNAMIC_SIZE);
+            }
+        }
+    }
+
+    return cq->size;
+}
+
+
+/*******************************************************************
+** ResizeQueue
+** ===========
+** Sets a new maximum size for a queue.  Preserves as many items
+** from the existing queue as possible, starting with the newest
+** (i.e. front).  Since storage comes and goes a chunk at a time,
+** nothing is copied; only items beyond the new size are released.
+**
+** Inputs:
+**      ClipQueue* cq           - address of the queue to resize.
+**      unsigned int new_size   - new size of the queue
+**
+** Outputs:
+**      BOOL                    - TRUE if resizing succeeded.
+*******************************************************************/
+BOOL ResizeQueue(ClipQueue* cq, unsigned int new_size)
+{
+    if(cq->count > new_size)
+    {
+        //The index can stay, since the surviving items don't move
+        while(cq->count > new_size)
+        {
+            ReleaseSlot(cq, cq->count - 1);
+            RemoveBackSlot(cq);
+        }
+
+        cq->modified = TRUE;
+    }
+
+    if(new_size != cq->size)
+    {
+        JournalResize(cq, new_size);
+    }
+
+    cq->size = new_size;
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** EnforceByteBudget
+** =================
+** Trims the queue until its payloads fit in queue_policy.byte_budget
+** (if set).  Each item's cost is its size times its age, so big,
+** old items go first.  Non-text formats are dropped one at a time,
+** costliest first, so a bitmap copied along with some text keeps
+** the text.  Only once nothing but text is left are whole items
+** dropped.  An item too big for the budget on its own is dropped
+** too, so the budget always holds.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+*******************************************************************/
+void EnforceByteBudget(ClipQueue* cq)
+{
+    if(queue_policy.byte_budget > 0)
+    {
+        BOOL dropped = TRUE;
+
+        while((cq->bytes > queue_policy.byte_budget) && dropped)
+        {
+            dropped = DropCostliestFormat(cq);
+        }
+
+        while((cq->bytes > queue_policy.byte_budget) && !IsQueueEmpty(cq))
+        {
+            RemoveItemAt(cq, FindCostliestItem(cq));
+        }
+    }
+}
+
+
+/*******************************************************************
+** CompressColdItems
+** =================
+** Compresses every item past queue_policy.cold_position, or unused
+** for queue_policy.cold_time.  Pushes take care of the position on
+** their own, so this is mostly for the age; call it now and then.
+** Items already compressed are skipped quickly.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+*******************************************************************/
+void CompressColdItems(ClipQueue* cq)
+{
+    unsigned int now = GetTicks();
+    unsigned int i;
+
+    if((queue_policy.cold_position == 0) && (queue_policy.cold_time == 0))
+    {
+        return;
+    }
+
+    for(i = 0; i < cq->count; ++i)
+    {
+        ClipItem* item = GetItem(cq, i);
+
+        if(((queue_policy.cold_position > 0)
+            && (i >= queue_policy.cold_position))
+        || ((queue_policy.cold_time > 0)
+            && (now - item->touched >= queue_policy.cold_time)))
+        {
+            CompressClipItem(item);
+        }
+    }
+}
+
+
+/*******************************************************************
+** RecountQueue
+** ============
+** Recomputes the byte count and insertion order of a queue whose
+** items were added with AddEmptyItem, rather than pushed (e.g. by
+** LoadQueueFromFile).  The front item is taken to
+** be the newest, and every item as just used.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+*******************************************************************/
+void RecountQueue(ClipQueue* cq)
+{
+    unsigned int now = GetTicks();
+    unsigned int i;
+
+    cq->bytes = 0;
+    cq->serial = cq->count;
+
+    for(i = 0; i < cq->count; ++i)
+    {
+        GetItem(cq, i)->serial = cq->count - i;
+        GetItem(cq, i)->touched = now;
+        cq->bytes += GetClipItemSize(GetItem(cq, i));
+    }
+}
+
+
+/*******************************************************************
+** AddEmptyItem
+** ============
+** Adds a blank item at the back of the queue, for code that builds
+** a queue up directly rather than by pushing (e.g. the loader).
+** Call RecountQueue once all the items are filled in.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**
+** Outputs:
+**      ClipItem*           - the new item, or NULL if the queue is
+**                            full or memory ran out
+*******************************************************************/
+ClipItem* AddEmptyItem(ClipQueue* cq)
+{
+    ClipItem* item = NULL;
+
+    if(cq->chunks && (cq->count < cq->size))
+    {
+        item = AddBackSlot(cq);
+
+        if(item)
+        {
+            memset(item, 0, sizeof(ClipItem));
+        }
+    }
+
+    return item;
+}
+
+
+/*******************************************************************
+** InsertItem
+** ==========
+** Adds an item at either end of the queue just as it is: unlike
+** PushItemFront, there's no looking for duplicates, no making room
+** and no byte budget.  For replaying changes already made once.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**      ClipItem* item      - the item, which the queue takes over
+**                            (or destroys, if memory runs out)
+**      BOOL at_front       - TRUE for the front, FALSE for the back
+**
+** Outputs:
+**      BOOL                - FALSE if memory ran out
+*******************************************************************/
+BOOL InsertItem(ClipQueue* cq, ClipItem* item, BOOL at_front)
+{
+    ClipItem* slot = at_front ? AddFrontSlot(cq) : AddBackSlot(cq);
+
+    if(!slot)
+    {
+        DestroyClipItem(item);
+        return FALSE;
+    }
+
+    StoreSlot(cq, slot, item, GetPlaceKey(cq, GetEndPlace(cq, at_front)));
+    JournalPush(cq, slot, at_front);
+    cq->modified = TRUE;
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** RemoveItemAt
+** ============
+** Destroys the item at any position in the queue.  The others stay
+** where they are, leaving a hole (see LeaveHole).  The offset must
+** be in the queue.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**      unsigned int offset - zero-based position of the item
+*******************************************************************/
+void RemoveItemAt(ClipQueue* cq, unsigned int offset)
+{
+    ReleaseSlot(cq, offset);
+    LeaveHole(cq, offset);
+
+    cq->modified = TRUE;
+}
+
+
+/*******************************************************************
+** MoveItem
+** ========
+** Moves an item to the front or back of the queue.  It takes a new
+** slot at that end and leaves a hole where it was, so the cost
+** doesn't depend on how far it moves.  The offset must be in the
+** queue.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**      unsigned int offset - zero-based position of the item
+**      BOOL to_front       - TRUE to move it to the front, FALSE
+**                            for the back
+*******************************************************************/
+void MoveItem(ClipQueue* cq, unsigned int offset, BOOL to_front)
+{
+    ClipItem moved = *GetItem(cq, offset);
+    ClipItem* slot;
+
+    JournalMove(cq, offset, to_front);
+    cq->modified = TRUE;
+
+    if(to_front ? (offset == 0) : (offset + 1 == cq->count))
+    {
+        return;
+    }
+
+    slot = to_front ? AddFrontSlot(cq) : AddBackSlot(cq);
+
+    if(!slot)
+    {
+        //No memory for a new chunk, so close up behind the item the
+        //slow way.  That changes the others' slots, so the index
+        //has to go until the next push rebuilds it.
+        DestroyItemIndex(&cq->index);
+
+        for(; to_front && (offset > 0); --offset)
+        {
+            *GetItem(cq, offset) = *GetItem(cq, offset - 1);
+        }
+
+        for(; !to_front && (offset + 1 < cq->count); ++offset)
+        {
+            *GetItem(cq, offset) = *GetItem(cq, offset + 1);
+        }
+
+        *GetItem(cq, offset) = moved;
+        return;
+    }
+
+    *slot = moved;
+
+    if(IsIndexActive(&cq->index))
+    {
+        RemoveFromIndex(&cq->index, &moved);
+
+        if(!AddToIndex(&cq->index, slot,
+            GetPlaceKey(cq, GetEndPlace(cq, to_front))))
+        {
+            DestroyItemIndex(&cq->index);
+        }
+    }
+
+    //A new front slot puts the old one a place further back
+    LeaveHole(cq, to_front ? offset + 1 : offset);
+}
+
+
+/*******************************************************************
+** MergeIntoItem
+** =============
+** Adds formats to the item at an offset (see MergeClipItem).  The
+** offset must be in the queue.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**      unsigned int offset - zero-based position of the item
+**      ClipItem* extra     - the formats; left empty
+*******************************************************************/
+void MergeIntoItem(ClipQueue* cq, unsigned int offset, ClipItem* extra)
+{
+    ClipItem* item = GetItem(cq, offset);
+
+    JournalAddFormats(cq, offset, extra);
+
+    //The item's contents change, and so does its hash
+    if(IsIndexActive(&cq->index))
+    {
+        RemoveFromIndex(&cq->index, item);
+    }
+
+    cq->bytes += MergeClipItem(item, extra);
+
+    if(IsIndexActive(&cq->index))
+    {
+        item->hash = HashClipItem(item);
+
+        if(!AddToIndex(&cq->index, item,
+            GetPlaceKey(cq, FindPlace(cq, offset))))
+        {
+            DestroyItemIndex(&cq->index);
+        }
+    }
+
+    cq->modified = TRUE;
+}
+
+
+/*******************************************************************
+** DropItemFormat
+** ==============
+** Drops one format from the item at an offset, which must be in the
+** queue and have a format there.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**      unsigned int offset - zero-based position of the item
+**      unsigned int format - which of its formats to drop
+*******************************************************************/
+void DropItemFormat(ClipQueue* cq, unsigned int offset, unsigned int format)
+{
+    ClipItem* item = GetItem(cq, offset);
+
+    JournalDropFormat(cq, offset, format);
+
+    //The item's contents change, and so does its hash
+    if(IsIndexActive(&cq->index))
+    {
+        RemoveFromIndex(&cq->index, item);
+    }
+
+    cq->bytes -= item->data[format].size;
+    RemoveClipFormat(item, format);
+
+    if(IsIndexActive(&cq->index))
+    {
+        item->hash = HashClipItem(item);
+
+        if(!AddToIndex(&cq->index, item,
+            GetPlaceKey(cq, FindPlace(cq, offset))))
+        {
+            DestroyItemIndex(&cq->index);
+        }
+    }
+
+    cq->modified = TRUE;
+}
+
+
+/*******************************************************************
+** IsDuplicate
+** ===========
+** Checks if a new ClipItem is a duplicate of the last one added
+** to a particular queue.  That item carries the newest serial,
+** and is always at one end of the queue.
+**
+** Duplicates are only considered if they come within a few ms of
+** each other - the idea is to block programs that inadvertently
+** copy data to the clipboard multiple times.
+**
+** Inputs:
+**      ClipItem* item      - the item to check
+**
+** Outputs:
+**      BOOL                - TRUE if the item is a duplicate
+*******************************************************************/
+BOOL IsDuplicate(ClipQueue* cq, ClipItem* item)
+{
+    BOOL duplicate = FALSE;
+
+    if(cq && cq->modified && !IsQueueEmpty(cq)
+    && (GetTicks() - cq->last_time < MAX_DUPLICATE_TIME))
+    {
+        ClipItem* last = GetItem(cq, 0);
+
+        if(last->serial != cq->serial)
+        {
+            last = GetItem(cq, cq->count - 1);
+        }
+
+        if(last->serial == cq->serial)
+        {
+            duplicate = CompareClipItems(item, last);
+        }
+    }
+
+    return duplicate;
+}
+
+
+/*******************************************************************
+** MoveDuplicate
+** =============
+** If duplicates are being moved, looks for an item with the same
+** contents anywhere in the queue.  When one is found, it is moved
+** to the front (or back) in place of the new item, which is
+** destroyed.  The item's hash is filled in along the way.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**      ClipItem* item      - newly captured item
+**      BOOL to_front       - TRUE to move to the front, FALSE for
+**                            the back
+**
+** Outputs:
+**      BOOL                - TRUE if an existing item was moved and
+**                            the new item destroyed
+*******************************************************************/
+BOOL MoveDuplicate(ClipQueue* cq, ClipItem* item, BOOL to_front)
+{
+    IndexEntry* found;
+    ClipItem* moved;
+
+    SyncIndex(cq);
+
+    if(!IsIndexActive(&cq->index))
+    {
+        return FALSE;
+    }
+
+    item->hash = HashClipItem(item);
+    found = FindInIndex(&cq->index, item);
+
+    if(!found)
+    {
+        return FALSE;
+    }
+
+    DestroyClipItem(item);
+    MoveItem(cq, GetKeyOffset(cq, found->key), to_front);
+    moved = GetItem(cq, to_front ? 0 : cq->count - 1);
+
+    //A re-copy counts as new, as far as eviction goes
+    moved->serial = ++(cq->serial);
+    moved->touched = GetTicks();
+    cq->last_time = moved->touched;
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** SyncIndex
+** =========
+** Builds the queue's item index when duplicates start being moved,
+** and drops it when they stop.  The index is built lazily so that
+** queues which never use it don't pay for it.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+*******************************************************************/
+void SyncIndex(ClipQueue* cq)
+{
+    if(!queue_policy.move_duplicates)
+    {
+        DestroyItemIndex(&cq->index);
+    }
+    else if(!IsIndexActive(&cq->index)
+    && CreateItemIndex(&cq->index, cq->count))
+    {
+        unsigned int i;
+
+        for(i = 0; i < cq->count; ++i)
+        {
+            unsigned int place = FindPlace(cq, i);
+            ClipItem* item = GetPlaceSlot(cq, place);
+
+            item->hash = HashClipItem(item);
+
+            if(!AddToIndex(&cq->index, item, GetPlaceKey(cq, place)))
+            {
+                DestroyItemIndex(&cq->index);
+                break;
+            }
+        }
+    }
+}
+
+
+/*******************************************************************
+** StoreSlot
+** =========
+** Places an item in an empty queue slot, adding it to the index.
+** The item's hash must already be set if the index is active.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**      ClipItem* slot      - the empty slot, from GetItem
+**      ClipItem* item      - item to store
+**      unsigned int key    - the slot's key (see GetPlaceKey)
+*******************************************************************/
+void StoreSlot(ClipQueue* cq, ClipItem* slot, ClipItem* item,
+    unsigned int key)
+{
+    item->serial = ++(cq->serial);
+    item->touched = GetTicks();
+
+    //Work out the popup's description while the payload is fresh
+    if(!item->preview)
+    {
+        UpdateClipPreview(item);
+    }
+
+    *slot = *item;
+    cq->bytes += GetClipItemSize(item);
+
+    //If the index can't keep up, drop it rather than let it go
+    //stale; the next push will try to rebuild it.
+    if(IsIndexActive(&cq->index) && !AddToIndex(&cq->index, item, key))
+    {
+        DestroyItemIndex(&cq->index);
+    }
+}
+
+
+/*******************************************************************
+** ReleaseSlot
+** ===========
+** Destroys the item in a queue slot, removing it from the index.
+** This is where every item that leaves the queue is journaled.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**      unsigned int offset - zero-based position of the slot
+*******************************************************************/
+void ReleaseSlot(ClipQueue* cq, unsigned int offset)
+{
+    ClipItem* slot = GetItem(cq, offset);
+
+    JournalRemove(cq, offset);
+
+    if(IsIndexActive(&cq->index) && slot->data)
+    {
+        RemoveFromIndex(&cq->index, slot);
+    }
+
+    cq->bytes -= GetClipItemSize(slot);
+    DestroyClipItem(slot);
+}
+
+
+/*******************************************************************
+** DropCostliestFormat
+** ===================
+** Drops the non-text format with the highest eviction cost from
+** the queue.  If that leaves its item empty, the item goes too.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**
+** Outputs:
+**      BOOL                - FALSE if only text formats were left
+*******************************************************************/
+BOOL DropCostliestFormat(ClipQueue* cq)
+{
+    ClipItem* item;
+    double cost, best_cost = 0;
+    unsigned int best_offset = 0, best_format = 0;
+    unsigned int i, j;
+    BOOL found = FALSE;
+
+    for(i = 0; i < cq->count; ++i)
+    {
+        item = GetItem(cq, i);
+
+        for(j = 0; j < item->formats; ++j)
+        {
+            if(!IsTextFormat(item->data[j].format))
+            {
+                cost = GetItemCost(cq, item, item->data[j].size);
+
+                if(!found || (cost > best_cost))
+                {
+                    best_cost = cost;
+                    best_offset = i;
+                    best_format = j;
+                    found = TRUE;
+                }
+            }
+        }
+    }
+
+    if(found)
+    {
+        item = GetItem(cq, best_offset);
+
+        if(item->formats == 1)
+        {
+            RemoveItemAt(cq, best_offset);
+        }
+        else
+        {
+            DropItemFormat(cq, best_offset, best_format);
+        }
+    }
+
+    return found;
+}
+
+
+/*******************************************************************
+** FindCostliestItem
+** =================
+** Finds the item with the highest eviction cost.  The queue must
+** not be empty.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**
+** Outputs:
+**      unsigned int        - offset of the item
+*******************************************************************/
+unsigned int FindCostliestItem(ClipQueue* cq)
+{
+    double cost, best_cost = 0;
+    unsigned int best_offset = 0;
+    unsigned int i;
+
+    for(i = 0; i < cq->count; ++i)
+    {
+        cost = GetItemCost(cq, GetItem(cq, i),
+            GetClipItemSize(GetItem(cq, i)));
+
+        if((i == 0) || (cost > best_cost))
+        {
+            best_cost = cost;
+            best_offset = i;
+        }
+    }
+
+    return best_offset;
+}
+
+
+/*******************************************************************
+** AddFrontSlot
+** ============
+** Makes room for one more item in front of the queue, adding a
+** chunk if the front chunk is full.  The caller fills the slot.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**
+** Outputs:
+**      ClipItem*           - the new (empty) front slot, or NULL if
+**                            memory ran out
+*******************************************************************/
+ClipItem* AddFrontSlot(ClipQueue* cq)
+{
+    if((cq->front == 0) || (cq->chunk_count == 0))
+    {
+        if(!AddChunk(cq, TRUE))
+        {
+            return NULL;
+        }
+
+        cq->front = QUEUE_CHUNK_ITEMS;
+    }
+
+    --(cq->front);
+    ++(cq->count);
+    MarkPlace(cq, cq->front, TRUE);
+
+    return GetPlaceSlot(cq, cq->front);
+}
+
+
+/*******************************************************************
+** AddBackSlot
+** ===========
+** Makes room for one more item at the back of the queue, adding a
+** chunk if the back chunk is full.  The caller fills the slot.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**
+** Outputs:
+**      ClipItem*           - the new (empty) back slot, or NULL if
+**                            memory ran out
+*******************************************************************/
+ClipItem* AddBackSlot(ClipQueue* cq)
+{
+    unsigned int place = cq->front + cq->count + cq->holes;
+
+    if(place == cq->chunk_count << QUEUE_CHUNK_SHIFT)
+    {
+        if(!AddChunk(cq, FALSE))
+        {
+            return NULL;
+        }
+    }
+
+    ++(cq->count);
+    MarkPlace(cq, place, TRUE);
+
+    return GetPlaceSlot(cq, place);
+}
+
+
+/*******************************************************************
+** RemoveFrontSlot
+** ===============
+** Forgets the front slot, whose item must already be released or
+** moved elsewhere.  Any holes behind it go too, so the front is
+** never a hole, and so do chunks left empty.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+*******************************************************************/
+void RemoveFrontSlot(ClipQueue* cq)
+{
+    ClearSlot(GetPlaceSlot(cq, cq->front));
+    MarkPlace(cq, cq->front, FALSE);
+    --(cq->count);
+
+    if(cq->count == 0)
+    {
+        DropChunk(cq, TRUE);
+        cq->front = 0;
+    }
+    else
+    {
+        for(;;)
+        {
+            if(++(cq->front) == QUEUE_CHUNK_ITEMS)
+            {
+                DropChunk(cq, TRUE);
+                cq->front = 0;
+            }
+
+            if(IsPlaceLive(cq, cq->front))
+            {
+                break;
+            }
+
+            --(cq->holes);
+        }
+    }
+}
+
+
+/*******************************************************************
+** RemoveBackSlot
+** ==============
+** Forgets the back slot, whose item must already be released or
+** moved elsewhere.  Any holes before it go too, so the back is
+** never a hole, and so do chunks left empty.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+*******************************************************************/
+void RemoveBackSlot(ClipQueue* cq)
+{
+    unsigned int place = GetBackPlace(cq);
+
+    ClearSlot(GetPlaceSlot(cq, place));
+    MarkPlace(cq, place, FALSE);
+    --(cq->count);
+
+    if(cq->count == 0)
+    {
+        while(cq->chunk_count > 0)
+        {
+            DropChunk(cq, FALSE);
+        }
+
+        cq->front = 0;
+    }
+    else
+    {
+        for(;;)
+        {
+            if(cq->front + cq->count + cq->holes <=
+                (cq->chunk_count - 1) << QUEUE_CHUNK_SHIFT)
+            {
+                DropChunk(cq, FALSE);
+            }
+
+            if(IsPlaceLive(cq, GetBackPlace(cq)))
+            {
+                break;
+            }
+
+            --(cq->holes);
+        }
+    }
+}
+
+
+/*******************************************************************
+** LeaveHole
+** =========
+** Forgets the slot at an offset, whose item must already be
+** released or moved elsewhere.  At either end that just shortens
+** the queue; anywhere else the slot becomes a hole, so nothing else
+** has to move.  Holes make finding items by offset cost more (see
+** FindPlace), so once they outnumber the items the queue is
+** compacted, which keeps the cost per hole constant.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**      unsigned int offset - zero-based position of the slot
+*******************************************************************/
+void LeaveHole(ClipQueue* cq, unsigned int offset)
+{
+    if(offset == 0)
+    {
+        RemoveFrontSlot(cq);
+    }
+    else if(offset + 1 == cq->count)
+    {
+        RemoveBackSlot(cq);
+    }
+    else
+    {
+        unsigned int place = FindPlace(cq, offset);
+
+        ClearSlot(GetPlaceSlot(cq, place));
+        MarkPlace(cq, place, FALSE);
+        --(cq->count);
+        ++(cq->holes);
+
+        if(cq->holes > cq->count + QUEUE_CHUNK_ITEMS)
+        {
+            CompactQueue(cq);
+        }
+    }
+}
+
+
+/*******************************************************************
+** CompactQueue
+** ============
+** Closes up every hole in the queue, moving items towards the
+** front, then drops the chunks left empty at the back.  The items
+** that moved have new keys, so the index is rebuilt.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+*******************************************************************/
+void CompactQueue(ClipQueue* cq)
+{
+    unsigned int end = cq->front + cq->count + cq->holes;
+    unsigned int from, to = cq->front;
+    unsigned int i;
+
+    for(from = cq->front; from < end; ++from)
+    {
+        if(IsPlaceLive(cq, from))
+        {
+            if(to != from)
+            {
+                *GetPlaceSlot(cq, to) = *GetPlaceSlot(cq, from);
+                ClearSlot(GetPlaceSlot(cq, from));
+            }
+
+            ++to;
+        }
+    }
+
+    for(i = 0; i < cq->chunk_count; ++i)
+    {
+        memset(cq->chunks[cq->first_chunk + i]->live, 0,
+            sizeof(cq->chunks[0]->live));
+        cq->chunks[cq->first_chunk + i]->count = 0;
+    }
+
+    for(from = cq->front; from < to; ++from)
+    {
+        QueueChunk* chunk =
+            cq->chunks[cq->first_chunk + (from >> QUEUE_CHUNK_SHIFT)];
+
+        chunk->live[(from & QUEUE_CHUNK_MASK) >> 6] |=
+            (uint64_t) 1 << (from & 63);
+        ++(chunk->count);
+    }
+
+    cq->holes = 0;
+
+    while(to <= (cq->chunk_count - 1) << QUEUE_CHUNK_SHIFT)
+    {
+        DropChunk(cq, FALSE);
+    }
+
+    BuildChunkTree(cq);
+
+    if(IsIndexActive(&cq->index))
+    {
+        DestroyItemIndex(&cq->index);
+
+        if(CreateItemIndex(&cq->index, cq->count))
+        {
+            for(i = 0; i < cq->count; ++i)
+            {
+                if(!AddToIndex(&cq->index, GetItem(cq, i),
+                    GetPlaceKey(cq, cq->front + i)))
+                {
+                    DestroyItemIndex(&cq->index);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+
+/*******************************************************************
+** AddChunk
+** ========
+** Adds an empty chunk to either end of the queue, growing the
+** chunk directory if there's no room for it on that side.  The
+** last chunk dropped is kept around, so a queue hovering at a
+** chunk boundary doesn't hit the allocator on every push.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**      BOOL at_front       - TRUE to add before the front chunk,
+**                            FALSE to add after the back chunk
+**
+** Outputs:
+**      BOOL                - FALSE if memory ran out
+*******************************************************************/
+BOOL AddChunk(ClipQueue* cq, BOOL at_front)
+{
+    QueueChunk* chunk;
+
+    if(at_front ? (cq->first_chunk == 0)
+    : (cq->first_chunk + cq->chunk_count == cq->directory_size))
+    {
+        if(!ResizeDirectory(cq))
+        {
+            return FALSE;
+        }
+    }
+
+    if(cq->spare_chunk)
+    {
+        chunk = cq->spare_chunk;
+        cq->spare_chunk = NULL;
+    }
+    else
+    {
+        chunk = (QueueChunk*) AllocMemory(sizeof(QueueChunk));
+
+        if(!chunk)
+        {
+            return FALSE;
+        }
+    }
+
+    if(at_front)
+    {
+        --(cq->first_chunk);
+    }
+
+    cq->chunks[cq->first_chunk + (at_front ? 0 : cq->chunk_count)] = chunk;
+    ++(cq->chunk_count);
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** DropChunk
+** =========
+** Removes the chunk at either end of the queue.  The chunk must
+** hold no items or holes.  One chunk is kept as a spare; the rest
+** are freed.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**      BOOL at_front       - TRUE to drop the front chunk, FALSE
+**                            for the back one
+*******************************************************************/
+void DropChunk(ClipQueue* cq, BOOL at_front)
+{
+    QueueChunk* chunk;
+
+    --(cq->chunk_count);
+
+    if(at_front)
+    {
+        chunk = cq->chunks[cq->first_chunk];
+        ++(cq->first_chunk);
+    }
+    else
+    {
+        chunk = cq->chunks[cq->first_chunk + cq->chunk_count];
+    }
+
+    if(cq->spare_chunk)
+    {
+        FreeMemory(chunk);
+    }
+    else
+    {
+        cq->spare_chunk = chunk;
+    }
+}
+
+
+/*******************************************************************
+** ResizeDirectory
+** ===============
+** Makes room at both ends of the chunk directory.  If the chunks
+** in use fill less than half of it they are just re-centred,
+** otherwise the directory doubles.  Only chunk pointers move; the
+** items themselves stay put.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**
+** Outputs:
+**      BOOL                - FALSE if memory ran out
+*******************************************************************/
+BOOL ResizeDirectory(ClipQueue* cq)
+{
+    unsigned int new_size = cq->directory_size;
+    unsigned int new_first;
+    QueueChunk** new_chunks = cq->chunks;
+    unsigned int* new_tree = cq->chunk_tree;
+
+    if(cq->chunk_count >= cq->directory_size / 2)
+    {
+        new_size = cq->directory_size * 2;
+        new_chunks = (QueueChunk**) AllocMemory(
+            sizeof(QueueChunk*) * new_size);
+        new_tree = (unsigned int*) AllocMemory(
+            sizeof(unsigned int) * (new_size + 1));
+
+        if(!new_chunks || !new_tree)
+        {
+            FreeMemory(new_chunks);
+            FreeMemory(new_tree);
+            return FALSE;
+        }
+    }
+
+    new_first = (new_size - cq->chunk_count) / 2;
+
+    memmove(new_chunks + new_first, cq->chunks + cq->first_chunk,
+        sizeof(QueueChunk*) * cq->chunk_count);
+
+    if(new_chunks != cq->chunks)
+    {
+        FreeMemory(cq->chunks);
+        FreeMemory(cq->chunk_tree);
+        cq->chunks = new_chunks;
+        cq->chunk_tree = new_tree;
+        cq->directory_size = new_size;
+    }
+
+    //Keys count chunks from key_origin rather than the start of the
+    //directory, so the index doesn't notice the chunks moving.
+    cq->key_origin -= new_first - cq->first_chunk;
+    cq->first_chunk = new_first;
+    BuildChunkTree(cq);
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** FindQueueSlot
+** =============
+** Finds the slot of the item at an offset when the queue has holes
+** (GetItem does the arithmetic itself when it has none).
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**      unsigned int offset - zero-based position of the item
+**
+** Outputs:
+**      ClipItem*           - the item's slot
+*******************************************************************/
+ClipItem* FindQueueSlot(ClipQueue* cq, unsigned int offset)
+{
+    return GetPlaceSlot(cq, FindPlace(cq, offset));
+}
+
+
+/*******************************************************************
+** FindPlace
+** =========
+** Works out where the item at an offset is.  With holes about, that
+** means walking down the chunk tree to the chunk holding it, then
+** counting the slots in use there, which is O(log n).
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**      unsigned int offset - zero-based position of the item
+**
+** Outputs:
+**      unsigned int        - the item's place
+*******************************************************************/
+unsigned int FindPlace(ClipQueue* cq, unsigned int offset)
+{
+    unsigned int chunk = 0, step, word = 0, bits;
+    QueueChunk* found;
+    uint64_t live;
+
+    if(cq->holes == 0)
+    {
+        return cq->front + offset;
+    }
+
+    //Nothing is live before the front, so the offset is the number
+    //of items to skip in the whole directory
+    for(step = cq->directory_size; step > 0; step >>= 1)
+    {
+        if((chunk + step <= cq->directory_size)
+        && (cq->chunk_tree[chunk + step] <= offset))
+        {
+            chunk += step;
+            offset -= cq->chunk_tree[chunk];
+        }
+    }
+
+    found = cq->chunks[chunk];
+
+    while((bits = CountBits(found->live[word])) <= offset)
+    {
+        offset -= bits;
+        ++word;
+    }
+
+    for(live = found->live[word]; offset > 0; --offset)
+    {
+        live &= live - 1;
+    }
+
+    return ((chunk - cq->first_chunk) << QUEUE_CHUNK_SHIFT) + word * 64
+        + CountBits((live & (~live + 1)) - 1);
+}
+
+
+/*******************************************************************
+** GetKeyOffset
+** ============
+** Works out the offset of the item in the slot with a given key,
+** the reverse of FindPlace.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**      unsigned int key    - key of a slot in use
+**
+** Outputs:
+**      unsigned int        - zero-based position of the item
+*******************************************************************/
+unsigned int GetKeyOffset(ClipQueue* cq, unsigned int key)
+{
+    unsigned int chunk =
+        ((key >> QUEUE_CHUNK_SHIFT) - cq->key_origin) & KEY_CHUNK_MASK;
+    unsigned int slot = key & QUEUE_CHUNK_MASK;
+    unsigned int offset = 0, i;
+    uint64_t* live = cq->chunks[chunk]->live;
+
+    if(cq->holes == 0)
+    {
+        return ((chunk - cq->first_chunk) << QUEUE_CHUNK_SHIFT) + slot
+            - cq->front;
+    }
+
+    //Items in the chunks before this one...
+    for(i = chunk; i > 0; i -= i & (0u - i))
+    {
+        offset += cq->chunk_tree[i];
+    }
+
+    //...and those before it in its own
+    for(i = 0; i < slot / 64; ++i)
+    {
+        offset += CountBits(live[i]);
+    }
+
+    return offset
+        + CountBits(live[i] & (((uint64_t) 1 << (slot & 63)) - 1));
+}
+
+
+/*******************************************************************
+** MarkPlace
+** =========
+** Marks a slot as in use or not, keeping its chunk's count and the
+** chunk tree up to date.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+**      unsigned int place  - the slot's place
+**      BOOL live           - TRUE if it now holds an item
+*******************************************************************/
+void MarkPlace(ClipQueue* cq, unsigned int place, BOOL live)
+{
+    unsigned int chunk = cq->first_chunk + (place >> QUEUE_CHUNK_SHIFT);
+    unsigned int change = live ? 1 : 0u - 1;
+    uint64_t* word =
+        &cq->chunks[chunk]->live[(place & QUEUE_CHUNK_MASK) >> 6];
+    uint64_t bit = (uint64_t) 1 << (place & 63);
+
+    *word = live ? (*word | bit) : (*word & ~bit);
+    cq->chunks[chunk]->count += change;
+
+    for(++chunk; chunk <= cq->directory_size; chunk += chunk & (0u - chunk))
+    {
+        cq->chunk_tree[chunk] += change;
+    }
+}
+
+
+/*******************************************************************
+** BuildChunkTree
+** ==============
+** Rebuilds the chunk tree from the chunks' counts.  It's a Fenwick
+** tree over the whole directory: entry i holds the items in the
+** i & -i chunks ending at directory position i - 1, so both counting
+** the items before a chunk and finding the chunk holding an offset
+** take O(log n) steps.
+**
+** Inputs:
+**      ClipQueue* cq       - address of the queue.
+*******************************************************************/
+void BuildChunkTree(ClipQueue* cq)
+{
+    unsigned int i, parent;
+
+    memset(cq->chunk_tree, 0,
+        sizeof(unsigned int) * (cq->directory_size + 1));
+
+    for(i = 0; i < cq->chunk_count; ++i)
+    {
+        cq->chunk_tree[cq->first_chunk + i + 1] =
+            cq->chunks[cq->first_chunk + i]->count;
+    }
+
+    for(i = 1; i <= cq->directory_size; ++i)
+    {
+        parent = i + (i & (0u - i));
+
+        if(parent <= cq->directory_size)
+        {
+            cq->chunk_tree[parent] += cq->chunk_tree[i];
+        }
+    }
+}
+
+
+/*******************************************************************
+** CountBits
+** =========
+** Counts the bits set in a word, portably.
+**
+** Inputs:
+**      uint64_t bits       - the word
+**
+** Outputs:
+**      unsigned int        - how many bits are set
+*******************************************************************/
+unsigned int CountBits(uint64_t bits)
+{
+    bits -= (bits >> 1) & 0x5555555555555555ULL;
+    bits = (bits & 0x3333333333333333ULL)
+        + ((bits >> 2) & 0x3333333333333333ULL);
+    bits = (bits + (bits >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+
+    return (unsigned int) ((bits * 0x0101010101010101ULL) >> 56);
+}
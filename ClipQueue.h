@@ -1,57 +1,126 @@
-/****************************************************************************
-** QClip
-** Copyright 2006 Aaron Curtis
-**
-** This file is part of QClip.
-**
-** QClip is free software: you can redistribute it and/or modify
-** it under the terms of the GNU General Public License as published by
-** the Free Software Foundation, either version 3 of the License, or
-** (at your option) any later version.
-**
-** QClip is distributed in the hope that it will be useful,
-** but WITHOUT ANY WARRANTY; without even the implied warranty of
-** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
-** GNU General Public License for more details.
-**
-** You should have received a copy of the GNU General Public License
-** along with QClip. If not, see <https://www.gnu.org/licenses/>.
-****************************************************************************/
-
-#ifndef __CLIPQUEUE__
-#define __CLIPQUEUE__
-
-#include "Clipboard.h"
-
-typedef struct
-{
-    unsigned int    front;
-    unsigned int    count;
-    unsigned int    size;
-    ClipItem*       clips;
-    unsigned int    last_item;  //index of the last inserted item
-    unsigned int    last_time;  //tick count for the last insertion
-    BOOL            modified;
-}ClipQueue;
-
-extern unsigned int PeekAt(ClipQueue* cq, unsigned int offset);
-extern void PushFront(ClipQueue* cq);
-extern unsigned int PopFront(ClipQueue* cq);
-extern unsigned int PeekFront(ClipQueue* cq);
-extern void PushBack(ClipQueue* cq);
-extern unsigned int PopBack(ClipQueue* cq);
-extern unsigned int PeekBack(ClipQueue* cq);
-extern void EmptyQueueAndResize(ClipQueue* cq);
-extern void DiscardFront(ClipQueue* cq);
-extern void DiscardBack(ClipQueue* cq);
-
-extern void InitQueue(ClipQueue* cq);
-extern BOOL CreateQueue(ClipQueue* cq, unsigned int queue_size);
-extern void DestroyQueue(ClipQueue* cq);
-extern BOOL ResizeQueue(ClipQueue* cq, unsigned int new_size);
-
-#define GetItem(cq, offset) (&(cq)->clips[((cq)->front + offset) % (cq)->size])
-#define GetQueueLength(cq)  ((cq)->count)
-#define IsQueueEmpty(cq)    ((cq)->count == 0)
-
-#endif
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef __CLIPQUEUE__
+#define __CLIPQUEUE__
+
+#include "Platform.h"
+#include "ClipItem.h"
+#include "ItemIndex.h"
+
+//Items live in fixed-size chunks, so the queue grows and shrinks a
+//chunk at a time without moving any items.  Chunk sizes are a power
+//of two, so finding an item is a shift and a mask.
+#define QUEUE_CHUNK_SHIFT   8
+#define QUEUE_CHUNK_ITEMS   (1u << QUEUE_CHUNK_SHIFT)
+#define QUEUE_CHUNK_MASK    (QUEUE_CHUNK_ITEMS - 1)
+
+//Items taken out of the middle of the queue leave holes rather than
+//moving the others up.  Each chunk marks which of its slots are in
+//use, so an item can still be found by offset while there are holes.
+typedef struct
+{
+    ClipItem        items[QUEUE_CHUNK_ITEMS];
+    uint64_t        live[QUEUE_CHUNK_ITEMS / 64];   //slots in use
+    unsigned int    count;                          //...and how many
+}QueueChunk;
+
+typedef struct
+{
+    QueueChunk**    chunks;         //chunk directory
+    unsigned int    directory_size;
+    unsigned int    first_chunk;    //directory index of the front chunk
+    unsigned int    chunk_count;
+    QueueChunk*     spare_chunk;    //last chunk dropped, for reuse
+    unsigned int*   chunk_tree;     //items per chunk, as a Fenwick tree
+    unsigned int    key_origin;     //keeps slot keys steady (see
+                                    //ResizeDirectory)
+    unsigned int    front;      //position of the front item in its chunk
+    unsigned int    count;
+    unsigned int    holes;      //empty slots between the ends
+    unsigned int    size;       //maximum number of items
+    unsigned int    last_time;  //tick count for the last insertion
+    BOOL            modified;
+    ItemIndex       index;      //only kept up when moving duplicates
+    size_t          bytes;      //payload bytes of the queued items
+    unsigned int    serial;     //serial of the newest item
+    struct ClipJournal* journal;    //records every change, or NULL
+    unsigned int    generation; //journal generation of the last file
+                                //loaded or saved (see ClipJournal.c)
+    uint64_t        journaled;  //bytes of the previous generation's
+                                //journal that file already holds
+}ClipQueue;
+
+//Settings that govern queue behaviour.  The core can't see gv, so
+//the application copies these in from its own settings.
+typedef struct
+{
+    unsigned int    queue_size;     //minimum size of a loaded queue
+    BOOL            dynamic_queue;
+    BOOL            move_duplicates;    //re-copied items move to the front
+    size_t          byte_budget;        //0 for no limit
+    unsigned int    cold_position;  //compress items this far back, 0 off
+    unsigned int    cold_time;      //...or unused this many ms, 0 off
+}QueuePolicy;
+
+extern QueuePolicy queue_policy;
+
+extern unsigned int PeekAt(ClipQueue* cq, unsigned int offset);
+extern void PushFront(ClipQueue* cq);
+extern void PushItemFront(ClipQueue* cq, ClipItem* item);
+extern BOOL AddFormatsToItem(ClipQueue* cq, unsigned int serial,
+    ClipItem* extra);
+extern unsigned int PopFront(ClipQueue* cq);
+extern unsigned int PeekFront(ClipQueue* cq);
+extern void PushBack(ClipQueue* cq);
+extern unsigned int PopBack(ClipQueue* cq);
+extern unsigned int PeekBack(ClipQueue* cq);
+extern void EmptyQueueAndResize(ClipQueue* cq);
+extern void EmptyQueue(ClipQueue* cq);
+extern void DiscardFront(ClipQueue* cq);
+extern void DiscardBack(ClipQueue* cq);
+
+extern void InitQueue(ClipQueue* cq);
+extern BOOL CreateQueue(ClipQueue* cq, unsigned int queue_size);
+extern void DestroyQueue(ClipQueue* cq);
+extern BOOL ResizeQueue(ClipQueue* cq, unsigned int new_size);
+extern void EnforceByteBudget(ClipQueue* cq);
+extern void CompressColdItems(ClipQueue* cq);
+extern void RecountQueue(ClipQueue* cq);
+extern ClipItem* AddEmptyItem(ClipQueue* cq);
+extern BOOL InsertItem(ClipQueue* cq, ClipItem* item, BOOL at_front);
+extern void RemoveItemAt(ClipQueue* cq, unsigned int offset);
+extern void MoveItem(ClipQueue* cq, unsigned int offset, BOOL to_front);
+extern void MergeIntoItem(ClipQueue* cq, unsigned int offset,
+    ClipItem* extra);
+extern void DropItemFormat(ClipQueue* cq, unsigned int offset,
+    unsigned int format);
+
+extern ClipItem* FindQueueSlot(ClipQueue* cq, unsigned int offset);
+
+#define GetItem(cq, offset) \
+    ((cq)->holes ? FindQueueSlot((cq), (offset)) \
+    : &(cq)->chunks[(cq)->first_chunk + (((cq)->front + (offset)) \
+    >> QUEUE_CHUNK_SHIFT)]->items[((cq)->front + (offset)) \
+    & QUEUE_CHUNK_MASK])
+#define GetQueueLength(cq)  ((cq)->count)
+#define IsQueueEmpty(cq)    ((cq)->count == 0)
+
+#endif
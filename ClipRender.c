@@ -0,0 +1,258 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include <string.h>
+#include "Platform.h"
+#include "ClipItem.h"
+#include "BlobStore.h"
+#include "Transcode.h"
+#include "ClipRender.h"
+
+//Formats already rendered have their memory set to NULL
+static ClipItem render_item = {NULL, 0, 0, 0, 0};
+
+
+/*******************************************************************
+** AnnounceClipItem
+** ================
+** Announces every format of an item to the clipboard, which must
+** just have been emptied.  Nothing is rendered yet; the item is
+** held on to until its formats are asked for, or the clipboard is
+** emptied again.
+**
+** Inputs:
+**      ClipItem* item      - item to announce
+**
+** Outputs:
+**      unsigned int        - number of formats announced
+*******************************************************************/
+unsigned int AnnounceClipItem(ClipItem* item)
+{
+    unsigned int announced = 0;
+    unsigned int i;
+
+    DropRenderItem();
+
+    if(!item || !item->data || !DuplicateClipItem(&render_item, item))
+    {
+        return 0;
+    }
+
+    for(i = 0; i < render_item.formats; ++i)
+    {
+        if(AnnounceClipFormat(GetExportFormat(render_item.data[i].format)))
+        {
+            ++announced;
+        }
+    }
+
+    if(announced == 0)
+    {
+        DropRenderItem();
+    }
+
+    return announced;
+}
+
+
+/*******************************************************************
+** RenderClipFormat
+** ================
+** Renders one announced format, as asked for by WM_RENDERFORMAT.
+** If nothing else holds the payload (the item was popped, say), its
+** block is handed over as it is; otherwise it's copied into a new
+** one.  Either way the item lets go of the payload afterwards.
+**
+** Inputs:
+**      UINT format         - the format asked for
+**
+** Outputs:
+**      BOOL                - TRUE if the format was placed on the
+**                            clipboard
+*******************************************************************/
+BOOL RenderClipFormat(UINT format)
+{
+    ClipData* data = NULL;
+    HANDLE block;
+    unsigned int i;
+
+    for(i = 0; (i < render_item.formats) && !data; ++i)
+    {
+        if((GetExportFormat(render_item.data[i].format) == format)
+        && render_item.data[i].memory)
+        {
+            data = &render_item.data[i];
+        }
+    }
+
+    if(!data)
+    {
+        return FALSE;
+    }
+
+    block = ExportClipData(data, TRUE);
+
+    if(!block)
+    {
+        return FALSE;
+    }
+
+    if(data->memory)
+    {
+        ReleaseBlob(data->memory);
+        data->memory = NULL;
+    }
+
+    if(!PlaceClipFormat(format, block))
+    {
+        FreeMovable(block);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** RenderAllClipFormats
+** ====================
+** Renders every format not yet asked for, as WM_RENDERALLFORMATS
+** wants before QClip goes away, then lets go of the item.
+**
+** Outputs:
+**      unsigned int        - number of formats rendered
+*******************************************************************/
+unsigned int RenderAllClipFormats()
+{
+    unsigned int rendered = 0;
+    unsigned int i;
+
+    for(i = 0; i < render_item.formats; ++i)
+    {
+        if(render_item.data[i].memory
+        && RenderClipFormat(GetExportFormat(render_item.data[i].format)))
+        {
+            ++rendered;
+        }
+    }
+
+    DropRenderItem();
+
+    return rendered;
+}
+
+
+/*******************************************************************
+** DropRenderItem
+** ==============
+** Lets go of the announced item, once the clipboard has been
+** emptied (WM_DESTROYCLIPBOARD) and its formats can't be asked for
+** any more.
+*******************************************************************/
+void DropRenderItem()
+{
+    DestroyClipItem(&render_item);
+}
+
+
+/*******************************************************************
+** IsRenderPending
+** ===============
+** Outputs:
+**      BOOL                - TRUE while an announced item is held
+*******************************************************************/
+BOOL IsRenderPending()
+{
+    return (render_item.formats > 0);
+}
+
+
+/*******************************************************************
+** ExportClipData
+** ==============
+** Makes the block that goes on the clipboard for one format.  When
+** moving, a payload nothing else holds is handed over as it is, and
+** taken out of the ClipData (memory is set to NULL); otherwise it's
+** copied.  Text kept as UTF-8 is turned back into UTF-16.
+**
+** Inputs:
+**      ClipData* data      - the format
+**      BOOL move           - TRUE to hand the payload over if possible
+**
+** Outputs:
+**      HANDLE              - movable block holding the format, for
+**                            GetExportFormat; NULL on failure
+*******************************************************************/
+HANDLE ExportClipData(ClipData* data, BOOL move)
+{
+    HANDLE block = NULL;
+    BYTE* bytes;
+    BYTE* copy;
+    size_t units = 0;
+
+    if(move && (data->format != UTF8_TEXT_FORMAT))
+    {
+        block = DetachBlob(data->memory);
+
+        if(block)
+        {
+            data->memory = NULL;
+            return block;
+        }
+    }
+
+    //Spilled payloads are mapped back in just for the copy
+    bytes = (BYTE*) LockBlob(data->memory);
+
+    if(!bytes)
+    {
+        return NULL;
+    }
+
+    if(data->format == UTF8_TEXT_FORMAT)
+    {
+        units = GetUtf16Units(bytes, data->size);
+        copy = (BYTE*) AllocMovable(units * sizeof(uint16_t), &block);
+
+        if(copy)
+        {
+            DecodeUtf8(bytes, data->size, (uint16_t*) copy, units);
+        }
+    }
+    else
+    {
+        copy = (BYTE*) AllocMovable(data->size, &block);
+
+        if(copy)
+        {
+            memcpy(copy, bytes, data->size);
+        }
+    }
+
+    if(copy)
+    {
+        UnlockMovable(block);
+    }
+
+    UnlockBlob(data->memory);
+
+    return copy ? block : NULL;
+}
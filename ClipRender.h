@@ -0,0 +1,46 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#ifndef __CLIPRENDER__
+#define __CLIPRENDER__
+
+#include "Platform.h"
+#include "ClipItem.h"
+
+//Delayed rendering: an item's formats are announced to the clipboard
+//without any data, and each is only rendered when a program asks for
+//it.  The announced item keeps its own references to the payloads,
+//so it survives being popped or evicted from the queue meanwhile.
+
+extern unsigned int AnnounceClipItem(ClipItem* item);
+extern BOOL RenderClipFormat(UINT format);
+extern unsigned int RenderAllClipFormats();
+extern void DropRenderItem();
+extern BOOL IsRenderPending();
+extern HANDLE ExportClipData(ClipData* data, BOOL move);
+
+//The clipboard backend for the above - Clipboard.c on Windows, or a
+//stand-in elsewhere (see bench/BenchClipboard.c).  The clipboard
+//must be open and owned by QClip.
+extern BOOL AnnounceClipFormat(UINT format);
+extern BOOL PlaceClipFormat(UINT format, HANDLE block);
+
+#endif
@@ -0,0 +1,1358 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include <string.h>
+#include "Platform.h"
+#include "ClipItem.h"
+#include "ClipQueue.h"
+#include "ClipSerialize.h"
+#include "BlobStore.h"
+#include "Hash.h"
+#include "Transcode.h"
+
+#define DATA_SIGNATURE      0x0abcd1234
+#define ITEM_SIGNATURE      0x06789f5d4
+#define FILE_SIGNATURE      0x02001ad00
+#define INDEX_SIGNATURE     0x05e1d3c27
+
+//Version 1 adds the index at the end; the rest is as version 0, so
+//either can be read from start to finish
+#define FILE_VERSION        1
+
+#define INDEX_HAS_PREVIEW   0x1
+#define MIN_INDEX_BUFFER    4096
+
+//Text is saved as UTF-16 (see UTF8_TEXT_FORMAT).  Up to this size,
+//it's read in as the queue is loaded, so it's kept as UTF-8 and found
+//again when it's copied again, just like text copied since.
+#define LOAD_TEXT_MAX       (64 * 1024)
+
+//A file is written through a buffer of WRITE_BUFFER_SIZE, in whole
+//multiples of WRITE_ALIGNMENT but for the last write.  Payloads of
+//WRITE_DIRECT_MIN or more are written from where they are, gathered
+//with whatever is in the buffer, rather than copied into it.
+#define WRITE_BUFFER_SIZE   (256 * 1024)
+#define WRITE_ALIGNMENT     4096
+#define WRITE_DIRECT_MIN    (64 * 1024)
+
+typedef struct
+{
+    unsigned int signature;
+    unsigned int format;
+    unsigned int size;
+    unsigned int name_length;       //length in bytes, including terminator
+    unsigned int reserved1;
+}ClipDataHeader;
+
+typedef struct
+{
+    unsigned int signature;
+    unsigned int formats;
+    unsigned int reserved1;
+    unsigned int reserved2;
+    unsigned int reserved3;
+}ClipItemHeader;
+
+typedef struct
+{
+    unsigned int signature;
+    unsigned int version;
+    unsigned int items;
+    unsigned int index_low;         //offset of the index, or 0 if the
+    unsigned int index_high;        //save didn't get that far
+    unsigned int index_size;
+    unsigned int generation;        //see ClipJournal.c
+    unsigned int journaled_low;     //...likewise
+    unsigned int journaled_high;
+}ClipFileHeader;
+
+//The index, after the last payload: a ClipIndexHeader, then for each
+//item a ClipIndexItem followed by a ClipIndexEntry for each format.
+//A registered format's name follows its entry.  With it, a queue
+//can be loaded without reading any payloads.
+typedef struct
+{
+    unsigned int signature;
+    unsigned int items;
+    unsigned int reserved1;
+    unsigned int reserved2;
+}ClipIndexHeader;
+
+typedef struct
+{
+    unsigned int formats;
+    unsigned int flags;             //INDEX_HAS_PREVIEW
+    unsigned int preview_format;    //the item's ClipPreview, less
+    unsigned int files;             //the thumbnail
+    int32_t width;
+    int32_t height;
+    unsigned int bits;
+    uint16_t text[PREVIEW_TEXT_LENGTH + 1];
+    uint16_t reserved1;
+}ClipIndexItem;
+
+typedef struct
+{
+    unsigned int offset_low;        //of the payload itself
+    unsigned int offset_high;
+    unsigned int hash_low;          //GetBlobHash of the payload
+    unsigned int hash_high;
+    unsigned int format;
+    unsigned int size;
+    unsigned int name_length;       //as in ClipDataHeader
+    unsigned int reserved1;
+}ClipIndexEntry;
+
+//The index as TakeQueueSnapshot builds it up
+typedef struct
+{
+    BYTE*           bytes;
+    size_t          size;
+    size_t          capacity;
+}IndexBuffer;
+
+//A payload held by a snapshot.  One that's packed, or still in a
+//file, is left where it is and unpacked or read as it's written.
+typedef struct
+{
+    HeldBlob        held;
+    BOOL            text;           //UTF8_TEXT_FORMAT, so written out
+                                    //as UTF-16
+}SnapshotPayload;
+
+//Writes a file through a buffer, for WriteQueueSnapshot
+typedef struct
+{
+    HANDLE          fhand;
+    BYTE*           buffer;
+    size_t          used;
+}FileWriter;
+
+struct QueueSnapshot
+{
+    ClipFileHeader      file_header;    //as it ends up
+    IndexBuffer         index;
+    SnapshotPayload*    payloads;       //in the order they're written
+    unsigned int        payload_count;
+    size_t              largest_held;   //size of the biggest payload
+                                        //that's packed or in a file
+    volatile unsigned int cancelled;
+};
+
+static BOOL LoadQueue(ClipQueue* cq, HANDLE fhand, BOOL map);
+static BOOL ReadItems(ClipQueue* cq, HANDLE fhand, unsigned int items);
+static BYTE* ReadIndex(HANDLE fhand, ClipFileHeader* file_header);
+static BOOL CheckIndex(const BYTE* index, size_t size, unsigned int items,
+    uint64_t payload_end);
+static BOOL LoadIndexedItems(ClipQueue* cq, HANDLE fhand, const BYTE* index,
+    uint64_t map_size);
+static BOOL AppendToIndex(IndexBuffer* index, const void* bytes,
+    size_t size);
+static BOOL IndexItem(IndexBuffer* index, ClipItem* item);
+static BOOL PinPayload(QueueSnapshot* snapshot, ClipData* data);
+static BOOL StartWriter(FileWriter* writer, HANDLE fhand);
+static BOOL WriteThrough(FileWriter* writer, const void* bytes,
+    size_t size);
+static BOOL WriteDirect(FileWriter* writer, const void* bytes,
+    size_t size);
+static BOOL FinishWriter(FileWriter* writer);
+
+
+/*******************************************************************
+** LoadQueueFromFile
+** =================
+** Loads a clipboard queue from an already opened .qcl file.  This
+** function will allocate memory for the queue, so be sure to call
+** DestroyQueue when finished.
+**
+** Files with an index are loaded from the index alone, and each
+** payload is read from the file the first time it's needed (see
+** AllocLazyBlob); the file can be closed as soon as this returns.
+** Older files, and any whose index is damaged, are read through.
+**
+** The handle must come from OpenFileForReading.  The payloads are
+** read through a copy of it, which shares the file the same way,
+** so any other handle would keep the file from being replaced or
+** renamed on Windows until the last payload had been read.
+**
+** Inputs:
+**      ClipQueue* cq           - address of the queue to populate.
+**      HANDLE fhand            - handle to a .qcl file, from
+**                                OpenFileForReading
+**
+** Outputs:
+**      BOOL                    - TRUE if loading succeeded.  If
+**                                loading fails, memory will be
+**                                cleaned up automatically.
+*******************************************************************/
+BOOL LoadQueueFromFile(ClipQueue* cq, HANDLE fhand)
+{
+    return LoadQueue(cq, fhand, FALSE);
+}
+
+
+/*******************************************************************
+** MapQueueFromFile
+** ================
+** Like LoadQueueFromFile, but for a queue that's only ever read,
+** like the common items.  The payloads of a file with an index are
+** used where they are in a mapping of the file, so loading takes
+** the same time however big the file is, and the payloads take up
+** no memory of their own (see MapBlobSource).  A file that can't be
+** mapped has its payloads read as needed instead, and one without
+** an index is read through, as LoadQueueFromFile does.
+**
+** The handle must come from OpenFileForReading, as it must for
+** LoadQueueFromFile.  The mapping holds on to the file for as long
+** as the queue is loaded, with the sharing the handle was opened
+** with.
+**
+** Inputs:
+**      ClipQueue* cq           - address of the queue to populate.
+**      HANDLE fhand            - handle to a .qcl file, from
+**                                OpenFileForReading
+**
+** Outputs:
+**      BOOL                    - TRUE if loading succeeded.  If
+**                                loading fails, memory will be
+**                                cleaned up automatically.
+*******************************************************************/
+BOOL MapQueueFromFile(ClipQueue* cq, HANDLE fhand)
+{
+    return LoadQueue(cq, fhand, TRUE);
+}
+
+
+/*******************************************************************
+** SaveQueueToFile
+** ===============
+** Stores a clipboard queue in an already opened .qcl file, with an
+** index at the end for LoadQueueFromFile.  The file mustn't be one
+** that lazy blobs are still being read from (see LoadLazyBlobs).
+**
+** Inputs:
+**      ClipQueue* cq           - address of the queue to store.
+**      HANDLE fhand            - handle to a .qcl file open for
+**                                writing.
+**
+** Outputs:
+**      BOOL                    - TRUE if saving succeeded.
+*******************************************************************/
+BOOL SaveQueueToFile(ClipQueue* cq, HANDLE fhand)
+{
+    QueueSnapshot* snapshot = TakeQueueSnapshot(cq);
+    BOOL success = (snapshot != NULL);
+
+    if(success)
+    {
+        success = WriteQueueSnapshot(snapshot, fhand);
+        ReleaseQueueSnapshot(snapshot);
+    }
+
+    return success;
+}
+
+
+/*******************************************************************
+** SaveQueueToPath
+** ===============
+** Saves a clipboard queue over a .qcl file, without ever leaving it
+** half written: see WriteQueueSnapshotToPath.  Lazy blobs still
+** being read from the file go on reading the old one, where the
+** system allows it (see MoveFileOver).
+**
+** Inputs:
+**      ClipQueue* cq           - the queue
+**      const PathChar* path    - the file to save it as
+**      const PathChar* temp_path   - where it's written first; on
+**                                    the same volume
+**
+** Outputs:
+**      BOOL                    - TRUE if the file was replaced
+*******************************************************************/
+BOOL SaveQueueToPath(ClipQueue* cq, const PathChar* path,
+    const PathChar* temp_path)
+{
+    QueueSnapshot* snapshot = TakeQueueSnapshot(cq);
+    BOOL success = (snapshot != NULL);
+
+    if(success)
+    {
+        success = WriteQueueSnapshotToPath(snapshot, path, temp_path);
+        ReleaseQueueSnapshot(snapshot);
+    }
+
+    return success;
+}
+
+
+/*******************************************************************
+** TakeQueueSnapshot
+** =================
+** Captures a queue as it stands, ready to be written out as a .qcl
+** file by WriteQueueSnapshot, even as the queue goes on changing.
+** No payload is copied: each is retained and pinned where it is,
+** and everything else the file needs, the index included, is
+** worked out now, but for where each payload goes, and the size and
+** hash of text going out as UTF-16.  Once taken, a snapshot can be
+** written on any thread, since writing it never goes near the
+** queue, the blob store or the format names.
+**
+** Nothing is read from disk here.  Payloads still in the file they
+** were loaded from, or in the spill file, are read from there as
+** they're written (see HoldBlob), and packed ones unpacked.
+**
+** Inputs:
+**      ClipQueue* cq           - the queue
+**
+** Outputs:
+**      QueueSnapshot*          - the snapshot, for
+**                                ReleaseQueueSnapshot, or NULL if a
+**                                payload couldn't be had or memory
+**                                ran out
+*******************************************************************/
+QueueSnapshot* TakeQueueSnapshot(ClipQueue* cq)
+{
+    QueueSnapshot* snapshot;
+    NameChar name[FORMAT_NAME_MAX+1];
+    ClipIndexHeader index_header;
+    ClipIndexEntry entry;
+    ClipItem* item;
+    unsigned int i, j, length, payloads = 0;
+    uint64_t hash;
+    BOOL fail;
+
+    snapshot = (QueueSnapshot*) AllocMemory(sizeof(QueueSnapshot));
+
+    if(!snapshot)
+    {
+        return NULL;
+    }
+
+    for(i = 0; i < GetQueueLength(cq); ++i)
+    {
+        payloads += GetItem(cq, i)->formats;
+    }
+
+    snapshot->payloads = (SnapshotPayload*) AllocMemory(
+        sizeof(SnapshotPayload) * (payloads ? payloads : 1));
+
+    snapshot->file_header.signature = FILE_SIGNATURE;
+    snapshot->file_header.version = FILE_VERSION;
+    snapshot->file_header.items = GetQueueLength(cq);
+    snapshot->file_header.generation = cq->generation;
+    snapshot->file_header.journaled_low = (unsigned int) cq->journaled;
+    snapshot->file_header.journaled_high =
+        (unsigned int) (cq->journaled >> 32);
+
+    memset(&index_header, 0, sizeof(ClipIndexHeader));
+    memset(&entry, 0, sizeof(ClipIndexEntry));
+
+    index_header.signature = INDEX_SIGNATURE;
+    index_header.items = snapshot->file_header.items;
+
+    fail = (snapshot->payloads == NULL)
+        || !AppendToIndex(&snapshot->index, &index_header,
+            sizeof(ClipIndexHeader));
+
+    for(i = 0; (i < snapshot->file_header.items) && !fail; ++i)
+    {
+        item = GetItem(cq, i);
+
+        fail = (item->data == NULL) || !IndexItem(&snapshot->index, item);
+
+        for(j = 0; (j < item->formats) && !fail; ++j)
+        {
+            entry.format = GetExportFormat(item->data[j].format);
+
+            //The size value saved to disk is 32-bit.  This
+            //may cause problems...
+            entry.size = (unsigned int) item->data[j].size;
+            entry.name_length = 0;
+
+            if(IsAppFormat(entry.format))
+            {
+                length = GetFormatName(entry.format, name,
+                    FORMAT_NAME_MAX / sizeof(NameChar));
+
+                fail = (length == 0);
+                entry.name_length = (length + 1) * sizeof(NameChar);
+            }
+
+            if(!fail)
+            {
+                hash = GetBlobHash(item->data[j].memory);
+
+                entry.hash_low = (unsigned int) hash;
+                entry.hash_high = (unsigned int) (hash >> 32);
+
+                fail = !AppendToIndex(&snapshot->index, &entry,
+                        sizeof(ClipIndexEntry))
+                    || !AppendToIndex(&snapshot->index, name,
+                        entry.name_length)
+                    || !PinPayload(snapshot, &item->data[j]);
+            }
+        }
+    }
+
+    snapshot->file_header.index_size = (unsigned int) snapshot->index.size;
+
+    if(fail)
+    {
+        ReleaseQueueSnapshot(snapshot);
+        snapshot = NULL;
+    }
+
+    return snapshot;
+}
+
+
+/*******************************************************************
+** WriteQueueSnapshot
+** ==================
+** Writes a snapshot out as a .qcl file, just as SaveQueueToFile
+** would have written the queue when the snapshot was taken.  This
+** can be done on any thread, while the thread that took the
+** snapshot goes on with the queue.
+**
+** Headers, names and small payloads are gathered up in a buffer
+** and written in large pieces (see WriteThrough), so a queue of
+** many small items takes a few writes rather than several per
+** item.  Each payload's place in the file is filled in to the index
+** as it's written, along with the size and hash of text turned
+** back into UTF-16.
+**
+** Inputs:
+**      QueueSnapshot* snapshot - from TakeQueueSnapshot
+**      HANDLE fhand            - handle to a .qcl file open for
+**                                writing
+**
+** Outputs:
+**      BOOL                    - TRUE if it was written; FALSE if
+**                                writing failed or the snapshot was
+**                                cancelled
+*******************************************************************/
+BOOL WriteQueueSnapshot(QueueSnapshot* snapshot, HANDLE fhand)
+{
+    ClipFileHeader file_header = snapshot->file_header;
+    ClipIndexItem index_item;
+    ClipItemHeader item_header;
+    ClipDataHeader data_header;
+    ClipIndexEntry entry;
+    SnapshotPayload* payload = snapshot->payloads;
+    FileWriter writer;
+    BYTE* index = snapshot->index.bytes;
+    const BYTE* bytes;
+    BYTE* held = NULL;
+    uint16_t* text = NULL;
+    size_t text_size = 0, units;
+    size_t position = sizeof(ClipIndexHeader);
+    uint64_t offset = sizeof(ClipFileHeader), hash;
+    unsigned int i, j;
+    BOOL fail;
+
+    memset(&item_header, 0, sizeof(ClipItemHeader));
+    memset(&data_header, 0, sizeof(ClipDataHeader));
+
+    item_header.signature = ITEM_SIGNATURE;
+    data_header.signature = DATA_SIGNATURE;
+
+    //The header is written again at the end, pointing to the index
+    file_header.index_low = 0;
+    file_header.index_high = 0;
+    file_header.index_size = 0;
+
+    fail = !StartWriter(&writer, fhand)
+        || !WriteThrough(&writer, &file_header, sizeof(ClipFileHeader));
+
+    if(!fail && (snapshot->largest_held > 0))
+    {
+        held = (BYTE*) AllocMemory(snapshot->largest_held);
+        fail = (held == NULL);
+    }
+
+    for(i = 0; (i < snapshot->file_header.items) && !fail; ++i)
+    {
+        memcpy(&index_item, index + position, sizeof(ClipIndexItem));
+        position += sizeof(ClipIndexItem);
+
+        item_header.formats = index_item.formats;
+
+        fail = LoadAcquire(&snapshot->cancelled)
+            || !WriteThrough(&writer, &item_header, sizeof(ClipItemHeader));
+        offset += sizeof(ClipItemHeader);
+
+        for(j = 0; (j < index_item.formats) && !fail; ++j, ++payload)
+        {
+            memcpy(&entry, index + position, sizeof(ClipIndexEntry));
+
+            bytes = GetHeldBytes(&payload->held, held);
+
+            if(bytes && payload->text)
+            {
+                units = GetUtf16Units(bytes, payload->held.size);
+
+                if(units * 2 > text_size)
+                {
+                    FreeMemory(text);
+                    text_size = units * 2;
+                    text = (uint16_t*) AllocMemory(text_size);
+                }
+
+                if(text)
+                {
+                    DecodeUtf8(bytes, payload->held.size, text, units);
+                    hash = HashBytes(text, units * 2, 0);
+                    entry.size = (unsigned int) (units * 2);
+                    entry.hash_low = (unsigned int) hash;
+                    entry.hash_high = (unsigned int) (hash >> 32);
+                }
+
+                bytes = (const BYTE*) text;
+            }
+
+            offset += sizeof(ClipDataHeader) + entry.name_length;
+            entry.offset_low = (unsigned int) offset;
+            entry.offset_high = (unsigned int) (offset >> 32);
+            memcpy(index + position, &entry, sizeof(ClipIndexEntry));
+            position += sizeof(ClipIndexEntry);
+
+            data_header.format = entry.format;
+            data_header.size = entry.size;
+            data_header.name_length = entry.name_length;
+
+            fail = (bytes == NULL)
+                || !WriteThrough(&writer, &data_header,
+                    sizeof(ClipDataHeader))
+                || !WriteThrough(&writer, index + position,
+                    entry.name_length)
+                || !WriteThrough(&writer, bytes, entry.size);
+            position += entry.name_length;
+            offset += entry.size;
+        }
+    }
+
+    FreeMemory(held);
+    FreeMemory(text);
+
+    file_header.index_low = (unsigned int) offset;
+    file_header.index_high = (unsigned int) (offset >> 32);
+    file_header.index_size = snapshot->file_header.index_size;
+
+    fail = fail
+        || !WriteThrough(&writer, snapshot->index.bytes, snapshot->index.size);
+
+    //Always called, to free the buffer
+    fail = !FinishWriter(&writer) || fail;
+
+    return !fail && WriteBytesAt(fhand, 0, &file_header,
+        sizeof(ClipFileHeader));
+}
+
+
+/*******************************************************************
+** WriteQueueSnapshotToPath
+** ========================
+** Writes a snapshot to a temporary file, and once that's safely on
+** disk, moves it over the file it's meant for.  If anything goes
+** wrong, the file is left as it was; a crash leaves one or the
+** other, never a file half written.  Like WriteQueueSnapshot, this
+** can be done on any thread.
+**
+** Inputs:
+**      QueueSnapshot* snapshot     - from TakeQueueSnapshot
+**      const PathChar* path        - the file to replace
+**      const PathChar* temp_path   - where it's written first; on
+**                                    the same volume
+**
+** Outputs:
+**      BOOL                        - TRUE if the file was replaced
+*******************************************************************/
+BOOL WriteQueueSnapshotToPath(QueueSnapshot* snapshot, const PathChar* path,
+    const PathChar* temp_path)
+{
+    HANDLE fhand = OpenFileForWriting(temp_path);
+    BOOL success = (fhand != INVALID_HANDLE_VALUE);
+
+    if(success)
+    {
+        success = WriteQueueSnapshot(snapshot, fhand) && FlushFile(fhand);
+        CloseFileHandle(fhand);
+    }
+
+    return success && MoveFileOver(temp_path, path);
+}
+
+
+/*******************************************************************
+** CancelQueueSnapshot
+** ===================
+** Asks a WriteQueueSnapshot under way on another thread to give up
+** as soon as it can.  It fails, leaving the file half written.
+**
+** Inputs:
+**      QueueSnapshot* snapshot - the snapshot being written
+*******************************************************************/
+void CancelQueueSnapshot(QueueSnapshot* snapshot)
+{
+    StoreRelease(&snapshot->cancelled, TRUE);
+}
+
+
+/*******************************************************************
+** ReleaseQueueSnapshot
+** ====================
+** Lets go of the payloads a snapshot pinned, and frees it.  This
+** has to be done on the thread that took it, once nothing is
+** writing it any more.
+**
+** Inputs:
+**      QueueSnapshot* snapshot - from TakeQueueSnapshot
+*******************************************************************/
+void ReleaseQueueSnapshot(QueueSnapshot* snapshot)
+{
+    unsigned int i;
+
+    for(i = 0; i < snapshot->payload_count; ++i)
+    {
+        ReleaseHeldBlob(&snapshot->payloads[i].held);
+    }
+
+    FreeMemory(snapshot->payloads);
+    FreeMemory(snapshot->index.bytes);
+    FreeMemory(snapshot);
+}
+
+
+/*******************************************************************
+** LoadQueue
+** =========
+** Loads a queue for LoadQueueFromFile or MapQueueFromFile.
+**
+** Inputs:
+**      ClipQueue* cq           - address of the queue to populate
+**      HANDLE fhand            - the file
+**      BOOL map                - TRUE to map an indexed file's
+**                                payloads instead of leaving them to
+**                                be read
+**
+** Outputs:
+**      BOOL                    - TRUE if loading succeeded
+*******************************************************************/
+BOOL LoadQueue(ClipQueue* cq, HANDLE fhand, BOOL map)
+{
+    ClipFileHeader file_header;
+    BYTE* index = NULL;
+    BOOL fail;
+
+    //First, read the file header - this will tell us
+    //how many ClipItems are in this queue.
+    fail = !ReadBytes(fhand, &file_header, sizeof(ClipFileHeader))
+        || (file_header.signature != FILE_SIGNATURE);
+
+    if(!fail)   //Got the file header successfully
+    {
+        if(file_header.items < queue_policy.queue_size)
+        {
+            fail = !CreateQueue(cq, queue_policy.queue_size);
+        }
+        else
+        {
+            fail = !CreateQueue(cq, file_header.items);
+        }
+
+        if(!fail)
+        {
+            cq->generation = file_header.generation;
+            cq->journaled = ((uint64_t) file_header.journaled_high << 32)
+                | file_header.journaled_low;
+        }
+    }
+
+    if(!fail && (file_header.version >= 1) && (file_header.index_size > 0))
+    {
+        index = ReadIndex(fhand, &file_header);
+
+        //Reading the header again puts the file position back after
+        //it, where reading through starts, if ReadIndex moved it
+        fail = !index && !ReadBytesAt(fhand, 0, &file_header,
+            sizeof(ClipFileHeader));
+    }
+
+    if(!fail)
+    {
+        fail = index ? !LoadIndexedItems(cq, fhand, index,
+            map ? ((uint64_t) file_header.index_high << 32)
+                | file_header.index_low : 0)
+            : !ReadItems(cq, fhand, file_header.items);
+    }
+
+    FreeMemory(index);
+
+    if(fail)
+    {
+        DestroyQueue(cq);
+    }
+    else
+    {
+        RecountQueue(cq);
+    }
+
+    return !fail;
+}
+
+
+/*******************************************************************
+** ReadItems
+** =========
+** Reads items from a .qcl file one after another, payloads and all,
+** into a new queue.
+**
+** Inputs:
+**      ClipQueue* cq           - the queue
+**      HANDLE fhand            - the file, just past its header
+**      unsigned int items      - items in the file
+**
+** Outputs:
+**      BOOL                    - FALSE if the file is damaged or
+**                                memory ran out
+*******************************************************************/
+BOOL ReadItems(ClipQueue* cq, HANDLE fhand, unsigned int items)
+{
+    ClipItemHeader item_header;
+    ClipDataHeader data_header;
+    ClipItem* item;
+    NameChar name[FORMAT_NAME_MAX+1];
+    unsigned int i, j;
+    BOOL fail = FALSE;
+
+    //Now, each ClipItem has its own header, telling
+    //how many individual formats are contained in it.
+    for(i = 0; (i < items) && !fail; ++i)
+    {
+        fail = !ReadBytes(fhand, &item_header, sizeof(ClipItemHeader))
+            || (item_header.signature != ITEM_SIGNATURE);
+
+        if(!fail)   //Got the item header successfully
+        {
+            item = AddEmptyItem(cq);
+            fail = (item == NULL);
+        }
+
+        if(!fail)
+        {
+            item->formats = item_header.formats;
+            item->data = (ClipData*) AllocMemory(
+                sizeof(ClipData) * item_header.formats);
+
+            fail = (item->data == NULL);
+
+            //Then there is another header for each format,
+            //telling exactly how much data there is.
+            //BUT, the data will be a little different for
+            //standard formats and registered formats;
+            //registered formats need a string to describe
+            //them, which will precede the data.
+            for(j = 0; (j < item_header.formats) && !fail; ++j)
+            {
+                fail = !ReadBytes(fhand, &data_header,
+                    sizeof(ClipDataHeader))
+                    || (data_header.signature != DATA_SIGNATURE)
+                    || (data_header.name_length > FORMAT_NAME_MAX);
+
+                if(!fail)   //Got the data header successfully
+                {
+                    if(IsAppFormat(data_header.format))
+                    {
+                        //In this case we've encountered a registered
+                        //application format, which is identified by a
+                        //string instead of a number (the number can
+                        //change between sessions).  This means we have
+                        //to query the system for the current number...
+
+                        //Note the name is always stored in UTF-16.
+
+                        fail = !ReadBytes(fhand, name,
+                            data_header.name_length);
+
+                        if(!fail)
+                        {
+                            name[data_header.name_length /
+                                sizeof(NameChar)] = 0;
+
+                            item->data[j].format =
+                                RegisterFormatName(name);
+
+                            fail = (item->data[j].format == 0);
+                        }
+                    }
+                    else
+                    {
+                        item->data[j].format = data_header.format;
+                    }
+
+                    if(!fail)
+                    {
+                        item->data[j].size = data_header.size;
+
+                        item->data[j].memory = AllocBlob(
+                            data_header.size);
+
+                        fail = (item->data[j].memory == NULL);
+
+                        if(!fail)
+                        {
+                            //A new blob is private, so always
+                            //locks and can be written to
+                            fail = !ReadBytes(fhand,
+                                LockBlob(item->data[j].memory),
+                                data_header.size);
+
+                            UnlockBlob(item->data[j].memory);
+                        }
+
+                        if(!fail)
+                        {
+                            item->data[j].memory = InternBlob(
+                                item->data[j].memory);
+                            item->data[j].hash = GetBlobHash(
+                                item->data[j].memory);
+                        }
+                    }
+                }
+            }
+
+            //Done now so the popup never has to read the
+            //payloads back
+            if(!fail)
+            {
+                for(j = 0; j < item->formats; ++j)
+                {
+                    PackClipText(&item->data[j]);
+                }
+
+                UpdateClipPreview(item);
+            }
+        }
+    }
+
+    return !fail;
+}
+
+
+/*******************************************************************
+** ReadIndex
+** =========
+** Reads the index of a version 1 file and checks it over.
+**
+** Inputs:
+**      HANDLE fhand                - the file
+**      ClipFileHeader* file_header - its header
+**
+** Outputs:
+**      BYTE*                       - the index, for FreeMemory, or
+**                                    NULL if it's missing, damaged
+**                                    or doesn't fit in memory
+*******************************************************************/
+BYTE* ReadIndex(HANDLE fhand, ClipFileHeader* file_header)
+{
+    uint64_t offset = ((uint64_t) file_header->index_high << 32)
+        | file_header->index_low;
+    BYTE* index = (BYTE*) AllocMemory(file_header->index_size);
+
+    if(index
+    && (!ReadBytesAt(fhand, offset, index, file_header->index_size)
+    || !CheckIndex(index, file_header->index_size, file_header->items,
+        offset)))
+    {
+        FreeMemory(index);
+        index = NULL;
+    }
+
+    return index;
+}
+
+
+/*******************************************************************
+** CheckIndex
+** ==========
+** Makes sure an index holds what LoadIndexedItems expects, so it
+** can be read without any further checks: an entry for every
+** format of every item, names that fit, and payloads that all lie
+** before the index.
+**
+** Inputs:
+**      const BYTE* index       - the index
+**      size_t size             - its size
+**      unsigned int items      - items in the file
+**      uint64_t payload_end    - where the index starts
+**
+** Outputs:
+**      BOOL                    - TRUE if it's sound
+*******************************************************************/
+BOOL CheckIndex(const BYTE* index, size_t size, unsigned int items,
+    uint64_t payload_end)
+{
+    ClipIndexHeader index_header;
+    ClipIndexItem index_item;
+    ClipIndexEntry entry;
+    size_t position = sizeof(ClipIndexHeader);
+    uint64_t offset;
+    unsigned int i, j;
+
+    if(size < sizeof(ClipIndexHeader))
+    {
+        return FALSE;
+    }
+
+    memcpy(&index_header, index, sizeof(ClipIndexHeader));
+
+    if((index_header.signature != INDEX_SIGNATURE)
+    || (index_header.items != items))
+    {
+        return FALSE;
+    }
+
+    for(i = 0; i < items; ++i)
+    {
+        if(size - position < sizeof(ClipIndexItem))
+        {
+            return FALSE;
+        }
+
+        memcpy(&index_item, index + position, sizeof(ClipIndexItem));
+        position += sizeof(ClipIndexItem);
+
+        for(j = 0; j < index_item.formats; ++j)
+        {
+            if(size - position < sizeof(ClipIndexEntry))
+            {
+                return FALSE;
+            }
+
+            memcpy(&entry, index + position, sizeof(ClipIndexEntry));
+            position += sizeof(ClipIndexEntry);
+            offset = ((uint64_t) entry.offset_high << 32)
+                | entry.offset_low;
+
+            if((entry.name_length > FORMAT_NAME_MAX)
+            || (size - position < entry.name_length)
+            || (offset > payload_end) || (entry.size > payload_end - offset)
+            || (IsAppFormat(entry.format) && (entry.name_length == 0)))
+            {
+                return FALSE;
+            }
+
+            position += entry.name_length;
+        }
+    }
+
+    return (position == size);
+}
+
+
+/*******************************************************************
+** LoadIndexedItems
+** ================
+** Builds a new queue's items from a file's index.  Each payload is
+** left in the file, as a lazy blob, and the previews come from the
+** index, so no payload is read but small text (LOAD_TEXT_MAX).  The
+** payloads are in a mapping of the file if asked for and it can be
+** had.
+**
+** Inputs:
+**      ClipQueue* cq           - the queue
+**      HANDLE fhand            - the file
+**      const BYTE* index       - its index, passed by CheckIndex
+**      uint64_t map_size       - where the payloads end, to map them,
+**                                or 0 to read them
+**
+** Outputs:
+**      BOOL                    - FALSE if memory ran out or a format
+**                                name couldn't be registered
+*******************************************************************/
+BOOL LoadIndexedItems(ClipQueue* cq, HANDLE fhand, const BYTE* index,
+    uint64_t map_size)
+{
+    ClipIndexHeader index_header;
+    ClipIndexItem index_item;
+    ClipIndexEntry entry;
+    ClipItem* item;
+    NameChar name[FORMAT_NAME_MAX+1];
+    size_t position = sizeof(ClipIndexHeader);
+    unsigned int i, j;
+    void* source = map_size ? MapBlobSource(fhand, map_size) : NULL;
+    BOOL fail;
+
+    if(!source)
+    {
+        source = OpenBlobSource(fhand);
+    }
+
+    fail = (source == NULL);
+    memcpy(&index_header, index, sizeof(ClipIndexHeader));
+
+    for(i = 0; (i < index_header.items) && !fail; ++i)
+    {
+        memcpy(&index_item, index + position, sizeof(ClipIndexItem));
+        position += sizeof(ClipIndexItem);
+
+        item = AddEmptyItem(cq);
+        fail = (item == NULL);
+
+        if(!fail)
+        {
+            item->formats = index_item.formats;
+            item->data = (ClipData*) AllocMemory(
+                sizeof(ClipData) * index_item.formats);
+
+            fail = (item->data == NULL);
+        }
+
+        for(j = 0; (j < index_item.formats) && !fail; ++j)
+        {
+            memcpy(&entry, index + position, sizeof(ClipIndexEntry));
+            position += sizeof(ClipIndexEntry);
+
+            if(IsAppFormat(entry.format))
+            {
+                memcpy(name, index + position, entry.name_length);
+                name[entry.name_length / sizeof(NameChar)] = 0;
+
+                item->data[j].format = RegisterFormatName(name);
+                fail = (item->data[j].format == 0);
+            }
+            else
+            {
+                item->data[j].format = entry.format;
+            }
+
+            position += entry.name_length;
+
+            if(!fail)
+            {
+                item->data[j].size = entry.size;
+                item->data[j].memory = AllocLazyBlob(source,
+                    ((uint64_t) entry.offset_high << 32) | entry.offset_low,
+                    entry.size,
+                    ((uint64_t) entry.hash_high << 32) | entry.hash_low);
+
+                fail = (item->data[j].memory == NULL);
+            }
+
+            if(!fail)
+            {
+                item->data[j].memory = InternBlob(item->data[j].memory);
+                item->data[j].hash = GetBlobHash(item->data[j].memory);
+
+                if(entry.size <= LOAD_TEXT_MAX)
+                {
+                    PackClipText(&item->data[j]);
+                }
+            }
+        }
+
+        if(!fail && (index_item.flags & INDEX_HAS_PREVIEW))
+        {
+            item->preview = (ClipPreview*) AllocMemory(sizeof(ClipPreview));
+            fail = (item->preview == NULL);
+
+            if(!fail)
+            {
+                item->preview->format = index_item.preview_format;
+                memcpy(&item->preview->text, index_item.text,
+                    sizeof(index_item.text));
+                item->preview->files = index_item.files;
+                item->preview->width = index_item.width;
+                item->preview->height = index_item.height;
+                item->preview->bits = index_item.bits;
+            }
+        }
+        else if(!fail)
+        {
+            UpdateClipPreview(item);
+        }
+    }
+
+    CloseBlobSource(source);
+
+    return !fail;
+}
+
+
+/*******************************************************************
+** AppendToIndex
+** =============
+** Adds bytes to the end of the index being built, making room as
+** needed.
+**
+** Inputs:
+**      IndexBuffer* index      - the index
+**      const void* bytes       - what to add
+**      size_t size             - how much; may be 0
+**
+** Outputs:
+**      BOOL                    - FALSE if out of memory
+*******************************************************************/
+BOOL AppendToIndex(IndexBuffer* index, const void* bytes, size_t size)
+{
+    size_t capacity = index->capacity ? index->capacity : MIN_INDEX_BUFFER;
+    BYTE* grown;
+
+    if(index->size + size > index->capacity)
+    {
+        while(capacity < index->size + size)
+        {
+            capacity *= 2;
+        }
+
+        grown = (BYTE*) AllocMemory(capacity);
+
+        if(!grown)
+        {
+            return FALSE;
+        }
+
+        if(index->bytes)
+        {
+            memcpy(grown, index->bytes, index->size);
+            FreeMemory(index->bytes);
+        }
+
+        index->bytes = grown;
+        index->capacity = capacity;
+    }
+
+    memcpy(index->bytes + index->size, bytes, size);
+    index->size += size;
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** IndexItem
+** =========
+** Adds an item's ClipIndexItem to the index being built; its
+** entries follow as the payloads are written.
+**
+** Inputs:
+**      IndexBuffer* index      - the index
+**      ClipItem* item          - the item
+**
+** Outputs:
+**      BOOL                    - FALSE if out of memory
+*******************************************************************/
+BOOL IndexItem(IndexBuffer* index, ClipItem* item)
+{
+    ClipIndexItem index_item;
+
+    memset(&index_item, 0, sizeof(ClipIndexItem));
+    index_item.formats = item->formats;
+
+    if(item->preview)
+    {
+        index_item.flags = INDEX_HAS_PREVIEW;
+        index_item.preview_format = item->preview->format;
+        memcpy(index_item.text, &item->preview->text,
+            sizeof(index_item.text));
+        index_item.files = item->preview->files;
+        index_item.width = item->preview->width;
+        index_item.height = item->preview->height;
+        index_item.bits = item->preview->bits;
+    }
+
+    return AppendToIndex(index, &index_item, sizeof(ClipIndexItem));
+}
+
+
+/*******************************************************************
+** PinPayload
+** ==========
+** Adds a payload to a snapshot, keeping hold of it until the
+** snapshot is released (see HoldBlob).
+**
+** Inputs:
+**      QueueSnapshot* snapshot - the snapshot
+**      ClipData* data          - the payload
+**
+** Outputs:
+**      BOOL                    - FALSE if it couldn't be locked
+*******************************************************************/
+BOOL PinPayload(QueueSnapshot* snapshot, ClipData* data)
+{
+    SnapshotPayload* payload = &snapshot->payloads[snapshot->payload_count];
+
+    if(!HoldBlob(data->memory, &payload->held))
+    {
+        return FALSE;
+    }
+
+    payload->text = (data->format == UTF8_TEXT_FORMAT);
+    ++(snapshot->payload_count);
+
+    if(!payload->held.bytes && (data->size > snapshot->largest_held))
+    {
+        snapshot->largest_held = data->size;
+    }
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** StartWriter
+** ===========
+** Sets up a FileWriter.  Finish with FinishWriter, whether or not
+** this succeeds.
+**
+** Inputs:
+**      FileWriter* writer      - the writer
+**      HANDLE fhand            - the file, open for writing
+**
+** Outputs:
+**      BOOL                    - FALSE if out of memory
+*******************************************************************/
+BOOL StartWriter(FileWriter* writer, HANDLE fhand)
+{
+    writer->fhand = fhand;
+    writer->used = 0;
+    writer->buffer = (BYTE*) AllocMemory(WRITE_BUFFER_SIZE);
+
+    return (writer->buffer != NULL);
+}
+
+
+/*******************************************************************
+** WriteThrough
+** ============
+** Adds bytes to the file through the writer's buffer, writing the
+** buffer out each time it fills.  Large runs of bytes go to
+** WriteDirect instead.
+**
+** Inputs:
+**      FileWriter* writer      - the writer
+**      const void* bytes       - what to write
+**      size_t size             - how much; may be 0
+**
+** Outputs:
+**      BOOL                    - FALSE if writing failed
+*******************************************************************/
+BOOL WriteThrough(FileWriter* writer, const void* bytes, size_t size)
+{
+    const BYTE* next = (const BYTE*) bytes;
+    size_t room;
+
+    if(size >= WRITE_DIRECT_MIN)
+    {
+        return WriteDirect(writer, bytes, size);
+    }
+
+    while(size > 0)
+    {
+        room = WRITE_BUFFER_SIZE - writer->used;
+
+        if(room > size)
+        {
+            room = size;
+        }
+
+        memcpy(writer->buffer + writer->used, next, room);
+        writer->used += room;
+        next += room;
+        size -= room;
+
+        if(writer->used == WRITE_BUFFER_SIZE)
+        {
+            if(!WriteBytes(writer->fhand, writer->buffer, writer->used))
+            {
+                return FALSE;
+            }
+
+            writer->used = 0;
+        }
+    }
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** WriteDirect
+** ===========
+** Writes a large run of bytes without copying it: the buffer and
+** as much of the run as ends on a WRITE_ALIGNMENT boundary are
+** written together, in one gathered write.  The last few bytes go
+** into the now empty buffer, so every write but the last still
+** starts and ends on a boundary.
+**
+** Inputs:
+**      FileWriter* writer      - the writer
+**      const void* bytes       - what to write
+**      size_t size             - how much, at least WRITE_DIRECT_MIN
+**
+** Outputs:
+**      BOOL                    - FALSE if writing failed
+*******************************************************************/
+BOOL WriteDirect(FileWriter* writer, const void* bytes, size_t size)
+{
+    ByteRun runs[2];
+    size_t tail = (writer->used + size) % WRITE_ALIGNMENT;
+
+    runs[0].bytes = writer->buffer;
+    runs[0].size = writer->used;
+    runs[1].bytes = bytes;
+    runs[1].size = size - tail;
+
+    if(!WriteGathered(writer->fhand, runs, 2))
+    {
+        return FALSE;
+    }
+
+    memcpy(writer->buffer, (const BYTE*) bytes + runs[1].size, tail);
+    writer->used = tail;
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** FinishWriter
+** ============
+** Writes out whatever is left in a writer's buffer, and frees it.
+**
+** Inputs:
+**      FileWriter* writer      - the writer
+**
+** Outputs:
+**      BOOL                    - FALSE if writing failed, or the
+**                                writer never started
+*******************************************************************/
+BOOL FinishWriter(FileWriter* writer)
+{
+    BOOL success = (writer->buffer != NULL)
+        && WriteBytes(writer->fhand, writer->buffer, writer->used);
+
+    FreeMemory(writer->buffer);
+    writer->buffer = NULL;
+
+    return success;
+}
@@ -0,0 +1,47 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#ifndef __CLIPSERIALIZE__
+#define __CLIPSERIALIZE__
+
+#include "Platform.h"
+#include "ClipQueue.h"
+
+//Bytes of a registered format's name, as stored
+#define FORMAT_NAME_MAX     512
+
+//A queue captured for saving, which can be written out on another
+//thread while the queue goes on changing.  See TakeQueueSnapshot.
+typedef struct QueueSnapshot QueueSnapshot;
+
+extern BOOL LoadQueueFromFile(ClipQueue* cq, HANDLE fhand);
+extern BOOL MapQueueFromFile(ClipQueue* cq, HANDLE fhand);
+extern BOOL SaveQueueToFile(ClipQueue* cq, HANDLE fhand);
+extern BOOL SaveQueueToPath(ClipQueue* cq, const PathChar* path,
+    const PathChar* temp_path);
+extern QueueSnapshot* TakeQueueSnapshot(ClipQueue* cq);
+extern BOOL WriteQueueSnapshot(QueueSnapshot* snapshot, HANDLE fhand);
+extern BOOL WriteQueueSnapshotToPath(QueueSnapshot* snapshot,
+    const PathChar* path, const PathChar* temp_path);
+extern void CancelQueueSnapshot(QueueSnapshot* snapshot);
+extern void ReleaseQueueSnapshot(QueueSnapshot* snapshot);
+
+#endif
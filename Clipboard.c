@@ -1,803 +1,1571 @@
-/****************************************************************************
-** QClip
-** Copyright 2006 Aaron Curtis
-**
-** This file is part of QClip.
-**
-** QClip is free software: you can redistribute it and/or modify
-** it under the terms of the GNU General Public License as published by
-** the Free Software Foundation, either version 3 of the License, or
-** (at your option) any later version.
-**
-** QClip is distributed in the hope that it will be useful,
-** but WITHOUT ANY WARRANTY; without even the implied warranty of
-** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
-** GNU General Public License for more details.
-**
-** You should have received a copy of the GNU General Public License
-** along with QClip. If not, see <https://www.gnu.org/licenses/>.
-****************************************************************************/
-
-#define _CRT_SECURE_NO_DEPRECATE
-#define _WIN32_WINNT 0x0600
-
-#ifndef CF_DIBV5
-#define CF_DIBV5 17     //MinGW's includes leave this out for some reason...
-#endif
-
-#include <windows.h>
-#include <tchar.h>
-#include <stdio.h>
-#include <shlobj.h>
-#include "Clipboard.h"
-#include "QClip.h"
-#include "resource.h"
-
-#define MENU_BMP_HEIGHT 100
-
-static BOOL IsFormatSupported(UINT format);
-static BOOL IsShellFormat(UINT format);
-static HBITMAP CreateBitmapFromClipboard(BYTE* memory);
-
-
-/*******************************************************************
-** AddClipItemToMenu
-** =================
-** Generates a text or image description of a ClipItem and appends
-** it to the end of the given menu.  Descriptions of some formats
-** may be rather vague.
-**
-** Inputs:
-**      ClipItem* item      - address of the item to describe
-**      HMENU menu          - the menu to append to
-**      int item_id         - ID to apply to the new menu item
-**      TCHAR* prefix       - pointer to a character to use as an
-**                            accelerator for the new menu item
-**                            (text items only); may be NULL
-**
-** Outputs:
-**      BOOL                - TRUE on success
-*******************************************************************/
-BOOL AddClipItemToMenu(ClipItem* item, HMENU menu, int item_id, TCHAR* prefix)
-{
-    BOOL success = FALSE;
-
-    if(item && item->data)
-    {
-        MENUITEMINFO mii;
-        unsigned int i;
-        int format = -1;
-        TCHAR text[POPUP_TEXT_LENGTH + 4] = _T("");
-        TCHAR* text_start = text;
-
-        if(prefix)
-        {
-            _stprintf_s(text, 4, _T("&%c "), *prefix);
-            text_start += 3;
-        }
-
-        ZeroMemory(&mii, sizeof(MENUITEMINFO));
-        mii.cbSize  = sizeof(MENUITEMINFO);
-        mii.fMask   = MIIM_FTYPE | MIIM_STRING | MIIM_STATE | MIIM_ID;
-        mii.fState  = MFS_ENABLED;
-        mii.wID     = item_id;
-        mii.fType   = MFT_STRING;
-
-        for(i = 0; i < item->formats; ++i)
-        {           
-            if((item->data[i].format == CF_TEXT)
-            || (item->data[i].format == CF_UNICODETEXT)
-            || (item->data[i].format == CF_DIB)
-            || (item->data[i].format == CF_DIBV5)
-            || (item->data[i].format == CF_HDROP))
-            {
-                format = item->data[i].format;
-                break;
-            }
-        }
-
-        switch(format)
-        {
-            case CF_UNICODETEXT:
-                #ifdef UNICODE
-                _tcscpy_s(text_start, POPUP_TEXT_LENGTH, item->data[i].memory);
-                #else
-                WideCharToMultiByte(CP_ACP, 0, item->data[i].memory,
-                    -1, text_start, POPUP_TEXT_LENGTH, NULL, NULL);
-                #endif
-
-                mii.dwTypeData      = text;
-                mii.cch             = (UINT) _tcslen(text);
-                break;
-
-            case CF_TEXT:
-                #ifdef UNICODE
-                MultiByteToWideChar(CP_ACP, 0, item->data[i].memory,
-                    -1, text_start, POPUP_TEXT_LENGTH, NULL, NULL);
-                #else
-                _tcscpy_s(text_start, POPUP_TEXT_LENGTH, item->data[i].memory);
-                #endif
-
-                mii.dwTypeData      = text;
-                mii.cch             = (UINT) _tcslen(text);
-                break;
-
-            case CF_HDROP:
-            {
-                DROPFILES* drop = (DROPFILES*) item->data[i].memory;
-                TCHAR file_text[POPUP_TEXT_LENGTH + 1];
-
-                int length;
-                int count = 0;
-
-                LoadString(GetModuleHandle(NULL),
-                    STRING_FILE_POPUP,
-                    file_text,
-                    POPUP_TEXT_LENGTH);
-
-                if(drop->fWide)
-                {
-                    wchar_t* names = (wchar_t*)(((BYTE*) drop) + drop->pFiles);
-
-                    while((length = wcslen(names)) > 0)
-                    {
-                        ++count;
-                        names += length + 1;
-                    }
-                }
-                else
-                {
-                    char* names = (char*)(((BYTE*) drop) + drop->pFiles);
-
-                    while((length = strlen(names)) > 0)
-                    {
-                        ++count;
-                        names += length + 1;
-                    }
-                }
-
-                _stprintf_s(text_start, POPUP_TEXT_LENGTH,
-                    file_text, count);
-
-                mii.dwTypeData      = text;
-                mii.cch             = (UINT) _tcslen(text);
-                break;
-            }
-
-            case CF_DIBV5:
-            case CF_DIB:
-                if(gv.settings.preview_bitmaps)
-                {
-                    // The Windows API documentation claims that using
-                    // MFT_BITMAP and dwTypeData is equivalent to hbmpItem,
-                    // but they're rendered differently. MFT_BITMAP is inline
-                    // with text items while hbmpItem is a separate column on
-                    // the left. In Win98/XP MFT_BITMAP looked better, but
-                    // Win10 stretches it match the menu width, which looks
-                    // really bad.
-
-                    /*
-                    mii.fMask = MIIM_TYPE | MIIM_STATE | MIIM_ID;
-                    mii.fType       = MFT_BITMAP;
-                    mii.dwTypeData  = (TCHAR*)
-                        CreateBitmapFromClipboard(item->data[i].memory);
-                    */
-                    
-                    mii.fMask |= MIIM_BITMAP;
-                    mii.hbmpItem =
-                        CreateBitmapFromClipboard(item->data[i].memory);
-                }
-
-                BITMAPINFOHEADER* header = (BITMAPINFOHEADER*)
-                    item->data[i].memory;
-                TCHAR bmp_text[POPUP_TEXT_LENGTH + 1];
-
-                LoadString(GetModuleHandle(NULL),
-                    STRING_BITMAP_POPUP,
-                    bmp_text,
-                    POPUP_TEXT_LENGTH);
-
-                _stprintf_s(text_start, POPUP_TEXT_LENGTH,
-                    bmp_text,
-                    header->biWidth,
-                    header->biHeight,
-                    header->biBitCount);
-
-                mii.dwTypeData      = text;
-                mii.cch             = (UINT) _tcslen(text);
-                break;
-
-            default:
-                LoadString(GetModuleHandle(NULL),
-                    STRING_DEFAULT_POPUP,
-                    text_start,
-                    POPUP_TEXT_LENGTH);
-
-                mii.dwTypeData      = text;
-                mii.cch             = (UINT) _tcslen(text);
-                break;
-        }
- 
-        success = InsertMenuItem(menu, GetMenuItemCount(menu),
-            TRUE, &mii);
-    }
-
-    return success;
-}
-
-
-/*******************************************************************
-** CreateBitmapFromClipboard
-** =========================
-** Generates a bitmap in memory based on data from the Windows
-** clipboard.  Data must be in either CF_DIB or CF_DIBV5 format.
-** The bitmap is scaled to be no taller than MENU_BMP_HEIGHT.
-**
-** Inputs:
-**      void* memory    - pointer to raw clipboard data
-**
-** Outputs:
-**      HBITMAP         - handle of the newly created bitmap
-*******************************************************************/
-HBITMAP CreateBitmapFromClipboard(BYTE* memory)
-{
-    BITMAPINFO* info = (BITMAPINFO*) memory;
-
-    BYTE* bits = memory + info->bmiHeader.biSize +
-        (info->bmiHeader.biClrUsed) * sizeof(RGBQUAD);
-
-    HDC display_dc = CreateDC(_T("DISPLAY"), NULL, NULL, NULL);
-    //HDC bmp_dc = CreateCompatibleDC(display_dc);
-    HDC scaled_dc = CreateCompatibleDC(display_dc);
-
-    int width, height;
-    //HGDIOBJ original1;
-    HGDIOBJ sdc_original;
-    //HBITMAP bmp;
-    HBITMAP scaled_bmp;
-
-    if(info->bmiHeader.biHeight > MENU_BMP_HEIGHT)
-    {
-        height = MENU_BMP_HEIGHT;
-        width = info->bmiHeader.biWidth *
-            MENU_BMP_HEIGHT / info->bmiHeader.biHeight;
-    }
-    else if(info->bmiHeader.biHeight < -MENU_BMP_HEIGHT)
-    {
-        height = -MENU_BMP_HEIGHT;
-        width = info->bmiHeader.biWidth *
-            (-MENU_BMP_HEIGHT) / info->bmiHeader.biHeight;
-    }
-    else 
-    {
-        height = info->bmiHeader.biHeight;
-        width = info->bmiHeader.biWidth;
-    }
-
-    //bmp = CreateDIBitmap(display_dc, &info->bmiHeader,
-    //    CBM_INIT, bits, info, DIB_RGB_COLORS);
-    //original1 = SelectObject(bmp_dc, bmp);
-
-    scaled_bmp = CreateCompatibleBitmap(display_dc, width, height);
-    sdc_original = SelectObject(scaled_dc, scaled_bmp);
-
-    //The default stretching mode looks like crap when using
-    //this method.  Oddly, when using StretchBlt (i.e. the
-    //commented out stuff), it seems impossible to NOT
-    //use HALFTONE on some systems.  Driver issue maybe...
-    SetStretchBltMode(scaled_dc, HALFTONE);
-    SetBrushOrgEx(scaled_dc, 0, 0, NULL);
-
-    StretchDIBits(scaled_dc, 0, 0, width, height, 0, 0,
-        info->bmiHeader.biWidth, info->bmiHeader.biHeight,
-        bits, info, DIB_RGB_COLORS, SRCCOPY);
-
-    //StretchBlt(scaled_dc, 0, 0, width, height, bmp_dc, 0, 0,
-    //    info->bmiHeader.biWidth, info->bmiHeader.biHeight,
-    //    SRCCOPY);
-
-    SelectObject(scaled_dc, sdc_original);
-    DeleteDC(scaled_dc);
-    //SelectObject(bmp_dc, original1);
-    //DeleteDC(bmp_dc);
-    DeleteDC(display_dc);
-    //DeleteObject(bmp);
-
-    return scaled_bmp;
-}
-
-
-
-/*******************************************************************
-** CopyToClipboard
-** ===============
-** Copies data from a ClipItem structure to the clipboard in all
-** available formats.
-**
-** Inputs:
-**      ClipItem* item      - structure to be copied
-**
-** Outputs:
-**      unsigned int        - number of formats successfully copied
-**                            (may be zero)
-*******************************************************************/
-unsigned int CopyToClipboard(ClipItem* item)
-{
-    unsigned int successes = 0;
-
-    if(item && item->data && (item->formats != 0)
-    && OpenClipboard(gv.main_window))
-    {
-        if(EmptyClipboard())
-        {
-            unsigned int i;
-            HGLOBAL clipboard_handle;
-            void* clipboard_pointer;
-
-            for(i = 0; i < item->formats; ++i)
-            {
-                if(item->data[i].memory)
-                {
-                    clipboard_handle = GlobalAlloc(
-                        GMEM_MOVEABLE | GMEM_DDESHARE,
-                        item->data[i].size);
-
-                    if(clipboard_handle)
-                    {
-                        clipboard_pointer = GlobalLock(clipboard_handle);
-
-                        if(clipboard_pointer)
-                        {
-                            CopyMemory(clipboard_pointer,
-                                item->data[i].memory,
-                                item->data[i].size);
-
-                            GlobalUnlock(clipboard_pointer);
-
-                            SetClipboardData(item->data[i].format,
-                                clipboard_handle);
-
-                            ++successes;
-                        }
-                    }
-                }
-            }
-        }
-
-        if(successes)
-        {
-            //Calling CloseClipboard will send further
-            //WM_DRAWCLIPBOARD messages (the function
-            //returns /after/ they're processed).  We
-            //want to ignore these.
-            ++gv.ignore;
-        }
-
-        CloseClipboard();
-    }
-
-    return successes;
-}
-
-
-
-/*******************************************************************
-** CopyStringToClipboard
-** =====================
-** Specialized function for copying text to the Windows clipboard.
-** Used for common items (date, etc).
-**
-** Inputs:
-**      TCHAR* text         - text to copy.
-**
-** Outputs:
-**      BOOL                - TRUE on success.
-*******************************************************************/
-BOOL CopyStringToClipboard(TCHAR* text)
-{
-    BOOL success = FALSE;
-
-    if(text && OpenClipboard(gv.main_window))
-    {
-        int text_length = (int) _tcslen(text);
-
-        if(EmptyClipboard() && (text_length > 0))
-        {
-            HGLOBAL clipboard_handle;
-            TCHAR* clipboard_pointer;
-
-            clipboard_handle = GlobalAlloc(
-                GMEM_MOVEABLE | GMEM_DDESHARE,
-                (text_length + 1) * sizeof(TCHAR));
-
-            if(clipboard_handle)
-            {
-                clipboard_pointer = (TCHAR*) GlobalLock(clipboard_handle);
-
-                if(clipboard_pointer)
-                {
-                    _tcscpy(clipboard_pointer, text);
-
-                    GlobalUnlock(clipboard_pointer);
-
-                    #ifdef UNICODE
-                    SetClipboardData(CF_UNICODETEXT, clipboard_handle);
-                    #else
-                    SetClipboardData(CF_TEXT, clipboard_handle);
-                    #endif
-
-                    success = TRUE;
-                }
-            }
-        }
-
-        if(success)
-        {
-            ++gv.ignore;
-        }
-
-        CloseClipboard();
-    }
-
-    return success;
-}
-
-
-
-/*******************************************************************
-** DestroyClipItem
-** ===============
-** Releases memory allocated by PopulateClipItem.  This function
-** will check if data has actually been allocated, so calling it
-** on an empty ClipItem is not an error.
-**
-** Inputs:
-**      ClipItem* item      - structure to be deallocated
-*******************************************************************/
-void DestroyClipItem(ClipItem* item)
-{
-    if(item)
-    {
-        if(item->data)
-        {
-            unsigned int i;
-        
-            for(i = 0; i < item->formats; ++i)
-            {
-                if(item->data[i].memory)
-                {
-                    HeapFree(GetProcessHeap(), 0,
-                        item->data[i].memory);
-                }
-            }
-
-            HeapFree(GetProcessHeap(), 0, item->data);
-            item->data = NULL;
-        }
-    
-        item->formats = 0;
-    }
-}
-
-
-
-/*******************************************************************
-** PopulateClipItem
-** ================
-** Copies data from the clipboard to a ClipItem structure in all
-** available formats.  Memory is dynamically allocated in the
-** process, so be sure to call DestroyClipItem when finished.
-**
-** Inputs:
-**      ClipItem* item      - structure to be populated
-**
-** Outputs:
-**      unsigned int        - number of formats successfully copied
-**                            (may be zero)
-*******************************************************************/
-unsigned int PopulateClipItem(ClipItem* item)
-{
-    item->formats = 0;
-
-    if(OpenClipboard(gv.main_window))
-    {
-        //First, get an estimate of how many different
-        //formats we'll need to store.  Some of these
-        //will almost certainly fail...
-        unsigned int clipboard_max_size = CountClipboardFormats();
-    
-        if(clipboard_max_size > 0)
-        {
-            //Allocate an array of pointers and meta-info
-            //for each potential clipboard format.
-            item->data = (ClipData*) HeapAlloc(GetProcessHeap(),
-                HEAP_ZERO_MEMORY, sizeof(ClipData) * clipboard_max_size);
-
-            if(item->data)
-            {
-                UINT format = EnumClipboardFormats(0);
-                HANDLE clipboard_handle;
-                void* clipboard_pointer;
-                void* mem_pointer;
-                size_t data_size;
-
-                //Now we'll try to get each format off the clipboard
-                //and store it, stopping when we either run out of
-                //space, or when we run out of formats.
-                while(format && (item->formats < clipboard_max_size))
-                {
-                    if(IsFormatSupported(format))
-                    {
-                        clipboard_handle = GetClipboardData(format);
-        
-                        if(clipboard_handle)
-                        {
-                            //This will fail for CF_BITMAPs - they're
-                            //not HGLOBAL handles.
-                            clipboard_pointer = GlobalLock(clipboard_handle);
-             
-                            if(clipboard_pointer)
-                            {
-                                //We've successfully accessed one data format
-                                //on the clipboard, so now we'll allocate
-                                //some memory to make a copy of it.
-                                data_size = GlobalSize(clipboard_pointer);
-                                mem_pointer = HeapAlloc(GetProcessHeap(),
-                                    HEAP_ZERO_MEMORY, data_size);
-        
-                                if(mem_pointer)
-                                {
-                                    CopyMemory(mem_pointer,
-                                        clipboard_pointer,
-                                        data_size);
-            
-                                    item->data[item->formats].memory =
-                                        mem_pointer;  
-                                    item->data[item->formats].format = format;
-                                    item->data[item->formats].size = data_size;
-            
-                                    ++(item->formats);
-                                }
-                   
-                                GlobalUnlock(clipboard_pointer);
-                            }
-                        }
-
-                    }
-
-                    format = EnumClipboardFormats(format);
-                }
-
-                //If we did not successfully store any clipboard
-                //data, we might as well just forget the whole
-                //thing...
-                if(item->formats == 0)
-                {
-                    HeapFree(GetProcessHeap(), 0, item->data);
-                    item->data = NULL;
-                }
-            }
-        }
-
-        CloseClipboard();
-    }
-
-    return item->formats;
-}
-
-
-/*******************************************************************
-** IsShellFormat
-** =============
-** Determines if a given clipboard format is one of several
-** application-defined formats known to be used by the Windows
-** Explorer shell.  These are necessary for some file cut & paste
-** operations, and so should be allowed if CF_HDROP is enabled.
-**
-** Inputs:
-**      UINT format         - the clipboard format in question
-**
-** Outputs:
-**      BOOL                - TRUE if format is a shell format
-*******************************************************************/
-BOOL IsShellFormat(UINT format)
-{
-    BOOL shell_format = FALSE;
-    unsigned int i;
-
-    for(i = 0; !shell_format && (i < NUM_SHELL_FORMATS); ++i)
-    {
-        shell_format = (format == gv.shell_formats[i]);
-    }
-
-    return shell_format;
-}
-
-
-/*******************************************************************
-** IsFormatSupported
-** =================
-** Determines if a given clipboard format should be saved in the
-** queue, based on user settings and known redundancies in the
-** standard formats.
-**
-** Inputs:
-**      UINT format         - the clipboard format in question
-**
-** Outputs:
-**      BOOL                - TRUE if the format should be copied
-*******************************************************************/
-BOOL IsFormatSupported(UINT format)
-{
-    BOOL supported = FALSE;
-
-    //CF_BITMAP is always redundant with CF_DIB and CF_DIBV5,
-    //so we discard it.  CF_BITMAP data is also allocated
-    //differently and cannot be handled by the current code.
-
-    //CF_PALETTE is only useful in combination with CF_BITMAP;
-    //CF_DIB[V5] contains its own palette information.
-
-    //CF_OWNERDISPLAY is useless to us, as no data is actually
-    //placed on the clipboard for it.
-
-    //CF_OEMTEXT converts to CF_[UNICODE]TEXT  ...I think...
-    //without loss of data.
-
-    //Also ...I think... CF_METAFILEPICT converts to
-    //CF_ENHMETAFILE without data loss.
-
-    if((format != CF_BITMAP)
-    && (format != CF_PALETTE)
-    && (format != CF_OWNERDISPLAY)
-    && (format != CF_OEMTEXT)
-    && (format != CF_METAFILEPICT))
-    {
-        if(gv.settings.enable_all_formats)
-        {
-            supported = TRUE;
-        }
-        else if(((format >= CF_PRIVATEFIRST) && (format <= CF_PRIVATELAST))
-        || ((format >= CF_GDIOBJFIRST) && (format <= CF_GDIOBJLAST)))
-        {
-            supported = gv.settings.format_flags & FORMAT_PRIVATE;
-        }
-        else if(format >= 0x0C000)
-        {
-            if(gv.settings.format_flags & FORMAT_REGISTERED)
-            {
-                supported = TRUE;
-            }
-            else if(gv.settings.format_flags & FORMAT_FILE)
-            {
-                supported = IsShellFormat(format);
-            }
-        }
-        else
-        {
-            switch(format)
-            {
-                //TIFFs are lumped together with bitmaps, the logic
-                //being that if users wants one, they probably want
-                //the other.  These maybe should go under "other
-                //standard formats" instead...
-                case CF_TIFF:
-                   supported = gv.settings.format_flags & FORMAT_BITMAP;
-                   break;
-
-                //Windows will automatically convert between CF_DIB
-                //and CF_DIBV5, but the conversion is buggy.  We
-                //want to only support whichever one is available
-                //"natively", so that Windows never does any conversion.
-                case CF_DIB:
-                case CF_DIBV5:
-                {
-                    UINT dib_formats[] = {CF_DIB, CF_DIBV5};
-                    int native_format = GetPriorityClipboardFormat(
-                        dib_formats, 2);
-
-                    supported = (format == native_format)
-                        && (gv.settings.format_flags & FORMAT_BITMAP);
-                    break;
-                }
-
-                case CF_UNICODETEXT:
-                    supported = gv.settings.format_flags & FORMAT_TEXT;
-                    break;
-
-                //CF_TEXT is redundant with CF_UNICODETEXT, but the
-                //latter is not available on all systems, so we enable
-                //CF_TEXT only in the case when CF_UNICODETEXT is
-                //unavailable.
-                case CF_TEXT:
-                    supported = (gv.settings.format_flags & FORMAT_TEXT)
-                        && !IsClipboardFormatAvailable(CF_UNICODETEXT);
-                    break;
-
-                //CF_LOCALE is only useful in combination with CF_TEXT,
-                //so we apply the same rules.
-                case CF_LOCALE:
-                    supported = (gv.settings.format_flags & FORMAT_TEXT)
-                        && !IsClipboardFormatAvailable(CF_UNICODETEXT);
-                    break;                    
-
-                case CF_HDROP:
-                    supported = gv.settings.format_flags & FORMAT_FILE;
-                    break;
-
-                case CF_ENHMETAFILE:
-                    supported = gv.settings.format_flags & FORMAT_META;
-                    break;
-
-                //See comment on TIFFs
-                case CF_RIFF:
-                case CF_WAVE:
-                    supported = gv.settings.format_flags & FORMAT_WAVE;
-                    break;
-
-                default:
-                    supported = gv.settings.format_flags & FORMAT_OTHERS;
-            }
-        }
-    }
-
-    return supported;
-}
-
-
-/*******************************************************************
-** CompareClipItems
-** ================
-** Compares two ClipItems, returns TRUE if they're identical.
-**
-** Inputs:
-**      ClipItem* item1
-**      ClipItem* item2
-**
-** Outputs:
-**      BOOL - TRUE if the ClipItems are identical
-*******************************************************************/
-BOOL CompareClipItems(ClipItem* item1, ClipItem* item2)
-{
-    BOOL identical = FALSE;
-
-    if(!item1 && !item2)
-    {
-        identical = TRUE;
-    }
-    else if(item1 && item2)
-    {
-        if(item1->formats == item2->formats)
-        {
-            if(item1->formats == 0)
-            {
-                identical = TRUE;
-            }
-            else if(item1->data && item2->data)
-            {
-                BOOL maybe_identical = TRUE;
-                unsigned int i;
-
-                for(i = 0; (i < item1->formats) && maybe_identical; ++i)
-                {
-                    if((item1->data[i].format == item2->data[i].format)
-                    && (item1->data[i].size == item2->data[i].size))
-                    {
-                        maybe_identical = (memcmp(
-                            item1->data[i].memory,
-                            item2->data[i].memory,
-                            item1->data[i].size) == 0);
-                    }
-                    else
-                    {
-                        maybe_identical = FALSE;
-                    }
-                }
-
-                identical = maybe_identical;
-            }
-        }
-    }
-
-    return identical;
-}
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#define _CRT_SECURE_NO_DEPRECATE
+#define _WIN32_WINNT 0x0600
+
+#ifndef CF_DIBV5
+#define CF_DIBV5 17     //MinGW's includes leave this out for some reason...
+#endif
+
+#include <windows.h>
+#include <tchar.h>
+#include <stdio.h>
+#include <shlobj.h>
+#include "Clipboard.h"
+#include "BlobStore.h"
+#include "ClipRender.h"
+#include "ClipCapture.h"
+#include "Thumbnail.h"
+#include "QClip.h"
+#include "resource.h"
+
+#define MENU_BMP_HEIGHT 100
+#define CAPTURE_TRIES       5       //attempts at opening the clipboard
+#define CAPTURE_RETRY_MS    10      //wait between them
+#define CAPTURE_STOP_MS     1000    //wait for the capture thread at exit
+
+//Whoever owns the clipboard while a snapshot is taken, and what the
+//snapshot has learned about it
+typedef struct
+{
+    HWND            window;
+    unsigned long   process;
+    BOOL            hung;       //stopped answering; fetch no more
+    FetchGuard*     guard;      //NULL for no deadlines
+}ClipOwner;
+
+//Which formats a snapshot fetches, copied from the settings when
+//it's asked for, so the capture thread never reads gv
+typedef struct
+{
+    unsigned int    policy;         //one of the FETCH_ values
+    unsigned int    format_flags;
+    BOOL            all_formats;
+    UINT            priority_formats[MAX_PRIORITY_FORMATS];
+    unsigned int    priority_count;
+    UINT            shell_formats[NUM_SHELL_FORMATS];
+}CaptureFilter;
+
+static CaptureRing capture_ring;
+static HANDLE capture_thread = NULL;
+static HANDLE capture_event = NULL;     //auto-reset; set for a request
+static volatile unsigned int capture_stop = FALSE;
+static ClipWatch capture_watch;
+static CaptureFilter watch_filter;      //capture_watch's details
+static CaptureThrottle capture_throttle;
+static FetchGuard fetch_guard;          //whichever thread snapshots
+static BOOL listening = FALSE;          //FALSE if in the viewer chain
+static unsigned int pushed_sequence = 0;    //of the last capture queued
+static TCHAR file_popup[POPUP_TEXT_LENGTH + 1];     //see LoadPopupStrings
+static TCHAR bitmap_popup[POPUP_TEXT_LENGTH + 1];
+static TCHAR default_popup[POPUP_TEXT_LENGTH + 1];
+static unsigned int pushed_serial = 0;      //and the item it became
+
+static void GetCaptureFilter(CaptureFilter* filter);
+static BOOL IsFormatSupported(UINT format, const CaptureFilter* filter);
+static BOOL IsPriorityFormat(UINT format, const CaptureFilter* filter);
+static BOOL IsShellFormat(UINT format, const CaptureFilter* filter);
+static void LoadPopupStrings();
+static HBITMAP CreateBitmapFromClipboard(BYTE* memory);
+static HBITMAP CreateBitmapFromThumbnail(ThumbnailImage* image);
+static unsigned int PlaceOnClipboard(ClipItem* item, BOOL move);
+static unsigned int PlaceAllFormats(ClipItem* item, BOOL move);
+static BOOL SnapshotClipboard(ClipCapture* capture, HWND owner,
+    unsigned int tries, unsigned int requested, ClipWatch* watch,
+    const CaptureFilter* filter, BOOL defer, FetchGuard* guard);
+static BOOL FetchDeferred(ClipCapture* rest, unsigned int tries,
+    FetchGuard* guard);
+static void FindClipboardOwner(ClipOwner* owner, FetchGuard* guard);
+static BOOL IsOwnerResponsive(ClipOwner* owner);
+static BOOL FetchClipFormat(ClipCapture* capture, UINT format,
+    ClipOwner* owner);
+static BOOL OpenClipboardWithRetry(HWND owner, unsigned int tries);
+static void HandOverCapture(ClipCapture* capture, HWND window);
+static void CaptureThread(void* arg);
+
+
+/*******************************************************************
+** AddClipItemToMenu
+** =================
+** Appends a text or image description of a ClipItem to the end of
+** the given menu.  Descriptions of some formats may be rather
+** vague.  The description comes from the item's preview, worked
+** out when it was queued; bitmap thumbnails are made once and kept
+** with it.
+**
+** Inputs:
+**      ClipItem* item      - address of the item to describe
+**      HMENU menu          - the menu to append to
+**      int item_id         - ID to apply to the new menu item
+**      TCHAR* prefix       - pointer to a character to use as an
+**                            accelerator for the new menu item
+**                            (text items only); may be NULL
+**
+** Outputs:
+**      BOOL                - TRUE on success
+*******************************************************************/
+BOOL AddClipItemToMenu(ClipItem* item, HMENU menu, int item_id, TCHAR* prefix)
+{
+    BOOL success = FALSE;
+
+    if(item && item->data)
+    {
+        MENUITEMINFO mii;
+        ClipPreview* preview;
+        TCHAR text[POPUP_TEXT_LENGTH + 4] = _T("");
+        TCHAR* text_start = text;
+
+        if(prefix)
+        {
+            _stprintf_s(text, 4, _T("&%c "), *prefix);
+            text_start += 3;
+        }
+
+        ZeroMemory(&mii, sizeof(MENUITEMINFO));
+        mii.cbSize  = sizeof(MENUITEMINFO);
+        mii.fMask   = MIIM_FTYPE | MIIM_STRING | MIIM_STATE | MIIM_ID;
+        mii.fState  = MFS_ENABLED;
+        mii.wID     = item_id;
+        mii.fType   = MFT_STRING;
+        mii.dwTypeData  = text;
+
+        //Items queued before they had previews get one now; if the
+        //payload can't be read, the generic description will do
+        if(!item->preview)
+        {
+            UpdateClipPreview(item);
+        }
+
+        preview = item->preview;
+        LoadPopupStrings();
+
+        switch(preview ? preview->format : 0)
+        {
+            case CF_UNICODETEXT:
+                #ifdef UNICODE
+                _tcsncpy_s(text_start, POPUP_TEXT_LENGTH,
+                    (wchar_t*) preview->text.wide, _TRUNCATE);
+                #else
+                {
+                    //A character may take two bytes in the code page
+                    char narrow[POPUP_TEXT_LENGTH * 2];
+
+                    if(WideCharToMultiByte(CP_ACP, 0,
+                        (wchar_t*) preview->text.wide, -1, narrow,
+                        sizeof(narrow), NULL, NULL))
+                    {
+                        _tcsncpy_s(text_start, POPUP_TEXT_LENGTH, narrow,
+                            _TRUNCATE);
+                    }
+                }
+                #endif
+                break;
+
+            case CF_TEXT:
+                #ifdef UNICODE
+                MultiByteToWideChar(CP_ACP, 0, preview->text.ansi,
+                    -1, text_start, POPUP_TEXT_LENGTH);
+                #else
+                _tcsncpy_s(text_start, POPUP_TEXT_LENGTH,
+                    preview->text.ansi, _TRUNCATE);
+                #endif
+                break;
+
+            case CF_HDROP:
+                _stprintf_s(text_start, POPUP_TEXT_LENGTH,
+                    file_popup, preview->files);
+                break;
+
+            case CF_DIBV5:
+            case CF_DIB:
+                if(gv.settings.preview_bitmaps)
+                {
+                    // The Windows API documentation claims that using
+                    // MFT_BITMAP and dwTypeData is equivalent to hbmpItem,
+                    // but they're rendered differently. MFT_BITMAP is inline
+                    // with text items while hbmpItem is a separate column on
+                    // the left. In Win98/XP MFT_BITMAP looked better, but
+                    // Win10 stretches it match the menu width, which looks
+                    // really bad.
+
+                    /*
+                    mii.fMask = MIIM_TYPE | MIIM_STATE | MIIM_ID;
+                    mii.fType       = MFT_BITMAP;
+                    mii.dwTypeData  = (TCHAR*)
+                        CreateBitmapFromClipboard(bytes);
+                    */
+
+                    mii.fMask |= MIIM_BITMAP;
+                    mii.hbmpItem = (HBITMAP) GetItemThumbnail(item);
+                }
+
+                _stprintf_s(text_start, POPUP_TEXT_LENGTH,
+                    bitmap_popup,
+                    preview->width,
+                    preview->height,
+                    preview->bits);
+                break;
+
+            default:
+                _tcsncpy_s(text_start, POPUP_TEXT_LENGTH,
+                    default_popup, _TRUNCATE);
+                break;
+        }
+
+        mii.cch = (UINT) _tcslen(text);
+        success = InsertMenuItem(menu, GetMenuItemCount(menu),
+            TRUE, &mii);
+    }
+
+    return success;
+}
+
+
+/*******************************************************************
+** LoadPopupStrings
+** ================
+** Loads the descriptions AddClipItemToMenu fills in, the first time
+** they're needed.
+*******************************************************************/
+void LoadPopupStrings()
+{
+    static BOOL loaded = FALSE;
+    HINSTANCE instance = GetModuleHandle(NULL);
+
+    if(!loaded)
+    {
+        LoadString(instance, STRING_FILE_POPUP, file_popup,
+            POPUP_TEXT_LENGTH);
+        LoadString(instance, STRING_BITMAP_POPUP, bitmap_popup,
+            POPUP_TEXT_LENGTH);
+        LoadString(instance, STRING_DEFAULT_POPUP, default_popup,
+            POPUP_TEXT_LENGTH);
+        loaded = TRUE;
+    }
+}
+
+
+/*******************************************************************
+** CreateThumbnail
+** ===============
+** Makes the menu bitmap for a CF_DIB or CF_DIBV5, for
+** GetItemThumbnail to keep.  ScaleDib averages the usual kinds of
+** DIB down itself; GDI stretches anything else.
+**
+** Inputs:
+**      const void* dib     - the payload
+**      size_t size         - its size
+**
+** Outputs:
+**      HANDLE              - the HBITMAP, or NULL
+*******************************************************************/
+HANDLE CreateThumbnail(const void* dib, size_t size)
+{
+    ThumbnailImage image;
+    HBITMAP bitmap;
+
+    if(size < sizeof(BITMAPINFOHEADER))
+    {
+        return NULL;
+    }
+
+    if(ScaleDib(dib, size, MENU_BMP_HEIGHT, &image))
+    {
+        bitmap = CreateBitmapFromThumbnail(&image);
+        FreeThumbnailImage(&image);
+        return (HANDLE) bitmap;
+    }
+
+    return (HANDLE) CreateBitmapFromClipboard((BYTE*) dib);
+}
+
+
+/*******************************************************************
+** ReleaseThumbnail
+** ================
+** Frees a bitmap from CreateThumbnail, once its item is gone.  If
+** the popup menu is open, it stops drawing the bitmap.
+**
+** Inputs:
+**      HANDLE thumbnail    - the HBITMAP
+*******************************************************************/
+void ReleaseThumbnail(HANDLE thumbnail)
+{
+    DeleteObject((HBITMAP) thumbnail);
+}
+
+
+/*******************************************************************
+** CreateBitmapFromClipboard
+** =========================
+** Generates a bitmap in memory based on data from the Windows
+** clipboard.  Data must be in either CF_DIB or CF_DIBV5 format.
+** The bitmap is scaled to be no taller than MENU_BMP_HEIGHT.
+**
+** Inputs:
+**      void* memory    - pointer to raw clipboard data
+**
+** Outputs:
+**      HBITMAP         - handle of the newly created bitmap
+*******************************************************************/
+HBITMAP CreateBitmapFromClipboard(BYTE* memory)
+{
+    BITMAPINFO* info = (BITMAPINFO*) memory;
+
+    BYTE* bits = memory + info->bmiHeader.biSize +
+        (info->bmiHeader.biClrUsed) * sizeof(RGBQUAD);
+
+    HDC display_dc = CreateDC(_T("DISPLAY"), NULL, NULL, NULL);
+    //HDC bmp_dc = CreateCompatibleDC(display_dc);
+    HDC scaled_dc = CreateCompatibleDC(display_dc);
+
+    int width, height;
+    //HGDIOBJ original1;
+    HGDIOBJ sdc_original;
+    //HBITMAP bmp;
+    HBITMAP scaled_bmp;
+
+    if(info->bmiHeader.biHeight > MENU_BMP_HEIGHT)
+    {
+        height = MENU_BMP_HEIGHT;
+        width = info->bmiHeader.biWidth *
+            MENU_BMP_HEIGHT / info->bmiHeader.biHeight;
+    }
+    else if(info->bmiHeader.biHeight < -MENU_BMP_HEIGHT)
+    {
+        height = -MENU_BMP_HEIGHT;
+        width = info->bmiHeader.biWidth *
+            (-MENU_BMP_HEIGHT) / info->bmiHeader.biHeight;
+    }
+    else 
+    {
+        height = info->bmiHeader.biHeight;
+        width = info->bmiHeader.biWidth;
+    }
+
+    //bmp = CreateDIBitmap(display_dc, &info->bmiHeader,
+    //    CBM_INIT, bits, info, DIB_RGB_COLORS);
+    //original1 = SelectObject(bmp_dc, bmp);
+
+    scaled_bmp = CreateCompatibleBitmap(display_dc, width, height);
+    sdc_original = SelectObject(scaled_dc, scaled_bmp);
+
+    //The default stretching mode looks like crap when using
+    //this method.  Oddly, when using StretchBlt (i.e. the
+    //commented out stuff), it seems impossible to NOT
+    //use HALFTONE on some systems.  Driver issue maybe...
+    SetStretchBltMode(scaled_dc, HALFTONE);
+    SetBrushOrgEx(scaled_dc, 0, 0, NULL);
+
+    StretchDIBits(scaled_dc, 0, 0, width, height, 0, 0,
+        info->bmiHeader.biWidth, info->bmiHeader.biHeight,
+        bits, info, DIB_RGB_COLORS, SRCCOPY);
+
+    //StretchBlt(scaled_dc, 0, 0, width, height, bmp_dc, 0, 0,
+    //    info->bmiHeader.biWidth, info->bmiHeader.biHeight,
+    //    SRCCOPY);
+
+    SelectObject(scaled_dc, sdc_original);
+    DeleteDC(scaled_dc);
+    //SelectObject(bmp_dc, original1);
+    //DeleteDC(bmp_dc);
+    DeleteDC(display_dc);
+    //DeleteObject(bmp);
+
+    return scaled_bmp;
+}
+
+
+/*******************************************************************
+** CreateBitmapFromThumbnail
+** =========================
+** Copies a thumbnail from ScaleDib into a DIB section.  Its pixels
+** are opaque, so menus that blend 32-bit bitmaps draw it as is.
+**
+** Inputs:
+**      ThumbnailImage* image   - the thumbnail
+**
+** Outputs:
+**      HBITMAP                 - the bitmap, or NULL
+*******************************************************************/
+HBITMAP CreateBitmapFromThumbnail(ThumbnailImage* image)
+{
+    BITMAPINFO info;
+    HBITMAP bitmap;
+    void* bits = NULL;
+
+    ZeroMemory(&info, sizeof(info));
+    info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    info.bmiHeader.biWidth = image->width;
+    info.bmiHeader.biHeight = -image->height;     //top-down
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+
+    bitmap = CreateDIBSection(NULL, &info, DIB_RGB_COLORS, &bits, NULL, 0);
+
+    if(bitmap && bits)
+    {
+        CopyMemory(bits, image->pixels,
+            sizeof(uint32_t) * image->width * image->height);
+    }
+
+    return bitmap;
+}
+
+
+
+/*******************************************************************
+** CopyToClipboard
+** ===============
+** Copies data from a ClipItem structure to the clipboard in all
+** available formats.  With delayed rendering on, the formats are
+** only announced, and copied when a program asks for them.
+**
+** Inputs:
+**      ClipItem* item      - structure to be copied
+**
+** Outputs:
+**      unsigned int        - number of formats successfully copied
+**                            (may be zero)
+*******************************************************************/
+unsigned int CopyToClipboard(ClipItem* item)
+{
+    return PlaceOnClipboard(item, FALSE);
+}
+
+
+/*******************************************************************
+** MoveToClipboard
+** ===============
+** Like CopyToClipboard, for an item about to be destroyed (i.e. a
+** pop).  Payloads that the item alone holds are handed to the
+** clipboard as they are instead of copied, and taken out of the
+** item.  The rest are copied.  With delayed rendering on, this is
+** the same as CopyToClipboard; payloads are handed over when asked
+** for, if nothing else holds them by then.
+**
+** Inputs:
+**      ClipItem* item      - structure to be moved
+**
+** Outputs:
+**      unsigned int        - number of formats successfully placed
+**                            (may be zero)
+*******************************************************************/
+unsigned int MoveToClipboard(ClipItem* item)
+{
+    return PlaceOnClipboard(item, TRUE);
+}
+
+
+/*******************************************************************
+** PlaceOnClipboard
+** ================
+** Does the work of CopyToClipboard and MoveToClipboard.
+**
+** Inputs:
+**      ClipItem* item      - structure to be placed
+**      BOOL move           - TRUE to hand over payloads where
+**                            possible
+**
+** Outputs:
+**      unsigned int        - number of formats successfully placed
+**                            (may be zero)
+*******************************************************************/
+unsigned int PlaceOnClipboard(ClipItem* item, BOOL move)
+{
+    unsigned int successes = 0;
+
+    if(item && item->data && (item->formats != 0)
+    && OpenClipboard(gv.main_window))
+    {
+        if(EmptyClipboard())
+        {
+            successes = gv.settings.delay_rendering
+                ? AnnounceClipItem(item) : PlaceAllFormats(item, move);
+        }
+
+        if(successes)
+        {
+            //Calling CloseClipboard will tell the clipboard
+            //listeners, us included; the sequence number is how
+            //we recognise the change as our own.
+            NoteOwnWrite(&capture_watch, GetClipboardSequenceNumber());
+        }
+
+        CloseClipboard();
+    }
+
+    return successes;
+}
+
+
+/*******************************************************************
+** PlaceAllFormats
+** ===============
+** Puts every format of an item on the open, freshly emptied
+** clipboard straight away.
+**
+** Inputs:
+**      ClipItem* item      - structure to be placed
+**      BOOL move           - TRUE to hand over payloads where
+**                            possible
+**
+** Outputs:
+**      unsigned int        - number of formats successfully placed
+*******************************************************************/
+unsigned int PlaceAllFormats(ClipItem* item, BOOL move)
+{
+    unsigned int successes = 0;
+    unsigned int i;
+    HANDLE clipboard_handle;
+
+    for(i = 0; i < item->formats; ++i)
+    {
+        clipboard_handle = ExportClipData(&item->data[i], move);
+
+        if(clipboard_handle)
+        {
+            if(SetClipboardData(GetExportFormat(item->data[i].format),
+                clipboard_handle))
+            {
+                ++successes;
+            }
+            else
+            {
+                FreeMovable(clipboard_handle);
+            }
+        }
+    }
+
+    return successes;
+}
+
+
+
+/*******************************************************************
+** AnnounceClipFormat
+** ==================
+** Offers a format on the open clipboard without any data, for
+** delayed rendering.  WM_RENDERFORMAT asks for it later.
+**
+** Inputs:
+**      UINT format         - format to offer
+**
+** Outputs:
+**      BOOL                - TRUE on success
+*******************************************************************/
+BOOL AnnounceClipFormat(UINT format)
+{
+    //A NULL handle comes back either way, so check the error
+    SetLastError(ERROR_SUCCESS);
+    SetClipboardData(format, NULL);
+
+    return (GetLastError() == ERROR_SUCCESS);
+}
+
+
+/*******************************************************************
+** PlaceClipFormat
+** ===============
+** Puts a rendered format on the open clipboard, which then owns the
+** block.
+**
+** Inputs:
+**      UINT format         - the format
+**      HANDLE block        - movable block holding the data
+**
+** Outputs:
+**      BOOL                - TRUE on success; otherwise the block is
+**                            still the caller's
+*******************************************************************/
+BOOL PlaceClipFormat(UINT format, HANDLE block)
+{
+    if(SetClipboardData(format, block) == NULL)
+    {
+        return FALSE;
+    }
+
+    NoteOwnWrite(&capture_watch, GetClipboardSequenceNumber());
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** RenderClipboardOnExit
+** =====================
+** Renders whatever delayed formats are still waiting, since they
+** can't be asked for once QClip is gone.
+**
+** Inputs:
+**      HWND hwnd           - QClip's main window
+*******************************************************************/
+void RenderClipboardOnExit(HWND hwnd)
+{
+    if(IsRenderPending() && OpenClipboard(hwnd))
+    {
+        //Someone else may have taken the clipboard meanwhile
+        if(GetClipboardOwner() == hwnd)
+        {
+            RenderAllClipFormats();
+        }
+
+        CloseClipboard();
+    }
+
+    DropRenderItem();
+}
+
+
+/*******************************************************************
+** CopyStringToClipboard
+** =====================
+** Specialized function for copying text to the Windows clipboard.
+** Used for common items (date, etc).
+**
+** Inputs:
+**      TCHAR* text         - text to copy.
+**
+** Outputs:
+**      BOOL                - TRUE on success.
+*******************************************************************/
+BOOL CopyStringToClipboard(TCHAR* text)
+{
+    BOOL success = FALSE;
+
+    if(text && OpenClipboard(gv.main_window))
+    {
+        int text_length = (int) _tcslen(text);
+
+        if(EmptyClipboard() && (text_length > 0))
+        {
+            HGLOBAL clipboard_handle;
+            TCHAR* clipboard_pointer;
+
+            clipboard_handle = GlobalAlloc(
+                GMEM_MOVEABLE | GMEM_DDESHARE,
+                (text_length + 1) * sizeof(TCHAR));
+
+            if(clipboard_handle)
+            {
+                clipboard_pointer = (TCHAR*) GlobalLock(clipboard_handle);
+
+                if(clipboard_pointer)
+                {
+                    _tcscpy(clipboard_pointer, text);
+
+                    GlobalUnlock(clipboard_pointer);
+
+                    #ifdef UNICODE
+                    SetClipboardData(CF_UNICODETEXT, clipboard_handle);
+                    #else
+                    SetClipboardData(CF_TEXT, clipboard_handle);
+                    #endif
+
+                    success = TRUE;
+                }
+            }
+        }
+
+        if(success)
+        {
+            NoteOwnWrite(&capture_watch, GetClipboardSequenceNumber());
+        }
+
+        CloseClipboard();
+    }
+
+    return success;
+}
+
+
+
+/*******************************************************************
+** PopulateClipItem
+** ================
+** Copies data from the clipboard to a ClipItem structure in all
+** available formats.  Memory is dynamically allocated in the
+** process, so be sure to call DestroyClipItem when finished.
+**
+** Inputs:
+**      ClipItem* item      - structure to be populated
+**
+** Outputs:
+**      unsigned int        - number of formats successfully copied
+**                            (may be zero)
+*******************************************************************/
+unsigned int PopulateClipItem(ClipItem* item)
+{
+    ClipCapture capture;
+    CaptureFilter filter;
+
+    item->formats = 0;
+    item->data = NULL;
+    item->preview = NULL;
+
+    GetCaptureFilter(&filter);
+
+    if(SnapshotClipboard(&capture, gv.main_window, 1, GetMicroTicks(),
+        NULL, &filter, FALSE, capture_thread ? NULL : &fetch_guard))
+    {
+        AdoptCapture(&capture, item);
+    }
+
+    return item->formats;
+}
+
+
+/*******************************************************************
+** SnapshotClipboard
+** =================
+** Copies every supported format on the clipboard into a capture.
+** This doesn't touch the blob store, so the capture thread can do
+** it; AdoptCapture turns the result into a ClipItem.  Given a
+** watch, it only copies changes the watch hasn't seen.  Given
+** defer, only the PriorityFormats are copied and the rest listed
+** in the capture's deferred formats.
+**
+** Inputs:
+**      ClipCapture* capture    - capture to fill in
+**      HWND owner              - window to open the clipboard with;
+**                                may be NULL
+**      unsigned int tries      - how many times to try opening the
+**                                clipboard, if someone else has it
+**      unsigned int requested  - GetMicroTicks when it was asked for
+**      ClipWatch* watch        - decides whether the clipboard has
+**                                changed; may be NULL
+**      const CaptureFilter* filter - which formats to copy
+**      BOOL defer              - TRUE to leave all but the priority
+**                                formats for later
+**      FetchGuard* guard       - deadlines for the clipboard owner;
+**                                may be NULL
+**
+** Outputs:
+**      BOOL                    - TRUE if the clipboard could be read,
+**                                even if nothing was copied; FALSE
+**                                if it was unchanged
+*******************************************************************/
+BOOL SnapshotClipboard(ClipCapture* capture, HWND owner,
+    unsigned int tries, unsigned int requested, ClipWatch* watch,
+    const CaptureFilter* filter, BOOL defer, FetchGuard* guard)
+{
+    BOOL opened = OpenClipboardWithRetry(owner, tries);
+    unsigned int sequence;
+    ClipOwner clip_owner;
+
+    if(!opened)
+    {
+        return FALSE;
+    }
+
+    //Nobody can change the clipboard while it's open, so this is
+    //the number of what we're about to copy
+    sequence = GetClipboardSequenceNumber();
+
+    if(watch && !IsNewSequence(watch, sequence))
+    {
+        CloseClipboard();
+        return FALSE;
+    }
+
+    //First, get an estimate of how many different formats we'll
+    //need to store.  Some of these will almost certainly fail...
+    if(CreateCapture(capture, CountClipboardFormats(), requested))
+    {
+        UINT format = EnumClipboardFormats(0);
+
+        capture->sequence = sequence;
+        FindClipboardOwner(&clip_owner, guard);
+
+        //Now we'll try to get each format off the clipboard and
+        //copy it, stopping when we either run out of space, or
+        //when we run out of formats.
+        while(format && (capture->formats < capture->max_formats))
+        {
+            if(!IsFormatSupported(format, filter))
+            {
+                //Not wanted at all
+            }
+            else if(defer && !IsPriorityFormat(format, filter))
+            {
+                DeferCaptureFormat(capture, format);
+            }
+            else
+            {
+                FetchClipFormat(capture, format, &clip_owner);
+            }
+
+            format = EnumClipboardFormats(format);
+        }
+    }
+    else
+    {
+        opened = FALSE;
+    }
+
+    CloseClipboard();
+
+    return opened;
+}
+
+
+/*******************************************************************
+** FetchDeferred
+** =============
+** Copies the formats an earlier snapshot deferred, provided the
+** clipboard still holds what that snapshot saw.
+**
+** Inputs:
+**      ClipCapture* rest   - capture from CreateRestCapture
+**      unsigned int tries  - how many times to try opening the
+**                            clipboard
+**      FetchGuard* guard   - deadlines for the clipboard owner; may
+**                            be NULL
+**
+** Outputs:
+**      BOOL                - FALSE if the clipboard has changed or
+**                            couldn't be opened; rest is destroyed
+*******************************************************************/
+BOOL FetchDeferred(ClipCapture* rest, unsigned int tries,
+    FetchGuard* guard)
+{
+    ClipOwner clip_owner;
+    unsigned int i;
+
+    if(!OpenClipboardWithRetry(NULL, tries))
+    {
+        DestroyCapture(rest);
+        return FALSE;
+    }
+
+    if(GetClipboardSequenceNumber() != rest->sequence)
+    {
+        CloseClipboard();
+        DestroyCapture(rest);
+        return FALSE;
+    }
+
+    FindClipboardOwner(&clip_owner, guard);
+
+    for(i = 0; i < rest->deferred_count; ++i)
+    {
+        FetchClipFormat(rest, rest->deferred[i], &clip_owner);
+    }
+
+    CloseClipboard();
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** FindClipboardOwner
+** ==================
+** Finds who owns the open clipboard, and with a deadline to keep,
+** checks it's still answering messages before asking it to render
+** anything.  QClip's own formats need no checking.
+**
+** Inputs:
+**      ClipOwner* owner    - receives the owner
+**      FetchGuard* guard   - deadlines to keep; may be NULL
+*******************************************************************/
+void FindClipboardOwner(ClipOwner* owner, FetchGuard* guard)
+{
+    DWORD process = 0;
+
+    owner->window = GetClipboardOwner();
+    owner->guard = (guard && guard->deadline) ? guard : NULL;
+    owner->hung = FALSE;
+
+    if(owner->window)
+    {
+        GetWindowThreadProcessId(owner->window, &process);
+    }
+
+    owner->process = process;
+
+    if(process == GetCurrentProcessId())
+    {
+        owner->guard = NULL;
+    }
+    else if(owner->guard && owner->window)
+    {
+        owner->hung = !IsOwnerResponsive(owner);
+    }
+}
+
+
+/*******************************************************************
+** IsOwnerResponsive
+** =================
+** Sends the clipboard owner a message that does nothing, to see if
+** it answers within the deadline.  GetClipboardData can't be given
+** a timeout, so this only catches owners that have already hung: one
+** that answers and then hangs while rendering still blocks the
+** capture thread (see StopCaptureThread).
+**
+** Inputs:
+**      ClipOwner* owner    - owner from FindClipboardOwner
+**
+** Outputs:
+**      BOOL                - FALSE if it's hung or too slow
+*******************************************************************/
+BOOL IsOwnerResponsive(ClipOwner* owner)
+{
+    DWORD_PTR result;
+
+    return SendMessageTimeout(owner->window, WM_NULL, 0, 0,
+        SMTO_ABORTIFHUNG | SMTO_BLOCK,
+        (owner->guard->deadline + 999) / 1000, &result) != 0;
+}
+
+
+/*******************************************************************
+** FetchClipFormat
+** ===============
+** Copies one format off the open clipboard into a capture, unless
+** its owner has hung or is being penalised for rendering it too
+** slowly; the format is then counted as skipped.  A fetch that
+** overruns the deadline counts against the owner, and has it
+** checked before anything else is asked of it.
+**
+** Inputs:
+**      ClipCapture* capture    - capture to add to
+**      UINT format             - the format
+**      ClipOwner* owner        - owner from FindClipboardOwner
+**
+** Outputs:
+**      BOOL                    - TRUE if the format was copied
+*******************************************************************/
+BOOL FetchClipFormat(ClipCapture* capture, UINT format, ClipOwner* owner)
+{
+    HANDLE clipboard_handle;
+    void* clipboard_pointer;
+    unsigned int started, elapsed;
+    BOOL copied = FALSE;
+
+    if(owner->guard && (owner->hung
+    || !IsFetchAllowed(owner->guard, owner->process, format, GetTicks())))
+    {
+        ++(capture->skipped);
+        return FALSE;
+    }
+
+    //GetClipboardData is where the owner renders it, so that's the
+    //part worth timing
+    started = GetMicroTicks();
+    clipboard_handle = GetClipboardData(format);
+    elapsed = GetMicroTicks() - started;
+
+    //This will fail for CF_BITMAPs - they're not HGLOBAL handles.
+    clipboard_pointer = clipboard_handle ?
+        GlobalLock(clipboard_handle) : NULL;
+
+    if(clipboard_pointer)
+    {
+        //GlobalSize rounds up, which would leave text and file lists
+        //with slack that's saved to disk and spoils comparisons
+        size_t size = GetLogicalSize(format, clipboard_pointer,
+            GlobalSize(clipboard_handle));
+
+        //Unicode text is kept as UTF-8; Windows makes CF_TEXT and
+        //CF_OEMTEXT from it on paste, as it did when it was copied
+        copied = (format == CF_UNICODETEXT)
+            ? AddCaptureText(capture, clipboard_pointer, size, started)
+            : AddCaptureData(capture, format, clipboard_pointer, size,
+            started);
+        GlobalUnlock(clipboard_handle);
+    }
+
+    //A slow owner may be on its way to hanging
+    if(owner->guard && NoteFetchTime(owner->guard, owner->process,
+        format, elapsed, GetTicks()) && owner->window)
+    {
+        owner->hung = !IsOwnerResponsive(owner);
+    }
+
+    return copied;
+}
+
+
+/*******************************************************************
+** OpenClipboardWithRetry
+** ======================
+** Opens the clipboard, waiting a little between attempts if some
+** other program has it open.
+**
+** Inputs:
+**      HWND owner          - window to open it with; may be NULL
+**      unsigned int tries  - how many attempts to make
+**
+** Outputs:
+**      BOOL                - TRUE if the clipboard is open
+*******************************************************************/
+BOOL OpenClipboardWithRetry(HWND owner, unsigned int tries)
+{
+    BOOL opened = OpenClipboard(owner);
+
+    while(!opened && (--tries > 0))
+    {
+        Sleep(CAPTURE_RETRY_MS);
+        opened = OpenClipboard(owner);
+    }
+
+    return opened;
+}
+
+
+/*******************************************************************
+** HandOverCapture
+** ===============
+** Passes a finished capture to the UI thread, or destroys it if
+** the ring is full.  Capture thread only.
+**
+** Inputs:
+**      ClipCapture* capture    - the capture; the ring takes it
+**      HWND window             - QClip's main window, to tell
+*******************************************************************/
+void HandOverCapture(ClipCapture* capture, HWND window)
+{
+    if(PutCapture(&capture_ring, capture))
+    {
+        PostMessage(window, CAPTURE_MESSAGE, 0, 0);
+    }
+    else
+    {
+        DestroyCapture(capture);
+    }
+}
+
+
+/*******************************************************************
+** GetCaptureStats
+** ===============
+** Copies the capture thread's latency and per-format fetch timings,
+** for tuning PriorityFormats.  UI thread only.
+**
+** Inputs:
+**      CaptureStats* stats - receives the numbers
+*******************************************************************/
+void GetCaptureStats(CaptureStats* stats)
+{
+    *stats = capture_ring.stats;
+}
+
+
+/*******************************************************************
+** StartCaptureThread
+** ==================
+** Starts the thread that copies the clipboard whenever it changes,
+** so a large copy doesn't hold up the UI thread.  Finished captures
+** are posted back with CAPTURE_MESSAGE; see CollectCaptures.  The
+** watch, throttle and fetch deadlines the thread shares with the UI
+** thread are set up here, before it starts, and never again while
+** it runs; the UI thread uses them itself if the thread won't start.
+**
+** Inputs:
+**      BOOL skip_current   - TRUE to leave what's on the clipboard
+**                            now out of the queue
+**
+** Outputs:
+**      BOOL                - TRUE if the thread is running
+*******************************************************************/
+BOOL StartCaptureThread(BOOL skip_current)
+{
+    if(capture_thread)
+    {
+        return TRUE;
+    }
+
+    InitClipWatch(&capture_watch,
+        skip_current ? GetClipboardSequenceNumber() : 0,
+        &watch_filter, sizeof(CaptureFilter));
+    InitCaptureThrottle(&capture_throttle, gv.settings.settle_time,
+        gv.settings.max_capture_rate);
+    InitFetchGuard(&fetch_guard, gv.settings.fetch_timeout * 1000);
+    InitCaptureRing(&capture_ring);
+    capture_stop = FALSE;
+    capture_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+    if(capture_event)
+    {
+        capture_thread = StartThread(CaptureThread, gv.main_window);
+
+        if(!capture_thread)
+        {
+            CloseHandle(capture_event);
+            capture_event = NULL;
+        }
+    }
+
+    return (capture_thread != NULL);
+}
+
+
+/*******************************************************************
+** StopCaptureThread
+** =================
+** Stops the capture thread and waits for it, but not for longer
+** than CAPTURE_STOP_MS: it may be stuck in GetClipboardData on an
+** owner that hung while rendering, and QClip mustn't hang at exit or
+** hold up a shutdown because of it.  A thread that doesn't stop in
+** time is left to the end of the process, and keeps the event and
+** the ring it uses.  Anything it already captured stays in the ring
+** for CollectCaptures.  Safe to call when the thread isn't running.
+*******************************************************************/
+void StopCaptureThread()
+{
+    if(capture_thread)
+    {
+        StoreRelease(&capture_stop, TRUE);
+        SetEvent(capture_event);
+
+        if(JoinThreadWithin(capture_thread, CAPTURE_STOP_MS))
+        {
+            CloseHandle(capture_event);
+            capture_event = NULL;
+        }
+
+        capture_thread = NULL;
+    }
+}
+
+
+/*******************************************************************
+** StartClipboardWatch
+** ===================
+** Starts listening for clipboard changes, with a format listener
+** where Windows has them, or else by joining the clipboard viewer
+** chain.  Start the capture thread first, even if it may fail: it
+** sets up what the captures need.
+**
+** Inputs:
+**      HWND hwnd           - QClip's main window
+**
+** Outputs:
+**      BOOL                - TRUE if using a format listener
+*******************************************************************/
+BOOL StartClipboardWatch(HWND hwnd)
+{
+    listening = AddClipboardFormatListener(hwnd);
+
+    if(listening)
+    {
+        //Unlike the viewer chain, this doesn't announce whatever
+        //is already on the clipboard
+        CaptureClipboard(&gv.cq);
+    }
+    else
+    {
+        gv.next_viewer = SetClipboardViewer(hwnd);
+    }
+
+    return listening;
+}
+
+
+/*******************************************************************
+** StopClipboardWatch
+** ==================
+** Stops listening for clipboard changes.  A change still waiting
+** for the clipboard to settle is dropped.
+**
+** Inputs:
+**      HWND hwnd           - QClip's main window
+*******************************************************************/
+void StopClipboardWatch(HWND hwnd)
+{
+    KillTimer(hwnd, CAPTURE_TIMER_ID);
+
+    if(listening)
+    {
+        RemoveClipboardFormatListener(hwnd);
+        listening = FALSE;
+    }
+    else
+    {
+        ChangeClipboardChain(hwnd, gv.next_viewer);
+    }
+}
+
+
+/*******************************************************************
+** CaptureClipboard
+** ================
+** Handles a clipboard change.  It's captured once the clipboard has
+** settled; see CaptureWhenSettled.
+**
+** Inputs:
+**      ClipQueue* cq       - queue to capture into
+*******************************************************************/
+void CaptureClipboard(ClipQueue* cq)
+{
+    NoteClipboardChange(&capture_throttle, GetTicks());
+    CaptureWhenSettled(cq);
+}
+
+
+/*******************************************************************
+** CaptureWhenSettled
+** ==================
+** Captures a waiting clipboard change if the throttle allows it:
+** asks the capture thread for a snapshot, or takes one here if the
+** thread isn't running.  Changes QClip made itself, and ones already
+** captured, are skipped.  Otherwise CAPTURE_TIMER_ID is set to try
+** again later.
+**
+** Inputs:
+**      ClipQueue* cq       - queue to capture into
+*******************************************************************/
+void CaptureWhenSettled(ClipQueue* cq)
+{
+    ClipCapture capture;
+    CaptureFilter filter;
+    ClipItem item;
+    unsigned int requested, wait;
+
+    if(!ThrottleCapture(&capture_throttle, GetTicks(), &wait))
+    {
+        if(wait > 0)
+        {
+            SetTimer(gv.main_window, CAPTURE_TIMER_ID, wait, NULL);
+        }
+
+        return;
+    }
+
+    KillTimer(gv.main_window, CAPTURE_TIMER_ID);
+    GetCaptureFilter(&filter);
+    RequestSnapshot(&capture_watch, &filter);
+
+    if(capture_thread)
+    {
+        SetEvent(capture_event);
+    }
+    else if(BeginSnapshot(&capture_watch, &requested, &filter)
+    && SnapshotClipboard(&capture, gv.main_window, 1, requested,
+        &capture_watch, &filter, filter.policy == FETCH_PRIORITY_ONLY,
+        &fetch_guard)
+    && AdoptCapture(&capture, &item))
+    {
+        PushItemFront(cq, &item);
+    }
+}
+
+
+/*******************************************************************
+** CollectCaptures
+** ===============
+** Pushes everything the capture thread has finished onto the front
+** of a queue, oldest first.  Deferred formats fetched later are
+** added to the item their snapshot became, if it's still queued.
+** UI thread only.
+**
+** Inputs:
+**      ClipQueue* cq       - the queue
+*******************************************************************/
+void CollectCaptures(ClipQueue* cq)
+{
+    ClipCapture taken;
+    ClipItem item;
+
+    while(TakeCaptureItem(&capture_ring, &item, &taken))
+    {
+        if(item.formats == 0)
+        {
+            DestroyClipItem(&item);
+        }
+        else if(taken.rest && (taken.sequence == pushed_sequence))
+        {
+            AddFormatsToItem(cq, pushed_serial, &item);
+        }
+        else
+        {
+            //Pushing a duplicate leaves the item it matched with the
+            //newest serial, so either way this is the one to add to
+            PushItemFront(cq, &item);
+            pushed_sequence = taken.sequence;
+            pushed_serial = cq->serial;
+        }
+    }
+}
+
+
+/*******************************************************************
+** CaptureThread
+** =============
+** Body of the capture thread: waits for a request, snapshots the
+** clipboard and hands the result to the UI thread.  Under
+** FETCH_PRIORITY_FIRST the priority formats go first, and the rest
+** follow in a second capture once they've been fetched.  Which
+** formats to fetch comes with the request, so nothing here reads
+** gv.
+**
+** Inputs:
+**      void* arg           - QClip's main window
+*******************************************************************/
+void CaptureThread(void* arg)
+{
+    HWND window = (HWND) arg;
+    ClipCapture capture, rest;
+    CaptureFilter filter;
+    unsigned int requested;
+    BOOL has_rest;
+
+    while(WaitForSingleObject(capture_event, INFINITE) == WAIT_OBJECT_0
+    && !LoadAcquire(&capture_stop))
+    {
+        if(!BeginSnapshot(&capture_watch, &requested, &filter))
+        {
+            continue;
+        }
+
+        if(SnapshotClipboard(&capture, NULL, CAPTURE_TRIES, requested,
+            &capture_watch, &filter, filter.policy != FETCH_ALL,
+            &fetch_guard))
+        {
+            //The list goes with the capture, so copy it first
+            has_rest = (filter.policy == FETCH_PRIORITY_FIRST)
+                && CreateRestCapture(&rest, &capture);
+
+            HandOverCapture(&capture, window);
+
+            if(has_rest && FetchDeferred(&rest, CAPTURE_TRIES,
+                &fetch_guard))
+            {
+                HandOverCapture(&rest, window);
+            }
+        }
+    }
+}
+
+
+/*******************************************************************
+** GetCaptureFilter
+** ================
+** Copies what decides which formats are fetched out of the
+** settings, for a snapshot to take with it.  UI thread only.
+**
+** Inputs:
+**      CaptureFilter* filter   - receives the settings
+*******************************************************************/
+void GetCaptureFilter(CaptureFilter* filter)
+{
+    filter->policy = gv.settings.fetch_policy;
+    filter->format_flags = gv.settings.format_flags;
+    filter->all_formats = gv.settings.enable_all_formats;
+    CopyMemory(filter->priority_formats, gv.settings.priority_formats,
+        sizeof(filter->priority_formats));
+    filter->priority_count = gv.settings.priority_count;
+    CopyMemory(filter->shell_formats, gv.shell_formats,
+        sizeof(filter->shell_formats));
+}
+
+
+/*******************************************************************
+** IsShellFormat
+** =============
+** Determines if a given clipboard format is one of several
+** application-defined formats known to be used by the Windows
+** Explorer shell.  These are necessary for some file cut & paste
+** operations, and so should be allowed if CF_HDROP is enabled.
+**
+** Inputs:
+**      UINT format                 - the clipboard format in question
+**      const CaptureFilter* filter - from GetCaptureFilter
+**
+** Outputs:
+**      BOOL                        - TRUE if format is a shell format
+*******************************************************************/
+BOOL IsShellFormat(UINT format, const CaptureFilter* filter)
+{
+    BOOL shell_format = FALSE;
+    unsigned int i;
+
+    for(i = 0; !shell_format && (i < NUM_SHELL_FORMATS); ++i)
+    {
+        shell_format = (format == filter->shell_formats[i]);
+    }
+
+    return shell_format;
+}
+
+
+/*******************************************************************
+** IsPriorityFormat
+** ================
+** Determines if a clipboard format is one of the PriorityFormats,
+** which are always fetched as soon as the clipboard changes.
+**
+** Inputs:
+**      UINT format                 - the clipboard format in question
+**      const CaptureFilter* filter - from GetCaptureFilter
+**
+** Outputs:
+**      BOOL                        - TRUE if format is a priority
+**                                    format
+*******************************************************************/
+BOOL IsPriorityFormat(UINT format, const CaptureFilter* filter)
+{
+    BOOL priority = FALSE;
+    unsigned int i;
+
+    for(i = 0; !priority && (i < filter->priority_count); ++i)
+    {
+        priority = (format == filter->priority_formats[i]);
+    }
+
+    return priority;
+}
+
+
+/*******************************************************************
+** IsFormatSupported
+** =================
+** Determines if a given clipboard format should be saved in the
+** queue, based on user settings and known redundancies in the
+** standard formats.
+**
+** Inputs:
+**      UINT format                 - the clipboard format in question
+**      const CaptureFilter* filter - from GetCaptureFilter
+**
+** Outputs:
+**      BOOL                        - TRUE if the format should be
+**                                    copied
+*******************************************************************/
+BOOL IsFormatSupported(UINT format, const CaptureFilter* filter)
+{
+    BOOL supported = FALSE;
+
+    //CF_BITMAP is always redundant with CF_DIB and CF_DIBV5,
+    //so we discard it.  CF_BITMAP data is also allocated
+    //differently and cannot be handled by the current code.
+
+    //CF_PALETTE is only useful in combination with CF_BITMAP;
+    //CF_DIB[V5] contains its own palette information.
+
+    //CF_OWNERDISPLAY is useless to us, as no data is actually
+    //placed on the clipboard for it.
+
+    //CF_OEMTEXT converts to CF_[UNICODE]TEXT  ...I think...
+    //without loss of data.
+
+    //Also ...I think... CF_METAFILEPICT converts to
+    //CF_ENHMETAFILE without data loss.
+
+    if((format != CF_BITMAP)
+    && (format != CF_PALETTE)
+    && (format != CF_OWNERDISPLAY)
+    && (format != CF_OEMTEXT)
+    && (format != CF_METAFILEPICT))
+    {
+        if(filter->all_formats)
+        {
+            supported = TRUE;
+        }
+        else if(((format >= CF_PRIVATEFIRST) && (format <= CF_PRIVATELAST))
+        || ((format >= CF_GDIOBJFIRST) && (format <= CF_GDIOBJLAST)))
+        {
+            supported = filter->format_flags & FORMAT_PRIVATE;
+        }
+        else if(format >= 0x0C000)
+        {
+            if(filter->format_flags & FORMAT_REGISTERED)
+            {
+                supported = TRUE;
+            }
+            else if(filter->format_flags & FORMAT_FILE)
+            {
+                supported = IsShellFormat(format, filter);
+            }
+        }
+        else
+        {
+            switch(format)
+            {
+                //TIFFs are lumped together with bitmaps, the logic
+                //being that if users wants one, they probably want
+                //the other.  These maybe should go under "other
+                //standard formats" instead...
+                case CF_TIFF:
+                   supported = filter->format_flags & FORMAT_BITMAP;
+                   break;
+
+                //Windows will automatically convert between CF_DIB
+                //and CF_DIBV5, but the conversion is buggy.  We
+                //want to only support whichever one is available
+                //"natively", so that Windows never does any conversion.
+                case CF_DIB:
+                case CF_DIBV5:
+                {
+                    UINT dib_formats[] = {CF_DIB, CF_DIBV5};
+                    int native_format = GetPriorityClipboardFormat(
+                        dib_formats, 2);
+
+                    supported = (format == native_format)
+                        && (filter->format_flags & FORMAT_BITMAP);
+                    break;
+                }
+
+                case CF_UNICODETEXT:
+                    supported = filter->format_flags & FORMAT_TEXT;
+                    break;
+
+                //CF_TEXT is redundant with CF_UNICODETEXT, but the
+                //latter is not available on all systems, so we enable
+                //CF_TEXT only in the case when CF_UNICODETEXT is
+                //unavailable.
+                case CF_TEXT:
+                    supported = (filter->format_flags & FORMAT_TEXT)
+                        && !IsClipboardFormatAvailable(CF_UNICODETEXT);
+                    break;
+
+                //CF_LOCALE is only useful in combination with CF_TEXT,
+                //so we apply the same rules.
+                case CF_LOCALE:
+                    supported = (filter->format_flags & FORMAT_TEXT)
+                        && !IsClipboardFormatAvailable(CF_UNICODETEXT);
+                    break;                    
+
+                case CF_HDROP:
+                    supported = filter->format_flags & FORMAT_FILE;
+                    break;
+
+                case CF_ENHMETAFILE:
+                    supported = filter->format_flags & FORMAT_META;
+                    break;
+
+                //See comment on TIFFs
+                case CF_RIFF:
+                case CF_WAVE:
+                    supported = filter->format_flags & FORMAT_WAVE;
+                    break;
+
+                default:
+                    supported = filter->format_flags & FORMAT_OTHERS;
+            }
+        }
+    }
+
+    return supported;
+}
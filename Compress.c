@@ -0,0 +1,445 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include <string.h>
+#include "Platform.h"
+#include "Compress.h"
+
+//The packed form is a series of sequences, each a run of literal
+//bytes followed by a copy of earlier output:
+//
+//  token       - literal length in the high nibble, match length
+//                (less MIN_MATCH) in the low one.  15 means more
+//                length bytes follow, 255 at a time.
+//  literals
+//  offset      - two bytes, little-endian; how far back to copy from
+//  match length bytes, if the token said so
+//
+//The last sequence is literals only, and ends the data.
+
+#define MIN_MATCH       4
+#define MAX_OFFSET      65535
+#define MIN_HASH_BITS   10
+#define MAX_HASH_BITS   14
+#define HASH_PRIME      2654435761u
+#define SKIP_SHIFT      6       //skips ahead faster over incompressible data
+#define SHORT_COPY      16      //lengths copied in one fixed-size move
+
+static uint32_t Read32(const BYTE* bytes);
+static size_t GetMatchLength(const BYTE* match, const BYTE* bytes,
+    const BYTE* end);
+static BYTE* WriteSequence(BYTE* out, BYTE* end, const BYTE* literals,
+    size_t literal_length, size_t offset, size_t match_length);
+static BYTE* WriteLength(BYTE* out, BYTE* end, size_t length);
+static BOOL ReadLength(const BYTE** in, const BYTE* end, size_t* length);
+
+
+/*******************************************************************
+** CompressBytes
+** =============
+** Packs a buffer.  Gives up as soon as the output would no longer
+** fit, so capacity doubles as the smallest saving worth having.
+**
+** Inputs:
+**      const void* source  - bytes to pack
+**      size_t size         - number of bytes
+**      void* dest          - receives the packed bytes
+**      size_t capacity     - room in dest
+**
+** Outputs:
+**      size_t              - packed size, or 0 if it didn't fit
+*******************************************************************/
+size_t CompressBytes(const void* source, size_t size,
+    void* dest, size_t capacity)
+{
+    const BYTE* in = (const BYTE*) source;
+    BYTE* out = (BYTE*) dest;
+    BYTE* out_end = out + capacity;
+    uint32_t table[1 << MAX_HASH_BITS];     //position + 1 by hash
+    unsigned int bits = MIN_HASH_BITS;
+    size_t pos = 0;
+    size_t anchor = 0;                      //start of pending literals
+
+    //Positions are kept in 32 bits
+    if(size > 0xFFFFFFF0u)
+    {
+        return 0;
+    }
+
+    //Small inputs don't need the whole table cleared
+    while((bits < MAX_HASH_BITS) && (((size_t) 1 << bits) < size))
+    {
+        ++bits;
+    }
+
+    memset(table, 0, sizeof(uint32_t) << bits);
+
+    while(pos + MIN_MATCH <= size)
+    {
+        uint32_t sequence = Read32(in + pos);
+        uint32_t* entry = &table[(sequence * HASH_PRIME) >> (32 - bits)];
+        size_t match = *entry;
+
+        *entry = (uint32_t) (pos + 1);
+
+        if(match && (pos + 1 - match <= MAX_OFFSET)
+        && (Read32(in + match - 1) == sequence))
+        {
+            size_t length;
+
+            --match;
+            length = MIN_MATCH + GetMatchLength(in + match + MIN_MATCH,
+                in + pos + MIN_MATCH, in + size);
+
+            //The match may have started before the hash found it
+            while((pos > anchor) && (match > 0)
+            && (in[pos - 1] == in[match - 1]))
+            {
+                --pos;
+                --match;
+                ++length;
+            }
+
+            out = WriteSequence(out, out_end, in + anchor, pos - anchor,
+                pos - match, length);
+
+            if(!out)
+            {
+                return 0;
+            }
+
+            pos += length;
+            anchor = pos;
+        }
+        else
+        {
+            pos += 1 + ((pos - anchor) >> SKIP_SHIFT);
+        }
+    }
+
+    out = WriteSequence(out, out_end, in + anchor, size - anchor, 0, 0);
+
+    return out ? (size_t) (out - (BYTE*) dest) : 0;
+}
+
+
+/*******************************************************************
+** DecompressBytes
+** ===============
+** Unpacks bytes from CompressBytes.  Damaged input is caught rather
+** than trusted; nothing is ever read or written out of bounds.
+**
+** Inputs:
+**      const void* source  - packed bytes
+**      size_t packed_size  - number of packed bytes
+**      void* dest          - receives the original bytes
+**      size_t size         - original size
+**
+** Outputs:
+**      BOOL                - TRUE if exactly size bytes came out
+*******************************************************************/
+BOOL DecompressBytes(const void* source, size_t packed_size,
+    void* dest, size_t size)
+{
+    const BYTE* in = (const BYTE*) source;
+    const BYTE* in_end = in + packed_size;
+    BYTE* out = (BYTE*) dest;
+    BYTE* out_end = out + size;
+
+    while(in < in_end)
+    {
+        unsigned int token = *in++;
+        size_t length = token >> 4;
+        size_t offset, step;
+        const BYTE* match;
+
+        if((length == 15) && !ReadLength(&in, in_end, &length))
+        {
+            return FALSE;
+        }
+
+        if(((size_t) (in_end - in) < length)
+        || ((size_t) (out_end - out) < length))
+        {
+            return FALSE;
+        }
+
+        //Most runs are short, and a fixed-size copy is much cheaper
+        //than a variable one when there's room to overshoot.
+        if((length <= SHORT_COPY) && (in_end - in >= SHORT_COPY)
+        && (out_end - out >= SHORT_COPY))
+        {
+            memcpy(out, in, SHORT_COPY);
+        }
+        else
+        {
+            memcpy(out, in, length);
+        }
+
+        in += length;
+        out += length;
+
+        if(in == in_end)
+        {
+            break;
+        }
+
+        if(in_end - in < 2)
+        {
+            return FALSE;
+        }
+
+        offset = in[0] | ((size_t) in[1] << 8);
+        in += 2;
+        length = token & 15;
+
+        if((length == 15) && !ReadLength(&in, in_end, &length))
+        {
+            return FALSE;
+        }
+
+        length += MIN_MATCH;
+
+        if((offset == 0) || (offset > (size_t) (out - (BYTE*) dest))
+        || ((size_t) (out_end - out) < length))
+        {
+            return FALSE;
+        }
+
+        //A match can overlap its own output (a run of one byte has
+        //an offset of 1).  What's been copied repeats with a period
+        //of offset, so each copy can be twice the size of the last.
+        match = out - offset;
+        step = offset;
+
+        if((length <= SHORT_COPY) && (offset >= SHORT_COPY)
+        && (out_end - out >= SHORT_COPY))
+        {
+            memcpy(out, match, SHORT_COPY);
+            out += length;
+            continue;
+        }
+
+        while(length > step)
+        {
+            memcpy(out, match, step);
+            out += step;
+            length -= step;
+            step *= 2;
+        }
+
+        memcpy(out, match, length);
+        out += length;
+    }
+
+    return (out == out_end);
+}
+
+
+/*******************************************************************
+** Read32
+** ======
+** Reads four bytes at any alignment.
+*******************************************************************/
+uint32_t Read32(const BYTE* bytes)
+{
+    uint32_t value;
+
+    memcpy(&value, bytes, sizeof(value));
+
+    return value;
+}
+
+
+/*******************************************************************
+** GetMatchLength
+** ==============
+** Counts how many bytes match between an earlier position and the
+** current one, eight at a time while there's room.
+**
+** Inputs:
+**      const BYTE* match   - the earlier position
+**      const BYTE* bytes   - the current position
+**      const BYTE* end     - end of the input
+**
+** Outputs:
+**      size_t              - number of matching bytes
+*******************************************************************/
+size_t GetMatchLength(const BYTE* match, const BYTE* bytes,
+    const BYTE* end)
+{
+    const BYTE* start = bytes;
+
+    while(end - bytes >= 8)
+    {
+        uint64_t a, b;
+
+        memcpy(&a, match, sizeof(a));
+        memcpy(&b, bytes, sizeof(b));
+
+        if(a != b)
+        {
+            break;
+        }
+
+        match += 8;
+        bytes += 8;
+    }
+
+    while((bytes < end) && (*match == *bytes))
+    {
+        ++match;
+        ++bytes;
+    }
+
+    return (size_t) (bytes - start);
+}
+
+
+/*******************************************************************
+** WriteSequence
+** =============
+** Writes one sequence.  An offset of 0 makes it the closing,
+** literals-only sequence.
+**
+** Inputs:
+**      BYTE* out               - where to write
+**      BYTE* end               - end of the output buffer
+**      const BYTE* literals    - bytes to copy as they are
+**      size_t literal_length
+**      size_t offset           - distance back to the match
+**      size_t match_length     - at least MIN_MATCH, unless offset
+**                                is 0
+**
+** Outputs:
+**      BYTE*                   - just past the sequence, or NULL if
+**                                it didn't fit
+*******************************************************************/
+BYTE* WriteSequence(BYTE* out, BYTE* end, const BYTE* literals,
+    size_t literal_length, size_t offset, size_t match_length)
+{
+    size_t match_code = offset ? match_length - MIN_MATCH : 0;
+
+    if(out >= end)
+    {
+        return NULL;
+    }
+
+    *out++ = (BYTE) (((literal_length < 15 ? literal_length : 15) << 4)
+        | (match_code < 15 ? match_code : 15));
+
+    if(literal_length >= 15)
+    {
+        out = WriteLength(out, end, literal_length - 15);
+    }
+
+    if(!out || ((size_t) (end - out) < literal_length))
+    {
+        return NULL;
+    }
+
+    memcpy(out, literals, literal_length);
+    out += literal_length;
+
+    if(offset)
+    {
+        if(end - out < 2)
+        {
+            return NULL;
+        }
+
+        *out++ = (BYTE) (offset & 0xFF);
+        *out++ = (BYTE) (offset >> 8);
+
+        if(match_code >= 15)
+        {
+            out = WriteLength(out, end, match_code - 15);
+        }
+    }
+
+    return out;
+}
+
+
+/*******************************************************************
+** WriteLength
+** ===========
+** Writes the rest of a length that didn't fit in its token nibble.
+**
+** Outputs:
+**      BYTE*               - just past the length, or NULL if it
+**                            didn't fit
+*******************************************************************/
+BYTE* WriteLength(BYTE* out, BYTE* end, size_t length)
+{
+    while(length >= 255)
+    {
+        if(out >= end)
+        {
+            return NULL;
+        }
+
+        *out++ = 255;
+        length -= 255;
+    }
+
+    if(out >= end)
+    {
+        return NULL;
+    }
+
+    *out++ = (BYTE) length;
+
+    return out;
+}
+
+
+/*******************************************************************
+** ReadLength
+** ==========
+** Adds the extra length bytes that follow a token nibble of 15.
+**
+** Inputs:
+**      const BYTE** in     - read position, moved past the bytes
+**      const BYTE* end     - end of the input
+**      size_t* length      - length so far, added to
+**
+** Outputs:
+**      BOOL                - FALSE if the input ran out
+*******************************************************************/
+BOOL ReadLength(const BYTE** in, const BYTE* end, size_t* length)
+{
+    unsigned int byte;
+
+    do
+    {
+        if(*in >= end)
+        {
+            return FALSE;
+        }
+
+        byte = *(*in)++;
+        *length += byte;
+    }
+    while(byte == 255);
+
+    return TRUE;
+}
@@ -0,0 +1,34 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#ifndef __COMPRESS__
+#define __COMPRESS__
+
+#include "Platform.h"
+
+//A small LZ77 codec in the style of LZ4: fast enough to run on every
+//cold payload, and good at the long runs found in bitmaps and text.
+extern size_t CompressBytes(const void* source, size_t size,
+    void* dest, size_t capacity);
+extern BOOL DecompressBytes(const void* source, size_t packed_size,
+    void* dest, size_t size);
+
+#endif
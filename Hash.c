@@ -0,0 +1,289 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include <string.h>
+#include "Platform.h"
+#include "Hash.h"
+
+//SSE2 is part of every x64 target, so this only leaves out old
+//32-bit builds; they get the same hash from the plain C loop.
+#if defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define HASH_SSE2
+#include <emmintrin.h>
+#endif
+
+#define PRIME1  0x9E3779B185EBCA87ULL
+#define PRIME2  0xC2B2AE3D27D4EB4FULL
+#define PRIME3  0x165667B19E3779F9ULL
+#define PRIME32 0x9E3779B1U
+
+#define NUM_LANES           8
+#define STRIPE_SIZE         (NUM_LANES * 8)
+#define STRIPES_PER_BLOCK   16
+
+//Each stripe in a block is keyed with a different window of this
+//table, so reordering stripes changes the hash.  The last NUM_LANES
+//entries key the scramble at the end of each block.
+static const uint64_t secret[STRIPES_PER_BLOCK + NUM_LANES] =
+{
+    0x6627ADF8403B6D17ULL, 0x34EC6AB6D99C8CFCULL, 0xE87C60A7E4F994F1ULL,
+    0x43EB269AB68CE76CULL, 0xD592DF66928398FCULL, 0xEE0F645E4A1ECA1CULL,
+    0x9B73AA98D82972D0ULL, 0x6C80FF06D352A7E4ULL, 0xCAEC61B50DF7CE27ULL,
+    0x9F80961268EA9C52ULL, 0xF7C716A9AAD9D1BEULL, 0xE95DF2ACE6961992ULL,
+    0xA8A233F1F81DADFFULL, 0xEFF0D3CAC883B67BULL, 0x519428AE63D9E652ULL,
+    0xAB8B246E477B2082ULL, 0x5AB4441CBE830F7EULL, 0x0BC0150D86BD524EULL,
+    0x537805E4E9D283DFULL, 0xF0EEEAD1889BFFFDULL, 0xF7AACA9ECF414DE8ULL,
+    0x756A04C14D70714CULL, 0x141E7A67B2B341A8ULL, 0x9CF1BC881B9D07D4ULL,
+};
+
+static uint64_t Mix(uint64_t value);
+static void HashStripes(uint64_t* lanes, const BYTE* bytes, size_t stripes);
+
+#ifdef HASH_SSE2
+static __m128i AccumulatePair(__m128i acc, const BYTE* bytes,
+    const uint64_t* key);
+static __m128i ScramblePair(__m128i acc, const uint64_t* key);
+#endif
+
+
+/*******************************************************************
+** HashBytes
+** =========
+** Computes a 64-bit, non-cryptographic hash of a block of memory.
+** Equal blocks always hash equal, but equal hashes don't prove
+** equal blocks - compare the bytes before trusting a match.
+**
+** Inputs:
+**      const void* memory  - data to hash
+**      size_t size         - size of the data in bytes
+**      uint64_t seed       - starting value; use 0 unless hashing
+**                            several blocks into one value
+**
+** Outputs:
+**      uint64_t            - the hash
+*******************************************************************/
+uint64_t HashBytes(const void* memory, size_t size, uint64_t seed)
+{
+    const BYTE* bytes = (const BYTE*) memory;
+    uint64_t hash = seed ^ (size * PRIME1);
+    uint64_t word;
+
+    //Bulk data goes through eight independent lanes, which is what
+    //lets HashStripes use vector instructions.
+    if(size >= STRIPE_SIZE)
+    {
+        uint64_t lanes[NUM_LANES];
+        size_t stripes = size / STRIPE_SIZE;
+        unsigned int i;
+
+        for(i = 0; i < NUM_LANES; ++i)
+        {
+            lanes[i] = seed + secret[i];
+        }
+
+        HashStripes(lanes, bytes, stripes);
+
+        bytes += stripes * STRIPE_SIZE;
+        size -= stripes * STRIPE_SIZE;
+
+        for(i = 0; i < NUM_LANES; ++i)
+        {
+            hash = (hash ^ Mix(lanes[i] + secret[STRIPES_PER_BLOCK + i]))
+                * PRIME1;
+        }
+    }
+
+    while(size >= 8)
+    {
+        memcpy(&word, bytes, 8);
+        hash = Mix(hash ^ (word * PRIME2));
+        bytes += 8;
+        size -= 8;
+    }
+
+    if(size > 0)
+    {
+        word = 0;
+        memcpy(&word, bytes, size);
+        hash = Mix(hash ^ (word * PRIME3) ^ size);
+    }
+
+    return Mix(hash);
+}
+
+
+/*******************************************************************
+** HashStripes
+** ===========
+** Folds whole 64-byte stripes into the hash lanes.  Each lane adds
+** its neighbour's word plus the product of the two halves of its
+** own keyed word; every block of stripes ends with a scramble so
+** that lanes can't cancel out over long inputs.  The SSE2 and plain
+** C versions give identical results.
+**
+** Inputs:
+**      uint64_t* lanes     - the NUM_LANES running lane values
+**      const BYTE* bytes   - data to hash
+**      size_t stripes      - number of stripes at bytes
+*******************************************************************/
+void HashStripes(uint64_t* lanes, const BYTE* bytes, size_t stripes)
+{
+    unsigned int stripe = 0;
+
+    #ifdef HASH_SSE2
+    //Spelled out lane by lane so the accumulators stay in registers
+    __m128i acc0 = _mm_loadu_si128((const __m128i*) (lanes + 0));
+    __m128i acc1 = _mm_loadu_si128((const __m128i*) (lanes + 2));
+    __m128i acc2 = _mm_loadu_si128((const __m128i*) (lanes + 4));
+    __m128i acc3 = _mm_loadu_si128((const __m128i*) (lanes + 6));
+
+    while(stripes-- > 0)
+    {
+        acc0 = AccumulatePair(acc0, bytes + 0, secret + stripe + 0);
+        acc1 = AccumulatePair(acc1, bytes + 16, secret + stripe + 2);
+        acc2 = AccumulatePair(acc2, bytes + 32, secret + stripe + 4);
+        acc3 = AccumulatePair(acc3, bytes + 48, secret + stripe + 6);
+
+        bytes += STRIPE_SIZE;
+
+        if(++stripe == STRIPES_PER_BLOCK)
+        {
+            acc0 = ScramblePair(acc0, secret + STRIPES_PER_BLOCK + 0);
+            acc1 = ScramblePair(acc1, secret + STRIPES_PER_BLOCK + 2);
+            acc2 = ScramblePair(acc2, secret + STRIPES_PER_BLOCK + 4);
+            acc3 = ScramblePair(acc3, secret + STRIPES_PER_BLOCK + 6);
+
+            stripe = 0;
+        }
+    }
+
+    _mm_storeu_si128((__m128i*) (lanes + 0), acc0);
+    _mm_storeu_si128((__m128i*) (lanes + 2), acc1);
+    _mm_storeu_si128((__m128i*) (lanes + 4), acc2);
+    _mm_storeu_si128((__m128i*) (lanes + 6), acc3);
+
+    #else
+    uint64_t words[NUM_LANES];
+    unsigned int i;
+
+    while(stripes-- > 0)
+    {
+        memcpy(words, bytes, STRIPE_SIZE);
+
+        for(i = 0; i < NUM_LANES; ++i)
+        {
+            uint64_t keyed = words[i] ^ secret[stripe + i];
+
+            lanes[i] += words[i ^ 1]
+                + (keyed & 0xFFFFFFFFU) * (keyed >> 32);
+        }
+
+        bytes += STRIPE_SIZE;
+
+        if(++stripe == STRIPES_PER_BLOCK)
+        {
+            for(i = 0; i < NUM_LANES; ++i)
+            {
+                lanes[i] ^= lanes[i] >> 47;
+                lanes[i] ^= secret[STRIPES_PER_BLOCK + i];
+                lanes[i] *= PRIME32;
+            }
+
+            stripe = 0;
+        }
+    }
+    #endif
+}
+
+
+#ifdef HASH_SSE2
+/*******************************************************************
+** AccumulatePair
+** ==============
+** HashStripes' inner step for two lanes at once.
+**
+** Inputs:
+**      __m128i acc         - the two lanes
+**      const BYTE* bytes   - the lanes' 16 bytes of the stripe
+**      const uint64_t* key - the lanes' two secret words
+**
+** Outputs:
+**      __m128i             - the updated lanes
+*******************************************************************/
+__m128i AccumulatePair(__m128i acc, const BYTE* bytes, const uint64_t* key)
+{
+    __m128i data = _mm_loadu_si128((const __m128i*) bytes);
+    __m128i keyed = _mm_xor_si128(data,
+        _mm_loadu_si128((const __m128i*) key));
+
+    //Low half times high half of each keyed word
+    __m128i product = _mm_mul_epu32(keyed,
+        _mm_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+
+    //Plus the neighbouring lane's word
+    return _mm_add_epi64(acc, _mm_add_epi64(product,
+        _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2))));
+}
+
+
+/*******************************************************************
+** ScramblePair
+** ============
+** HashStripes' end of block scramble for two lanes at once.
+**
+** Inputs:
+**      __m128i acc         - the two lanes
+**      const uint64_t* key - the lanes' two secret words
+**
+** Outputs:
+**      __m128i             - the scrambled lanes
+*******************************************************************/
+__m128i ScramblePair(__m128i acc, const uint64_t* key)
+{
+    const __m128i prime = _mm_set1_epi32((int) PRIME32);
+
+    acc = _mm_xor_si128(acc, _mm_srli_epi64(acc, 47));
+    acc = _mm_xor_si128(acc, _mm_loadu_si128((const __m128i*) key));
+
+    //No 64-bit multiply in SSE2, so build it from 32 x 32 halves
+    return _mm_add_epi64(_mm_mul_epu32(acc, prime),
+        _mm_slli_epi64(_mm_mul_epu32(
+        _mm_shuffle_epi32(acc, _MM_SHUFFLE(0, 3, 0, 1)), prime), 32));
+}
+#endif
+
+
+/*******************************************************************
+** Mix
+** ===
+** Scrambles the bits of a 64-bit value (the murmur3 finalizer).
+*******************************************************************/
+uint64_t Mix(uint64_t value)
+{
+    value ^= value >> 33;
+    value *= 0xFF51AFD7ED558CCDULL;
+    value ^= value >> 33;
+    value *= 0xC4CEB9FE1A85EC53ULL;
+    value ^= value >> 33;
+
+    return value;
+}
@@ -0,0 +1,277 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include "Platform.h"
+#include "ClipItem.h"
+#include "ItemIndex.h"
+
+#define MIN_INDEX_CAPACITY  64
+
+static BOOL GrowIndex(ItemIndex* index);
+static void InsertEntry(ItemIndex* index, IndexEntry* entry);
+
+
+/*******************************************************************
+** InitItemIndex
+** =============
+** Marks an index as inactive, without allocating anything.
+**
+** Inputs:
+**      ItemIndex* index    - the index to initialize
+*******************************************************************/
+void InitItemIndex(ItemIndex* index)
+{
+    index->entries  = NULL;
+    index->capacity = 0;
+    index->count    = 0;
+}
+
+
+/*******************************************************************
+** CreateItemIndex
+** ===============
+** Allocates an empty index with room for a given number of items
+** (it grows as needed after that).  Be sure to call
+** DestroyItemIndex.
+**
+** Inputs:
+**      ItemIndex* index    - the index to create
+**      unsigned int items  - expected number of items
+**
+** Outputs:
+**      BOOL                - TRUE on success
+*******************************************************************/
+BOOL CreateItemIndex(ItemIndex* index, unsigned int items)
+{
+    unsigned int capacity = MIN_INDEX_CAPACITY;
+
+    //Keep the load factor at or under 1/2
+    while(capacity < items * 2)
+    {
+        capacity *= 2;
+    }
+
+    InitItemIndex(index);
+    index->entries = (IndexEntry*) AllocMemory(
+        sizeof(IndexEntry) * capacity);
+
+    if(index->entries)
+    {
+        index->capacity = capacity;
+    }
+
+    return (index->entries != NULL);
+}
+
+
+/*******************************************************************
+** DestroyItemIndex
+** ================
+** Frees an index, leaving it inactive.  The items themselves
+** belong to the queue and are not touched.
+**
+** Inputs:
+**      ItemIndex* index    - the index to destroy
+*******************************************************************/
+void DestroyItemIndex(ItemIndex* index)
+{
+    FreeMemory(index->entries);
+    InitItemIndex(index);
+}
+
+
+/*******************************************************************
+** AddToIndex
+** ==========
+** Adds a queued item to the index.  The item's hash must already
+** be set (see HashClipItem).
+**
+** Inputs:
+**      ItemIndex* index    - an active index
+**      ClipItem* item      - the item, as stored in the queue
+**      unsigned int key    - the queue's key for the item's slot
+**
+** Outputs:
+**      BOOL                - TRUE on success
+*******************************************************************/
+BOOL AddToIndex(ItemIndex* index, ClipItem* item, unsigned int key)
+{
+    IndexEntry entry;
+
+    if(!item->data
+    || (((index->count + 1) * 2 > index->capacity) && !GrowIndex(index)))
+    {
+        return FALSE;
+    }
+
+    entry.item = *item;
+    entry.key = key;
+    InsertEntry(index, &entry);
+    ++(index->count);
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** RemoveFromIndex
+** ===============
+** Removes a queued item from the index, if it's there.
+**
+** Inputs:
+**      ItemIndex* index    - an active index
+**      ClipItem* item      - the item, as stored in the queue
+*******************************************************************/
+void RemoveFromIndex(ItemIndex* index, ClipItem* item)
+{
+    unsigned int mask = index->capacity - 1;
+    unsigned int hole = (unsigned int) item->hash & mask;
+
+    while(index->entries[hole].item.data
+    && (index->entries[hole].item.data != item->data))
+    {
+        hole = (hole + 1) & mask;
+    }
+
+    if(index->entries[hole].item.data)
+    {
+        unsigned int next = hole;
+
+        //Linear probing can't just leave a hole - shift back any
+        //later entries of the run that would no longer be found.
+        for(;;)
+        {
+            unsigned int home;
+
+            next = (next + 1) & mask;
+
+            if(!index->entries[next].item.data)
+            {
+                break;
+            }
+
+            home = (unsigned int) index->entries[next].item.hash & mask;
+
+            if(((next - home) & mask) >= ((next - hole) & mask))
+            {
+                index->entries[hole] = index->entries[next];
+                hole = next;
+            }
+        }
+
+        index->entries[hole].item.data = NULL;
+        index->entries[hole].item.formats = 0;
+        --(index->count);
+    }
+}
+
+
+/*******************************************************************
+** FindInIndex
+** ===========
+** Looks for a queued item identical to the given one.
+**
+** Inputs:
+**      ItemIndex* index    - an active index
+**      ClipItem* item      - the item to look for, with its hash set
+**
+** Outputs:
+**      IndexEntry*         - index entry of the identical item; its
+**                            key says where it is in the queue.
+**                            NULL if there is none.
+*******************************************************************/
+IndexEntry* FindInIndex(ItemIndex* index, ClipItem* item)
+{
+    unsigned int mask = index->capacity - 1;
+    unsigned int position = (unsigned int) item->hash & mask;
+
+    while(index->entries[position].item.data)
+    {
+        if((index->entries[position].item.hash == item->hash)
+        && CompareClipItems(&index->entries[position].item, item))
+        {
+            return &index->entries[position];
+        }
+
+        position = (position + 1) & mask;
+    }
+
+    return NULL;
+}
+
+
+/*******************************************************************
+** GrowIndex
+** =========
+** Doubles the capacity of an index.
+**
+** Inputs:
+**      ItemIndex* index    - the index to grow
+**
+** Outputs:
+**      BOOL                - TRUE on success; on failure the index
+**                            is unchanged.
+*******************************************************************/
+BOOL GrowIndex(ItemIndex* index)
+{
+    ItemIndex bigger;
+
+    if(CreateItemIndex(&bigger, index->capacity))
+    {
+        unsigned int i;
+
+        for(i = 0; i < index->capacity; ++i)
+        {
+            if(index->entries[i].item.data)
+            {
+                InsertEntry(&bigger, &index->entries[i]);
+            }
+        }
+
+        bigger.count = index->count;
+        FreeMemory(index->entries);
+        *index = bigger;
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+
+/*******************************************************************
+** InsertEntry
+** ===========
+** Places an entry in the first free position of its probe run.
+** Does not check capacity or update the count.
+*******************************************************************/
+void InsertEntry(ItemIndex* index, IndexEntry* entry)
+{
+    unsigned int mask = index->capacity - 1;
+    unsigned int position = (unsigned int) entry->item.hash & mask;
+
+    while(index->entries[position].item.data)
+    {
+        position = (position + 1) & mask;
+    }
+
+    index->entries[position] = *entry;
+}
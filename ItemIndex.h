@@ -0,0 +1,57 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#ifndef __ITEMINDEX__
+#define __ITEMINDEX__
+
+#include "Platform.h"
+#include "ClipItem.h"
+
+//A hash set of the items in a queue, keyed by ClipItem.hash.  Entries
+//are copies of the queued ClipItems; an item's data pointer doesn't
+//change when the queue moves it around, so that's what identifies
+//it.  Each entry also holds a key the queue gives it, saying which
+//slot the item is in.  An index with no entries array is simply
+//inactive.
+
+typedef struct
+{
+    ClipItem        item;
+    unsigned int    key;            //queue slot of the item
+}IndexEntry;
+
+typedef struct
+{
+    IndexEntry*     entries;        //open addressing, data NULL if empty
+    unsigned int    capacity;       //always a power of two
+    unsigned int    count;
+}ItemIndex;
+
+extern void InitItemIndex(ItemIndex* index);
+extern BOOL CreateItemIndex(ItemIndex* index, unsigned int items);
+extern void DestroyItemIndex(ItemIndex* index);
+extern BOOL AddToIndex(ItemIndex* index, ClipItem* item, unsigned int key);
+extern void RemoveFromIndex(ItemIndex* index, ClipItem* item);
+extern IndexEntry* FindInIndex(ItemIndex* index, ClipItem* item);
+
+#define IsIndexActive(index)    ((index)->entries != NULL)
+
+#endif
@@ -0,0 +1,1376 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifdef _WIN32
+#define _WIN32_WINNT    0x0600      //SetFileInformationByHandle
+#else
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "Platform.h"
+#include <string.h>
+
+#ifdef _WIN32
+#include <tchar.h>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#ifdef _WIN32
+#define ASCII_NAME_MAX      512
+#define RENAME_NAME_MAX     1024        //UTF-16 units
+
+//FILE_RENAME_INFO as FileRenameInfoEx takes it, with flags where
+//the BOOLEAN was; older SDKs have neither
+#define FILE_RENAME_INFO_EX         22
+#define RENAME_REPLACE_IF_EXISTS    0x01
+#define RENAME_POSIX_SEMANTICS      0x02
+
+typedef struct
+{
+    DWORD           flags;
+    HANDLE          root;
+    DWORD           name_size;      //bytes, less the terminator
+    WCHAR           name[RENAME_NAME_MAX];
+}RenameInfo;
+
+static BOOL ReplaceOpenFile(const PathChar* from, const PathChar* to);
+#else
+#define GATHER_MAX          16          //runs per writev
+#define FIRST_APP_FORMAT    0x0C000
+#define MAX_APP_FORMATS     1024
+
+static NameChar* app_formats[MAX_APP_FORMATS];
+static unsigned int app_format_count = 0;
+
+static unsigned int NameLength(const NameChar* name);
+
+#define HandleToFd(fhand)   ((int) (intptr_t) (fhand))
+#define FdToHandle(fd)      ((HANDLE) (intptr_t) (fd))
+#endif
+
+static size_t GetMapGranularity();
+
+#ifndef _WIN32
+#define THREAD_RUNNING      0
+#define THREAD_FINISHED     1
+#define THREAD_ABANDONED    2   //by JoinThreadWithin; the thread frees
+                                //its own ThreadStart
+#endif
+
+//What a new thread runs; StartThread hands one to the thread
+typedef struct
+{
+    ThreadRoutine   routine;
+    void*           arg;
+    #ifndef _WIN32
+    pthread_t       thread;
+    volatile unsigned int state;    //one of the THREAD_ values
+    #endif
+}ThreadStart;
+
+#ifdef _WIN32
+static DWORD WINAPI RunThread(LPVOID start);
+#else
+static void* RunThread(void* start);
+#endif
+
+
+/*******************************************************************
+** AllocMemory
+** ===========
+** Allocates a zero-filled block of memory.  Release it with
+** FreeMemory.
+**
+** Inputs:
+**      size_t size         - size of the block in bytes
+**
+** Outputs:
+**      void*               - the new block, or NULL on failure
+*******************************************************************/
+void* AllocMemory(size_t size)
+{
+    #ifdef _WIN32
+    return HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, size);
+    #else
+    //calloc(0) may legally return NULL, which callers would
+    //mistake for a failure.
+    return calloc(1, size ? size : 1);
+    #endif
+}
+
+
+/*******************************************************************
+** FreeMemory
+** ==========
+** Releases memory allocated by AllocMemory.  NULL is ignored.
+**
+** Inputs:
+**      void* memory        - the block to release
+*******************************************************************/
+void FreeMemory(void* memory)
+{
+    if(memory)
+    {
+        #ifdef _WIN32
+        HeapFree(GetProcessHeap(), 0, memory);
+        #else
+        free(memory);
+        #endif
+    }
+}
+
+
+/*******************************************************************
+** AllocMovable
+** ============
+** Allocates a zero-filled movable block, like GlobalAlloc with
+** GMEM_MOVEABLE, and hands it back locked.  Such a block can be
+** given to the clipboard outright once it's unlocked, rather than
+** copied.  Elsewhere the handle is just the memory.
+**
+** Inputs:
+**      size_t size         - size of the block in bytes
+**      HANDLE* handle      - receives the block's handle, or NULL
+**
+** Outputs:
+**      void*               - the locked block, or NULL on failure
+*******************************************************************/
+void* AllocMovable(size_t size, HANDLE* handle)
+{
+    void* memory;
+
+    #ifdef _WIN32
+    *handle = GlobalAlloc(GMEM_MOVEABLE | GMEM_DDESHARE | GMEM_ZEROINIT,
+        size ? size : 1);
+    memory = *handle ? GlobalLock(*handle) : NULL;
+
+    if(*handle && !memory)
+    {
+        GlobalFree(*handle);
+        *handle = NULL;
+    }
+    #else
+    memory = AllocMemory(size);
+    *handle = memory;
+    #endif
+
+    return memory;
+}
+
+
+/*******************************************************************
+** UnlockMovable
+** =============
+** Unlocks a block from AllocMovable, ready to be handed over.
+**
+** Inputs:
+**      HANDLE handle       - the block
+*******************************************************************/
+void UnlockMovable(HANDLE handle)
+{
+    #ifdef _WIN32
+    GlobalUnlock(handle);
+    #else
+    (void) handle;
+    #endif
+}
+
+
+/*******************************************************************
+** FreeMovable
+** ===========
+** Frees a block from AllocMovable, locked or not.  NULL is ignored.
+**
+** Inputs:
+**      HANDLE handle       - the block
+*******************************************************************/
+void FreeMovable(HANDLE handle)
+{
+    if(handle)
+    {
+        #ifdef _WIN32
+        GlobalFree(handle);
+        #else
+        FreeMemory(handle);
+        #endif
+    }
+}
+
+
+/*******************************************************************
+** GetTicks
+** ========
+** Returns a millisecond counter suitable for measuring short
+** intervals.  Like GetTickCount, it wraps around.
+**
+** Outputs:
+**      unsigned int        - milliseconds since some fixed point
+*******************************************************************/
+unsigned int GetTicks()
+{
+    #ifdef _WIN32
+    return GetTickCount();
+    #else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned int) (now.tv_sec * 1000 + now.tv_nsec / 1000000);
+    #endif
+}
+
+
+/*******************************************************************
+** GetMicroTicks
+** =============
+** Returns a microsecond counter, for timing things too quick for
+** GetTicks.  It wraps around after an hour or so, so only use it
+** for differences.
+**
+** Outputs:
+**      unsigned int        - microseconds since some fixed point
+*******************************************************************/
+unsigned int GetMicroTicks()
+{
+    #ifdef _WIN32
+    static LARGE_INTEGER frequency = {{0, 0}};
+    LARGE_INTEGER now;
+
+    if(frequency.QuadPart == 0)
+    {
+        QueryPerformanceFrequency(&frequency);
+    }
+
+    QueryPerformanceCounter(&now);
+
+    return (unsigned int) (now.QuadPart / frequency.QuadPart * 1000000
+        + now.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart);
+    #else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned int) ((uint64_t) now.tv_sec * 1000000
+        + now.tv_nsec / 1000);
+    #endif
+}
+
+
+/*******************************************************************
+** StartThread
+** ===========
+** Runs a routine on a new thread.  Wait for it with JoinThread.
+**
+** Inputs:
+**      ThreadRoutine routine   - what to run
+**      void* arg               - passed to the routine
+**
+** Outputs:
+**      HANDLE                  - the thread, or NULL on failure
+*******************************************************************/
+HANDLE StartThread(ThreadRoutine routine, void* arg)
+{
+    ThreadStart* start = (ThreadStart*) AllocMemory(sizeof(ThreadStart));
+    HANDLE thread = NULL;
+
+    if(start)
+    {
+        start->routine = routine;
+        start->arg = arg;
+
+        #ifdef _WIN32
+        thread = CreateThread(NULL, 0, RunThread, start, 0, NULL);
+        #else
+        start->state = THREAD_RUNNING;
+
+        if(pthread_create(&start->thread, NULL, RunThread, start) == 0)
+        {
+            thread = start;
+        }
+        #endif
+
+        if(!thread)
+        {
+            FreeMemory(start);
+        }
+    }
+
+    return thread;
+}
+
+
+/*******************************************************************
+** JoinThread
+** ==========
+** Waits for a thread from StartThread to finish, and cleans up
+** after it.
+**
+** Inputs:
+**      HANDLE thread       - the thread
+*******************************************************************/
+void JoinThread(HANDLE thread)
+{
+    #ifdef _WIN32
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+    #else
+    ThreadStart* start = (ThreadStart*) thread;
+
+    pthread_join(start->thread, NULL);
+    FreeMemory(start);
+    #endif
+}
+
+
+/*******************************************************************
+** JoinThreadWithin
+** ================
+** Like JoinThread, but gives up on a thread that hasn't finished in
+** time.  That thread is left to run until it returns or the process
+** ends, and cleans up after itself, so nothing it uses may be freed
+** in the meantime.  Either way the handle can't be used again.
+**
+** Inputs:
+**      HANDLE thread           - the thread
+**      unsigned int timeout    - ms to wait
+**
+** Outputs:
+**      BOOL                    - TRUE if the thread finished
+*******************************************************************/
+BOOL JoinThreadWithin(HANDLE thread, unsigned int timeout)
+{
+    #ifdef _WIN32
+    BOOL finished = (WaitForSingleObject(thread, timeout) == WAIT_OBJECT_0);
+
+    CloseHandle(thread);
+
+    return finished;
+    #else
+    ThreadStart* start = (ThreadStart*) thread;
+    unsigned int started = GetTicks();
+    struct timespec pause = {0, 1000000};
+
+    while(LoadAcquire(&start->state) != THREAD_FINISHED)
+    {
+        if(GetTicks() - started >= timeout)
+        {
+            pthread_detach(start->thread);
+
+            //If it finished after all, it left this for us to free
+            if(__atomic_exchange_n(&start->state, THREAD_ABANDONED,
+                __ATOMIC_ACQ_REL) == THREAD_FINISHED)
+            {
+                FreeMemory(start);
+            }
+
+            return FALSE;
+        }
+
+        nanosleep(&pause, NULL);
+    }
+
+    JoinThread(thread);
+
+    return TRUE;
+    #endif
+}
+
+
+/*******************************************************************
+** YieldThread
+** ===========
+** Lets other threads run, for code that has to wait on another
+** thread without a better way of doing so.
+*******************************************************************/
+void YieldThread()
+{
+    #ifdef _WIN32
+    Sleep(0);
+    #else
+    sched_yield();
+    #endif
+}
+
+
+/*******************************************************************
+** RunThread
+** =========
+** Thread entry point; calls the routine from StartThread.
+*******************************************************************/
+#ifdef _WIN32
+DWORD WINAPI RunThread(LPVOID start)
+{
+    ThreadStart* thread_start = (ThreadStart*) start;
+    ThreadRoutine routine = thread_start->routine;
+    void* arg = thread_start->arg;
+
+    FreeMemory(thread_start);
+    routine(arg);
+
+    return 0;
+}
+#else
+void* RunThread(void* start)
+{
+    ThreadStart* thread_start = (ThreadStart*) start;
+
+    //JoinThread frees this, since it holds the pthread_t, unless
+    //JoinThreadWithin has given up on the thread
+    thread_start->routine(thread_start->arg);
+
+    if(__atomic_exchange_n(&thread_start->state, THREAD_FINISHED,
+        __ATOMIC_ACQ_REL) == THREAD_ABANDONED)
+    {
+        FreeMemory(thread_start);
+    }
+
+    return NULL;
+}
+#endif
+
+
+/*******************************************************************
+** LoadAcquire
+** ===========
+** Reads a value shared between threads.  Anything the other thread
+** wrote before its matching StoreRelease is visible afterwards.
+**
+** Inputs:
+**      volatile unsigned int* value    - the shared value
+**
+** Outputs:
+**      unsigned int                    - its current value
+*******************************************************************/
+unsigned int LoadAcquire(volatile unsigned int* value)
+{
+    #ifdef _WIN32
+    return (unsigned int) InterlockedCompareExchange(
+        (volatile LONG*) value, 0, 0);
+    #else
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+    #endif
+}
+
+
+/*******************************************************************
+** StoreRelease
+** ============
+** Writes a value shared between threads, after everything written
+** before it.
+**
+** Inputs:
+**      volatile unsigned int* value    - the shared value
+**      unsigned int new_value          - what to store
+*******************************************************************/
+void StoreRelease(volatile unsigned int* value, unsigned int new_value)
+{
+    #ifdef _WIN32
+    InterlockedExchange((volatile LONG*) value, (LONG) new_value);
+    #else
+    __atomic_store_n(value, new_value, __ATOMIC_RELEASE);
+    #endif
+}
+
+
+/*******************************************************************
+** OpenFileForReading
+** ==================
+** Opens an existing file for sequential reading.  Others may read
+** it too, or replace it (see MoveFileOver), in which case the
+** handle goes on reading the file it opened.
+**
+** Inputs:
+**      const PathChar* path    - path to the file
+**
+** Outputs:
+**      HANDLE              - file handle, or INVALID_HANDLE_VALUE
+*******************************************************************/
+HANDLE OpenFileForReading(const PathChar* path)
+{
+    #ifdef _WIN32
+    return CreateFile(path, GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    #else
+    int fd = open(path, O_RDONLY);
+    return (fd < 0) ? INVALID_HANDLE_VALUE : FdToHandle(fd);
+    #endif
+}
+
+
+/*******************************************************************
+** OpenFileForWriting
+** ==================
+** Creates a file for writing, truncating it if it already exists.
+**
+** Inputs:
+**      const PathChar* path    - path to the file
+**
+** Outputs:
+**      HANDLE              - file handle, or INVALID_HANDLE_VALUE
+*******************************************************************/
+HANDLE OpenFileForWriting(const PathChar* path)
+{
+    #ifdef _WIN32
+    return CreateFile(path, GENERIC_WRITE, 0, NULL,
+        CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    #else
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    return (fd < 0) ? INVALID_HANDLE_VALUE : FdToHandle(fd);
+    #endif
+}
+
+
+/*******************************************************************
+** OpenFileForUpdate
+** =================
+** Opens a file for reading and writing at any offset, creating it
+** if it doesn't exist.  What's in it is kept.
+**
+** Inputs:
+**      const PathChar* path    - path to the file
+**
+** Outputs:
+**      HANDLE              - file handle, or INVALID_HANDLE_VALUE
+*******************************************************************/
+HANDLE OpenFileForUpdate(const PathChar* path)
+{
+    #ifdef _WIN32
+    return CreateFile(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+        NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    #else
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    return (fd < 0) ? INVALID_HANDLE_VALUE : FdToHandle(fd);
+    #endif
+}
+
+
+/*******************************************************************
+** MoveFileOver
+** ============
+** Renames a file, replacing any file already at the new path in
+** one step: anyone opening the new path gets either the old file
+** or the new one, never a mix.  Anyone with the old file open from
+** OpenFileForReading goes on reading it, though Windows only allows
+** that from Windows 10 1709; before that, the rename fails.
+**
+** Inputs:
+**      const PathChar* from    - the file to rename; closed
+**      const PathChar* to      - its new path
+**
+** Outputs:
+**      BOOL                - TRUE on success
+*******************************************************************/
+BOOL MoveFileOver(const PathChar* from, const PathChar* to)
+{
+    #ifdef _WIN32
+    return ReplaceOpenFile(from, to) || MoveFileEx(from, to,
+        MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+    #else
+    return (rename(from, to) == 0);
+    #endif
+}
+
+
+/*******************************************************************
+** CloseFileHandle
+** ===============
+** Closes a handle from OpenFileForReading or OpenFileForWriting.
+**
+** Inputs:
+**      HANDLE fhand        - the file to close
+*******************************************************************/
+void CloseFileHandle(HANDLE fhand)
+{
+    if(fhand != INVALID_HANDLE_VALUE)
+    {
+        #ifdef _WIN32
+        CloseHandle(fhand);
+        #else
+        close(HandleToFd(fhand));
+        #endif
+    }
+}
+
+
+/*******************************************************************
+** DuplicateFileHandle
+** ===================
+** Makes a second handle to an open file, which stays open after
+** the first is closed.  Only use ReadBytesAt and WriteBytesAt with
+** it, since the two share a file position; those leave the
+** position alone, so either handle can be used on any thread.
+**
+** Inputs:
+**      HANDLE fhand        - the file
+**
+** Outputs:
+**      HANDLE              - the new handle, for CloseFileHandle, or
+**                            INVALID_HANDLE_VALUE
+*******************************************************************/
+HANDLE DuplicateFileHandle(HANDLE fhand)
+{
+    #ifdef _WIN32
+    HANDLE copy;
+
+    if(!DuplicateHandle(GetCurrentProcess(), fhand, GetCurrentProcess(),
+        &copy, 0, FALSE, DUPLICATE_SAME_ACCESS))
+    {
+        return INVALID_HANDLE_VALUE;
+    }
+
+    return copy;
+    #else
+    int fd = dup(HandleToFd(fhand));
+    return (fd < 0) ? INVALID_HANDLE_VALUE : FdToHandle(fd);
+    #endif
+}
+
+
+/*******************************************************************
+** ReadBytes
+** =========
+** Reads exactly the requested number of bytes from a file.  A
+** short read counts as a failure.
+**
+** Inputs:
+**      HANDLE fhand        - file open for reading
+**      void* buffer        - buffer of at least size bytes
+**      size_t size         - number of bytes to read
+**
+** Outputs:
+**      BOOL                - TRUE if all bytes were read
+*******************************************************************/
+BOOL ReadBytes(HANDLE fhand, void* buffer, size_t size)
+{
+    #ifdef _WIN32
+    DWORD num_bytes;
+
+    return ReadFile(fhand, buffer, (DWORD) size, &num_bytes, NULL)
+        && (num_bytes == size);
+    #else
+    BYTE* position = (BYTE*) buffer;
+
+    while(size > 0)
+    {
+        ssize_t result = read(HandleToFd(fhand), position, size);
+
+        if(result <= 0)
+        {
+            if((result < 0) && (errno == EINTR))
+            {
+                continue;
+            }
+
+            return FALSE;
+        }
+
+        position += result;
+        size -= (size_t) result;
+    }
+
+    return TRUE;
+    #endif
+}
+
+
+/*******************************************************************
+** WriteBytes
+** ==========
+** Writes a block of bytes to a file in its entirety.
+**
+** Inputs:
+**      HANDLE fhand        - file open for writing
+**      const void* buffer  - data to write
+**      size_t size         - number of bytes to write
+**
+** Outputs:
+**      BOOL                - TRUE if all bytes were written
+*******************************************************************/
+BOOL WriteBytes(HANDLE fhand, const void* buffer, size_t size)
+{
+    #ifdef _WIN32
+    DWORD num_bytes;
+
+    return WriteFile(fhand, buffer, (DWORD) size, &num_bytes, NULL)
+        && (num_bytes == size);
+    #else
+    const BYTE* position = (const BYTE*) buffer;
+
+    while(size > 0)
+    {
+        ssize_t result = write(HandleToFd(fhand), position, size);
+
+        if(result < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+
+            return FALSE;
+        }
+
+        position += result;
+        size -= (size_t) result;
+    }
+
+    return TRUE;
+    #endif
+}
+
+
+/*******************************************************************
+** WriteGathered
+** =============
+** Writes several runs of bytes to a file, one after another, in
+** their entirety, with as few calls to the OS as it takes.  On
+** POSIX that's one writev for up to GATHER_MAX runs.  Windows only
+** gathers into unbuffered files, in whole pages, so there each run
+** is written in turn.
+**
+** Inputs:
+**      HANDLE fhand            - file open for writing
+**      const ByteRun* runs     - what to write
+**      unsigned int count      - how many runs
+**
+** Outputs:
+**      BOOL                    - TRUE if all bytes were written
+*******************************************************************/
+BOOL WriteGathered(HANDLE fhand, const ByteRun* runs, unsigned int count)
+{
+    #ifdef _WIN32
+    unsigned int i;
+
+    for(i = 0; i < count; ++i)
+    {
+        if(!WriteBytes(fhand, runs[i].bytes, runs[i].size))
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+    #else
+    struct iovec vectors[GATHER_MAX];
+    unsigned int i, first, batch;
+    ssize_t result;
+
+    while(count > 0)
+    {
+        batch = (count < GATHER_MAX) ? count : GATHER_MAX;
+
+        for(i = 0; i < batch; ++i)
+        {
+            vectors[i].iov_base = (void*) runs[i].bytes;
+            vectors[i].iov_len = runs[i].size;
+        }
+
+        first = 0;
+
+        while(first < batch)
+        {
+            result = writev(HandleToFd(fhand), vectors + first,
+                (int) (batch - first));
+
+            if(result < 0)
+            {
+                if(errno == EINTR)
+                {
+                    continue;
+                }
+
+                return FALSE;
+            }
+
+            //Step over what was written, which may end part way
+            //through a run
+            while((first < batch)
+            && ((size_t) result >= vectors[first].iov_len))
+            {
+                result -= (ssize_t) vectors[first].iov_len;
+                ++first;
+            }
+
+            if(first < batch)
+            {
+                vectors[first].iov_base =
+                    (BYTE*) vectors[first].iov_base + result;
+                vectors[first].iov_len -= (size_t) result;
+            }
+        }
+
+        runs += batch;
+        count -= batch;
+    }
+
+    return TRUE;
+    #endif
+}
+
+
+/*******************************************************************
+** OpenScratchFile
+** ===============
+** Creates an empty file for reading and writing at any offset.
+** The file is deleted once it is closed (or, on POSIX, as soon as
+** it is open), so nothing is left behind if the process dies.
+**
+** Inputs:
+**      const PathChar* path    - path to the file
+**
+** Outputs:
+**      HANDLE              - file handle, or INVALID_HANDLE_VALUE
+*******************************************************************/
+HANDLE OpenScratchFile(const PathChar* path)
+{
+    #ifdef _WIN32
+    return CreateFile(path, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+        CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE,
+        NULL);
+    #else
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+
+    if(fd < 0)
+    {
+        return INVALID_HANDLE_VALUE;
+    }
+
+    unlink(path);
+    return FdToHandle(fd);
+    #endif
+}
+
+
+/*******************************************************************
+** ReadBytesAt
+** ===========
+** Reads exactly the requested number of bytes from a given offset
+** in a file.  A short read counts as a failure.  The offset goes
+** with the read, rather than through the file position, so other
+** threads can read or write the same file at the same time.
+**
+** Inputs:
+**      HANDLE fhand        - file open for reading
+**      uint64_t offset     - where to start reading
+**      void* buffer        - buffer of at least size bytes
+**      size_t size         - number of bytes to read
+**
+** Outputs:
+**      BOOL                - TRUE if all bytes were read
+*******************************************************************/
+BOOL ReadBytesAt(HANDLE fhand, uint64_t offset, void* buffer, size_t size)
+{
+    #ifdef _WIN32
+    OVERLAPPED overlapped;
+    DWORD num_bytes;
+
+    memset(&overlapped, 0, sizeof(OVERLAPPED));
+    overlapped.Offset = (DWORD) offset;
+    overlapped.OffsetHigh = (DWORD) (offset >> 32);
+
+    return ReadFile(fhand, buffer, (DWORD) size, &num_bytes, &overlapped)
+        && (num_bytes == size);
+    #else
+    BYTE* position = (BYTE*) buffer;
+
+    while(size > 0)
+    {
+        ssize_t result = pread(HandleToFd(fhand), position, size,
+            (off_t) offset);
+
+        if(result <= 0)
+        {
+            if((result < 0) && (errno == EINTR))
+            {
+                continue;
+            }
+
+            return FALSE;
+        }
+
+        position += result;
+        offset += (uint64_t) result;
+        size -= (size_t) result;
+    }
+
+    return TRUE;
+    #endif
+}
+
+
+/*******************************************************************
+** WriteBytesAt
+** ============
+** Writes a block of bytes at a given offset in a file, extending
+** the file if needed.  Like ReadBytesAt, this leaves the file
+** position alone.
+**
+** Inputs:
+**      HANDLE fhand        - file open for writing
+**      uint64_t offset     - where to start writing
+**      const void* buffer  - data to write
+**      size_t size         - number of bytes to write
+**
+** Outputs:
+**      BOOL                - TRUE if all bytes were written
+*******************************************************************/
+BOOL WriteBytesAt(HANDLE fhand, uint64_t offset, const void* buffer,
+size_t size)
+{
+    #ifdef _WIN32
+    OVERLAPPED overlapped;
+    DWORD num_bytes;
+
+    memset(&overlapped, 0, sizeof(OVERLAPPED));
+    overlapped.Offset = (DWORD) offset;
+    overlapped.OffsetHigh = (DWORD) (offset >> 32);
+
+    return WriteFile(fhand, buffer, (DWORD) size, &num_bytes, &overlapped)
+        && (num_bytes == size);
+    #else
+    const BYTE* position = (const BYTE*) buffer;
+
+    while(size > 0)
+    {
+        ssize_t result = pwrite(HandleToFd(fhand), position, size,
+            (off_t) offset);
+
+        if(result < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+
+            return FALSE;
+        }
+
+        position += result;
+        offset += (uint64_t) result;
+        size -= (size_t) result;
+    }
+
+    return TRUE;
+    #endif
+}
+
+
+/*******************************************************************
+** SetFileLength
+** =============
+** Truncates (or extends) a file to the given length.
+**
+** Inputs:
+**      HANDLE fhand        - file open for writing
+**      uint64_t length     - new length in bytes
+**
+** Outputs:
+**      BOOL                - TRUE on success
+*******************************************************************/
+BOOL SetFileLength(HANDLE fhand, uint64_t length)
+{
+    #ifdef _WIN32
+    LARGE_INTEGER position;
+
+    position.QuadPart = (LONGLONG) length;
+
+    return SetFilePointerEx(fhand, position, NULL, FILE_BEGIN)
+        && SetEndOfFile(fhand);
+    #else
+    return (ftruncate(HandleToFd(fhand), (off_t) length) == 0);
+    #endif
+}
+
+
+/*******************************************************************
+** GetFileLength
+** =============
+** Finds out how long a file is.
+**
+** Inputs:
+**      HANDLE fhand        - the file
+**      uint64_t* length    - receives its length in bytes
+**
+** Outputs:
+**      BOOL                - TRUE on success
+*******************************************************************/
+BOOL GetFileLength(HANDLE fhand, uint64_t* length)
+{
+    #ifdef _WIN32
+    LARGE_INTEGER size;
+
+    if(!GetFileSizeEx(fhand, &size))
+    {
+        return FALSE;
+    }
+
+    *length = (uint64_t) size.QuadPart;
+    return TRUE;
+    #else
+    struct stat info;
+
+    if(fstat(HandleToFd(fhand), &info) != 0)
+    {
+        return FALSE;
+    }
+
+    *length = (uint64_t) info.st_size;
+    return TRUE;
+    #endif
+}
+
+
+/*******************************************************************
+** FlushFile
+** =========
+** Waits until everything written to a file is on the disk itself,
+** not just in the system's cache, so it survives a power cut.
+**
+** Inputs:
+**      HANDLE fhand        - file open for writing
+**
+** Outputs:
+**      BOOL                - TRUE on success
+*******************************************************************/
+BOOL FlushFile(HANDLE fhand)
+{
+    #ifdef _WIN32
+    return FlushFileBuffers(fhand);
+    #else
+    return (fsync(HandleToFd(fhand)) == 0);
+    #endif
+}
+
+
+/*******************************************************************
+** MapFileRange
+** ============
+** Maps part of a file into memory, read only.  The range needn't
+** be aligned in any way.  Release it with UnmapFileRange, passing
+** the same offset and size.
+**
+** Inputs:
+**      HANDLE fhand        - file open for reading
+**      uint64_t offset     - start of the range
+**      size_t size         - length of the range, at least 1 byte
+**
+** Outputs:
+**      void*               - address of the byte at offset, or NULL
+**                            on failure
+*******************************************************************/
+void* MapFileRange(HANDLE fhand, uint64_t offset, size_t size)
+{
+    size_t lead = (size_t) (offset % GetMapGranularity());
+    BYTE* view;
+
+    #ifdef _WIN32
+    uint64_t start = offset - lead;
+    HANDLE mapping = CreateFileMapping(fhand, NULL, PAGE_READONLY,
+        0, 0, NULL);
+
+    if(!mapping)
+    {
+        return NULL;
+    }
+
+    //The view keeps the mapping object alive on its own
+    view = (BYTE*) MapViewOfFile(mapping, FILE_MAP_READ,
+        (DWORD) (start >> 32), (DWORD) start, lead + size);
+    CloseHandle(mapping);
+    #else
+    view = (BYTE*) mmap(NULL, lead + size, PROT_READ, MAP_SHARED,
+        HandleToFd(fhand), (off_t) (offset - lead));
+
+    if(view == (BYTE*) MAP_FAILED)
+    {
+        view = NULL;
+    }
+    #endif
+
+    return view ? view + lead : NULL;
+}
+
+
+/*******************************************************************
+** UnmapFileRange
+** ==============
+** Releases a range mapped by MapFileRange.
+**
+** Inputs:
+**      void* memory        - address returned by MapFileRange
+**      uint64_t offset     - offset passed to MapFileRange
+**      size_t size         - size passed to MapFileRange
+*******************************************************************/
+void UnmapFileRange(void* memory, uint64_t offset, size_t size)
+{
+    size_t lead = (size_t) (offset % GetMapGranularity());
+
+    #ifdef _WIN32
+    UnmapViewOfFile((BYTE*) memory - lead);
+    #else
+    munmap((BYTE*) memory - lead, lead + size);
+    #endif
+}
+
+
+/*******************************************************************
+** GetMapGranularity
+** =================
+** Returns the alignment file mappings must start on.
+**
+** Outputs:
+**      size_t              - alignment in bytes
+*******************************************************************/
+size_t GetMapGranularity()
+{
+    static size_t granularity = 0;
+
+    if(granularity == 0)
+    {
+        #ifdef _WIN32
+        SYSTEM_INFO info;
+
+        GetSystemInfo(&info);
+        granularity = info.dwAllocationGranularity;
+        #else
+        granularity = (size_t) sysconf(_SC_PAGESIZE);
+        #endif
+    }
+
+    return granularity;
+}
+
+
+/*******************************************************************
+** RegisterFormatName
+** ==================
+** Looks up (registering if needed) the numeric ID of an application
+** clipboard format, given its name.  The number for a given name
+** can change between sessions, which is why names are what get
+** stored on disk.
+**
+** Inputs:
+**      const NameChar* name    - UTF-16 name of the format
+**
+** Outputs:
+**      UINT                - the format ID, or 0 on failure
+*******************************************************************/
+UINT RegisterFormatName(const NameChar* name)
+{
+    #ifdef _WIN32
+    #ifdef UNICODE
+    return RegisterClipboardFormat(name);
+    #else
+    char ascii_name[ASCII_NAME_MAX+1];
+
+    WideCharToMultiByte(CP_ACP, 0, name, -1,
+        ascii_name, ASCII_NAME_MAX, NULL, NULL);
+
+    return RegisterClipboardFormat(ascii_name);
+    #endif
+
+    #else
+    unsigned int i;
+    unsigned int length = NameLength(name);
+
+    for(i = 0; i < app_format_count; ++i)
+    {
+        if((NameLength(app_formats[i]) == length)
+        && (memcmp(app_formats[i], name, length * sizeof(NameChar)) == 0))
+        {
+            return FIRST_APP_FORMAT + i;
+        }
+    }
+
+    if(app_format_count < MAX_APP_FORMATS)
+    {
+        app_formats[i] = (NameChar*) AllocMemory(
+            (length + 1) * sizeof(NameChar));
+
+        if(app_formats[i])
+        {
+            memcpy(app_formats[i], name, length * sizeof(NameChar));
+            ++app_format_count;
+
+            return FIRST_APP_FORMAT + i;
+        }
+    }
+
+    return 0;
+    #endif
+}
+
+
+/*******************************************************************
+** GetFormatName
+** =============
+** Retrieves the name of an application clipboard format.
+**
+** Inputs:
+**      UINT format             - the format ID
+**      NameChar* name          - buffer for the UTF-16 name
+**      unsigned int max_length - size of the buffer in characters
+**
+** Outputs:
+**      unsigned int        - length of the name in characters, not
+**                            including the terminator; 0 on failure
+*******************************************************************/
+unsigned int GetFormatName(UINT format, NameChar* name,
+unsigned int max_length)
+{
+    #ifdef _WIN32
+    #ifdef UNICODE
+    return GetClipboardFormatName(format, name, max_length);
+    #else
+    char ascii_name[ASCII_NAME_MAX+1];
+    unsigned int length = 0;
+
+    if(GetClipboardFormatName(format, ascii_name, ASCII_NAME_MAX) > 0)
+    {
+        if(MultiByteToWideChar(CP_ACP, 0, ascii_name, -1,
+            name, max_length) > 0)
+        {
+            length = (unsigned int) wcslen(name);
+        }
+    }
+
+    return length;
+    #endif
+
+    #else
+    unsigned int length = 0;
+
+    if((format >= FIRST_APP_FORMAT)
+    && (format - FIRST_APP_FORMAT < app_format_count)
+    && (max_length > 0))
+    {
+        length = NameLength(app_formats[format - FIRST_APP_FORMAT]);
+
+        if(length >= max_length)
+        {
+            length = max_length - 1;
+        }
+
+        memcpy(name, app_formats[format - FIRST_APP_FORMAT],
+            length * sizeof(NameChar));
+        name[length] = 0;
+    }
+
+    return length;
+    #endif
+}
+
+
+#ifdef _WIN32
+/*******************************************************************
+** ReplaceOpenFile
+** ===============
+** MoveFileOver with POSIX semantics, which let a file be replaced
+** while it's still open, if it was opened with FILE_SHARE_DELETE.
+** Windows before 10 1709 doesn't have them, and fails this.
+**
+** Inputs:
+**      const PathChar* from    - the file to rename; closed
+**      const PathChar* to      - its new path
+**
+** Outputs:
+**      BOOL                - TRUE on success
+*******************************************************************/
+BOOL ReplaceOpenFile(const PathChar* from, const PathChar* to)
+{
+    RenameInfo info;
+    HANDLE fhand;
+    int length;
+    BOOL success;
+
+    #ifdef UNICODE
+    length = lstrlenW(to);
+
+    if(length >= RENAME_NAME_MAX)
+    {
+        return FALSE;
+    }
+
+    memcpy(info.name, to, (length + 1) * sizeof(WCHAR));
+    #else
+    length = MultiByteToWideChar(CP_ACP, 0, to, -1, info.name,
+        RENAME_NAME_MAX) - 1;
+
+    if(length < 0)
+    {
+        return FALSE;
+    }
+    #endif
+
+    info.flags = RENAME_REPLACE_IF_EXISTS | RENAME_POSIX_SEMANTICS;
+    info.root = NULL;
+    info.name_size = (DWORD) length * sizeof(WCHAR);
+
+    fhand = CreateFile(from, DELETE | SYNCHRONIZE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if(fhand == INVALID_HANDLE_VALUE)
+    {
+        return FALSE;
+    }
+
+    success = SetFileInformationByHandle(fhand,
+        (FILE_INFO_BY_HANDLE_CLASS) FILE_RENAME_INFO_EX, &info,
+        sizeof(RenameInfo));
+    CloseHandle(fhand);
+
+    return success;
+}
+#endif
+
+
+#ifndef _WIN32
+/*******************************************************************
+** NameLength
+** ==========
+** wcslen for UTF-16 strings, since wchar_t is 32 bits here.
+**
+** Inputs:
+**      const NameChar* name    - a null terminated UTF-16 string
+**
+** Outputs:
+**      unsigned int        - length in characters
+*******************************************************************/
+unsigned int NameLength(const NameChar* name)
+{
+    unsigned int length = 0;
+
+    while(name[length])
+    {
+        ++length;
+    }
+
+    return length;
+}
+#endif
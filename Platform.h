@@ -0,0 +1,104 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef __PLATFORM__
+#define __PLATFORM__
+
+//This is the thin OS layer underneath the queue, item and file code,
+//so those can be built (and benchmarked) away from Windows.  Nothing
+//in here should know about the clipboard itself.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+typedef WCHAR           NameChar;       //always UTF-16, as stored on disk
+typedef TCHAR           PathChar;
+
+#else
+
+typedef int             BOOL;
+typedef unsigned int    UINT;
+typedef unsigned char   BYTE;
+typedef void*           HANDLE;
+typedef uint16_t        NameChar;
+typedef char            PathChar;
+
+#define TRUE                    1
+#define FALSE                   0
+#define INVALID_HANDLE_VALUE    ((HANDLE) (intptr_t) -1)
+
+#endif
+
+extern void* AllocMemory(size_t size);
+extern void FreeMemory(void* memory);
+extern void* AllocMovable(size_t size, HANDLE* handle);
+extern void UnlockMovable(HANDLE handle);
+extern void FreeMovable(HANDLE handle);
+extern unsigned int GetTicks();
+extern unsigned int GetMicroTicks();
+
+typedef void (*ThreadRoutine)(void* arg);
+
+extern HANDLE StartThread(ThreadRoutine routine, void* arg);
+extern void JoinThread(HANDLE thread);
+extern BOOL JoinThreadWithin(HANDLE thread, unsigned int timeout);
+extern void YieldThread();
+extern unsigned int LoadAcquire(volatile unsigned int* value);
+extern void StoreRelease(volatile unsigned int* value, unsigned int new_value);
+
+extern HANDLE OpenFileForReading(const PathChar* path);
+extern HANDLE OpenFileForWriting(const PathChar* path);
+extern HANDLE OpenFileForUpdate(const PathChar* path);
+extern BOOL MoveFileOver(const PathChar* from, const PathChar* to);
+extern void CloseFileHandle(HANDLE fhand);
+extern HANDLE DuplicateFileHandle(HANDLE fhand);
+extern BOOL ReadBytes(HANDLE fhand, void* buffer, size_t size);
+extern BOOL WriteBytes(HANDLE fhand, const void* buffer, size_t size);
+
+//A run of bytes, for WriteGathered
+typedef struct
+{
+    const void*     bytes;
+    size_t          size;
+}ByteRun;
+
+extern BOOL WriteGathered(HANDLE fhand, const ByteRun* runs,
+    unsigned int count);
+
+extern HANDLE OpenScratchFile(const PathChar* path);
+extern BOOL ReadBytesAt(HANDLE fhand, uint64_t offset,
+    void* buffer, size_t size);
+extern BOOL WriteBytesAt(HANDLE fhand, uint64_t offset,
+    const void* buffer, size_t size);
+extern BOOL SetFileLength(HANDLE fhand, uint64_t length);
+extern BOOL GetFileLength(HANDLE fhand, uint64_t* length);
+extern BOOL FlushFile(HANDLE fhand);
+extern void* MapFileRange(HANDLE fhand, uint64_t offset, size_t size);
+extern void UnmapFileRange(void* memory, uint64_t offset, size_t size);
+
+extern UINT RegisterFormatName(const NameChar* name);
+extern unsigned int GetFormatName(UINT format,
+    NameChar* name, unsigned int max_length);
+
+#endif
@@ -0,0 +1,390 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include <string.h>
+#include "Platform.h"
+#include "Thumbnail.h"
+
+//As in Hash.c: SSE2 is part of every x64 target.  Without it the
+//rows are added up a byte at a time, to the same result.
+#if defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define THUMBNAIL_SSE2
+#include <emmintrin.h>
+#endif
+
+//Layout of a BITMAPINFOHEADER, which starts CF_DIB and CF_DIBV5
+#define DIB_HEADER_SIZE     40
+#define DIB_WIDTH           4
+#define DIB_HEIGHT          8
+#define DIB_BIT_COUNT       14
+#define DIB_COMPRESSION     16
+#define DIB_COLOURS_USED    32
+#define DIB_RED_MASK        40      //BITMAPV4HEADER and later
+
+#define BI_RGB              0
+#define BI_BITFIELDS        3
+#define MAX_DIB_SIDE        0x10000
+
+//Where the pixels are and how to read them
+typedef struct
+{
+    int32_t         width;
+    int32_t         height;     //always positive
+    BOOL            bottom_up;
+    unsigned int    bits;
+    const BYTE*     palette;    //RGBQUADs, for 8 bits or fewer
+    uint32_t        colours;
+    const BYTE*     rows;
+    size_t          stride;
+}DibLayout;
+
+static BOOL ReadDibLayout(const BYTE* dib, size_t size, DibLayout* layout);
+static void ExpandRow(const DibLayout* layout, const BYTE* row,
+    BYTE* expanded);
+static void AccumulateRow(uint32_t* sums, const BYTE* row, size_t bytes);
+
+
+/*******************************************************************
+** ScaleDib
+** ========
+** Scales a DIB down to no more than max_height rows, keeping its
+** shape, by averaging the block of pixels each thumbnail pixel
+** covers.  Pictures already short enough are copied as they are.
+** Handles 1, 4 and 8-bit palettized DIBs, 24-bit, and 32-bit in
+** the usual BGR layout, stored either way up.
+**
+** Inputs:
+**      const void* dib         - the CF_DIB or CF_DIBV5
+**      size_t size             - its size
+**      int32_t max_height      - rows in the thumbnail at most
+**      ThumbnailImage* image   - receives the thumbnail; free it
+**                                with FreeThumbnailImage
+**
+** Outputs:
+**      BOOL                    - FALSE if the DIB is malformed, not
+**                                one of those kinds, or there's no
+**                                memory
+*******************************************************************/
+BOOL ScaleDib(const void* dib, size_t size, int32_t max_height,
+    ThumbnailImage* image)
+{
+    DibLayout layout;
+    uint32_t* sums;
+    BYTE* expanded = NULL;
+    const BYTE* row;
+    size_t row_bytes, pixel_bytes;
+    int32_t x, y, sy, x0, x1, y0, y1, sx;
+    uint32_t blue, green, red, count;
+
+    image->pixels = NULL;
+
+    if((max_height <= 0)
+    || !ReadDibLayout((const BYTE*) dib, size, &layout))
+    {
+        return FALSE;
+    }
+
+    image->height = (layout.height > max_height)
+        ? max_height : layout.height;
+    image->width = (int32_t) ((int64_t) layout.width * image->height
+        / layout.height);
+    image->width = image->width ? image->width : 1;
+
+    //Palettized rows are looked up into 32-bit ones first; the rest
+    //are added up as they are
+    pixel_bytes = (layout.bits == 24) ? 3 : 4;
+    row_bytes = (size_t) layout.width * pixel_bytes;
+
+    image->pixels = (uint32_t*) AllocMemory(sizeof(uint32_t)
+        * image->width * image->height);
+    sums = (uint32_t*) AllocMemory(sizeof(uint32_t) * row_bytes);
+
+    if(layout.bits <= 8)
+    {
+        expanded = (BYTE*) AllocMemory(row_bytes);
+    }
+
+    if(!image->pixels || !sums || ((layout.bits <= 8) && !expanded))
+    {
+        FreeMemory(expanded);
+        FreeMemory(sums);
+        FreeThumbnailImage(image);
+        return FALSE;
+    }
+
+    for(y = 0; y < image->height; ++y)
+    {
+        y0 = (int32_t) ((int64_t) y * layout.height / image->height);
+        y1 = (int32_t) ((int64_t) (y + 1) * layout.height / image->height);
+        memset(sums, 0, sizeof(uint32_t) * row_bytes);
+
+        //Down the block of rows...
+        for(sy = y0; sy < y1; ++sy)
+        {
+            row = layout.rows + layout.stride * (layout.bottom_up
+                ? layout.height - 1 - sy : sy);
+
+            if(expanded)
+            {
+                ExpandRow(&layout, row, expanded);
+                row = expanded;
+            }
+
+            AccumulateRow(sums, row, row_bytes);
+        }
+
+        //...then across it, a block of columns to each pixel
+        for(x = 0; x < image->width; ++x)
+        {
+            x0 = (int32_t) ((int64_t) x * layout.width / image->width);
+            x1 = (int32_t) ((int64_t) (x + 1) * layout.width / image->width);
+            blue = green = red = 0;
+
+            for(sx = x0; sx < x1; ++sx)
+            {
+                blue += sums[sx * pixel_bytes];
+                green += sums[sx * pixel_bytes + 1];
+                red += sums[sx * pixel_bytes + 2];
+            }
+
+            count = (uint32_t) (x1 - x0) * (uint32_t) (y1 - y0);
+            image->pixels[y * image->width + x] = 0xFF000000
+                | (((red + count / 2) / count) << 16)
+                | (((green + count / 2) / count) << 8)
+                | ((blue + count / 2) / count);
+        }
+    }
+
+    FreeMemory(expanded);
+    FreeMemory(sums);
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** FreeThumbnailImage
+** ==================
+** Frees the pixels of a thumbnail from ScaleDib.
+**
+** Inputs:
+**      ThumbnailImage* image   - the thumbnail
+*******************************************************************/
+void FreeThumbnailImage(ThumbnailImage* image)
+{
+    FreeMemory(image->pixels);
+    image->pixels = NULL;
+}
+
+
+/*******************************************************************
+** ReadDibLayout
+** =============
+** Works out where a DIB's pixels are and how they're stored, and
+** checks they're all there.
+**
+** Inputs:
+**      const BYTE* dib     - the DIB
+**      size_t size         - its size
+**      DibLayout* layout   - receives the layout
+**
+** Outputs:
+**      BOOL                - FALSE if ScaleDib can't handle it
+*******************************************************************/
+BOOL ReadDibLayout(const BYTE* dib, size_t size, DibLayout* layout)
+{
+    uint32_t header_size, compression, masks[3];
+    uint16_t bits;
+    size_t offset;
+
+    if(size < DIB_HEADER_SIZE)
+    {
+        return FALSE;
+    }
+
+    memcpy(&header_size, dib, sizeof(header_size));
+    memcpy(&layout->width, dib + DIB_WIDTH, sizeof(layout->width));
+    memcpy(&layout->height, dib + DIB_HEIGHT, sizeof(layout->height));
+    memcpy(&bits, dib + DIB_BIT_COUNT, sizeof(bits));
+    memcpy(&compression, dib + DIB_COMPRESSION, sizeof(compression));
+    memcpy(&layout->colours, dib + DIB_COLOURS_USED,
+        sizeof(layout->colours));
+
+    layout->bits = bits;
+    layout->bottom_up = (layout->height > 0);
+    layout->height = layout->bottom_up ? layout->height : -layout->height;
+    offset = header_size;
+
+    if((header_size < DIB_HEADER_SIZE) || (header_size > size)
+    || (layout->width <= 0) || (layout->width > MAX_DIB_SIDE)
+    || (layout->height <= 0) || (layout->height > MAX_DIB_SIDE))
+    {
+        return FALSE;
+    }
+
+    //32-bit pixels may come with masks, which are only any use to
+    //us if they're the usual ones; they follow a plain
+    //BITMAPINFOHEADER and are part of anything bigger
+    if((compression == BI_BITFIELDS) && (bits == 32))
+    {
+        if(header_size == DIB_HEADER_SIZE)
+        {
+            offset += sizeof(masks);
+        }
+
+        if(size < DIB_RED_MASK + sizeof(masks))
+        {
+            return FALSE;
+        }
+
+        memcpy(masks, dib + DIB_RED_MASK, sizeof(masks));
+
+        if((masks[0] != 0x00FF0000) || (masks[1] != 0x0000FF00)
+        || (masks[2] != 0x000000FF))
+        {
+            return FALSE;
+        }
+    }
+    else if(compression != BI_RGB)
+    {
+        return FALSE;
+    }
+
+    switch(bits)
+    {
+    case 1:
+    case 4:
+    case 8:
+        if((layout->colours == 0) || (layout->colours > (1u << bits)))
+        {
+            layout->colours = 1u << bits;
+        }
+
+        layout->palette = dib + offset;
+        offset += (size_t) layout->colours * 4;
+        break;
+
+    case 24:
+    case 32:
+        layout->palette = NULL;
+
+        //A colour table for optimising palettes may still be there
+        offset += (size_t) ((layout->colours <= 256)
+            ? layout->colours : 0) * 4;
+        break;
+
+    default:
+        return FALSE;
+    }
+
+    layout->stride = ((size_t) layout->width * bits + 31) / 32 * 4;
+    layout->rows = dib + offset;
+
+    return (offset <= size)
+        && (layout->stride * layout->height <= size - offset);
+}
+
+
+/*******************************************************************
+** ExpandRow
+** =========
+** Looks up a row of palette indexes into 32-bit pixels.
+**
+** Inputs:
+**      const DibLayout* layout - the DIB
+**      const BYTE* row         - the row
+**      BYTE* expanded          - width * 4 bytes for the pixels
+*******************************************************************/
+void ExpandRow(const DibLayout* layout, const BYTE* row, BYTE* expanded)
+{
+    unsigned int mask = (1u << layout->bits) - 1;
+    unsigned int per_byte = 8 / layout->bits;
+    unsigned int index, shift;
+    int32_t x;
+
+    for(x = 0; x < layout->width; ++x)
+    {
+        if(layout->bits == 8)
+        {
+            index = row[x];
+        }
+        else
+        {
+            shift = 8 - layout->bits * (x % per_byte + 1);
+            index = (row[x / per_byte] >> shift) & mask;
+        }
+
+        //An index past the end of the table comes out black
+        if(index < layout->colours)
+        {
+            memcpy(expanded + x * 4, layout->palette + index * 4, 4);
+        }
+        else
+        {
+            memset(expanded + x * 4, 0, 4);
+        }
+    }
+}
+
+
+/*******************************************************************
+** AccumulateRow
+** =============
+** Adds each byte of a row to its running total.  This is where
+** nearly all the time goes, since it sees every byte of the DIB.
+**
+** Inputs:
+**      uint32_t* sums      - one total for each byte
+**      const BYTE* row     - the row
+**      size_t bytes        - bytes in it
+*******************************************************************/
+void AccumulateRow(uint32_t* sums, const BYTE* row, size_t bytes)
+{
+    size_t i = 0;
+
+    #ifdef THUMBNAIL_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    __m128i block, low, high;
+    __m128i* total;
+
+    for(; i + 16 <= bytes; i += 16)
+    {
+        block = _mm_loadu_si128((const __m128i*) (row + i));
+        low = _mm_unpacklo_epi8(block, zero);
+        high = _mm_unpackhi_epi8(block, zero);
+        total = (__m128i*) (sums + i);
+
+        _mm_storeu_si128(total, _mm_add_epi32(_mm_loadu_si128(total),
+            _mm_unpacklo_epi16(low, zero)));
+        _mm_storeu_si128(total + 1, _mm_add_epi32(
+            _mm_loadu_si128(total + 1), _mm_unpackhi_epi16(low, zero)));
+        _mm_storeu_si128(total + 2, _mm_add_epi32(
+            _mm_loadu_si128(total + 2), _mm_unpacklo_epi16(high, zero)));
+        _mm_storeu_si128(total + 3, _mm_add_epi32(
+            _mm_loadu_si128(total + 3), _mm_unpackhi_epi16(high, zero)));
+    }
+    #endif
+
+    for(; i < bytes; ++i)
+    {
+        sums[i] += row[i];
+    }
+}
@@ -0,0 +1,38 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef __THUMBNAIL__
+#define __THUMBNAIL__
+
+#include "Platform.h"
+
+//A picture scaled down from a DIB, for the popup menu
+typedef struct
+{
+    int32_t         width;
+    int32_t         height;
+    uint32_t*       pixels;     //top-down rows of opaque 0xFFRRGGBB
+}ThumbnailImage;
+
+extern BOOL ScaleDib(const void* dib, size_t size, int32_t max_height,
+    ThumbnailImage* image);
+extern void FreeThumbnailImage(ThumbnailImage* image);
+
+#endif
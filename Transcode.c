@@ -0,0 +1,510 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include <string.h>
+#include "Platform.h"
+#include "Transcode.h"
+
+//As in Hash.c: SSE2 is part of every x64 target.  Without it, runs
+//of ASCII are still taken four characters at a time.
+#if defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define TRANSCODE_SSE2
+#include <emmintrin.h>
+#endif
+
+#define REPLACEMENT_CHAR    0xFFFD
+
+#define IsHighSurrogate(unit)   (((unit) & 0xFC00) == 0xD800)
+#define IsLowSurrogate(unit)    (((unit) & 0xFC00) == 0xDC00)
+#define IsContinuation(byte)    (((byte) & 0xC0) == 0x80)
+
+static size_t SkipAsciiUnits(const uint16_t* text, size_t units,
+    BYTE* dest);
+static size_t SkipAsciiBytes(const BYTE* text, size_t size,
+    uint16_t* dest);
+static uint32_t DecodeCodePoint(const BYTE* text, size_t size,
+    size_t* used);
+
+
+/*******************************************************************
+** GetUtf8Size
+** ===========
+** Works out how many bytes EncodeUtf8 will turn some UTF-16 into.
+**
+** Inputs:
+**      const uint16_t* text    - the UTF-16
+**      size_t units            - its length in 16-bit units
+**
+** Outputs:
+**      size_t                  - bytes of UTF-8
+*******************************************************************/
+size_t GetUtf8Size(const uint16_t* text, size_t units)
+{
+    size_t size = 0;
+    size_t i = 0;
+    size_t ascii;
+
+    while(i < units)
+    {
+        if(text[i] < 0x80)
+        {
+            ascii = SkipAsciiUnits(text + i, units - i, NULL);
+            ascii += (ascii == 0);
+            i += ascii;
+            size += ascii;
+            continue;
+        }
+
+        if(text[i] < 0x800)
+        {
+            size += 2;
+        }
+        else if(IsHighSurrogate(text[i]) && (i + 1 < units)
+        && IsLowSurrogate(text[i + 1]))
+        {
+            size += 4;
+            ++i;
+        }
+        else
+        {
+            size += 3;
+        }
+
+        ++i;
+    }
+
+    return size;
+}
+
+
+/*******************************************************************
+** EncodeUtf8
+** ==========
+** Turns UTF-16 into UTF-8.
+**
+** Inputs:
+**      const uint16_t* text    - the UTF-16
+**      size_t units            - its length in 16-bit units
+**      BYTE* dest              - GetUtf8Size bytes for the UTF-8
+**
+** Outputs:
+**      size_t                  - bytes written
+*******************************************************************/
+size_t EncodeUtf8(const uint16_t* text, size_t units, BYTE* dest)
+{
+    BYTE* start = dest;
+    size_t i = 0;
+    size_t ascii;
+    uint32_t code;
+
+    while(i < units)
+    {
+        code = text[i];
+
+        if(code < 0x80)
+        {
+            ascii = SkipAsciiUnits(text + i, units - i, dest);
+
+            if(ascii == 0)
+            {
+                *dest = (BYTE) code;
+                ascii = 1;
+            }
+
+            i += ascii;
+            dest += ascii;
+            continue;
+        }
+
+        ++i;
+
+        if(code < 0x800)
+        {
+            *dest++ = (BYTE) (0xC0 | (code >> 6));
+            *dest++ = (BYTE) (0x80 | (code & 0x3F));
+        }
+        else if(IsHighSurrogate(code) && (i < units)
+        && IsLowSurrogate(text[i]))
+        {
+            code = 0x10000 + ((code - 0xD800) << 10) + (text[i++] - 0xDC00);
+            *dest++ = (BYTE) (0xF0 | (code >> 18));
+            *dest++ = (BYTE) (0x80 | ((code >> 12) & 0x3F));
+            *dest++ = (BYTE) (0x80 | ((code >> 6) & 0x3F));
+            *dest++ = (BYTE) (0x80 | (code & 0x3F));
+        }
+        else
+        {
+            *dest++ = (BYTE) (0xE0 | (code >> 12));
+            *dest++ = (BYTE) (0x80 | ((code >> 6) & 0x3F));
+            *dest++ = (BYTE) (0x80 | (code & 0x3F));
+        }
+    }
+
+    return (size_t) (dest - start);
+}
+
+
+/*******************************************************************
+** GetUtf16Units
+** =============
+** Works out how many 16-bit units DecodeUtf8 will turn some UTF-8
+** into, given room for them all.
+**
+** Inputs:
+**      const BYTE* text    - the UTF-8
+**      size_t size         - its size in bytes
+**
+** Outputs:
+**      size_t              - units of UTF-16
+*******************************************************************/
+size_t GetUtf16Units(const BYTE* text, size_t size)
+{
+    size_t i = SkipAsciiBytes(text, size, NULL);
+    size_t units = i;
+    size_t used;
+
+    //As in DecodeUtf8, the rest a character at a time
+    while(i < size)
+    {
+        if(text[i] < 0x80)
+        {
+            ++units;
+            ++i;
+        }
+        else
+        {
+            units += (DecodeCodePoint(text + i, size - i, &used)
+                >= 0x10000) ? 2 : 1;
+            i += used;
+        }
+    }
+
+    return units;
+}
+
+
+/*******************************************************************
+** DecodeUtf8
+** ==========
+** Turns UTF-8 into UTF-16, stopping early if dest fills up; a
+** character that needs two units is never split.  Only the ASCII
+** the text starts with is taken in blocks.  Past the first other
+** character, runs of ASCII are mostly too short to be worth it, so
+** the rest is done a character at a time, with whole two- and
+** three-byte characters decoded in place.
+**
+** Inputs:
+**      const BYTE* text    - the UTF-8
+**      size_t size         - its size in bytes
+**      uint16_t* dest      - where to put the UTF-16
+**      size_t capacity     - room at dest, in units
+**
+** Outputs:
+**      size_t              - units written
+*******************************************************************/
+size_t DecodeUtf8(const BYTE* text, size_t size, uint16_t* dest,
+    size_t capacity)
+{
+    size_t i = SkipAsciiBytes(text, (size < capacity) ? size : capacity,
+        dest);
+    size_t written = i;
+    size_t stop, used;
+    uint32_t code;
+    BYTE lead;
+    BOOL valid;
+
+    while(i < size)
+    {
+        //A character makes no more units than it has bytes, so while
+        //a whole one fits before stop, neither dest nor the text can
+        //run out in the middle of it
+        stop = (size - i < capacity - written)
+            ? size : i + (capacity - written);
+
+        while(i + 4 <= stop)
+        {
+            lead = text[i];
+
+            if(lead < 0x80)
+            {
+                dest[written++] = lead;
+                ++i;
+            }
+            else if(lead < 0xE0)
+            {
+                if((lead < 0xC2) || !IsContinuation(text[i + 1]))
+                {
+                    break;
+                }
+
+                dest[written++] = (uint16_t) (((lead & 0x1F) << 6)
+                    | (text[i + 1] & 0x3F));
+                i += 2;
+            }
+            else if(lead < 0xF0)
+            {
+                //Text that needs three bytes a character tends to come
+                //in long runs of it
+                do
+                {
+                    code = ((lead & 0x0F) << 12)
+                        | ((text[i + 1] & 0x3F) << 6) | (text[i + 2] & 0x3F);
+                    valid = (code >= 0x800) && !(((text[i + 1] ^ 0x80)
+                        | (text[i + 2] ^ 0x80)) & 0xC0);
+
+                    if(valid)
+                    {
+                        dest[written++] = (uint16_t) code;
+                        i += 3;
+                        lead = text[i];
+                    }
+                }
+                while(valid && (i + 4 <= stop) && ((lead & 0xF0) == 0xE0));
+
+                if(!valid)
+                {
+                    break;
+                }
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        if(i >= size)
+        {
+            break;
+        }
+
+        //Anything else, and the last few bytes, one at a time
+        code = DecodeCodePoint(text + i, size - i, &used);
+
+        if(written + ((code >= 0x10000) ? 2 : 1) > capacity)
+        {
+            break;
+        }
+
+        if(code >= 0x10000)
+        {
+            code -= 0x10000;
+            dest[written++] = (uint16_t) (0xD800 + (code >> 10));
+            dest[written++] = (uint16_t) (0xDC00 + (code & 0x3FF));
+        }
+        else
+        {
+            dest[written++] = (uint16_t) code;
+        }
+
+        i += used;
+    }
+
+    return written;
+}
+
+
+/*******************************************************************
+** SkipAsciiUnits
+** ==============
+** Finds the run of ASCII at the start of some UTF-16, copying it
+** out as bytes if asked.  Most text copied is ASCII, so this is
+** where the time goes: eight units at a time with SSE2, four
+** otherwise.  The last few units of a run may be left for the
+** caller.
+**
+** Inputs:
+**      const uint16_t* text    - the UTF-16
+**      size_t units            - its length in 16-bit units
+**      BYTE* dest              - where to copy the run; may be NULL
+**
+** Outputs:
+**      size_t                  - units in the run
+*******************************************************************/
+size_t SkipAsciiUnits(const uint16_t* text, size_t units, BYTE* dest)
+{
+    size_t i = 0;
+
+    #ifdef TRANSCODE_SSE2
+    const __m128i high = _mm_set1_epi16((short) 0xFF80);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i block;
+
+    for(; i + 8 <= units; i += 8)
+    {
+        block = _mm_loadu_si128((const __m128i*) (text + i));
+
+        if(_mm_movemask_epi8(_mm_cmpeq_epi16(
+            _mm_and_si128(block, high), zero)) != 0xFFFF)
+        {
+            break;
+        }
+
+        if(dest)
+        {
+            _mm_storel_epi64((__m128i*) (dest + i),
+                _mm_packus_epi16(block, block));
+        }
+    }
+    #endif
+
+    for(; i + 4 <= units; i += 4)
+    {
+        if((text[i] | text[i + 1] | text[i + 2] | text[i + 3]) >= 0x80)
+        {
+            break;
+        }
+
+        if(dest)
+        {
+            dest[i] = (BYTE) text[i];
+            dest[i + 1] = (BYTE) text[i + 1];
+            dest[i + 2] = (BYTE) text[i + 2];
+            dest[i + 3] = (BYTE) text[i + 3];
+        }
+    }
+
+    return i;
+}
+
+
+/*******************************************************************
+** SkipAsciiBytes
+** ==============
+** SkipAsciiUnits the other way round: finds the run of ASCII at the
+** start of some UTF-8, widening it into UTF-16 if asked.
+**
+** Inputs:
+**      const BYTE* text    - the UTF-8
+**      size_t size         - how much of it to look at
+**      uint16_t* dest      - where to copy the run; may be NULL
+**
+** Outputs:
+**      size_t              - bytes in the run
+*******************************************************************/
+size_t SkipAsciiBytes(const BYTE* text, size_t size, uint16_t* dest)
+{
+    size_t i = 0;
+
+    #ifdef TRANSCODE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    __m128i block;
+
+    for(; i + 16 <= size; i += 16)
+    {
+        block = _mm_loadu_si128((const __m128i*) (text + i));
+
+        if(_mm_movemask_epi8(block) != 0)
+        {
+            break;
+        }
+
+        if(dest)
+        {
+            _mm_storeu_si128((__m128i*) (dest + i),
+                _mm_unpacklo_epi8(block, zero));
+            _mm_storeu_si128((__m128i*) (dest + i + 8),
+                _mm_unpackhi_epi8(block, zero));
+        }
+    }
+    #endif
+
+    for(; i + 4 <= size; i += 4)
+    {
+        if((text[i] | text[i + 1] | text[i + 2] | text[i + 3]) & 0x80)
+        {
+            break;
+        }
+
+        if(dest)
+        {
+            dest[i] = text[i];
+            dest[i + 1] = text[i + 1];
+            dest[i + 2] = text[i + 2];
+            dest[i + 3] = text[i + 3];
+        }
+    }
+
+    return i;
+}
+
+
+/*******************************************************************
+** DecodeCodePoint
+** ===============
+** Decodes one character of UTF-8.  Encoded surrogates are allowed,
+** since EncodeUtf8 writes unpaired ones; anything else malformed is
+** taken as U+FFFD, one byte long.
+**
+** Inputs:
+**      const BYTE* text    - the UTF-8; at least one byte
+**      size_t size         - bytes available
+**      size_t* used        - receives the character's length
+**
+** Outputs:
+**      uint32_t            - the code point
+*******************************************************************/
+uint32_t DecodeCodePoint(const BYTE* text, size_t size, size_t* used)
+{
+    uint32_t code;
+
+    *used = 1;
+
+    if(text[0] < 0x80)
+    {
+        return text[0];
+    }
+
+    if((text[0] >= 0xC2) && (text[0] <= 0xDF)
+    && (size >= 2) && IsContinuation(text[1]))
+    {
+        *used = 2;
+        return ((text[0] & 0x1F) << 6) | (text[1] & 0x3F);
+    }
+
+    if(((text[0] & 0xF0) == 0xE0) && (size >= 3)
+    && IsContinuation(text[1]) && IsContinuation(text[2]))
+    {
+        code = ((text[0] & 0x0F) << 12) | ((text[1] & 0x3F) << 6)
+            | (text[2] & 0x3F);
+
+        if(code >= 0x800)
+        {
+            *used = 3;
+            return code;
+        }
+    }
+
+    if((text[0] >= 0xF0) && (text[0] <= 0xF4) && (size >= 4)
+    && IsContinuation(text[1]) && IsContinuation(text[2])
+    && IsContinuation(text[3]))
+    {
+        code = ((text[0] & 0x07) << 18) | ((text[1] & 0x3F) << 12)
+            | ((text[2] & 0x3F) << 6) | (text[3] & 0x3F);
+
+        if((code >= 0x10000) && (code <= 0x10FFFF))
+        {
+            *used = 4;
+            return code;
+        }
+    }
+
+    return REPLACEMENT_CHAR;
+}
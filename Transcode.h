@@ -0,0 +1,36 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef __TRANSCODE__
+#define __TRANSCODE__
+
+#include "Platform.h"
+
+//UTF-16 to UTF-8 and back, for text kept in the queue as UTF-8.
+//Unpaired surrogates are encoded like any other code point (as
+//WTF-8 does), so any run of UTF-16 comes back exactly as it went in.
+//Malformed UTF-8 decodes to U+FFFD a byte at a time.
+extern size_t GetUtf8Size(const uint16_t* text, size_t units);
+extern size_t EncodeUtf8(const uint16_t* text, size_t units, BYTE* dest);
+extern size_t GetUtf16Units(const BYTE* text, size_t size);
+extern size_t DecodeUtf8(const BYTE* text, size_t size, uint16_t* dest,
+    size_t capacity);
+
+#endif
@@ -0,0 +1,85 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#ifndef __BENCH__
+#define __BENCH__
+
+#include "Platform.h"
+#include "ClipItem.h"
+
+#define CF_TEXT             1
+#define CF_DIB              8
+#define CF_UNICODETEXT      13
+#define CF_HDROP            15
+
+typedef struct
+{
+    const char*     name;
+    unsigned int    (*run)();   //returns how many checks failed
+}BenchSuite;
+
+extern double GetBenchTime();
+extern double GetBenchThreadTime();
+extern void ReportRate(const char* label, unsigned long operations,
+    double bytes, double seconds);
+extern const char* GetBenchFile(const char* name);
+
+extern void FillSyntheticBytes(void* memory, size_t size, unsigned int seed);
+extern BOOL MakeSyntheticItem(ClipItem* item, unsigned int seed,
+    unsigned int formats, size_t size);
+extern void SetBenchClipboard(ClipItem* item);
+extern const void* PasteBenchFormat(UINT format);
+extern unsigned int CountPlacedFormats(unsigned int* rendered);
+extern void ClearBenchClipboard();
+
+extern unsigned long bench_clipboard_reads;
+extern unsigned long bench_clipboard_writes;
+extern unsigned long bench_clipboard_moves;
+extern unsigned long bench_clipboard_renders;
+extern unsigned long bench_thumbnails_made;
+extern unsigned long bench_thumbnails_released;
+extern BOOL bench_clipboard_delayed;
+extern BOOL bench_clipboard_unique;
+
+extern unsigned int RunQueueBench();
+extern unsigned int RunBlobBench();
+extern unsigned int RunDedupeBench();
+extern unsigned int RunCompareBench();
+extern unsigned int RunBudgetBench();
+extern unsigned int RunDequeBench();
+extern unsigned int RunSpillBench();
+extern unsigned int RunCodecBench();
+extern unsigned int RunRenderBench();
+extern unsigned int RunCaptureBench();
+extern unsigned int RunReplayBench();
+extern unsigned int RunStormBench();
+extern unsigned int RunFetchBench();
+extern unsigned int RunHungBench();
+extern unsigned int RunSizeBench();
+extern unsigned int RunTranscodeBench();
+extern unsigned int RunPreviewBench();
+extern unsigned int RunThumbnailBench();
+extern unsigned int RunScaleBench();
+extern unsigned int RunStartupBench();
+extern unsigned int RunJournalBench();
+extern unsigned int RunWriteBench();
+
+#endif
@@ -0,0 +1,471 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+//A stand-in for the Windows clipboard, so the queue code can be
+//driven with synthetic items.  "Copying" to this clipboard costs
+//the same allocate-and-copy that CopyToClipboard pays on Windows.
+
+#include <string.h>
+#include "Bench.h"
+#include "BlobStore.h"
+#include "Hash.h"
+#include "ClipRender.h"
+#include "ClipCapture.h"
+#include "Thumbnail.h"
+
+#define MAX_PLACED_FORMATS  32
+#define THUMBNAIL_HEIGHT    100     //MENU_BMP_HEIGHT in Clipboard.c
+
+typedef struct
+{
+    UINT            format;
+    HANDLE          block;      //NULL until rendered
+}PlacedFormat;
+
+static ClipItem* bench_clipboard = NULL;
+
+static PlacedFormat placed[MAX_PLACED_FORMATS];    //delayed mode only
+static unsigned int placed_count = 0;
+
+static unsigned int PlaceOnClipboard(ClipItem* item, BOOL move);
+
+unsigned long bench_clipboard_reads = 0;
+unsigned long bench_clipboard_writes = 0;
+unsigned long bench_clipboard_moves = 0;    //formats handed over, not copied
+unsigned long bench_clipboard_renders = 0;  //formats rendered on request
+unsigned long bench_thumbnails_made = 0;
+unsigned long bench_thumbnails_released = 0;
+
+//When set, copies to the clipboard use delayed rendering, and stay
+//on it until ClearBenchClipboard
+BOOL bench_clipboard_delayed = FALSE;
+
+//When set, each capture is stamped with a serial number so that no
+//two captures are identical, like real copies of different things.
+BOOL bench_clipboard_unique = TRUE;
+
+
+/*******************************************************************
+** SetBenchClipboard
+** =================
+** Places an item on the fake clipboard.  The item is not copied,
+** so it must stay valid until the next call.
+**
+** Inputs:
+**      ClipItem* item      - item for PopulateClipItem to capture;
+**                            NULL empties the clipboard
+*******************************************************************/
+void SetBenchClipboard(ClipItem* item)
+{
+    bench_clipboard = item;
+}
+
+
+/*******************************************************************
+** FillSyntheticBytes
+** ==================
+** Fills a buffer with repeatable pseudo-random data.
+**
+** Inputs:
+**      void* memory        - buffer to fill
+**      size_t size         - size of the buffer in bytes
+**      unsigned int seed   - different seeds give different data
+*******************************************************************/
+void FillSyntheticBytes(void* memory, size_t size, unsigned int seed)
+{
+    BYTE* bytes = (BYTE*) memory;
+    unsigned int state = seed * 2654435761u + 1;
+    size_t i;
+
+    for(i = 0; i < size; ++i)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        bytes[i] = (BYTE) state;
+    }
+}
+
+
+/*******************************************************************
+** MakeSyntheticItem
+** =================
+** Builds a ClipItem with the given number of formats, each of the
+** given size.  The payloads are private blobs, not interned, so the
+** item doesn't count as a copy of anything.  Free it with
+** DestroyClipItem.
+**
+** Inputs:
+**      ClipItem* item          - item to populate
+**      unsigned int seed       - seed for the item's contents
+**      unsigned int formats    - number of formats
+**      size_t size             - size of each format in bytes
+**
+** Outputs:
+**      BOOL                    - TRUE on success
+*******************************************************************/
+BOOL MakeSyntheticItem(ClipItem* item, unsigned int seed,
+unsigned int formats, size_t size)
+{
+    static const UINT format_ids[] = {CF_UNICODETEXT, CF_TEXT, CF_DIB,
+        CF_HDROP, 0x0C001, 0x0C002, 0x0C003, 0x0C004};
+
+    unsigned int i;
+
+    item->formats = 0;
+    item->data = (ClipData*) AllocMemory(sizeof(ClipData) * formats);
+    item->preview = NULL;
+
+    if(item->data)
+    {
+        for(i = 0; i < formats; ++i)
+        {
+            item->data[i].memory = AllocBlob(size);
+
+            if(!item->data[i].memory)
+            {
+                DestroyClipItem(item);
+                return FALSE;
+            }
+
+            item->data[i].size = size;
+            item->data[i].format = format_ids[i % 8];
+            FillSyntheticBytes(LockBlob(item->data[i].memory),
+                size, seed * 8 + i);
+            UnlockBlob(item->data[i].memory);
+            item->data[i].hash = GetBlobHash(item->data[i].memory);
+            ++(item->formats);
+        }
+    }
+
+    return (item->data != NULL);
+}
+
+
+/*******************************************************************
+** PopulateClipItem
+** ================
+** Copies the fake clipboard into a ClipItem, allocating memory
+** the same way the Windows version does.
+**
+** Inputs:
+**      ClipItem* item      - structure to be populated
+**
+** Outputs:
+**      unsigned int        - number of formats copied
+*******************************************************************/
+unsigned int PopulateClipItem(ClipItem* item)
+{
+    ClipCapture capture;
+
+    item->formats = 0;
+    item->data = NULL;
+    item->preview = NULL;
+
+    if(bench_clipboard && (bench_clipboard->formats > 0)
+    && CreateCapture(&capture, bench_clipboard->formats, GetMicroTicks()))
+    {
+        unsigned int i;
+
+        for(i = 0; i < bench_clipboard->formats; ++i)
+        {
+            ClipData* source = &bench_clipboard->data[i];
+
+            if(AddCaptureData(&capture, source->format,
+                LockBlob(source->memory), source->size, GetMicroTicks())
+            && bench_clipboard_unique
+            && (source->size >= sizeof(bench_clipboard_reads)))
+            {
+                CaptureData* data = &capture.data[capture.formats - 1];
+
+                memcpy(data->bytes, &bench_clipboard_reads,
+                    sizeof(bench_clipboard_reads));
+                data->hash = HashBytes(data->bytes, data->size, 0);
+            }
+
+            UnlockBlob(source->memory);
+        }
+
+        AdoptCapture(&capture, item);
+
+        ++bench_clipboard_reads;
+    }
+
+    return item->formats;
+}
+
+
+/*******************************************************************
+** CopyToClipboard
+** ===============
+** Copies every format of a ClipItem to a scratch buffer and throws
+** it away again, standing in for GlobalAlloc and SetClipboardData.
+**
+** Inputs:
+**      ClipItem* item      - structure to be copied
+**
+** Outputs:
+**      unsigned int        - number of formats copied
+*******************************************************************/
+unsigned int CopyToClipboard(ClipItem* item)
+{
+    return PlaceOnClipboard(item, FALSE);
+}
+
+
+/*******************************************************************
+** MoveToClipboard
+** ===============
+** Like CopyToClipboard, but payloads that DetachBlob hands over are
+** freed rather than copied, as the clipboard would take them.
+**
+** Inputs:
+**      ClipItem* item      - structure to be moved
+**
+** Outputs:
+**      unsigned int        - number of formats placed
+*******************************************************************/
+unsigned int MoveToClipboard(ClipItem* item)
+{
+    return PlaceOnClipboard(item, TRUE);
+}
+
+
+/*******************************************************************
+** PlaceOnClipboard
+** ================
+** Does the work of CopyToClipboard and MoveToClipboard.
+*******************************************************************/
+unsigned int PlaceOnClipboard(ClipItem* item, BOOL move)
+{
+    unsigned int successes = 0;
+
+    if(bench_clipboard_delayed)
+    {
+        ClearBenchClipboard();
+        ++bench_clipboard_writes;
+
+        return AnnounceClipItem(item);
+    }
+
+    if(item && item->data)
+    {
+        unsigned int i;
+
+        for(i = 0; i < item->formats; ++i)
+        {
+            HANDLE block = ExportClipData(&item->data[i], move);
+
+            if(block)
+            {
+                //A payload handed over is taken out of the item
+                if(!item->data[i].memory)
+                {
+                    ++bench_clipboard_moves;
+                }
+
+                FreeMovable(block);
+                ++successes;
+            }
+        }
+
+        ++bench_clipboard_writes;
+    }
+
+    return successes;
+}
+
+
+/*******************************************************************
+** AnnounceClipFormat
+** ==================
+** Records a format offered for delayed rendering.
+*******************************************************************/
+BOOL AnnounceClipFormat(UINT format)
+{
+    if(placed_count >= MAX_PLACED_FORMATS)
+    {
+        return FALSE;
+    }
+
+    placed[placed_count].format = format;
+    placed[placed_count].block = NULL;
+    ++placed_count;
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** PlaceClipFormat
+** ===============
+** Takes the block for an announced format, as SetClipboardData
+** would while rendering.
+*******************************************************************/
+BOOL PlaceClipFormat(UINT format, HANDLE block)
+{
+    unsigned int i;
+
+    for(i = 0; i < placed_count; ++i)
+    {
+        if((placed[i].format == format) && !placed[i].block)
+        {
+            placed[i].block = block;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+
+/*******************************************************************
+** PasteBenchFormat
+** ================
+** Reads one format off the fake clipboard, the way a program
+** pasting would.  A format that was only announced is rendered
+** first, as Windows would ask for it with WM_RENDERFORMAT.
+**
+** Inputs:
+**      UINT format         - format to read
+**
+** Outputs:
+**      const void*         - the data, or NULL if the format isn't
+**                            on the clipboard or couldn't be
+**                            rendered
+*******************************************************************/
+const void* PasteBenchFormat(UINT format)
+{
+    unsigned int i;
+
+    for(i = 0; i < placed_count; ++i)
+    {
+        if(placed[i].format == format)
+        {
+            if(!placed[i].block && RenderClipFormat(format))
+            {
+                ++bench_clipboard_renders;
+            }
+
+            //Off Windows, a block's handle is its memory
+            return placed[i].block;
+        }
+    }
+
+    return NULL;
+}
+
+
+/*******************************************************************
+** CountPlacedFormats
+** ==================
+** Outputs:
+**      unsigned int        - formats on the fake clipboard
+**      unsigned int* rendered  - receives how many have data
+*******************************************************************/
+unsigned int CountPlacedFormats(unsigned int* rendered)
+{
+    unsigned int i;
+
+    *rendered = 0;
+
+    for(i = 0; i < placed_count; ++i)
+    {
+        if(placed[i].block)
+        {
+            ++(*rendered);
+        }
+    }
+
+    return placed_count;
+}
+
+
+/*******************************************************************
+** ClearBenchClipboard
+** ===================
+** Empties the fake clipboard's delayed formats, freeing the blocks
+** it was given, and tells the render code (as WM_DESTROYCLIPBOARD
+** would) that nothing more will be asked for.
+*******************************************************************/
+void ClearBenchClipboard()
+{
+    unsigned int i;
+
+    for(i = 0; i < placed_count; ++i)
+    {
+        FreeMovable(placed[i].block);
+    }
+
+    placed_count = 0;
+    DropRenderItem();
+}
+
+
+/*******************************************************************
+** CreateThumbnail
+** ===============
+** Stands in for the GDI thumbnail: the ThumbnailImage ScaleDib
+** makes, which Windows copies into a DIB section.
+**
+** Inputs:
+**      const void* dib     - the CF_DIB or CF_DIBV5
+**      size_t size         - its size
+**
+** Outputs:
+**      HANDLE              - the ThumbnailImage, or NULL if the DIB
+**                            isn't one ScaleDib handles
+*******************************************************************/
+HANDLE CreateThumbnail(const void* dib, size_t size)
+{
+    ThumbnailImage* image = (ThumbnailImage*)
+        AllocMemory(sizeof(ThumbnailImage));
+
+    if(!image || !ScaleDib(dib, size, THUMBNAIL_HEIGHT, image))
+    {
+        FreeMemory(image);
+        return NULL;
+    }
+
+    ++bench_thumbnails_made;
+
+    return (HANDLE) image;
+}
+
+
+/*******************************************************************
+** ReleaseThumbnail
+** ================
+** Frees a thumbnail from CreateThumbnail.
+**
+** Inputs:
+**      HANDLE thumbnail    - the thumbnail
+*******************************************************************/
+void ReleaseThumbnail(HANDLE thumbnail)
+{
+    if(thumbnail)
+    {
+        FreeThumbnailImage((ThumbnailImage*) thumbnail);
+        FreeMemory(thumbnail);
+    }
+
+    ++bench_thumbnails_released;
+}
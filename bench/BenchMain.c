@@ -0,0 +1,206 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "Bench.h"
+
+#define BENCH_FILE_LENGTH   512
+
+static const BenchSuite suites[] =
+{
+    {"queue",       RunQueueBench},
+    {"blob",        RunBlobBench},
+    {"dedupe",      RunDedupeBench},
+    {"compare",     RunCompareBench},
+    {"budget",      RunBudgetBench},
+    {"deque",       RunDequeBench},
+    {"spill",       RunSpillBench},
+    {"codec",       RunCodecBench},
+    {"render",      RunRenderBench},
+    {"capture",     RunCaptureBench},
+    {"replay",      RunReplayBench},
+    {"storm",       RunStormBench},
+    {"fetch",       RunFetchBench},
+    {"hung",        RunHungBench},
+    {"size",        RunSizeBench},
+    {"utf8",        RunTranscodeBench},
+    {"preview",     RunPreviewBench},
+    {"thumb",       RunThumbnailBench},
+    {"scale",       RunScaleBench},
+    {"startup",     RunStartupBench},
+    {"journal",     RunJournalBench},
+    {"write",       RunWriteBench},
+};
+
+#define NUM_SUITES  (sizeof(suites) / sizeof(BenchSuite))
+
+
+/*******************************************************************
+** GetBenchTime
+** ============
+** Returns a high resolution timestamp for measuring benchmarks.
+**
+** Outputs:
+**      double              - seconds since some fixed point
+*******************************************************************/
+double GetBenchTime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+/*******************************************************************
+** GetBenchThreadTime
+** ==================
+** Returns the processor time the calling thread has used, leaving
+** out whatever other threads get through, even on one core.
+**
+** Outputs:
+**      double              - seconds since the thread started
+*******************************************************************/
+double GetBenchThreadTime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+/*******************************************************************
+** ReportRate
+** ==========
+** Prints one line of benchmark results.
+**
+** Inputs:
+**      const char* label       - name of the measurement
+**      unsigned long operations- operations performed
+**      double bytes            - payload bytes processed (may be 0)
+**      double seconds          - elapsed time
+*******************************************************************/
+void ReportRate(const char* label, unsigned long operations,
+double bytes, double seconds)
+{
+    if(seconds <= 0)
+    {
+        seconds = 1e-9;
+    }
+
+    printf("  %-36s %10lu ops %12.0f ops/s", label, operations,
+        operations / seconds);
+
+    if(bytes > 0)
+    {
+        printf(" %10.1f MB/s", bytes / seconds / (1024.0 * 1024.0));
+    }
+
+    printf("\n");
+}
+
+
+/*******************************************************************
+** GetBenchFile
+** ============
+** Builds the path of a scratch file for a benchmark.  Files go in
+** $TMPDIR (or /tmp).  The returned buffer is reused by every call.
+**
+** Inputs:
+**      const char* name    - base name of the file
+**
+** Outputs:
+**      const char*         - full path to the file
+*******************************************************************/
+const char* GetBenchFile(const char* name)
+{
+    static char path[BENCH_FILE_LENGTH];
+    const char* directory = getenv("TMPDIR");
+
+    if(!directory || !*directory)
+    {
+        directory = "/tmp";
+    }
+
+    snprintf(path, BENCH_FILE_LENGTH, "%s/qclipbench-%s", directory, name);
+
+    return path;
+}
+
+
+/*******************************************************************
+** main
+** ====
+** Runs the suites named on the command line, or all of them.
+** Exits with 1 if any of their checks failed, or a suite is
+** unknown.
+*******************************************************************/
+int main(int argc, char** argv)
+{
+    unsigned int i, failures = 0;
+    int j;
+    int result = 0;
+
+    for(i = 0; i < NUM_SUITES; ++i)
+    {
+        BOOL selected = (argc < 2);
+
+        for(j = 1; j < argc; ++j)
+        {
+            selected = selected || (strcmp(argv[j], suites[i].name) == 0);
+        }
+
+        if(selected)
+        {
+            printf("[%s]\n", suites[i].name);
+            failures += suites[i].run();
+            printf("\n");
+        }
+    }
+
+    for(j = 1; j < argc; ++j)
+    {
+        BOOL known = FALSE;
+
+        for(i = 0; i < NUM_SUITES; ++i)
+        {
+            known = known || (strcmp(argv[j], suites[i].name) == 0);
+        }
+
+        if(!known)
+        {
+            fprintf(stderr, "unknown suite: %s\n", argv[j]);
+            result = 1;
+        }
+    }
+
+    if(failures > 0)
+    {
+        fprintf(stderr, "%u checks FAILED\n", failures);
+        result = 1;
+    }
+
+    return result;
+}
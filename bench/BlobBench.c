@@ -0,0 +1,175 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include <stdio.h>
+#include "Bench.h"
+#include "BlobStore.h"
+#include "ClipQueue.h"
+
+#define SCREENSHOT_SIZE     (4 * 1024 * 1024)
+#define SCREENSHOT_COPIES   10
+#define MIXED_PUSHES        4000
+#define MIXED_SIZE          (64 * 1024)
+#define MIXED_DISTINCT      500
+
+static void BenchRepeatedScreenshot();
+static void BenchMixedDuplicates(unsigned int distinct);
+static void ReportStore(const char* label);
+
+
+/*******************************************************************
+** RunBlobBench
+** ============
+** Measures how much the blob store saves when the same payloads
+** are copied more than once, and what it costs per push.
+**
+** Outputs:
+**      unsigned int        - how many checks failed; it makes
+**                            none
+*******************************************************************/
+unsigned int RunBlobBench()
+{
+    BenchRepeatedScreenshot();
+    BenchMixedDuplicates(MIXED_DISTINCT);
+    BenchMixedDuplicates(MIXED_PUSHES);
+
+    return 0;
+}
+
+
+/*******************************************************************
+** ReportStore
+** ===========
+** Prints the blob store's stored and logical sizes.
+*******************************************************************/
+void ReportStore(const char* label)
+{
+    BlobStoreStats stats;
+
+    GetBlobStoreStats(&stats);
+
+    printf("  %-36s %10u blobs %8.1f MB stored %8.1f MB logical\n",
+        label, stats.blobs, stats.bytes / (1024.0 * 1024.0),
+        stats.logical_bytes / (1024.0 * 1024.0));
+}
+
+
+/*******************************************************************
+** BenchRepeatedScreenshot
+** =======================
+** Copies the same 4 MB bitmap ten times, into both the queue and
+** a second queue standing in for the common items.
+*******************************************************************/
+void BenchRepeatedScreenshot()
+{
+    ClipItem screenshot;
+    ClipQueue cq, common;
+    unsigned int i;
+    double start;
+
+    queue_policy.dynamic_queue = TRUE;
+    bench_clipboard_unique = FALSE;
+
+    if(MakeSyntheticItem(&screenshot, 1, 1, SCREENSHOT_SIZE)
+    && CreateQueue(&cq, 16) && CreateQueue(&common, 16))
+    {
+        SetBenchClipboard(&screenshot);
+
+        start = GetBenchTime();
+
+        for(i = 0; i < SCREENSHOT_COPIES; ++i)
+        {
+            //PushBack, since the duplicate filter only looks at
+            //the last item and would otherwise skip the repeats
+            PushBack(&cq);
+            cq.last_time -= 1000;
+        }
+
+        PushFront(&common);
+
+        ReportRate("PushBack 4 MB, same item x10", SCREENSHOT_COPIES,
+            (double) SCREENSHOT_COPIES * SCREENSHOT_SIZE,
+            GetBenchTime() - start);
+        ReportStore("after 11 copies");
+
+        DestroyQueue(&cq);
+        DestroyQueue(&common);
+        SetBenchClipboard(NULL);
+        DestroyClipItem(&screenshot);
+    }
+
+    bench_clipboard_unique = TRUE;
+    queue_policy.dynamic_queue = FALSE;
+}
+
+
+/*******************************************************************
+** BenchMixedDuplicates
+** ====================
+** Pushes 64 KB items drawn from a set of the given size into a
+** dynamic queue.  The smaller the set, the higher the duplication
+** rate.
+*******************************************************************/
+void BenchMixedDuplicates(unsigned int distinct)
+{
+    ClipItem* items = (ClipItem*) AllocMemory(sizeof(ClipItem) * distinct);
+    ClipQueue cq;
+    unsigned int i;
+    char label[64];
+    double start;
+
+    queue_policy.dynamic_queue = TRUE;
+    bench_clipboard_unique = FALSE;
+
+    if(items && CreateQueue(&cq, 16))
+    {
+        for(i = 0; i < distinct; ++i)
+        {
+            MakeSyntheticItem(&items[i], i, 1, MIXED_SIZE);
+        }
+
+        start = GetBenchTime();
+
+        for(i = 0; i < MIXED_PUSHES; ++i)
+        {
+            SetBenchClipboard(&items[(i * 7919) % distinct]);
+            PushFront(&cq);
+        }
+
+        snprintf(label, sizeof(label), "PushFront 64 KB, %u distinct",
+            distinct);
+        ReportRate(label, MIXED_PUSHES, (double) MIXED_PUSHES * MIXED_SIZE,
+            GetBenchTime() - start);
+        ReportStore("queue + source items");
+
+        DestroyQueue(&cq);
+        SetBenchClipboard(NULL);
+
+        for(i = 0; i < distinct; ++i)
+        {
+            DestroyClipItem(&items[i]);
+        }
+    }
+
+    FreeMemory(items);
+    bench_clipboard_unique = TRUE;
+    queue_policy.dynamic_queue = FALSE;
+}
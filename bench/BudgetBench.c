@@ -0,0 +1,326 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include <stdio.h>
+#include "Bench.h"
+#include "BlobStore.h"
+#include "ClipQueue.h"
+
+#define RANDOM_OPERATIONS   50000
+#define POOL_ITEMS          64
+#define MIN_BUDGET          (256 * 1024)
+#define MAX_BUDGET          (16 * 1024 * 1024)
+
+static unsigned int random_state = 12345;
+
+static unsigned int NextRandom();
+static BOOL MakeMixedItem(ClipItem* item, unsigned int seed);
+static BOOL CheckBudget(ClipQueue* cq, unsigned long operation);
+static void CheckTextKept();
+
+
+//Checks that have failed
+static unsigned int failed_checks = 0;
+
+
+/*******************************************************************
+** RunBudgetBench
+** ==============
+** Runs a long random stream of queue operations against a byte
+** budget that keeps changing, checking after every operation that
+** the queue's byte count is exact and within budget.  Then checks
+** that eviction drops an old bitmap before any text.
+**
+** Outputs:
+**      unsigned int        - how many checks failed
+*******************************************************************/
+unsigned int RunBudgetBench()
+{
+    ClipItem pool[POOL_ITEMS];
+    ClipQueue cq;
+    unsigned long i;
+    unsigned long failures = 0;
+    double start;
+
+    queue_policy.byte_budget = MAX_BUDGET / 2;
+
+    for(i = 0; i < POOL_ITEMS; ++i)
+    {
+        if(!MakeMixedItem(&pool[i], (unsigned int) i))
+        {
+            printf("  out of memory\n");
+            return 1;
+        }
+    }
+
+    if(CreateQueue(&cq, 64))
+    {
+        start = GetBenchTime();
+
+        for(i = 0; (i < RANDOM_OPERATIONS) && (failures < 10); ++i)
+        {
+            unsigned int choice = NextRandom() % 100;
+
+            SetBenchClipboard(&pool[NextRandom() % POOL_ITEMS]);
+
+            if(choice < 40)
+            {
+                PushFront(&cq);
+            }
+            else if(choice < 55)
+            {
+                PushBack(&cq);
+            }
+            else if(choice < 65)
+            {
+                PopFront(&cq);
+            }
+            else if(choice < 75)
+            {
+                PopBack(&cq);
+            }
+            else if(choice < 82)
+            {
+                DiscardFront(&cq);
+            }
+            else if(choice < 89)
+            {
+                DiscardBack(&cq);
+            }
+            else if(choice < 93)
+            {
+                ResizeQueue(&cq, 1 + NextRandom() % 128);
+            }
+            else if(choice < 96)
+            {
+                queue_policy.byte_budget =
+                    MIN_BUDGET + NextRandom() % (MAX_BUDGET - MIN_BUDGET);
+                EnforceByteBudget(&cq);
+            }
+            else if(choice < 98)
+            {
+                queue_policy.dynamic_queue = !queue_policy.dynamic_queue;
+            }
+            else
+            {
+                queue_policy.move_duplicates = !queue_policy.move_duplicates;
+            }
+
+            failures += !CheckBudget(&cq, i);
+        }
+
+        ReportRate("random ops under budget", i, 0, GetBenchTime() - start);
+        printf("  %s\n", failures ? "budget check FAILED" : "budget held");
+        failed_checks += (failures > 0);
+
+        DestroyQueue(&cq);
+    }
+
+    SetBenchClipboard(NULL);
+
+    for(i = 0; i < POOL_ITEMS; ++i)
+    {
+        DestroyClipItem(&pool[i]);
+    }
+
+    queue_policy.byte_budget = 0;
+    queue_policy.dynamic_queue = FALSE;
+    queue_policy.move_duplicates = FALSE;
+
+    CheckTextKept();
+
+    return failed_checks;
+}
+
+
+/*******************************************************************
+** CheckBudget
+** ===========
+** Recounts the queue's payload bytes and compares them with its
+** byte counter and the budget.
+**
+** Outputs:
+**      BOOL                - TRUE if both hold
+*******************************************************************/
+BOOL CheckBudget(ClipQueue* cq, unsigned long operation)
+{
+    size_t bytes = 0;
+    unsigned int i;
+
+    for(i = 0; i < GetQueueLength(cq); ++i)
+    {
+        bytes += GetClipItemSize(GetItem(cq, i));
+    }
+
+    if(bytes != cq->bytes)
+    {
+        printf("  op %lu: counted %lu bytes, queue says %lu\n", operation,
+            (unsigned long) bytes, (unsigned long) cq->bytes);
+        return FALSE;
+    }
+
+    if(bytes > queue_policy.byte_budget)
+    {
+        printf("  op %lu: %lu bytes over a %lu byte budget\n", operation,
+            (unsigned long) bytes, (unsigned long) queue_policy.byte_budget);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** CheckTextKept
+** =============
+** Copies text-plus-bitmap items into a queue until it's over
+** budget, and checks that the oldest item lost its bitmap but kept
+** its text.
+*******************************************************************/
+void CheckTextKept()
+{
+    ClipItem items[4];
+    ClipQueue cq;
+    BOOL kept = FALSE;
+    unsigned int i;
+
+    for(i = 0; i < 4; ++i)
+    {
+        MakeSyntheticItem(&items[i], 1000 + i, 3, 1024 * 1024);
+    }
+
+    //Four 3 MB items in an 11 MB budget, so one bitmap has to go
+    queue_policy.byte_budget = 11 * 1024 * 1024;
+
+    if(CreateQueue(&cq, 8))
+    {
+        for(i = 0; i < 4; ++i)
+        {
+            SetBenchClipboard(&items[i]);
+            PushFront(&cq);
+        }
+
+        kept = (GetQueueLength(&cq) == 4)
+            && (GetItem(&cq, 3)->formats == 2)
+            && IsTextFormat(GetItem(&cq, 3)->data[0].format)
+            && IsTextFormat(GetItem(&cq, 3)->data[1].format)
+            && (GetItem(&cq, 2)->formats == 3);
+
+        DestroyQueue(&cq);
+    }
+
+    printf("  %s\n", kept ? "oldest bitmap dropped, text kept"
+        : "eviction order check FAILED");
+    failed_checks += !kept;
+
+    SetBenchClipboard(NULL);
+
+    for(i = 0; i < 4; ++i)
+    {
+        DestroyClipItem(&items[i]);
+    }
+
+    queue_policy.byte_budget = 0;
+}
+
+
+/*******************************************************************
+** MakeMixedItem
+** =============
+** Builds an item shaped like a typical copy: some text, often with
+** a bitmap or a large private format alongside it, and sometimes a
+** bitmap alone.
+**
+** Inputs:
+**      ClipItem* item      - item to populate
+**      unsigned int seed   - seed for the item's contents
+**
+** Outputs:
+**      BOOL                - TRUE on success
+*******************************************************************/
+BOOL MakeMixedItem(ClipItem* item, unsigned int seed)
+{
+    UINT formats[3];
+    size_t sizes[3];
+    unsigned int count = 0;
+    unsigned int shape = NextRandom() % 4;
+    unsigned int i;
+
+    if(shape != 3)
+    {
+        formats[count] = CF_UNICODETEXT;
+        sizes[count++] = 64 + NextRandom() % (16 * 1024);
+    }
+
+    if(shape >= 1)
+    {
+        formats[count] = CF_DIB;
+        sizes[count++] = 16 * 1024 + NextRandom() % (1024 * 1024);
+    }
+
+    if(shape == 2)
+    {
+        formats[count] = 0x0C001;
+        sizes[count++] = 1024 + NextRandom() % (256 * 1024);
+    }
+
+    item->formats = 0;
+    item->preview = NULL;
+    item->data = (ClipData*) AllocMemory(sizeof(ClipData) * count);
+
+    if(item->data)
+    {
+        for(i = 0; i < count; ++i)
+        {
+            item->data[i].memory = AllocBlob(sizes[i]);
+
+            if(!item->data[i].memory)
+            {
+                DestroyClipItem(item);
+                return FALSE;
+            }
+
+            FillSyntheticBytes(LockBlob(item->data[i].memory),
+                sizes[i], seed * 4 + i);
+            UnlockBlob(item->data[i].memory);
+            item->data[i].size = sizes[i];
+            item->data[i].format = formats[i];
+            item->data[i].hash = GetBlobHash(item->data[i].memory);
+            ++(item->formats);
+        }
+    }
+
+    return (item->data != NULL);
+}
+
+
+/*******************************************************************
+** NextRandom
+** ==========
+** A small, repeatable pseudo-random number generator.
+*******************************************************************/
+unsigned int NextRandom()
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+
+    return random_state;
+}
@@ -0,0 +1,348 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include <stdio.h>
+#include <string.h>
+#include "Bench.h"
+#include "BlobStore.h"
+#include "ClipQueue.h"
+#include "ClipCapture.h"
+
+#define NUM_FORMATS         4
+#define CAPTURE_COUNT       256
+#define QUEUE_SIZE          16
+
+//What the producer thread works from.  It only ever touches these
+//buffers and the ring, never the blob store, just like the capture
+//thread on Windows.
+typedef struct
+{
+    CaptureRing*            ring;
+    BYTE*                   source;     //NUM_FORMATS * size bytes
+    size_t                  size;       //bytes per format
+    BOOL                    wait;       //FALSE to drop when full
+    volatile unsigned int   done;
+}Producer;
+
+static void BenchCapture(size_t size);
+static double BenchSynchronous(size_t size);
+static void BenchRing(size_t size, BOOL wait, double sync_seconds);
+static void ProduceCaptures(void* arg);
+static unsigned int GetSerial(ClipItem* item);
+static void ReportLatency(const char* label, uint64_t total,
+    unsigned int max, unsigned long count);
+
+
+//Checks that have failed
+static unsigned int failed_checks = 0;
+
+
+/*******************************************************************
+** RunCaptureBench
+** ===============
+** Compares the time the UI thread spends on each clipboard change
+** when it copies the clipboard itself, and when a capture thread
+** does the copying and the UI thread only adopts the result.  Then
+** floods the capture ring to check nothing is lost or reordered
+** other than the captures it reports as dropped.
+**
+** Outputs:
+**      unsigned int        - how many checks failed
+*******************************************************************/
+unsigned int RunCaptureBench()
+{
+    BenchCapture(4 * 1024);
+    BenchCapture(256 * 1024);
+
+    return failed_checks;
+}
+
+
+/*******************************************************************
+** BenchCapture
+** ============
+** Runs the synchronous and threaded captures for one item size.
+**
+** Inputs:
+**      size_t size         - bytes per format
+*******************************************************************/
+void BenchCapture(size_t size)
+{
+    double sync_seconds = BenchSynchronous(size);
+
+    BenchRing(size, TRUE, sync_seconds);
+    BenchRing(size, FALSE, sync_seconds);
+}
+
+
+/*******************************************************************
+** BenchSynchronous
+** ================
+** Times PushFront, which copies the clipboard on the calling
+** thread, the way QClip did everything before the capture thread.
+**
+** Inputs:
+**      size_t size         - bytes per format
+**
+** Outputs:
+**      double              - seconds the whole run took
+*******************************************************************/
+double BenchSynchronous(size_t size)
+{
+    ClipItem item;
+    ClipQueue cq;
+    char label[64];
+    double seconds = 0;
+    unsigned int i;
+
+    if(MakeSyntheticItem(&item, 1, NUM_FORMATS, size)
+    && CreateQueue(&cq, QUEUE_SIZE))
+    {
+        SetBenchClipboard(&item);
+        seconds = GetBenchTime();
+
+        for(i = 0; i < CAPTURE_COUNT; ++i)
+        {
+            PushFront(&cq);
+        }
+
+        seconds = GetBenchTime() - seconds;
+
+        snprintf(label, sizeof(label), "UI thread, %u x %lu KB, copying",
+            NUM_FORMATS, (unsigned long) size / 1024);
+        ReportRate(label, CAPTURE_COUNT,
+            (double) CAPTURE_COUNT * NUM_FORMATS * size, seconds);
+
+        SetBenchClipboard(NULL);
+        DestroyQueue(&cq);
+        DestroyClipItem(&item);
+    }
+
+    return seconds;
+}
+
+
+/*******************************************************************
+** BenchRing
+** =========
+** Runs a producer thread making CAPTURE_COUNT numbered captures
+** while this thread takes them out of the ring and pushes them
+** onto a queue.  Only the time spent taking and pushing counts as
+** UI thread time.
+**
+** Inputs:
+**      size_t size             - bytes per format
+**      BOOL wait               - TRUE for the producer to wait for
+**                                room; FALSE to drop captures
+**      double sync_seconds     - time BenchSynchronous took
+*******************************************************************/
+void BenchRing(size_t size, BOOL wait, double sync_seconds)
+{
+    CaptureRing ring;
+    Producer producer;
+    ClipQueue cq;
+    ClipItem item;
+    HANDLE thread;
+    unsigned int serial, last = 0;
+    unsigned long taken = 0;
+    BOOL ordered = TRUE;
+    double ui_seconds = 0, start, now;
+    char label[64];
+
+    InitCaptureRing(&ring);
+    producer.ring = &ring;
+    producer.size = size;
+    producer.wait = wait;
+    producer.done = FALSE;
+    producer.source = (BYTE*) AllocMemory(NUM_FORMATS * size);
+
+    if(!producer.source || !CreateQueue(&cq, QUEUE_SIZE))
+    {
+        FreeMemory(producer.source);
+        return;
+    }
+
+    FillSyntheticBytes(producer.source, NUM_FORMATS * size, 2);
+    thread = StartThread(ProduceCaptures, &producer);
+
+    if(!thread)
+    {
+        printf("  StartThread FAILED\n");
+        ++failed_checks;
+        DestroyQueue(&cq);
+        FreeMemory(producer.source);
+        return;
+    }
+
+    //Stops once the producer is finished and the ring is empty
+    for(;;)
+    {
+        BOOL done = LoadAcquire(&producer.done);
+
+        start = GetBenchTime();
+
+        if(TakeCaptureItem(&ring, &item, NULL))
+        {
+            serial = GetSerial(&item);
+            ordered = ordered && (serial > last);
+            last = serial;
+            ++taken;
+
+            PushItemFront(&cq, &item);
+
+            now = GetBenchTime();
+            ui_seconds += now - start;
+        }
+        else if(done)
+        {
+            break;
+        }
+        else
+        {
+            YieldThread();
+        }
+    }
+
+    JoinThread(thread);
+
+    snprintf(label, sizeof(label), "UI thread, %u x %lu KB, %s",
+        NUM_FORMATS, (unsigned long) size / 1024,
+        wait ? "adopting" : "flooded");
+    ReportRate(label, taken, (double) taken * NUM_FORMATS * size,
+        ui_seconds);
+
+    if(wait)
+    {
+        printf("  %-36s %10.1f x less UI thread time\n", "",
+            sync_seconds / (ui_seconds > 0 ? ui_seconds : 1e-9)
+            * taken / CAPTURE_COUNT);
+    }
+
+    ReportLatency("  snapshot latency", ring.stats.snapshot_total,
+        ring.stats.snapshot_max, ring.stats.captures);
+    ReportLatency("  handoff latency", ring.stats.handoff_total,
+        ring.stats.handoff_max, ring.stats.captures);
+
+    if(!ordered)
+    {
+        printf("  capture order FAILED\n");
+        ++failed_checks;
+    }
+
+    if((taken + ring.dropped != CAPTURE_COUNT)
+    || (wait && (ring.dropped != 0)))
+    {
+        printf("  %lu taken + %u dropped of %u FAILED\n",
+            taken, ring.dropped, CAPTURE_COUNT);
+        ++failed_checks;
+    }
+
+    DestroyQueue(&cq);
+    FreeMemory(producer.source);
+}
+
+
+/*******************************************************************
+** ProduceCaptures
+** ===============
+** Producer thread: makes CAPTURE_COUNT captures, each format
+** stamped with its serial number so the consumer can check the
+** order, and puts them in the ring.
+**
+** Inputs:
+**      void* arg           - the Producer
+*******************************************************************/
+void ProduceCaptures(void* arg)
+{
+    Producer* producer = (Producer*) arg;
+    CaptureRing* ring = producer->ring;
+    ClipCapture capture;
+    unsigned int serial, i;
+    BYTE* source;
+
+    for(serial = 1; serial <= CAPTURE_COUNT; ++serial)
+    {
+        if(!CreateCapture(&capture, NUM_FORMATS, GetMicroTicks()))
+        {
+            continue;
+        }
+
+        for(i = 0; i < NUM_FORMATS; ++i)
+        {
+            source = producer->source + i * producer->size;
+            memcpy(source, &serial, sizeof(serial));
+            AddCaptureData(&capture, 0x0C001 + i, source, producer->size,
+                GetMicroTicks());
+        }
+
+        //A waiting producer gives the consumer time to make room
+        while(producer->wait && (ring->head - LoadAcquire(&ring->tail)
+            >= CAPTURE_RING_SIZE))
+        {
+            YieldThread();
+        }
+
+        if(!PutCapture(ring, &capture))
+        {
+            DestroyCapture(&capture);
+        }
+    }
+
+    StoreRelease(&producer->done, TRUE);
+}
+
+
+/*******************************************************************
+** GetSerial
+** =========
+** Reads back the serial number ProduceCaptures stamped on an item.
+*******************************************************************/
+unsigned int GetSerial(ClipItem* item)
+{
+    unsigned int serial = 0;
+
+    if(item->formats > 0)
+    {
+        memcpy(&serial, LockBlob(item->data[0].memory), sizeof(serial));
+        UnlockBlob(item->data[0].memory);
+    }
+
+    return serial;
+}
+
+
+/*******************************************************************
+** ReportLatency
+** =============
+** Prints the average and worst of a set of latencies.
+**
+** Inputs:
+**      const char* label       - name of the measurement
+**      uint64_t total          - sum of the latencies, in us
+**      unsigned int max        - the worst of them
+**      unsigned long count     - how many there were
+*******************************************************************/
+void ReportLatency(const char* label, uint64_t total,
+    unsigned int max, unsigned long count)
+{
+    printf("  %-36s %10.1f us avg %10u us max\n", label,
+        count ? (double) total / count : 0.0, max);
+}
@@ -0,0 +1,480 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include <stdio.h>
+#include <string.h>
+#include "Bench.h"
+#include "BlobStore.h"
+#include "ClipQueue.h"
+#include "Compress.h"
+
+#define NUM_KINDS           3
+#define KIND_TEXT           0
+#define KIND_DIB            1
+#define KIND_RANDOM         2
+
+#define CODEC_SIZE          (1024 * 1024)
+#define CODEC_MIN_TIME      0.25    //seconds per measurement
+
+#define POOL_SIZE           32
+#define TEXT_SIZE           (8 * 1024)
+#define DIB_WIDTH           512
+#define DIB_HEIGHT          512
+#define DIB_HEADER_SIZE     40
+#define BITMAP_SIZE         (DIB_HEADER_SIZE + DIB_WIDTH * DIB_HEIGHT * 4)
+#define COLD_POSITION       4
+#define PEEK_PASSES         4
+
+static const char* kind_names[NUM_KINDS] = {"text", "DIB", "random"};
+
+static void BenchCodec(unsigned int kind);
+static BOOL CheckDamage(const BYTE* packed, size_t packed_size);
+static void FillKindBytes(BYTE* bytes, unsigned int kind, size_t size,
+    unsigned int seed);
+static BOOL CreatePool(ClipItem* pool);
+static void DestroyPool(ClipItem* pool);
+static void RunWorkload(ClipItem* pool, BOOL compress);
+
+
+//Checks that have failed
+static unsigned int failed_checks = 0;
+
+
+/*******************************************************************
+** RunCodecBench
+** =============
+** Measures the codec on its own, on text, a screenshot-like bitmap
+** and incompressible data, then fills a queue with and without
+** compressing cold items to compare memory use and access rates.
+**
+** Outputs:
+**      unsigned int        - how many checks failed
+*******************************************************************/
+unsigned int RunCodecBench()
+{
+    ClipItem pool[POOL_SIZE];
+    unsigned int kind;
+
+    for(kind = 0; kind < NUM_KINDS; ++kind)
+    {
+        BenchCodec(kind);
+    }
+
+    if(CreatePool(pool))
+    {
+        RunWorkload(pool, FALSE);
+        RunWorkload(pool, TRUE);
+        DestroyPool(pool);
+    }
+
+    return failed_checks;
+}
+
+
+/*******************************************************************
+** BenchCodec
+** ==========
+** Packs and unpacks a megabyte of one kind of data for a while,
+** reporting both rates and the ratio, and checks the round trip.
+*******************************************************************/
+void BenchCodec(unsigned int kind)
+{
+    BYTE* source = (BYTE*) AllocMemory(CODEC_SIZE);
+    BYTE* packed = (BYTE*) AllocMemory(CODEC_SIZE);
+    BYTE* unpacked = (BYTE*) AllocMemory(CODEC_SIZE);
+    size_t packed_size = 0;
+    unsigned long runs;
+    char label[64];
+    double start, elapsed;
+
+    if(!source || !packed || !unpacked)
+    {
+        printf("  %s: out of memory\n", kind_names[kind]);
+        FreeMemory(source);
+        FreeMemory(packed);
+        FreeMemory(unpacked);
+        return;
+    }
+
+    FillKindBytes(source, kind, CODEC_SIZE, kind);
+    start = GetBenchTime();
+
+    for(runs = 0, elapsed = 0; elapsed < CODEC_MIN_TIME; ++runs)
+    {
+        packed_size = CompressBytes(source, CODEC_SIZE, packed, CODEC_SIZE);
+        elapsed = GetBenchTime() - start;
+    }
+
+    snprintf(label, sizeof(label), "compress 1 MB %s", kind_names[kind]);
+    ReportRate(label, runs, (double) runs * CODEC_SIZE, elapsed);
+
+    if(packed_size == 0)
+    {
+        printf("  %-36s didn't fit, left as is\n", "");
+    }
+    else
+    {
+        printf("  %-36s %10.1f%% of original\n", "",
+            100.0 * packed_size / CODEC_SIZE);
+
+        start = GetBenchTime();
+
+        for(runs = 0, elapsed = 0; elapsed < CODEC_MIN_TIME; ++runs)
+        {
+            DecompressBytes(packed, packed_size, unpacked, CODEC_SIZE);
+            elapsed = GetBenchTime() - start;
+        }
+
+        snprintf(label, sizeof(label), "decompress 1 MB %s",
+            kind_names[kind]);
+        ReportRate(label, runs, (double) runs * CODEC_SIZE, elapsed);
+
+        if(!DecompressBytes(packed, packed_size, unpacked, CODEC_SIZE)
+        || (memcmp(source, unpacked, CODEC_SIZE) != 0))
+        {
+            printf("  round trip FAILED\n");
+            ++failed_checks;
+        }
+
+        if(!CheckDamage(packed, packed_size))
+        {
+            printf("  damaged input FAILED\n");
+            ++failed_checks;
+        }
+    }
+
+    FreeMemory(source);
+    FreeMemory(packed);
+    FreeMemory(unpacked);
+}
+
+
+/*******************************************************************
+** CheckDamage
+** ===========
+** Feeds the decoder truncated and corrupted input.  It must refuse
+** the truncated input, and must never write past its buffer (which
+** a sanitizer build will catch).
+**
+** Outputs:
+**      BOOL                - TRUE if the damage was handled
+*******************************************************************/
+BOOL CheckDamage(const BYTE* packed, size_t packed_size)
+{
+    BYTE* copy = (BYTE*) AllocMemory(packed_size);
+    BYTE* unpacked = (BYTE*) AllocMemory(CODEC_SIZE);
+    BOOL handled = TRUE;
+    size_t i;
+
+    if(copy && unpacked)
+    {
+        handled = !DecompressBytes(packed, packed_size / 2,
+            unpacked, CODEC_SIZE);
+
+        for(i = 0; i < packed_size; i += packed_size / 64 + 1)
+        {
+            memcpy(copy, packed, packed_size);
+            copy[i] ^= 0x5A;
+            DecompressBytes(copy, packed_size, unpacked, CODEC_SIZE);
+        }
+    }
+
+    FreeMemory(copy);
+    FreeMemory(unpacked);
+
+    return handled;
+}
+
+
+/*******************************************************************
+** FillKindBytes
+** =============
+** Fills a buffer with data shaped like the given kind: UTF-16 prose
+** drawn from a small vocabulary, a 32-bit bitmap that looks like a
+** screenshot (flat panels, text-like speckle, a shaded band), or
+** pseudo-random bytes.
+*******************************************************************/
+void FillKindBytes(BYTE* bytes, unsigned int kind, size_t size,
+    unsigned int seed)
+{
+    static const char* words[] = {"the", "queue", "keeps", "every",
+        "item", "you", "copy", "so", "that", "it", "can", "be", "pasted",
+        "again", "later", "from", "a", "popup", "menu", "or", "with",
+        "hot", "keys", "bitmaps", "text", "and", "files", "are", "all",
+        "stored", "in", "memory", "until", "they", "leave"};
+
+    unsigned int state = seed * 2654435761u + 1;
+    size_t i = 0;
+
+    if(kind == KIND_TEXT)
+    {
+        while(i + 1 < size)
+        {
+            const char* word;
+
+            state = state * 1103515245u + 12345;
+            word = words[(state >> 16) % (sizeof(words) / sizeof(words[0]))];
+
+            for(; *word && (i + 1 < size); ++word, i += 2)
+            {
+                bytes[i] = (BYTE) *word;
+                bytes[i + 1] = 0;
+            }
+
+            if(i + 1 < size)
+            {
+                bytes[i] = ((state >> 8) % 12 == 0) ? '\n' : ' ';
+                bytes[i + 1] = 0;
+                i += 2;
+            }
+        }
+    }
+    else if(kind == KIND_DIB)
+    {
+        memset(bytes, 0, (size < DIB_HEADER_SIZE) ? size : DIB_HEADER_SIZE);
+
+        for(i = DIB_HEADER_SIZE; i + 4 <= size; i += 4)
+        {
+            size_t pixel = (i - DIB_HEADER_SIZE) / 4;
+            size_t x = pixel % DIB_WIDTH;
+            size_t y = pixel / DIB_WIDTH;
+            unsigned int colour;
+
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+
+            if(y < 24)
+            {
+                colour = 0x2B579A;          //title bar
+            }
+            else if((y % 16 < 10) && (x > 16) && (x < 400)
+            && ((state & 3) == 0))
+            {
+                colour = 0x202020;          //lines of "text"
+            }
+            else if(y > DIB_HEIGHT - 96)
+            {
+                //a shaded picture, with a little noise
+                colour = (unsigned int) ((x + seed) & 0xFF)
+                    | (unsigned int) ((y & 0xFF) << 8)
+                    | ((state >> 24) & 0x07) << 16;
+            }
+            else
+            {
+                colour = 0xF0F0F0;          //window background
+            }
+
+            bytes[i] = (BYTE) colour;
+            bytes[i + 1] = (BYTE) (colour >> 8);
+            bytes[i + 2] = (BYTE) (colour >> 16);
+            bytes[i + 3] = 0;
+        }
+    }
+    else
+    {
+        FillSyntheticBytes(bytes, size, seed);
+    }
+}
+
+
+/*******************************************************************
+** CreatePool
+** ==========
+** Makes POOL_SIZE distinct items, each some text and a bitmap.
+*******************************************************************/
+BOOL CreatePool(ClipItem* pool)
+{
+    static const UINT formats[2] = {CF_UNICODETEXT, CF_DIB};
+    static const unsigned int kinds[2] = {KIND_TEXT, KIND_DIB};
+    static const size_t sizes[2] = {TEXT_SIZE, BITMAP_SIZE};
+
+    unsigned int i, j;
+    BOOL success = TRUE;
+
+    for(i = 0; (i < POOL_SIZE) && success; ++i)
+    {
+        pool[i].formats = 0;
+        pool[i].preview = NULL;
+        pool[i].data = (ClipData*) AllocMemory(sizeof(ClipData) * 2);
+        success = (pool[i].data != NULL);
+
+        for(j = 0; (j < 2) && success; ++j)
+        {
+            pool[i].data[j].memory = AllocBlob(sizes[j]);
+            success = (pool[i].data[j].memory != NULL);
+
+            if(success)
+            {
+                FillKindBytes(LockBlob(pool[i].data[j].memory),
+                    kinds[j], sizes[j], i + 1);
+                UnlockBlob(pool[i].data[j].memory);
+
+                pool[i].data[j].size = sizes[j];
+                pool[i].data[j].format = formats[j];
+                pool[i].data[j].hash = GetBlobHash(pool[i].data[j].memory);
+                ++(pool[i].formats);
+            }
+        }
+    }
+
+    if(!success)
+    {
+        while(i > 0)
+        {
+            DestroyClipItem(&pool[--i]);
+        }
+    }
+
+    return success;
+}
+
+
+/*******************************************************************
+** DestroyPool
+** ===========
+** Frees the items made by CreatePool.
+*******************************************************************/
+void DestroyPool(ClipItem* pool)
+{
+    unsigned int i;
+
+    SetBenchClipboard(NULL);
+
+    for(i = 0; i < POOL_SIZE; ++i)
+    {
+        DestroyClipItem(&pool[i]);
+    }
+}
+
+
+/*******************************************************************
+** RunWorkload
+** ===========
+** Pushes the whole pool, reports how much memory the queue's
+** payloads take, then peeks at the hot items and the cold ones and
+** checks the contents survived.
+**
+** Inputs:
+**      ClipItem* pool      - items from CreatePool
+**      BOOL compress       - TRUE to compress items past
+**                            COLD_POSITION
+*******************************************************************/
+void RunWorkload(ClipItem* pool, BOOL compress)
+{
+    const char* mode = compress ? "compressed" : "plain";
+    ClipQueue cq;
+    BlobStoreStats before, after;
+    unsigned long moves;
+    unsigned int i, pass;
+    char label[64];
+    double start;
+
+    queue_policy.dynamic_queue = TRUE;
+    queue_policy.cold_position = compress ? COLD_POSITION : 0;
+    bench_clipboard_unique = FALSE;
+
+    if(CreateQueue(&cq, 16))
+    {
+        GetBlobStoreStats(&before);
+        start = GetBenchTime();
+
+        for(i = 0; i < POOL_SIZE; ++i)
+        {
+            SetBenchClipboard(&pool[i]);
+            PushFront(&cq);
+        }
+
+        snprintf(label, sizeof(label), "PushFront text + DIB, %s", mode);
+        ReportRate(label, POOL_SIZE,
+            (double) POOL_SIZE * (TEXT_SIZE + BITMAP_SIZE),
+            GetBenchTime() - start);
+
+        GetBlobStoreStats(&after);
+        printf("  %-36s %8.1f MB resident for %.1f MB of items\n", "",
+            (after.bytes - after.packed_bytes + after.packed_size
+            - before.bytes) / (1024.0 * 1024.0),
+            (after.bytes - before.bytes) / (1024.0 * 1024.0));
+
+        start = GetBenchTime();
+
+        for(pass = 0; pass < PEEK_PASSES; ++pass)
+        {
+            for(i = 0; i < COLD_POSITION; ++i)
+            {
+                PeekAt(&cq, i);
+            }
+        }
+
+        snprintf(label, sizeof(label), "PeekAt hot items, %s", mode);
+        ReportRate(label, PEEK_PASSES * COLD_POSITION,
+            (double) PEEK_PASSES * COLD_POSITION * (TEXT_SIZE + BITMAP_SIZE),
+            GetBenchTime() - start);
+
+        start = GetBenchTime();
+
+        for(pass = 0; pass < PEEK_PASSES; ++pass)
+        {
+            for(i = COLD_POSITION; i < GetQueueLength(&cq); ++i)
+            {
+                PeekAt(&cq, i);
+            }
+        }
+
+        snprintf(label, sizeof(label), "PeekAt cold items, %s", mode);
+        ReportRate(label, PEEK_PASSES * (POOL_SIZE - COLD_POSITION),
+            (double) PEEK_PASSES * (POOL_SIZE - COLD_POSITION)
+            * (TEXT_SIZE + BITMAP_SIZE), GetBenchTime() - start);
+
+        for(i = 0; i < GetQueueLength(&cq); ++i)
+        {
+            if(!CompareClipItems(GetItem(&cq, i), &pool[POOL_SIZE - 1 - i]))
+            {
+                printf("  contents of item %u FAILED\n", i);
+                ++failed_checks;
+            }
+        }
+
+        //A packed payload is unpacked straight into the block that
+        //goes to the clipboard
+        moves = bench_clipboard_moves;
+
+        if((PopBack(&cq) != 2) || (bench_clipboard_moves - moves != 2))
+        {
+            printf("  popping a cold item FAILED\n");
+            ++failed_checks;
+        }
+
+        DestroyQueue(&cq);
+
+        GetBlobStoreStats(&after);
+
+        if(after.packed_bytes != before.packed_bytes)
+        {
+            printf("  freeing packed items FAILED\n");
+            ++failed_checks;
+        }
+    }
+
+    bench_clipboard_unique = TRUE;
+    queue_policy.cold_position = 0;
+    queue_policy.dynamic_queue = FALSE;
+}
@@ -0,0 +1,340 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "Bench.h"
+#include "BlobStore.h"
+#include "Hash.h"
+
+#define KIND_TEXT           0
+#define KIND_DIB            1
+#define KIND_HDROP          2
+#define NUM_KINDS           3
+
+#define DIB_HEADER_SIZE     40
+#define DROPFILES_SIZE      20
+
+#define BYTES_PER_TEST      (256.0 * 1024 * 1024)
+#define MAX_OPERATIONS      100000
+
+static const char* kind_names[NUM_KINDS] = {"text", "DIB", "HDROP"};
+static const UINT kind_formats[NUM_KINDS] = {CF_UNICODETEXT, CF_DIB, CF_HDROP};
+
+//Called through a pointer so the compiler can't hoist the loop
+static int (*volatile compare_bytes)(const void*, const void*, size_t)
+    = memcmp;
+
+static const size_t item_sizes[] = {1024, 64 * 1024, 1024 * 1024,
+    16 * 1024 * 1024, 64 * 1024 * 1024};
+
+#define NUM_ITEM_SIZES      (sizeof(item_sizes) / sizeof(size_t))
+
+static void BenchKind(unsigned int kind, size_t size);
+static BOOL MakeKindItem(ClipItem* item, unsigned int kind, size_t size);
+static BOOL CopyKindItem(ClipItem* copy, ClipItem* item, BOOL change_last);
+static void FillKindBytes(BYTE* bytes, unsigned int kind, size_t size);
+
+
+/*******************************************************************
+** RunCompareBench
+** ===============
+** Measures CompareClipItems on text, DIB and HDROP items from 1 KB
+** to 64 MB: the fingerprint computed on capture, rejecting an item
+** that only differs in its last byte (which a plain memcmp has to
+** read all the way through to find), and confirming a match.
+**
+** Outputs:
+**      unsigned int        - how many checks failed; it makes
+**                            none
+*******************************************************************/
+unsigned int RunCompareBench()
+{
+    unsigned int kind;
+    unsigned int i;
+
+    for(kind = 0; kind < NUM_KINDS; ++kind)
+    {
+        for(i = 0; i < NUM_ITEM_SIZES; ++i)
+        {
+            BenchKind(kind, item_sizes[i]);
+        }
+    }
+
+    return 0;
+}
+
+
+/*******************************************************************
+** BenchKind
+** =========
+** Runs the comparisons for one kind and size of item.
+*******************************************************************/
+void BenchKind(unsigned int kind, size_t size)
+{
+    ClipItem item, changed, same;
+    BYTE* item_bytes;
+    BYTE* changed_bytes;
+    unsigned long operations = (unsigned long) (BYTES_PER_TEST / size);
+    unsigned long i;
+    long matches = 0;
+    uint64_t hash = 0;
+    char label[64];
+    double start;
+
+    if(operations < 4)
+    {
+        operations = 4;
+    }
+    else if(operations > MAX_OPERATIONS)
+    {
+        operations = MAX_OPERATIONS;
+    }
+
+    if(!MakeKindItem(&item, kind, size))
+    {
+        return;
+    }
+
+    if(CopyKindItem(&changed, &item, TRUE))
+    {
+        if(CopyKindItem(&same, &item, FALSE))
+        {
+            item_bytes = (BYTE*) LockBlob(item.data[0].memory);
+            changed_bytes = (BYTE*) LockBlob(changed.data[0].memory);
+
+            start = GetBenchTime();
+
+            for(i = 0; i < operations; ++i)
+            {
+                hash ^= HashBytes(item_bytes, size, i);
+            }
+
+            snprintf(label, sizeof(label), "%s %lu KB fingerprint",
+                kind_names[kind], (unsigned long) (size / 1024));
+            ReportRate(label, operations, (double) operations * size,
+                GetBenchTime() - start);
+
+            start = GetBenchTime();
+
+            for(i = 0; i < operations; ++i)
+            {
+                matches += (compare_bytes(item_bytes,
+                    changed_bytes, size) == 0);
+            }
+
+            UnlockBlob(item.data[0].memory);
+            UnlockBlob(changed.data[0].memory);
+
+            snprintf(label, sizeof(label), "%s %lu KB reject, memcmp",
+                kind_names[kind], (unsigned long) (size / 1024));
+            ReportRate(label, operations, (double) operations * size,
+                GetBenchTime() - start);
+
+            start = GetBenchTime();
+
+            for(i = 0; i < operations; ++i)
+            {
+                matches += CompareClipItems(&item, &changed);
+            }
+
+            snprintf(label, sizeof(label), "%s %lu KB reject, compare",
+                kind_names[kind], (unsigned long) (size / 1024));
+            ReportRate(label, operations, (double) operations * size,
+                GetBenchTime() - start);
+
+            start = GetBenchTime();
+
+            for(i = 0; i < operations; ++i)
+            {
+                matches -= CompareClipItems(&item, &same);
+            }
+
+            snprintf(label, sizeof(label), "%s %lu KB match, compare",
+                kind_names[kind], (unsigned long) (size / 1024));
+            ReportRate(label, operations, (double) operations * size,
+                GetBenchTime() - start);
+
+            if(matches + (long) operations != 0)
+            {
+                printf("  compare results are wrong!\n");
+            }
+
+            //Keeps the fingerprint loop from being optimized away
+            if(hash == 0)
+            {
+                printf("  zero hash\n");
+            }
+
+            DestroyClipItem(&same);
+        }
+
+        DestroyClipItem(&changed);
+    }
+
+    DestroyClipItem(&item);
+}
+
+
+/*******************************************************************
+** MakeKindItem
+** ============
+** Builds a one-format item that looks like a copied piece of text,
+** bitmap or file list.  The payload is a private blob.
+**
+** Inputs:
+**      ClipItem* item      - item to populate
+**      unsigned int kind   - KIND_TEXT, KIND_DIB or KIND_HDROP
+**      size_t size         - payload size in bytes
+**
+** Outputs:
+**      BOOL                - TRUE on success
+*******************************************************************/
+BOOL MakeKindItem(ClipItem* item, unsigned int kind, size_t size)
+{
+    item->formats = 0;
+    item->preview = NULL;
+    item->data = (ClipData*) AllocMemory(sizeof(ClipData));
+
+    if(item->data)
+    {
+        item->data[0].memory = AllocBlob(size);
+
+        if(!item->data[0].memory)
+        {
+            DestroyClipItem(item);
+            return FALSE;
+        }
+
+        FillKindBytes((BYTE*) LockBlob(item->data[0].memory), kind, size);
+        UnlockBlob(item->data[0].memory);
+        item->data[0].size = size;
+        item->data[0].format = kind_formats[kind];
+        item->data[0].hash = GetBlobHash(item->data[0].memory);
+        item->formats = 1;
+    }
+
+    return (item->data != NULL);
+}
+
+
+/*******************************************************************
+** CopyKindItem
+** ============
+** Copies a one-format item into a new private blob, optionally
+** changing its last byte.
+**
+** Inputs:
+**      ClipItem* copy      - item to populate
+**      ClipItem* item      - item to copy
+**      BOOL change_last    - TRUE to change the copy's last byte
+**
+** Outputs:
+**      BOOL                - TRUE on success
+*******************************************************************/
+BOOL CopyKindItem(ClipItem* copy, ClipItem* item, BOOL change_last)
+{
+    size_t size = item->data[0].size;
+    BYTE* bytes;
+
+    copy->formats = 0;
+    copy->preview = NULL;
+    copy->data = (ClipData*) AllocMemory(sizeof(ClipData));
+
+    if(copy->data)
+    {
+        copy->data[0] = item->data[0];
+        copy->data[0].memory = AllocBlob(size);
+
+        if(!copy->data[0].memory)
+        {
+            DestroyClipItem(copy);
+            return FALSE;
+        }
+
+        bytes = (BYTE*) LockBlob(copy->data[0].memory);
+        memcpy(bytes, LockBlob(item->data[0].memory), size);
+        UnlockBlob(item->data[0].memory);
+
+        if(change_last)
+        {
+            bytes[size - 1] ^= 1;
+        }
+
+        UnlockBlob(copy->data[0].memory);
+
+        copy->data[0].hash = GetBlobHash(copy->data[0].memory);
+        copy->formats = 1;
+    }
+
+    return (copy->data != NULL);
+}
+
+
+/*******************************************************************
+** FillKindBytes
+** =============
+** Fills a payload with data shaped like the given kind of item:
+** UTF-16 text, a 32-bit DIB with a gradient, or a DROPFILES list.
+*******************************************************************/
+void FillKindBytes(BYTE* bytes, unsigned int kind, size_t size)
+{
+    static const char words[] = "the quick brown fox jumps over "
+        "the lazy dog while the queue fills up ";
+    size_t i;
+
+    if(kind == KIND_TEXT)
+    {
+        for(i = 0; i + 1 < size; i += 2)
+        {
+            bytes[i] = (BYTE) words[(i / 2) % (sizeof(words) - 1)];
+            bytes[i + 1] = 0;
+        }
+    }
+    else if(kind == KIND_DIB)
+    {
+        memset(bytes, 0, (size < DIB_HEADER_SIZE) ? size : DIB_HEADER_SIZE);
+
+        for(i = DIB_HEADER_SIZE; i < size; ++i)
+        {
+            bytes[i] = (BYTE) ((i >> 2) + (i >> 12));
+        }
+    }
+    else
+    {
+        char path[32];
+        size_t position = DROPFILES_SIZE;
+        unsigned int file = 0;
+
+        memset(bytes, 0, size);
+
+        while(position + sizeof(path) * 2 < size)
+        {
+            int length = snprintf(path, sizeof(path),
+                "C:\\Users\\me\\file%u.txt", file++);
+
+            for(i = 0; i <= (size_t) length; ++i)
+            {
+                bytes[position++] = (BYTE) path[i];
+                bytes[position++] = 0;
+            }
+        }
+    }
+}
@@ -0,0 +1,223 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include <stdio.h>
+#include "Bench.h"
+#include "ClipQueue.h"
+
+#define ITEM_SIZE           64
+#define TIMED_PUSHES        20000
+#define TIMED_RUNS          3
+
+static const unsigned int queue_sizes[] = {1000, 10000, 100000};
+
+#define NUM_QUEUE_SIZES     (sizeof(queue_sizes) / sizeof(unsigned int))
+
+//How much longer a re-copy may take than pushing a new item into an
+//indexed queue of the same size.  Both miss the cache about as much
+//in a big queue, so this holds at every size if moves are cheap.
+#define MAX_RECOPY_COST     4.0
+
+static double BenchDistinctPushes(unsigned int queue_size, BOOL move);
+static double BenchRecopies(unsigned int queue_size);
+
+//Checks that have failed
+static unsigned int failed_checks = 0;
+
+
+/*******************************************************************
+** RunDedupeBench
+** ==============
+** Measures what finding duplicates anywhere in the queue costs.
+** Pushing new items, and re-copying queued ones from any depth,
+** should both cost the same whatever the queue size, so at each
+** size a re-copy is checked against a new push.
+**
+** Outputs:
+**      unsigned int        - how many checks failed
+*******************************************************************/
+unsigned int RunDedupeBench()
+{
+    double pushes[NUM_QUEUE_SIZES];
+    double recopies, cost;
+    unsigned int i;
+
+    failed_checks = 0;
+
+    for(i = 0; i < NUM_QUEUE_SIZES; ++i)
+    {
+        BenchDistinctPushes(queue_sizes[i], FALSE);
+        pushes[i] = BenchDistinctPushes(queue_sizes[i], TRUE);
+    }
+
+    for(i = 0; i < NUM_QUEUE_SIZES; ++i)
+    {
+        recopies = BenchRecopies(queue_sizes[i]);
+
+        if((pushes[i] > 0) && (recopies > 0))
+        {
+            cost = recopies / pushes[i];
+            printf("  re-copy vs new push, %u queued: %.2fx%s\n",
+                queue_sizes[i], cost,
+                (cost > MAX_RECOPY_COST) ? " FAILED" : "");
+            failed_checks += (cost > MAX_RECOPY_COST);
+        }
+    }
+
+    return failed_checks;
+}
+
+
+/*******************************************************************
+** BenchDistinctPushes
+** ===================
+** Fills a queue, then times pushing new items into it, each of
+** which evicts the oldest.  Returns the best time of a few runs,
+** or 0 if it couldn't run.
+*******************************************************************/
+double BenchDistinctPushes(unsigned int queue_size, BOOL move)
+{
+    ClipItem source;
+    ClipQueue cq;
+    unsigned int i, run;
+    char label[64];
+    double elapsed, seconds = 0;
+
+    queue_policy.move_duplicates = move;
+
+    if(MakeSyntheticItem(&source, 1, 1, ITEM_SIZE)
+    && CreateQueue(&cq, queue_size))
+    {
+        SetBenchClipboard(&source);
+
+        for(i = 0; i < queue_size; ++i)
+        {
+            PushFront(&cq);
+        }
+
+        for(run = 0; run < TIMED_RUNS; ++run)
+        {
+            elapsed = GetBenchTime();
+
+            for(i = 0; i < TIMED_PUSHES; ++i)
+            {
+                PushFront(&cq);
+            }
+
+            elapsed = GetBenchTime() - elapsed;
+
+            if((run == 0) || (elapsed < seconds))
+            {
+                seconds = elapsed;
+            }
+        }
+
+        snprintf(label, sizeof(label), "PushFront new, %u queued%s",
+            queue_size, move ? ", indexed" : "");
+        ReportRate(label, TIMED_PUSHES, 0, seconds);
+
+        DestroyQueue(&cq);
+        SetBenchClipboard(NULL);
+        DestroyClipItem(&source);
+    }
+
+    queue_policy.move_duplicates = FALSE;
+
+    return seconds;
+}
+
+
+/*******************************************************************
+** BenchRecopies
+** =============
+** Fills a queue with distinct items, then times copying items
+** that are already queued, at random depths, so each one moves to
+** the front.  Returns the best time of a few runs, or 0 if it
+** couldn't run.
+*******************************************************************/
+double BenchRecopies(unsigned int queue_size)
+{
+    ClipItem* items = (ClipItem*) AllocMemory(sizeof(ClipItem) * queue_size);
+    ClipQueue cq;
+    unsigned int i, run, last = 0;
+    char label[64];
+    double elapsed, seconds = 0;
+
+    queue_policy.move_duplicates = TRUE;
+    bench_clipboard_unique = FALSE;
+
+    if(items && CreateQueue(&cq, queue_size))
+    {
+        for(i = 0; i < queue_size; ++i)
+        {
+            MakeSyntheticItem(&items[i], i, 1, ITEM_SIZE);
+            SetBenchClipboard(&items[i]);
+            PushFront(&cq);
+        }
+
+        for(run = 0; run < TIMED_RUNS; ++run)
+        {
+            elapsed = GetBenchTime();
+
+            for(i = 0; i < TIMED_PUSHES; ++i)
+            {
+                last = (i * 7919u + run) % queue_size;
+                SetBenchClipboard(&items[last]);
+                PushFront(&cq);
+            }
+
+            elapsed = GetBenchTime() - elapsed;
+
+            if((run == 0) || (elapsed < seconds))
+            {
+                seconds = elapsed;
+            }
+        }
+        snprintf(label, sizeof(label), "PushFront re-copy, %u queued",
+            queue_size);
+        ReportRate(label, TIMED_PUSHES, 0, seconds);
+
+        if(GetQueueLength(&cq) != queue_size)
+        {
+            printf("  re-copies changed the queue length FAILED\n");
+            ++failed_checks;
+        }
+
+        if(!CompareClipItems(GetItem(&cq, 0), &items[last]))
+        {
+            printf("  last re-copy isn't at the front FAILED\n");
+            ++failed_checks;
+        }
+
+        DestroyQueue(&cq);
+        SetBenchClipboard(NULL);
+
+        for(i = 0; i < queue_size; ++i)
+        {
+            DestroyClipItem(&items[i]);
+        }
+    }
+
+    FreeMemory(items);
+    bench_clipboard_unique = TRUE;
+    queue_policy.move_duplicates = FALSE;
+
+    return seconds;
+}
@@ -0,0 +1,617 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+//Compares the chunked ClipQueue with the single array ring it
+//replaced.  The ring is kept here as a reference: it grows and
+//shrinks by copying every item into a new array, and finds items
+//with a modulo.  Both sides capture from the bench clipboard, so
+//the difference is down to the storage alone.
+
+#include <stdio.h>
+#include "Bench.h"
+#include "ClipQueue.h"
+
+#define POOL_SIZE           64
+#define MIN_RING_SIZE       16
+#define SWING_OPERATIONS    2000000
+#define SCAN_ITEMS          100000
+#define SCAN_PASSES         50
+#define CHECK_OPERATIONS    20000
+
+typedef struct
+{
+    unsigned int    front;
+    unsigned int    count;
+    unsigned int    size;
+    ClipItem*       clips;
+    unsigned int    last_time;
+}RingQueue;
+
+static BOOL CreateRing(RingQueue* rq, unsigned int size);
+static void DestroyRing(RingQueue* rq);
+static void ResizeRing(RingQueue* rq, unsigned int new_size);
+static void CheckRingSize(RingQueue* rq);
+static void RingPushFront(RingQueue* rq);
+static void RingPushBack(RingQueue* rq);
+static void RingDiscardFront(RingQueue* rq);
+static void RingDiscardBack(RingQueue* rq);
+static BOOL CreatePool(ClipItem* pool);
+static void DestroyPool(ClipItem* pool);
+static void BenchSwing(unsigned int depth);
+static void BenchScan();
+static void CheckAgainstRing();
+
+#define Max(a, b)   (((a) > (b)) ? (a) : (b))
+#define Min(a, b)   (((a) < (b)) ? (a) : (b))
+
+#define GetRingItem(rq, offset) \
+    (&(rq)->clips[((rq)->front + (offset)) % (rq)->size])
+
+
+//Checks that have failed
+static unsigned int failed_checks = 0;
+
+
+/*******************************************************************
+** RunDequeBench
+** =============
+** Runs push/pop oscillation workloads against the chunked queue
+** and the old array ring, then checks that the two agree.
+**
+** Outputs:
+**      unsigned int        - how many checks failed
+*******************************************************************/
+unsigned int RunDequeBench()
+{
+    BenchSwing(8);
+    BenchSwing(100);
+    BenchSwing(1000);
+    BenchSwing(10000);
+    BenchSwing(100000);
+    BenchScan();
+    CheckAgainstRing();
+
+    return failed_checks;
+}
+
+
+/*******************************************************************
+** CreateRing
+** ==========
+** Allocates an empty ring of the given size.
+*******************************************************************/
+BOOL CreateRing(RingQueue* rq, unsigned int size)
+{
+    rq->front = 0;
+    rq->count = 0;
+    rq->size = size;
+    rq->last_time = 0;
+    rq->clips = (ClipItem*) AllocMemory(sizeof(ClipItem) * size);
+
+    return (rq->clips != NULL);
+}
+
+
+/*******************************************************************
+** DestroyRing
+** ===========
+** Frees a ring and every item in it.
+*******************************************************************/
+void DestroyRing(RingQueue* rq)
+{
+    unsigned int i;
+
+    for(i = 0; i < rq->count; ++i)
+    {
+        DestroyClipItem(GetRingItem(rq, i));
+    }
+
+    FreeMemory(rq->clips);
+    rq->clips = NULL;
+    rq->count = 0;
+}
+
+
+/*******************************************************************
+** ResizeRing
+** ==========
+** Moves the ring into a new array, as ResizeQueue used to.
+*******************************************************************/
+void ResizeRing(RingQueue* rq, unsigned int new_size)
+{
+    ClipItem* new_clips = (ClipItem*) AllocMemory(
+        sizeof(ClipItem) * new_size);
+
+    if(new_clips)
+    {
+        unsigned int i;
+
+        for(i = 0; (i < rq->count) && (i < new_size); ++i)
+        {
+            new_clips[i] = *GetRingItem(rq, i);
+        }
+
+        for(; i < rq->count; ++i)
+        {
+            DestroyClipItem(GetRingItem(rq, i));
+        }
+
+        FreeMemory(rq->clips);
+        rq->clips = new_clips;
+        rq->count = (rq->count < new_size) ? rq->count : new_size;
+        rq->front = 0;
+        rq->size = new_size;
+    }
+}
+
+
+/*******************************************************************
+** CheckRingSize
+** =============
+** The old CheckDynamicSize: double when full, halve under 1/4.
+*******************************************************************/
+void CheckRingSize(RingQueue* rq)
+{
+    if(!queue_policy.dynamic_queue)
+    {
+        return;
+    }
+
+    if(rq->count == rq->size)
+    {
+        ResizeRing(rq, rq->size * 2);
+    }
+    else if(rq->count < rq->size / 4)
+    {
+        if(rq->size > MIN_RING_SIZE * 2)
+        {
+            ResizeRing(rq, rq->size / 2);
+        }
+        else if(rq->size > MIN_RING_SIZE)
+        {
+            ResizeRing(rq, MIN_RING_SIZE);
+        }
+    }
+}
+
+
+/*******************************************************************
+** RingPushFront
+** =============
+** Captures the bench clipboard onto the front of the ring.  Like
+** PushFront, it first compares against the last item pushed if
+** that was only just now.
+*******************************************************************/
+void RingPushFront(RingQueue* rq)
+{
+    ClipItem item;
+
+    if(PopulateClipItem(&item))
+    {
+        if((rq->count > 0) && (GetTicks() - rq->last_time < 20)
+        && CompareClipItems(&item, GetRingItem(rq, 0)))
+        {
+            DestroyClipItem(&item);
+        }
+        else
+        {
+            CheckRingSize(rq);
+
+            rq->front = (rq->front - 1 + rq->size) % rq->size;
+            *GetRingItem(rq, 0) = item;
+            ++(rq->count);
+            rq->last_time = GetTicks();
+        }
+    }
+}
+
+
+/*******************************************************************
+** RingPushBack
+** ============
+** Captures the bench clipboard onto the back of the ring.
+*******************************************************************/
+void RingPushBack(RingQueue* rq)
+{
+    ClipItem item;
+
+    if(PopulateClipItem(&item))
+    {
+        if((rq->count > 0) && (GetTicks() - rq->last_time < 20)
+        && CompareClipItems(&item, GetRingItem(rq, rq->count - 1)))
+        {
+            DestroyClipItem(&item);
+        }
+        else
+        {
+            CheckRingSize(rq);
+
+            *GetRingItem(rq, rq->count) = item;
+            ++(rq->count);
+            rq->last_time = GetTicks();
+        }
+    }
+}
+
+
+/*******************************************************************
+** RingDiscardFront
+** ================
+** Destroys the front item of the ring.
+*******************************************************************/
+void RingDiscardFront(RingQueue* rq)
+{
+    if(rq->count > 0)
+    {
+        DestroyClipItem(GetRingItem(rq, 0));
+        rq->front = (rq->front + 1) % rq->size;
+        --(rq->count);
+    }
+
+    CheckRingSize(rq);
+}
+
+
+/*******************************************************************
+** RingDiscardBack
+** ===============
+** Destroys the back item of the ring.
+*******************************************************************/
+void RingDiscardBack(RingQueue* rq)
+{
+    if(rq->count > 0)
+    {
+        --(rq->count);
+        DestroyClipItem(GetRingItem(rq, rq->count));
+    }
+
+    CheckRingSize(rq);
+}
+
+
+/*******************************************************************
+** CreatePool
+** ==========
+** Makes POOL_SIZE small, distinct items, so the container work
+** isn't buried under copying.
+*******************************************************************/
+BOOL CreatePool(ClipItem* pool)
+{
+    unsigned int i;
+    BOOL success = TRUE;
+
+    for(i = 0; (i < POOL_SIZE) && success; ++i)
+    {
+        success = MakeSyntheticItem(&pool[i], i, 1, 16);
+    }
+
+    if(!success)
+    {
+        while(i > 0)
+        {
+            DestroyClipItem(&pool[--i]);
+        }
+    }
+
+    return success;
+}
+
+
+/*******************************************************************
+** DestroyPool
+** ===========
+** Frees the items made by CreatePool.
+*******************************************************************/
+void DestroyPool(ClipItem* pool)
+{
+    unsigned int i;
+
+    SetBenchClipboard(NULL);
+
+    for(i = 0; i < POOL_SIZE; ++i)
+    {
+        DestroyClipItem(&pool[i]);
+    }
+}
+
+
+/*******************************************************************
+** BenchSwing
+** ==========
+** Pushes depth items onto the front of a dynamic queue, drops them
+** again from the back, and repeats.  Each swing crosses every size
+** boundary on the way up and down, which is where the ring has to
+** copy itself.  Besides the rate, the slowest push is shown, since
+** that copy lands on whichever push fills the ring.  To keep the
+** scheduler out of it, that's the slowest push of the quickest
+** swing - the copies happen on every swing, preemption doesn't.
+**
+** Inputs:
+**      unsigned int depth  - items pushed per swing
+*******************************************************************/
+void BenchSwing(unsigned int depth)
+{
+    ClipItem pool[POOL_SIZE];
+    ClipQueue cq;
+    RingQueue rq;
+    unsigned int swings = SWING_OPERATIONS / (depth * 2);
+    unsigned int i, j;
+    char label[64];
+    double start, before, worst, swing_worst;
+
+    queue_policy.dynamic_queue = TRUE;
+
+    if(!CreatePool(pool))
+    {
+        return;
+    }
+
+    if(CreateRing(&rq, MIN_RING_SIZE))
+    {
+        start = GetBenchTime();
+        worst = 0;
+
+        for(i = 0; i < swings; ++i)
+        {
+            swing_worst = 0;
+
+            for(j = 0; j < depth; ++j)
+            {
+                SetBenchClipboard(&pool[j % POOL_SIZE]);
+                before = GetBenchTime();
+                RingPushFront(&rq);
+                swing_worst = Max(swing_worst, GetBenchTime() - before);
+            }
+
+            worst = (i == 0) ? swing_worst : Min(worst, swing_worst);
+
+            for(j = 0; j < depth; ++j)
+            {
+                RingDiscardBack(&rq);
+            }
+        }
+
+        snprintf(label, sizeof(label), "Swing %u, array ring", depth);
+        ReportRate(label, swings * depth * 2, 0, GetBenchTime() - start);
+        printf("  %-36s %10.1f us\n", "  slowest push", worst * 1e6);
+
+        DestroyRing(&rq);
+    }
+
+    if(CreateQueue(&cq, MIN_RING_SIZE))
+    {
+        start = GetBenchTime();
+        worst = 0;
+
+        for(i = 0; i < swings; ++i)
+        {
+            swing_worst = 0;
+
+            for(j = 0; j < depth; ++j)
+            {
+                SetBenchClipboard(&pool[j % POOL_SIZE]);
+                before = GetBenchTime();
+                PushFront(&cq);
+                swing_worst = Max(swing_worst, GetBenchTime() - before);
+            }
+
+            worst = (i == 0) ? swing_worst : Min(worst, swing_worst);
+
+            for(j = 0; j < depth; ++j)
+            {
+                DiscardBack(&cq);
+            }
+        }
+
+        snprintf(label, sizeof(label), "Swing %u, chunked", depth);
+        ReportRate(label, swings * depth * 2, 0, GetBenchTime() - start);
+        printf("  %-36s %10.1f us\n", "  slowest push", worst * 1e6);
+
+        DestroyQueue(&cq);
+    }
+
+    DestroyPool(pool);
+    queue_policy.dynamic_queue = FALSE;
+}
+
+
+/*******************************************************************
+** BenchScan
+** =========
+** Measures walking a full queue with GetItem, which is what the
+** budget and duplicate scans do, against the ring's modulo.
+*******************************************************************/
+void BenchScan()
+{
+    ClipItem pool[POOL_SIZE];
+    ClipQueue cq;
+    RingQueue rq;
+    unsigned int i, pass;
+    volatile size_t total = 0;
+    double start;
+
+    queue_policy.dynamic_queue = FALSE;
+
+    if(!CreatePool(pool))
+    {
+        return;
+    }
+
+    //Odd sizes, and an offset front, so the modulo can't be
+    //strength-reduced away.
+    if(CreateRing(&rq, SCAN_ITEMS + 7) && CreateQueue(&cq, SCAN_ITEMS + 7))
+    {
+        for(i = 0; i < SCAN_ITEMS + 7; ++i)
+        {
+            SetBenchClipboard(&pool[i % POOL_SIZE]);
+            RingPushFront(&rq);
+            PushFront(&cq);
+        }
+
+        for(i = 0; i < 7; ++i)
+        {
+            RingDiscardFront(&rq);
+            DiscardFront(&cq);
+        }
+
+        start = GetBenchTime();
+
+        for(pass = 0; pass < SCAN_PASSES; ++pass)
+        {
+            for(i = 0; i < rq.count; ++i)
+            {
+                total += GetRingItem(&rq, i)->formats;
+            }
+        }
+
+        ReportRate("Scan 100000, array ring", SCAN_PASSES * SCAN_ITEMS,
+            0, GetBenchTime() - start);
+
+        start = GetBenchTime();
+
+        for(pass = 0; pass < SCAN_PASSES; ++pass)
+        {
+            for(i = 0; i < GetQueueLength(&cq); ++i)
+            {
+                total += GetItem(&cq, i)->formats;
+            }
+        }
+
+        ReportRate("Scan 100000, chunked", SCAN_PASSES * SCAN_ITEMS,
+            0, GetBenchTime() - start);
+    }
+
+    DestroyRing(&rq);
+    DestroyQueue(&cq);
+    DestroyPool(pool);
+}
+
+
+/*******************************************************************
+** CheckAgainstRing
+** ================
+** Drives the queue and the ring through the same random mix of
+** pushes and discards at both ends, with and without a size limit,
+** and checks they end up holding the same items in the same order.
+*******************************************************************/
+void CheckAgainstRing()
+{
+    ClipItem pool[POOL_SIZE];
+    ClipQueue cq;
+    RingQueue rq;
+    unsigned int state = 12345;
+    unsigned int i, limited;
+    BOOL match = TRUE;
+
+    if(!CreatePool(pool))
+    {
+        return;
+    }
+
+    //Both sides capture each item, so rewind the clipboard's read
+    //count in between to give them the same unique stamp.
+    for(limited = 0; limited < 2; ++limited)
+    {
+        queue_policy.dynamic_queue = !limited;
+
+        if(!CreateRing(&rq, limited ? 100 : MIN_RING_SIZE))
+        {
+            break;
+        }
+
+        if(!CreateQueue(&cq, limited ? 100 : MIN_RING_SIZE))
+        {
+            DestroyRing(&rq);
+            break;
+        }
+
+        for(i = 0; (i < CHECK_OPERATIONS) && match; ++i)
+        {
+            state = state * 1103515245 + 12345;
+
+            //Lean towards pushes so the queue fills up now and then
+            switch((state >> 16) % 5)
+            {
+            case 0:
+            case 1:
+                SetBenchClipboard(&pool[(state >> 8) % POOL_SIZE]);
+                PushFront(&cq);
+
+                //A full ring of fixed size drops its back item
+                if(limited && (rq.count == rq.size))
+                {
+                    RingDiscardBack(&rq);
+                }
+
+                --bench_clipboard_reads;
+                RingPushFront(&rq);
+                break;
+
+            case 2:
+                SetBenchClipboard(&pool[(state >> 8) % POOL_SIZE]);
+                PushBack(&cq);
+
+                if(limited && (rq.count == rq.size))
+                {
+                    RingDiscardFront(&rq);
+                }
+
+                --bench_clipboard_reads;
+                RingPushBack(&rq);
+                break;
+
+            case 3:
+                DiscardFront(&cq);
+                RingDiscardFront(&rq);
+                break;
+
+            default:
+                DiscardBack(&cq);
+                RingDiscardBack(&rq);
+                break;
+            }
+
+            match = (GetQueueLength(&cq) == rq.count);
+
+            if(match && (rq.count > 0))
+            {
+                match = CompareClipItems(GetItem(&cq, 0),
+                    GetRingItem(&rq, 0))
+                    && CompareClipItems(GetItem(&cq, cq.count - 1),
+                    GetRingItem(&rq, rq.count - 1));
+            }
+        }
+
+        for(i = 0; (i < rq.count) && match; ++i)
+        {
+            match = CompareClipItems(GetItem(&cq, i), GetRingItem(&rq, i));
+        }
+
+        DestroyRing(&rq);
+        DestroyQueue(&cq);
+    }
+
+    printf("  Chunked queue vs array ring: %s\n", match ? "ok" : "FAILED");
+    failed_checks += !match;
+
+    DestroyPool(pool);
+    queue_policy.dynamic_queue = FALSE;
+}
@@ -0,0 +1,424 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include <stdio.h>
+#include <string.h>
+#include "Bench.h"
+#include "BlobStore.h"
+#include "ClipQueue.h"
+#include "ClipCapture.h"
+
+#define CF_ENHMETAFILE      14
+#define NUM_OFFICE_FORMATS  7
+#define NUM_PRIORITY        2
+#define CAPTURE_COUNT       8
+#define QUEUE_SIZE          16
+
+//What a word processor leaves on the clipboard for a copy, richest
+//first, as it enumerates them.  Text is cheap to produce; the rest
+//is rendered when asked for, and costs accordingly.
+typedef struct
+{
+    UINT            format;
+    size_t          size;
+    unsigned int    cost;       //us to render it
+    BYTE*           bytes;
+}OfficeFormat;
+
+static OfficeFormat office_formats[NUM_OFFICE_FORMATS] =
+{
+    {0xC001,            512 * 1024,     30000,  NULL},  //Embed Source
+    {0xC002,            1024,           500,    NULL},  //Object Descriptor
+    {0xC003,            64 * 1024,      5000,   NULL},  //Rich Text Format
+    {0xC004,            32 * 1024,      2000,   NULL},  //HTML Format
+    {CF_ENHMETAFILE,    256 * 1024,     15000,  NULL},
+    {CF_UNICODETEXT,    8 * 1024,       20,     NULL},
+    {CF_TEXT,           4 * 1024,       20,     NULL},
+};
+
+static const UINT priority_formats[NUM_PRIORITY] = {CF_UNICODETEXT, CF_TEXT};
+
+static BOOL CreateOfficeFormats();
+static void DestroyOfficeFormats();
+static void BenchPolicy(const char* name, BOOL defer, BOOL fetch_rest,
+    ClipQueue* cq);
+static void CheckPolicy(const char* name, BOOL fetch_rest,
+    ClipQueue* reference);
+static BOOL Snapshot(ClipCapture* capture, unsigned int serial,
+    BOOL defer);
+static void FetchFormats(ClipCapture* capture, const UINT* formats,
+    unsigned int count, unsigned int serial);
+static void ReportFetchTimings(CaptureStats* stats);
+
+
+//Checks that have failed
+static unsigned int failed_checks = 0;
+
+
+/*******************************************************************
+** RunFetchBench
+** =============
+** Captures a simulated word processor copy, whose rich formats are
+** slow to render, three ways: every format up front, the priority
+** formats first with the rest merged in afterwards, and the
+** priority formats only.  Compares how soon each capture reaches
+** the queue, and checks the merged items match the full ones.
+**
+** Outputs:
+**      unsigned int        - how many checks failed
+*******************************************************************/
+unsigned int RunFetchBench()
+{
+    ClipQueue reference;
+
+    if(CreateOfficeFormats() && CreateQueue(&reference, QUEUE_SIZE))
+    {
+        BenchPolicy("fetch all", FALSE, FALSE, &reference);
+        CheckPolicy("priority first", TRUE, &reference);
+        CheckPolicy("priority only", FALSE, &reference);
+        DestroyQueue(&reference);
+    }
+
+    DestroyOfficeFormats();
+
+    return failed_checks;
+}
+
+
+/*******************************************************************
+** CreateOfficeFormats
+** ===================
+** Fills in the payload of each simulated format.
+**
+** Outputs:
+**      BOOL                - FALSE if out of memory
+*******************************************************************/
+BOOL CreateOfficeFormats()
+{
+    unsigned int i;
+
+    for(i = 0; i < NUM_OFFICE_FORMATS; ++i)
+    {
+        office_formats[i].bytes =
+            (BYTE*) AllocMemory(office_formats[i].size);
+
+        if(!office_formats[i].bytes)
+        {
+            return FALSE;
+        }
+
+        FillSyntheticBytes(office_formats[i].bytes,
+            office_formats[i].size, i);
+    }
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** DestroyOfficeFormats
+** ====================
+** Frees what CreateOfficeFormats made.
+*******************************************************************/
+void DestroyOfficeFormats()
+{
+    unsigned int i;
+
+    for(i = 0; i < NUM_OFFICE_FORMATS; ++i)
+    {
+        FreeMemory(office_formats[i].bytes);
+        office_formats[i].bytes = NULL;
+    }
+}
+
+
+/*******************************************************************
+** BenchPolicy
+** ===========
+** Captures CAPTURE_COUNT copies under one fetch policy, the way the
+** capture thread and CollectCaptures do it, and reports how long
+** each took to reach the queue.
+**
+** Inputs:
+**      const char* name    - the policy, for the report
+**      BOOL defer          - TRUE to fetch the priority formats first
+**      BOOL fetch_rest     - TRUE to fetch the deferred formats
+**                            afterwards
+**      ClipQueue* cq       - queue to capture into
+*******************************************************************/
+void BenchPolicy(const char* name, BOOL defer, BOOL fetch_rest,
+    ClipQueue* cq)
+{
+    ClipCapture capture, taken, rest;
+    ClipItem item;
+    CaptureRing ring;
+    unsigned int i, requested, pushed_serial = 0;
+    size_t queued_bytes = 0;
+    uint64_t queued_total = 0, complete_total = 0;
+    BOOL has_rest;
+    char label[64];
+
+    InitCaptureRing(&ring);
+
+    for(i = 0; i < CAPTURE_COUNT; ++i)
+    {
+        if(!Snapshot(&capture, i, defer))
+        {
+            continue;
+        }
+
+        requested = capture.requested;
+        has_rest = fetch_rest && CreateRestCapture(&rest, &capture);
+
+        if(!PutCapture(&ring, &capture))
+        {
+            DestroyCapture(&capture);
+        }
+
+        //The UI thread has the item as soon as it's handed over
+        while(TakeCaptureItem(&ring, &item, &taken))
+        {
+            PushItemFront(cq, &item);
+            pushed_serial = cq->serial;
+            queued_total += GetMicroTicks() - requested;
+        }
+
+        if(has_rest)
+        {
+            FetchFormats(&rest, rest.deferred, rest.deferred_count, i);
+
+            if(!PutCapture(&ring, &rest))
+            {
+                DestroyCapture(&rest);
+            }
+
+            while(TakeCaptureItem(&ring, &item, &taken))
+            {
+                if(!taken.rest
+                || !AddFormatsToItem(cq, pushed_serial, &item))
+                {
+                    printf("  merging deferred formats FAILED\n");
+                    ++failed_checks;
+                    DestroyClipItem(&item);
+                }
+            }
+        }
+
+        complete_total += GetMicroTicks() - requested;
+    }
+
+    for(i = 0; i < GetQueueLength(cq); ++i)
+    {
+        queued_bytes += GetClipItemSize(GetItem(cq, i));
+    }
+
+    snprintf(label, sizeof(label), "%s, queued after", name);
+    printf("  %-36s %10.1f ms avg\n", label,
+        queued_total / 1000.0 / CAPTURE_COUNT);
+    snprintf(label, sizeof(label), "%s, complete after", name);
+    printf("  %-36s %10.1f ms avg\n", label,
+        complete_total / 1000.0 / CAPTURE_COUNT);
+    snprintf(label, sizeof(label), "%s, queue holds", name);
+    printf("  %-36s %10.1f KB/item %7lu deferred\n", label,
+        queued_bytes / 1024.0 / CAPTURE_COUNT, ring.stats.deferred);
+
+    if(!defer)
+    {
+        ReportFetchTimings(&ring.stats);
+    }
+}
+
+
+/*******************************************************************
+** CheckPolicy
+** ===========
+** Runs a policy that defers formats and checks the result against
+** fetching everything: the same items once the deferred formats are
+** merged in, or just the priority formats if they never are.
+**
+** Inputs:
+**      const char* name        - the policy, for the report
+**      BOOL fetch_rest         - TRUE to fetch the deferred formats
+**      ClipQueue* reference    - queue of fully fetched items
+*******************************************************************/
+void CheckPolicy(const char* name, BOOL fetch_rest, ClipQueue* reference)
+{
+    ClipQueue cq;
+    unsigned int i;
+    BOOL match;
+
+    if(!CreateQueue(&cq, QUEUE_SIZE))
+    {
+        return;
+    }
+
+    BenchPolicy(name, TRUE, fetch_rest, &cq);
+    match = (GetQueueLength(&cq) == GetQueueLength(reference));
+
+    for(i = 0; (i < GetQueueLength(&cq)) && match; ++i)
+    {
+        if(fetch_rest)
+        {
+            match = CompareClipItems(GetItem(&cq, i), GetItem(reference, i));
+        }
+        else
+        {
+            match = (GetItem(&cq, i)->formats == NUM_PRIORITY);
+        }
+    }
+
+    if(!match)
+    {
+        printf("  %s contents FAILED\n", name);
+        ++failed_checks;
+    }
+
+    DestroyQueue(&cq);
+}
+
+
+/*******************************************************************
+** Snapshot
+** ========
+** Does what SnapshotClipboard does, against the simulated
+** clipboard: every format, or just the priority ones with the rest
+** listed as deferred.
+**
+** Inputs:
+**      ClipCapture* capture    - capture to fill in
+**      unsigned int serial     - stamped into each format, so each
+**                                copy is different
+**      BOOL defer              - TRUE to fetch only priority formats
+**
+** Outputs:
+**      BOOL                    - FALSE if out of memory
+*******************************************************************/
+BOOL Snapshot(ClipCapture* capture, unsigned int serial, BOOL defer)
+{
+    UINT formats[NUM_OFFICE_FORMATS];
+    unsigned int i, j;
+    BOOL priority;
+
+    if(!CreateCapture(capture, NUM_OFFICE_FORMATS, GetMicroTicks()))
+    {
+        return FALSE;
+    }
+
+    capture->sequence = serial + 1;
+
+    for(i = 0; i < NUM_OFFICE_FORMATS; ++i)
+    {
+        priority = FALSE;
+
+        for(j = 0; (j < NUM_PRIORITY) && !priority; ++j)
+        {
+            priority = (office_formats[i].format == priority_formats[j]);
+        }
+
+        formats[i] = office_formats[i].format;
+
+        if(defer && !priority)
+        {
+            DeferCaptureFormat(capture, formats[i]);
+        }
+        else
+        {
+            FetchFormats(capture, &formats[i], 1, serial);
+        }
+    }
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** FetchFormats
+** ============
+** Fetches formats from the simulated clipboard, which takes as long
+** as each one costs to render, and adds them to a capture.
+**
+** Inputs:
+**      ClipCapture* capture    - capture to add to
+**      const UINT* formats     - formats to fetch
+**      unsigned int count      - how many
+**      unsigned int serial     - stamped into each one
+*******************************************************************/
+void FetchFormats(ClipCapture* capture, const UINT* formats,
+    unsigned int count, unsigned int serial)
+{
+    OfficeFormat* source;
+    unsigned int i, j, started;
+
+    for(i = 0; i < count; ++i)
+    {
+        for(j = 0; j < NUM_OFFICE_FORMATS; ++j)
+        {
+            source = &office_formats[j];
+
+            if(source->format == formats[i])
+            {
+                started = GetMicroTicks();
+
+                while(GetMicroTicks() - started < source->cost)
+                {
+                    YieldThread();
+                }
+
+                memcpy(source->bytes, &serial, sizeof(serial));
+                AddCaptureData(capture, source->format, source->bytes,
+                    source->size, started);
+            }
+        }
+    }
+}
+
+
+/*******************************************************************
+** ReportFetchTimings
+** ==================
+** Prints how long each format took to fetch, as kept by the
+** capture ring, which is what PriorityFormats is tuned from.
+**
+** Inputs:
+**      CaptureStats* stats - the ring's stats
+*******************************************************************/
+void ReportFetchTimings(CaptureStats* stats)
+{
+    FetchTiming* timing;
+    unsigned int i;
+    char label[64];
+
+    for(i = 0; i < stats->timed_formats; ++i)
+    {
+        timing = &stats->fetches[i];
+        snprintf(label, sizeof(label), "  fetch format 0x%04X",
+            timing->format);
+        printf("  %-36s %10.1f us avg %10u us max\n", label,
+            timing->fetches ? (double) timing->total / timing->fetches : 0.0,
+            timing->max);
+    }
+
+    if(stats->timed_formats != NUM_OFFICE_FORMATS)
+    {
+        printf("  fetch timings FAILED\n");
+        ++failed_checks;
+    }
+}
@@ -0,0 +1,321 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include <stdio.h>
+#include <string.h>
+#include "Bench.h"
+#include "ClipCapture.h"
+
+#define SLOW_PROCESS        100
+#define FAST_PROCESS        200
+#define SLOW_FORMAT         0xC001      //Embed Source, say
+#define SLOW_COST           60000       //us to render it
+#define DEADLINE            20000       //us
+#define CAPTURE_COUNT       12
+#define PAYLOAD_SIZE        1024
+#define STOP_WAIT           50          //ms to wait for a hung thread
+
+//A fetch that's stuck until the owner is let go
+typedef struct
+{
+    volatile unsigned int   hung;
+    volatile unsigned int   done;
+}HungFetch;
+
+static void BenchOwner(const char* label, unsigned int deadline);
+static BOOL FetchSimulated(ClipCapture* capture, UINT format,
+    unsigned int cost, FetchGuard* guard, const BYTE* payload);
+static void CheckPenalties();
+static void CheckStopWithin();
+static void HangInFetch(void* arg);
+
+
+//Checks that have failed
+static unsigned int failed_checks = 0;
+
+
+/*******************************************************************
+** RunHungBench
+** ============
+** Captures copies from a program that takes far too long to render
+** one of its formats, with and without a fetch deadline, and checks
+** the penalties the FetchGuard hands out and lifts, and that a
+** thread stuck in a fetch doesn't hold up stopping.
+**
+** Outputs:
+**      unsigned int        - how many checks failed
+*******************************************************************/
+unsigned int RunHungBench()
+{
+    BenchOwner("no deadline", 0);
+    BenchOwner("20 ms deadline", DEADLINE);
+    CheckPenalties();
+    CheckStopWithin();
+
+    return failed_checks;
+}
+
+
+/*******************************************************************
+** BenchOwner
+** ==========
+** Captures CAPTURE_COUNT copies of text plus one slow format from
+** the same owner, and reports how long it took and what was left
+** out.
+**
+** Inputs:
+**      const char* label       - name of the run
+**      unsigned int deadline   - us a fetch may take; 0 for no limit
+*******************************************************************/
+void BenchOwner(const char* label, unsigned int deadline)
+{
+    BYTE payload[PAYLOAD_SIZE];
+    FetchGuard guard;
+    CaptureRing ring;
+    ClipCapture capture;
+    ClipItem item;
+    unsigned int i;
+    unsigned long texts = 0;
+    double start;
+
+    FillSyntheticBytes(payload, PAYLOAD_SIZE, 1);
+    InitFetchGuard(&guard, deadline);
+    InitCaptureRing(&ring);
+    start = GetBenchTime();
+
+    for(i = 0; i < CAPTURE_COUNT; ++i)
+    {
+        if(!CreateCapture(&capture, 2, GetMicroTicks()))
+        {
+            continue;
+        }
+
+        FetchSimulated(&capture, CF_UNICODETEXT, 0, &guard, payload);
+        FetchSimulated(&capture, SLOW_FORMAT, SLOW_COST, &guard, payload);
+
+        if(!PutCapture(&ring, &capture))
+        {
+            DestroyCapture(&capture);
+        }
+
+        while(TakeCaptureItem(&ring, &item, NULL))
+        {
+            texts += (item.formats > 0)
+                && (item.data[0].format == CF_UNICODETEXT);
+            DestroyClipItem(&item);
+        }
+    }
+
+    printf("  %-36s %10.1f ms %4lu overran %4lu skipped\n", label,
+        (GetBenchTime() - start) * 1000.0, guard.overruns,
+        ring.stats.skipped);
+
+    if(texts != CAPTURE_COUNT)
+    {
+        printf("  %s text FAILED\n", label);
+        ++failed_checks;
+    }
+
+    if(deadline
+    && ((guard.overruns != PENALTY_STRIKES)
+    || (ring.stats.skipped != CAPTURE_COUNT - PENALTY_STRIKES)
+    || (guard.penalties_given != 1)))
+    {
+        printf("  %s penalty FAILED\n", label);
+        ++failed_checks;
+    }
+}
+
+
+/*******************************************************************
+** FetchSimulated
+** ==============
+** Does what FetchClipFormat does, against an owner that takes cost
+** microseconds to render the format.
+**
+** Inputs:
+**      ClipCapture* capture    - capture to add to
+**      UINT format             - the format
+**      unsigned int cost       - us to render it
+**      FetchGuard* guard       - the guard
+**      const BYTE* payload     - the format's data
+**
+** Outputs:
+**      BOOL                    - TRUE if the format was copied
+*******************************************************************/
+BOOL FetchSimulated(ClipCapture* capture, UINT format,
+    unsigned int cost, FetchGuard* guard, const BYTE* payload)
+{
+    unsigned int started;
+    BOOL copied;
+
+    if(!IsFetchAllowed(guard, SLOW_PROCESS, format, GetTicks()))
+    {
+        ++(capture->skipped);
+        return FALSE;
+    }
+
+    started = GetMicroTicks();
+
+    while(GetMicroTicks() - started < cost)
+    {
+        YieldThread();
+    }
+
+    copied = AddCaptureData(capture, format, payload, PAYLOAD_SIZE,
+        started);
+    NoteFetchTime(guard, SLOW_PROCESS, format,
+        GetMicroTicks() - started, GetTicks());
+
+    return copied;
+}
+
+
+/*******************************************************************
+** CheckPenalties
+** ==============
+** Checks the rules without waiting on anything: a penalty is per
+** process and format, runs out after PENALTY_TIME, comes straight
+** back if the format is still slow, and an owner that is only
+** sometimes slow is never penalised.
+*******************************************************************/
+void CheckPenalties()
+{
+    FetchGuard guard;
+    unsigned int i, now = 1000;
+    BOOL passed = TRUE;
+
+    InitFetchGuard(&guard, DEADLINE);
+
+    for(i = 0; i < PENALTY_STRIKES; ++i)
+    {
+        passed = passed && IsFetchAllowed(&guard, SLOW_PROCESS,
+            SLOW_FORMAT, now);
+        NoteFetchTime(&guard, SLOW_PROCESS, SLOW_FORMAT, 2 * DEADLINE, now);
+    }
+
+    //Penalised, but only for that process and format
+    passed = passed
+        && !IsFetchAllowed(&guard, SLOW_PROCESS, SLOW_FORMAT, now + 1)
+        && IsFetchAllowed(&guard, SLOW_PROCESS, CF_UNICODETEXT, now + 1)
+        && IsFetchAllowed(&guard, FAST_PROCESS, SLOW_FORMAT, now + 1);
+
+    //Let out after PENALTY_TIME, and back in after one more overrun
+    now += PENALTY_TIME;
+    passed = passed
+        && IsFetchAllowed(&guard, SLOW_PROCESS, SLOW_FORMAT, now);
+    NoteFetchTime(&guard, SLOW_PROCESS, SLOW_FORMAT, 2 * DEADLINE, now);
+    passed = passed
+        && !IsFetchAllowed(&guard, SLOW_PROCESS, SLOW_FORMAT, now + 1);
+
+    //Overruns that aren't in a row don't add up
+    for(i = 0; i < 4 * PENALTY_STRIKES; ++i)
+    {
+        NoteFetchTime(&guard, FAST_PROCESS, SLOW_FORMAT,
+            (i & 1) ? DEADLINE / 2 : 2 * DEADLINE, now);
+    }
+
+    passed = passed
+        && IsFetchAllowed(&guard, FAST_PROCESS, SLOW_FORMAT, now + 1);
+
+    if(!passed)
+    {
+        printf("  penalty rules FAILED\n");
+        ++failed_checks;
+    }
+}
+
+
+/*******************************************************************
+** CheckStopWithin
+** ===============
+** Stops a thread stuck in a fetch, as StopCaptureThread does at
+** exit: JoinThreadWithin must give up on it after STOP_WAIT, and the
+** thread must still be able to finish and clean up after itself.  A
+** thread that isn't stuck is joined as usual.
+*******************************************************************/
+void CheckStopWithin()
+{
+    HungFetch fetch = {TRUE, FALSE};
+    HANDLE thread = StartThread(HangInFetch, &fetch);
+    BOOL joined;
+    double start, waited;
+
+    if(!thread)
+    {
+        printf("  StartThread FAILED\n");
+        ++failed_checks;
+        return;
+    }
+
+    start = GetBenchTime();
+    joined = JoinThreadWithin(thread, STOP_WAIT);
+    waited = (GetBenchTime() - start) * 1000.0;
+
+    printf("  %-36s %10.1f ms to give up\n", "stop with a fetch hung", waited);
+
+    //Let it go, and wait until it's done with fetch
+    StoreRelease(&fetch.hung, FALSE);
+
+    while(!LoadAcquire(&fetch.done))
+    {
+        YieldThread();
+    }
+
+    if(joined || (waited < STOP_WAIT / 2) || (waited > 10 * STOP_WAIT))
+    {
+        printf("  stop with a fetch hung FAILED\n");
+        ++failed_checks;
+    }
+
+    fetch.hung = FALSE;
+    fetch.done = FALSE;
+    thread = StartThread(HangInFetch, &fetch);
+
+    if(!thread || !JoinThreadWithin(thread, 100 * STOP_WAIT)
+    || !fetch.done)
+    {
+        printf("  stop with nothing hung FAILED\n");
+        ++failed_checks;
+    }
+}
+
+
+/*******************************************************************
+** HangInFetch
+** ===========
+** Stands in for a capture thread that's waiting on GetClipboardData
+** from an owner that has hung.
+**
+** Inputs:
+**      void* arg           - the HungFetch
+*******************************************************************/
+void HangInFetch(void* arg)
+{
+    HungFetch* fetch = (HungFetch*) arg;
+
+    while(LoadAcquire(&fetch->hung))
+    {
+        YieldThread();
+    }
+
+    StoreRelease(&fetch->done, TRUE);
+}
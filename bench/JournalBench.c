@@ -0,0 +1,1286 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include <stdio.h>
+#include <string.h>
+#include "Bench.h"
+#include "BlobStore.h"
+#include "ClipQueue.h"
+#include "ClipSerialize.h"
+#include "ClipJournal.h"
+#include "Hash.h"
+
+#define POOL_ITEMS          48
+#define OPERATIONS          1500
+#define CUTS                200
+#define BYTE_BUDGET         (192 * 1024)
+#define EXIT_ITEMS          4000
+#define EXIT_ITEM_SIZE      4096
+#define EXIT_ROUNDS         3
+#define AUTOSAVE_ITEMS      24
+#define AUTOSAVE_ITEM_SIZE  (64 * 1024)
+#define STALL_ITEMS         10000
+#define STALL_ITEM_SIZE     2048
+#define TEXT_UNITS          4096
+
+//Where the first payload's format is in a journal with one record,
+//and in a .qcl file with one item
+#define JOURNAL_FORMAT_OFFSET   56
+#define FILE_FORMAT_OFFSET      60
+
+static char journal_path[1024];
+static char snapshot_path[1024];
+static char temp_path[1024];
+static unsigned int random_state = 4242;
+
+static unsigned int NextRandom();
+static BOOL CreatePool(ClipItem* pool);
+static void RunOperations(ClipQueue* cq, ClipItem* pool, uint64_t* ends,
+    uint64_t* prints);
+static void CheckCrashRecovery(ClipItem* pool);
+static void CheckCut(uint64_t cut, const BYTE* journal,
+    const BYTE* snapshot, uint64_t snapshot_size, uint64_t* ends,
+    uint64_t* prints, unsigned long* mid_operation);
+static void CheckCompaction(ClipItem* pool);
+static void CheckAutosave(ClipItem* pool);
+static void CheckSavedText();
+static BOOL AutosaveWhileChanging(ClipQueue* cq, ClipItem* pool,
+    unsigned int changes);
+static BOOL WaitForAutosave(ClipQueue* cq);
+static void WaitForWrites(ClipQueue* cq);
+static BOOL CompareQueues(ClipQueue* cq, ClipQueue* other);
+static void BenchExit();
+static void BenchAutosave();
+static BOOL ReopenQueue(ClipQueue* cq);
+static uint64_t FingerprintQueue(ClipQueue* cq);
+static BYTE* ReadWholeFile(const char* path, uint64_t* size);
+static BOOL WriteWholeFile(const char* path, const BYTE* bytes,
+    uint64_t size);
+
+
+//Checks that have failed
+static unsigned int failed_checks = 0;
+
+
+/*******************************************************************
+** RunJournalBench
+** ===============
+** Runs a random stream of queue operations against a journaled
+** queue, then cuts the journal short at random offsets, as a crash
+** would, and checks that replaying it on top of the snapshot gives
+** the queue as it was after the last whole record.  Checks that a
+** crash in the middle of compacting doesn't replay anything twice,
+** and that autosaves in the background lose nothing, crash or no
+** crash, and that text goes out as CF_UNICODETEXT.  Compares
+** exiting with a journal against saving
+** everything, and an autosave against a save that holds up the
+** queue.
+**
+** Outputs:
+**      unsigned int        - how many checks failed
+*******************************************************************/
+unsigned int RunJournalBench()
+{
+    ClipItem pool[POOL_ITEMS];
+    unsigned int i;
+
+    snprintf(journal_path, sizeof(journal_path), "%s",
+        GetBenchFile("journal.qcj"));
+    snprintf(snapshot_path, sizeof(snapshot_path), "%s",
+        GetBenchFile("journal.qcl"));
+    snprintf(temp_path, sizeof(temp_path), "%s",
+        GetBenchFile("journal.tmp"));
+
+    if(CreatePool(pool))
+    {
+        CheckCrashRecovery(pool);
+        CheckCompaction(pool);
+        CheckAutosave(pool);
+        CheckSavedText();
+
+        SetBenchClipboard(NULL);
+
+        for(i = 0; i < POOL_ITEMS; ++i)
+        {
+            DestroyClipItem(&pool[i]);
+        }
+    }
+
+    BenchExit();
+    BenchAutosave();
+
+    remove(journal_path);
+    remove(snapshot_path);
+    remove(temp_path);
+
+    return failed_checks;
+}
+
+
+/*******************************************************************
+** NextRandom
+** ==========
+** A small, repeatable pseudo-random number generator.
+*******************************************************************/
+unsigned int NextRandom()
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+
+    return random_state;
+}
+
+
+/*******************************************************************
+** CreatePool
+** ==========
+** Makes POOL_ITEMS items of one to three formats and various sizes
+** to copy.
+**
+** Outputs:
+**      BOOL                - FALSE if out of memory
+*******************************************************************/
+BOOL CreatePool(ClipItem* pool)
+{
+    unsigned int i;
+
+    for(i = 0; i < POOL_ITEMS; ++i)
+    {
+        if(!MakeSyntheticItem(&pool[i], i, 1 + i % 3,
+            64 + (i * 997) % 6144))
+        {
+            while(i > 0)
+            {
+                DestroyClipItem(&pool[--i]);
+            }
+
+            printf("  out of memory\n");
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** RunOperations
+** =============
+** Copies, pastes, discards, merges formats into, resizes and empties
+** a queue at random, with duplicates moved, dynamic sizing and a
+** byte budget, noting after each operation how long the journal is
+** and what's in the queue.
+**
+** Inputs:
+**      ClipQueue* cq       - a journaled queue
+**      ClipItem* pool      - items to copy
+**      uint64_t* ends      - receives OPERATIONS journal sizes
+**      uint64_t* prints    - ...and queue fingerprints
+*******************************************************************/
+void RunOperations(ClipQueue* cq, ClipItem* pool, uint64_t* ends,
+    uint64_t* prints)
+{
+    JournalStats stats;
+    ClipItem extra;
+    unsigned int i, choice;
+
+    for(i = 0; i < OPERATIONS; ++i)
+    {
+        choice = NextRandom() % 100;
+        SetBenchClipboard(&pool[NextRandom() % POOL_ITEMS]);
+
+        if(choice < 35)
+        {
+            PushFront(cq);
+        }
+        else if(choice < 50)
+        {
+            PushBack(cq);
+        }
+        else if(choice < 60)
+        {
+            PopFront(cq);
+        }
+        else if(choice < 66)
+        {
+            PopBack(cq);
+        }
+        else if(choice < 74)
+        {
+            DiscardFront(cq);
+        }
+        else if(choice < 80)
+        {
+            DiscardBack(cq);
+        }
+        else if(choice < 90)
+        {
+            //Formats that turn up after the item was queued
+            if(!IsQueueEmpty(cq)
+            && MakeSyntheticItem(&extra, POOL_ITEMS + i, 1, 512))
+            {
+                AddFormatsToItem(cq, GetItem(cq, 0)->serial, &extra);
+            }
+        }
+        else if(choice < 96)
+        {
+            ResizeQueue(cq, 1 + NextRandom() % 64);
+        }
+        else if(choice < 98)
+        {
+            queue_policy.dynamic_queue = !queue_policy.dynamic_queue;
+        }
+        else
+        {
+            EmptyQueueAndResize(cq);
+        }
+
+        GetJournalStats(cq, &stats);
+        ends[i] = stats.size;
+        prints[i] = FingerprintQueue(cq);
+    }
+}
+
+
+/*******************************************************************
+** CheckCrashRecovery
+** ==================
+** Journals a random stream of operations, then for each of CUTS
+** random offsets, puts back the snapshot, cuts a copy of the
+** journal short there and opens the queue as QClip does at startup.
+*******************************************************************/
+void CheckCrashRecovery(ClipItem* pool)
+{
+    uint64_t ends[OPERATIONS + 1];
+    uint64_t prints[OPERATIONS + 1];
+    ClipQueue cq, replayed;
+    JournalStats stats;
+    BYTE* journal = NULL;
+    BYTE* snapshot = NULL;
+    uint64_t journal_size = 0, snapshot_size = 0;
+    unsigned long mid_operation = 0;
+    unsigned int i;
+    BOOL passed;
+
+    queue_policy.move_duplicates = TRUE;
+    queue_policy.byte_budget = BYTE_BUDGET;
+    bench_clipboard_unique = FALSE;
+
+    remove(journal_path);
+    remove(snapshot_path);
+
+    passed = CreateQueue(&cq, 16);
+
+    if(passed)
+    {
+        //The state before anything is recorded goes first
+        passed = OpenJournal(&cq, journal_path, snapshot_path, temp_path,
+            FALSE);
+        GetJournalStats(&cq, &stats);
+        ends[0] = stats.size;
+        prints[0] = FingerprintQueue(&cq);
+
+        RunOperations(&cq, pool, ends + 1, prints + 1);
+        GetJournalStats(&cq, &stats);
+        printf("  %-36s %10lu records %8.1f MB journal\n",
+            "random operations", stats.records,
+            stats.size / (1024.0 * 1024.0));
+
+        passed = passed && CloseJournal(&cq);
+        journal = ReadWholeFile(journal_path, &journal_size);
+        snapshot = ReadWholeFile(snapshot_path, &snapshot_size);
+        passed = passed && journal && snapshot
+            && (journal_size == stats.size);
+    }
+
+    //The whole journal replays to the same queue, payloads and all
+    if(passed)
+    {
+        passed = ReopenQueue(&replayed);
+
+        if(passed)
+        {
+            passed = (GetQueueLength(&replayed) == GetQueueLength(&cq));
+
+            for(i = 0; (i < GetQueueLength(&cq)) && passed; ++i)
+            {
+                passed = CompareClipItems(GetItem(&replayed, i),
+                    GetItem(&cq, i));
+            }
+
+            GetJournalStats(&replayed, &stats);
+            passed = passed && (stats.replayed > 0)
+                && (stats.discarded == 0);
+            DestroyQueue(&replayed);
+        }
+    }
+
+    if(!passed)
+    {
+        printf("  journal replay FAILED\n");
+        ++failed_checks;
+    }
+
+    for(i = 0; (i < CUTS) && passed; ++i)
+    {
+        CheckCut(((uint64_t) NextRandom() << 16 ^ NextRandom())
+            % (journal_size + 1), journal, snapshot, snapshot_size,
+            ends, prints, &mid_operation);
+    }
+
+    //And cuts right on and either side of operation boundaries
+    for(i = 0; (i < CUTS) && passed; ++i)
+    {
+        CheckCut(ends[NextRandom() % (OPERATIONS + 1)] + i % 3 - 1,
+            journal, snapshot, snapshot_size, ends, prints,
+            &mid_operation);
+    }
+
+    if(passed)
+    {
+        printf("  %-36s %10u cuts %8lu mid-operation\n",
+            "journal cut short", 2 * CUTS, mid_operation);
+    }
+
+    DestroyQueue(&cq);
+    FreeMemory(journal);
+    FreeMemory(snapshot);
+
+    bench_clipboard_unique = TRUE;
+    queue_policy.dynamic_queue = FALSE;
+    queue_policy.move_duplicates = FALSE;
+    queue_policy.byte_budget = 0;
+}
+
+
+/*******************************************************************
+** CheckSavedText
+** ==============
+** Journals and saves an item of text kept as UTF-8, and checks it's
+** written to both as CF_UNICODETEXT, which any QClip can read, and
+** comes back as UTF-8 when either is read.
+*******************************************************************/
+void CheckSavedText()
+{
+    ClipQueue cq, replayed;
+    ClipItem item, copy;
+    BYTE* file;
+    uint64_t size = 0;
+    unsigned int i, format = 0;
+    BOOL passed;
+
+    remove(journal_path);
+    remove(snapshot_path);
+
+    memset(&item, 0, sizeof(ClipItem));
+    item.data = (ClipData*) AllocMemory(sizeof(ClipData));
+    passed = (item.data != NULL);
+
+    if(passed)
+    {
+        item.formats = 1;
+        item.data[0].format = CF_UNICODETEXT;
+        item.data[0].size = TEXT_UNITS * 2;
+        item.data[0].memory = AllocBlob(TEXT_UNITS * 2);
+        passed = (item.data[0].memory != NULL);
+    }
+
+    if(passed)
+    {
+        for(i = 0; i < TEXT_UNITS; ++i)
+        {
+            ((uint16_t*) LockBlob(item.data[0].memory))[i] =
+                (uint16_t) ((i % 9) ? 'a' + i % 26 : 0x00E9);
+            UnlockBlob(item.data[0].memory);
+        }
+
+        PackClipText(&item.data[0]);
+        passed = (item.data[0].format == UTF8_TEXT_FORMAT)
+            && DuplicateClipItem(&copy, &item);
+    }
+
+    passed = passed && CreateQueue(&cq, 16);
+
+    if(passed)
+    {
+        passed = OpenJournal(&cq, journal_path, snapshot_path, temp_path,
+            FALSE);
+        PushItemFront(&cq, &copy);
+        passed = passed && CloseJournal(&cq);
+
+        file = ReadWholeFile(journal_path, &size);
+        passed = passed && file && (size > JOURNAL_FORMAT_OFFSET + 4);
+
+        if(file)
+        {
+            memcpy(&format, file + JOURNAL_FORMAT_OFFSET, 4);
+            FreeMemory(file);
+        }
+
+        passed = passed && (format == CF_UNICODETEXT)
+            && ReopenQueue(&replayed);
+
+        if(passed)
+        {
+            passed = (GetQueueLength(&replayed) == 1)
+                && CompareClipItems(GetItem(&replayed, 0), &item);
+            CloseJournal(&replayed);
+            DestroyQueue(&replayed);
+        }
+
+        //Now it's in the snapshot
+        format = 0;
+        passed = passed
+            && SaveQueueToPath(&cq, snapshot_path, temp_path);
+        remove(journal_path);
+
+        file = ReadWholeFile(snapshot_path, &size);
+        passed = passed && file && (size > FILE_FORMAT_OFFSET + 4);
+
+        if(file)
+        {
+            memcpy(&format, file + FILE_FORMAT_OFFSET, 4);
+            FreeMemory(file);
+        }
+
+        passed = passed && (format == CF_UNICODETEXT)
+            && ReopenQueue(&replayed);
+
+        if(passed)
+        {
+            passed = (GetQueueLength(&replayed) == 1)
+                && CompareClipItems(GetItem(&replayed, 0), &item);
+            CloseJournal(&replayed);
+            DestroyQueue(&replayed);
+        }
+
+        DestroyQueue(&cq);
+    }
+
+    DestroyClipItem(&item);
+
+    if(!passed)
+    {
+        printf("  saving text as CF_UNICODETEXT FAILED\n");
+        ++failed_checks;
+    }
+}
+
+
+/*******************************************************************
+** CheckCut
+** ========
+** Cuts the journal short at one offset, replays it, and checks the
+** queue.  A cut inside an operation that made several records
+** (a push that evicted, say) replays part of it; the journal must
+** still end on a whole record, and if that's where an operation
+** ended, the queue must match.
+**
+** Inputs:
+**      uint64_t cut            - the offset
+**      const BYTE* journal     - the whole journal
+**      const BYTE* snapshot    - the snapshot it goes with
+**      uint64_t snapshot_size  - its size
+**      uint64_t* ends          - journal size after each operation
+**      uint64_t* prints        - queue fingerprint after each
+**      unsigned long* mid_operation - counts cuts that replayed
+**                                part of an operation
+*******************************************************************/
+void CheckCut(uint64_t cut, const BYTE* journal, const BYTE* snapshot,
+    uint64_t snapshot_size, uint64_t* ends, uint64_t* prints,
+    unsigned long* mid_operation)
+{
+    ClipQueue cq;
+    JournalStats stats;
+    uint64_t length = 0;
+    unsigned int last = 0;
+    HANDLE fhand;
+    BOOL passed;
+
+    //ends goes up, but only so far as the journal was never
+    //compacted, which it isn't here
+    while((last < OPERATIONS) && (ends[last + 1] <= cut))
+    {
+        ++last;
+    }
+
+    passed = WriteWholeFile(snapshot_path, snapshot, snapshot_size)
+        && WriteWholeFile(journal_path, journal, cut)
+        && ReopenQueue(&cq);
+
+    if(passed)
+    {
+        GetJournalStats(&cq, &stats);
+
+        //Cut into the header, the journal starts again
+        passed = (stats.size <= cut) || (cut < ends[0]);
+        passed = passed && (stats.size >= ends[last]);
+
+        if(stats.size == ends[last])
+        {
+            passed = passed && (FingerprintQueue(&cq) == prints[last]);
+        }
+        else
+        {
+            ++(*mid_operation);
+        }
+
+        DestroyQueue(&cq);
+    }
+
+    //Cut back to the last whole record
+    fhand = OpenFileForReading(journal_path);
+    passed = passed && (fhand != INVALID_HANDLE_VALUE)
+        && GetFileLength(fhand, &length) && (length == stats.size);
+    CloseFileHandle(fhand);
+
+    if(!passed)
+    {
+        printf("  journal cut at %llu FAILED\n", (unsigned long long) cut);
+        ++failed_checks;
+    }
+}
+
+
+/*******************************************************************
+** CheckCompaction
+** ===============
+** Compacts a journal part way through, and checks the queue still
+** comes back whole.  Then puts the old journal back, as if QClip
+** had crashed after saving the snapshot but before starting the
+** journal again, and checks it isn't replayed on top.  Also checks
+** a small journal isn't compacted unless asked.
+*******************************************************************/
+void CheckCompaction(ClipItem* pool)
+{
+    ClipQueue cq, replayed;
+    JournalStats stats;
+    BYTE* old_journal = NULL;
+    uint64_t old_size = 0, print = 0;
+    unsigned int i;
+    BOOL passed;
+
+    remove(journal_path);
+    remove(snapshot_path);
+    bench_clipboard_unique = FALSE;
+
+    passed = CreateQueue(&cq, 64)
+        && OpenJournal(&cq, journal_path, snapshot_path, temp_path, FALSE);
+
+    for(i = 0; (i < POOL_ITEMS) && passed; ++i)
+    {
+        SetBenchClipboard(&pool[i]);
+        PushFront(&cq);
+
+        if(i == POOL_ITEMS / 2)
+        {
+            //Too small to be worth it, so just flushed
+            passed = CompactJournal(&cq, FALSE);
+            GetJournalStats(&cq, &stats);
+            passed = passed && (stats.compactions == 1);
+
+            old_journal = ReadWholeFile(journal_path, &old_size);
+            passed = passed && old_journal && CompactJournal(&cq, TRUE);
+            print = FingerprintQueue(&cq);
+        }
+    }
+
+    GetJournalStats(&cq, &stats);
+    passed = passed && (stats.compactions == 2) && CloseJournal(&cq);
+
+    if(passed)
+    {
+        passed = ReopenQueue(&replayed);
+
+        if(passed)
+        {
+            passed = (FingerprintQueue(&replayed) == FingerprintQueue(&cq));
+            DestroyQueue(&replayed);
+        }
+    }
+
+    passed = passed && WriteWholeFile(journal_path, old_journal, old_size);
+
+    if(passed)
+    {
+        passed = ReopenQueue(&replayed);
+
+        if(passed)
+        {
+            GetJournalStats(&replayed, &stats);
+            passed = (stats.replayed == 0)
+                && (FingerprintQueue(&replayed) == print);
+            DestroyQueue(&replayed);
+        }
+    }
+
+    if(!passed)
+    {
+        printf("  journal compaction FAILED\n");
+        ++failed_checks;
+    }
+
+    DestroyQueue(&cq);
+    FreeMemory(old_journal);
+    bench_clipboard_unique = TRUE;
+}
+
+
+/*******************************************************************
+** CheckAutosave
+** =============
+** Fills a journaled queue past the size at which it's compacted,
+** some of it packed, and checks AutosaveJournal holds off while
+** the queue is still changing.  Then autosaves twice, changing the
+** queue while each snapshot is saved.  The first is left to finish,
+** and the queue must come back as it is.  The second is treated as
+** a crash just after the snapshot was saved: the journal from
+** before it is put back, and the queue must come back as it was
+** when the save started.  The records not yet written by then were
+** written ahead of the snapshot, and are in it, so none are
+** replayed; the changes made during the save hadn't been written,
+** and are lost with the crash.
+*******************************************************************/
+void CheckAutosave(ClipItem* pool)
+{
+    ClipQueue cq, replayed;
+    ClipItem item;
+    JournalStats stats;
+    BYTE* old_journal = NULL;
+    BYTE* bytes;
+    uint64_t old_size = 0, print = 0;
+    unsigned int i;
+    BOOL passed;
+
+    remove(journal_path);
+    remove(snapshot_path);
+
+    passed = CreateQueue(&cq, 2 * AUTOSAVE_ITEMS)
+        && OpenJournal(&cq, journal_path, snapshot_path, temp_path, FALSE);
+
+    for(i = 0; (i < AUTOSAVE_ITEMS) && passed; ++i)
+    {
+        passed = MakeSyntheticItem(&item, POOL_ITEMS + i, 1,
+            AUTOSAVE_ITEM_SIZE);
+
+        //Every other one compresses, and is saved from its packed bytes
+        if(passed && (i % 2 == 0))
+        {
+            bytes = (BYTE*) LockBlob(item.data[0].memory);
+            memset(bytes + 16, 'q', AUTOSAVE_ITEM_SIZE - 16);
+            UnlockBlob(item.data[0].memory);
+
+            //Only shared payloads are packed
+            item.data[0].memory = InternBlob(item.data[0].memory);
+            item.data[0].hash = GetBlobHash(item.data[0].memory);
+        }
+
+        if(passed && (i % 2 == 0))
+        {
+            //Not packed while the journal holds it to be written
+            PushItemFront(&cq, &item);
+            WaitForWrites(&cq);
+            passed = CompressBlob(GetItem(&cq, 0)->data[0].memory);
+        }
+        else if(passed)
+        {
+            PushItemFront(&cq, &item);
+        }
+    }
+
+    //Just changed, so only flushed
+    passed = passed && AutosaveJournal(&cq, GetTicks());
+    GetJournalStats(&cq, &stats);
+    passed = passed && !stats.saving && (stats.compactions == 1)
+        && (stats.size >= JOURNAL_COMPACT_MIN);
+
+    passed = passed && AutosaveWhileChanging(&cq, pool, POOL_ITEMS / 2);
+
+    if(passed)
+    {
+        //Along with the changes made during the save
+        WaitForWrites(&cq);
+        passed = ReopenQueue(&replayed);
+
+        if(passed)
+        {
+            passed = CompareQueues(&replayed, &cq);
+            DestroyQueue(&replayed);
+        }
+    }
+
+    //Again, but the journal isn't started again before the "crash".
+    //Pushing out older items keeps the queue smaller than the journal.
+    for(i = 0; (i < 3 * AUTOSAVE_ITEMS) && passed; ++i)
+    {
+        passed = MakeSyntheticItem(&item, POOL_ITEMS + AUTOSAVE_ITEMS + i,
+            1, AUTOSAVE_ITEM_SIZE);
+
+        if(passed)
+        {
+            PushItemFront(&cq, &item);
+        }
+    }
+
+    if(passed)
+    {
+        WaitForWrites(&cq);
+        print = FingerprintQueue(&cq);
+        passed = AutosaveWhileChanging(&cq, pool, 0);
+
+        //Saved, but the journal not yet started again
+        do
+        {
+            YieldThread();
+            GetJournalStats(&cq, &stats);
+        }while(passed && stats.saving);
+
+        old_journal = ReadWholeFile(journal_path, &old_size);
+
+        passed = passed && old_journal && WaitForAutosave(&cq)
+            && CloseJournal(&cq)
+            && WriteWholeFile(journal_path, old_journal, old_size);
+    }
+
+    if(passed)
+    {
+        passed = ReopenQueue(&replayed);
+
+        if(passed)
+        {
+            GetJournalStats(&replayed, &stats);
+            passed = (stats.replayed == 0)
+                && (FingerprintQueue(&replayed) == print);
+            DestroyQueue(&replayed);
+        }
+    }
+
+    if(!passed)
+    {
+        printf("  autosave FAILED\n");
+        ++failed_checks;
+    }
+
+    DestroyQueue(&cq);
+    FreeMemory(old_journal);
+}
+
+
+/*******************************************************************
+** AutosaveWhileChanging
+** =====================
+** Starts an autosave, as if the queue had been left alone for a
+** while, and changes the queue as it's saved.
+**
+** Inputs:
+**      ClipQueue* cq           - a journaled queue, due an autosave
+**      ClipItem* pool          - items to copy
+**      unsigned int changes    - how many changes to make, then
+**                                wait for the save to finish; 0 to
+**                                make POOL_ITEMS / 4 and not wait
+**
+** Outputs:
+**      BOOL                    - TRUE if the save started, and
+**                                finished if it was waited for
+*******************************************************************/
+BOOL AutosaveWhileChanging(ClipQueue* cq, ClipItem* pool,
+    unsigned int changes)
+{
+    unsigned int i;
+    BOOL started;
+
+    WaitForWrites(cq);
+    started = AutosaveJournal(cq, GetTicks() + JOURNAL_QUIET_TIME);
+
+    for(i = 0; (i < (changes ? changes : POOL_ITEMS / 4)) && started; ++i)
+    {
+        SetBenchClipboard(&pool[i]);
+
+        if(i % 4 == 3)
+        {
+            DiscardBack(cq);
+        }
+        else
+        {
+            PushFront(cq);
+        }
+    }
+
+    return started && ((changes == 0) || WaitForAutosave(cq));
+}
+
+
+/*******************************************************************
+** WaitForAutosave
+** ===============
+** Waits for an autosave under way to finish, as the timer would.
+**
+** Inputs:
+**      ClipQueue* cq       - the queue
+**
+** Outputs:
+**      BOOL                - TRUE if it saved the queue
+*******************************************************************/
+BOOL WaitForAutosave(ClipQueue* cq)
+{
+    JournalStats stats;
+    unsigned int compactions;
+    double start = GetBenchTime();
+
+    GetJournalStats(cq, &stats);
+    compactions = stats.compactions;
+
+    while(stats.compactions == compactions)
+    {
+        YieldThread();
+
+        //Just changed, so no new autosave starts
+        if(!AutosaveJournal(cq, GetTicks())
+        || (GetBenchTime() - start > 10.0))
+        {
+            return FALSE;
+        }
+
+        GetJournalStats(cq, &stats);
+    }
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** WaitForWrites
+** =============
+** Has every record so far written, as AutosaveJournal does while
+** the queue is still changing, and waits until it's done, so the
+** next AutosaveJournal can start a save there and then.
+**
+** Inputs:
+**      ClipQueue* cq       - the queue
+*******************************************************************/
+void WaitForWrites(ClipQueue* cq)
+{
+    JournalStats stats;
+
+    GetJournalStats(cq, &stats);
+
+    while(stats.writing || (stats.unwritten > 0))
+    {
+        if(stats.writing)
+        {
+            YieldThread();
+        }
+        else
+        {
+            AutosaveJournal(cq, GetTicks());
+        }
+
+        GetJournalStats(cq, &stats);
+    }
+}
+
+
+/*******************************************************************
+** CompareQueues
+** =============
+** Compares two queues item by item, payloads and all.
+**
+** Outputs:
+**      BOOL                - TRUE if they match
+*******************************************************************/
+BOOL CompareQueues(ClipQueue* cq, ClipQueue* other)
+{
+    unsigned int i;
+    BOOL match = (GetQueueLength(cq) == GetQueueLength(other));
+
+    for(i = 0; (i < GetQueueLength(cq)) && match; ++i)
+    {
+        match = CompareClipItems(GetItem(cq, i), GetItem(other, i));
+    }
+
+    return match;
+}
+
+
+/*******************************************************************
+** BenchExit
+** =========
+** Copies EXIT_ITEMS items into a queue with and without a journal,
+** and compares what it costs to keep the journal up with what
+** saving the whole queue at exit costs, and how long replaying the
+** journal at startup takes.  Checks, taking the best of EXIT_ROUNDS
+** rounds, that closing the journal takes less time than saving the
+** queue would, and that the journal costs the queue's thread no
+** more than a quarter as much again as pushing the items does; it's
+** written on another thread, which the elapsed times include on a
+** single core.
+*******************************************************************/
+void BenchExit()
+{
+    ClipQueue cq;
+    ClipItem item;
+    JournalStats stats;
+    HANDLE fhand;
+    unsigned int i, pass, round;
+    double start, thread_start, elapsed[2], pushing[2], exiting[2];
+    BOOL saved, passed = TRUE;
+
+    //The best of a few rounds, since the journal's thread shares the
+    //machine with the queue's
+    for(round = 0; (round < EXIT_ROUNDS) && passed; ++round)
+    {
+        for(pass = 0; (pass < 2) && passed; ++pass)
+        {
+            remove(journal_path);
+            remove(snapshot_path);
+
+            passed = CreateQueue(&cq, EXIT_ITEMS)
+                && (!pass || OpenJournal(&cq, journal_path, snapshot_path,
+                    temp_path, FALSE));
+
+            start = GetBenchTime();
+            thread_start = GetBenchThreadTime();
+
+            for(i = 0; (i < EXIT_ITEMS) && passed; ++i)
+            {
+                passed = MakeSyntheticItem(&item, i, 1, EXIT_ITEM_SIZE);
+
+                if(passed)
+                {
+                    PushItemFront(&cq, &item);
+                }
+            }
+
+            thread_start = GetBenchThreadTime() - thread_start;
+
+            if((round == 0) || (thread_start < pushing[pass]))
+            {
+                pushing[pass] = thread_start;
+                elapsed[pass] = GetBenchTime() - start;
+            }
+
+            start = GetBenchTime();
+
+            if(pass)
+            {
+                GetJournalStats(&cq, &stats);
+                saved = CloseJournal(&cq);
+            }
+            else
+            {
+                fhand = OpenFileForWriting(snapshot_path);
+                saved = (fhand != INVALID_HANDLE_VALUE)
+                    && SaveQueueToFile(&cq, fhand);
+                CloseFileHandle(fhand);
+            }
+
+            start = GetBenchTime() - start;
+
+            if((round == 0) || (start < exiting[pass]))
+            {
+                exiting[pass] = start;
+            }
+
+            passed = passed && saved;
+            DestroyQueue(&cq);
+        }
+    }
+
+    if(passed)
+    {
+        ReportRate("PushItemFront 4 KB, no journal", EXIT_ITEMS,
+            (double) EXIT_ITEMS * EXIT_ITEM_SIZE, elapsed[0]);
+        printf("  %-36s %10.1f ms\n", "exit, saving every item",
+            exiting[0] * 1000.0);
+        ReportRate("PushItemFront 4 KB, journaled", EXIT_ITEMS,
+            (double) EXIT_ITEMS * EXIT_ITEM_SIZE, elapsed[1]);
+        printf("  %-36s %10.1f ms %8.1f MB left to write\n",
+            "exit, closing the journal", exiting[1] * 1000.0,
+            stats.unwritten / (1024.0 * 1024.0));
+        printf("  %-36s %10.1f ms %8.1f ms journaled\n",
+            "pushing, on the queue's thread", pushing[0] * 1000.0,
+            pushing[1] * 1000.0);
+
+        passed = (exiting[1] < exiting[0])
+            && (pushing[1] < pushing[0] * 1.25);
+    }
+
+    if(passed)
+    {
+        start = GetBenchTime();
+        passed = ReopenQueue(&cq);
+
+        printf("  %-36s %10.1f ms %8.1f MB journal\n", "startup, replaying",
+            (GetBenchTime() - start) * 1000.0,
+            stats.size / (1024.0 * 1024.0));
+
+        passed = passed && (GetQueueLength(&cq) == EXIT_ITEMS);
+        DestroyQueue(&cq);
+    }
+
+    if(!passed)
+    {
+        printf("  journaled exit FAILED\n");
+        ++failed_checks;
+    }
+}
+
+
+/*******************************************************************
+** BenchAutosave
+** =============
+** Saves a queue of STALL_ITEMS items in the background, and then
+** there and then, comparing how long the queue is held up by each.
+** Half the items haven't been read from the snapshot they were
+** loaded from yet, and the other half are in the spill file.
+** Checks the background save reads none of them in, and holds up
+** the queue for a fraction of the time the other does.
+*******************************************************************/
+void BenchAutosave()
+{
+    ClipQueue cq, replayed;
+    ClipItem item;
+    BlobStoreStats before, after;
+    double start, stall, saved, foreground;
+    unsigned int i;
+    BOOL passed;
+
+    remove(journal_path);
+    remove(snapshot_path);
+
+    passed = CreateQueue(&cq, STALL_ITEMS)
+        && OpenJournal(&cq, journal_path, snapshot_path, temp_path, FALSE);
+
+    for(i = 0; (i < STALL_ITEMS / 2) && passed; ++i)
+    {
+        passed = MakeSyntheticItem(&item, i, 1, STALL_ITEM_SIZE);
+
+        if(passed)
+        {
+            //Not text, which is read in as it's loaded
+            item.data[0].format = CF_TEXT;
+            PushItemFront(&cq, &item);
+        }
+    }
+
+    passed = passed && CompactJournal(&cq, TRUE) && CloseJournal(&cq);
+    DestroyQueue(&cq);
+
+    passed = passed && ReopenQueue(&cq)
+        && SetBlobSpill(GetBenchFile("journal.spill"), STALL_ITEM_SIZE);
+    passed = passed && ResizeQueue(&cq, STALL_ITEMS);
+
+    //Twice the other half, and every other one discarded, so the
+    //journal outgrows the queue and an autosave is due
+    for(i = 0; (i < STALL_ITEMS) && passed; ++i)
+    {
+        passed = MakeSyntheticItem(&item, STALL_ITEMS + i, 1,
+            STALL_ITEM_SIZE);
+
+        if(passed)
+        {
+            item.data[0].format = CF_TEXT;
+            item.data[0].memory = InternBlob(item.data[0].memory);
+            PushItemFront(&cq, &item);
+
+            if(i % 2 == 0)
+            {
+                DiscardFront(&cq);
+            }
+        }
+    }
+
+    WaitForWrites(&cq);
+    GetBlobStoreStats(&before);
+    passed = passed && (GetQueueLength(&cq) == STALL_ITEMS)
+        && (before.lazy_bytes >= STALL_ITEMS / 2 * STALL_ITEM_SIZE)
+        && (before.spilled_bytes >= STALL_ITEMS / 2 * STALL_ITEM_SIZE);
+
+    if(passed)
+    {
+        start = GetBenchTime();
+        passed = AutosaveJournal(&cq, GetTicks() + JOURNAL_QUIET_TIME);
+        stall = GetBenchTime() - start;
+        GetBlobStoreStats(&after);
+
+        passed = passed && (after.lazy_bytes == before.lazy_bytes)
+            && (after.spilled_bytes == before.spilled_bytes)
+            && WaitForAutosave(&cq);
+        saved = GetBenchTime() - start;
+        GetBlobStoreStats(&after);
+
+        printf("  %-36s %10.1f ms stall %8.1f ms to save\n",
+            "autosave 10000 items, background", stall * 1000.0,
+            saved * 1000.0);
+
+        //Still lazy, and read from the snapshot that was replaced
+        passed = passed && (after.lazy_bytes == before.lazy_bytes)
+            && ReopenQueue(&replayed);
+
+        if(passed)
+        {
+            passed = CompareQueues(&replayed, &cq);
+            DestroyQueue(&replayed);
+        }
+
+        start = GetBenchTime();
+        passed = passed && CompactJournal(&cq, TRUE);
+        foreground = GetBenchTime() - start;
+
+        printf("  %-36s %10.1f ms stall\n",
+            "autosave 10000 items, foreground", foreground * 1000.0);
+
+        passed = passed && (stall * 4 < foreground);
+    }
+
+    if(!passed)
+    {
+        printf("  autosave stall FAILED\n");
+        ++failed_checks;
+    }
+
+    DestroyQueue(&cq);
+    SetBlobSpill(NULL, 0);
+}
+
+
+/*******************************************************************
+** ReopenQueue
+** ===========
+** Does what OpenQueueFromDefault does: loads the snapshot, if
+** there is one, and replays the journal on top.
+**
+** Inputs:
+**      ClipQueue* cq       - receives the queue, journaled
+**
+** Outputs:
+**      BOOL                - FALSE if out of memory or the journal
+**                            couldn't be opened
+*******************************************************************/
+BOOL ReopenQueue(ClipQueue* cq)
+{
+    HANDLE fhand = OpenFileForReading(snapshot_path);
+    BOOL loaded = (fhand != INVALID_HANDLE_VALUE)
+        && LoadQueueFromFile(cq, fhand);
+
+    CloseFileHandle(fhand);
+
+    if(!loaded && !CreateQueue(cq, 16))
+    {
+        return FALSE;
+    }
+
+    if(!OpenJournal(cq, journal_path, snapshot_path, temp_path, TRUE))
+    {
+        DestroyQueue(cq);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** FingerprintQueue
+** ================
+** Hashes what's in a queue, in order.
+**
+** Outputs:
+**      uint64_t            - the fingerprint
+*******************************************************************/
+uint64_t FingerprintQueue(ClipQueue* cq)
+{
+    uint64_t print = GetQueueLength(cq), hash;
+    unsigned int i;
+
+    for(i = 0; i < GetQueueLength(cq); ++i)
+    {
+        hash = HashClipItem(GetItem(cq, i));
+        print = HashBytes(&hash, sizeof(hash), print);
+    }
+
+    return print;
+}
+
+
+/*******************************************************************
+** ReadWholeFile
+** =============
+** Reads a file into memory.
+**
+** Inputs:
+**      const char* path    - the file
+**      uint64_t* size      - receives its size
+**
+** Outputs:
+**      BYTE*               - its contents, for FreeMemory, or NULL
+*******************************************************************/
+BYTE* ReadWholeFile(const char* path, uint64_t* size)
+{
+    HANDLE fhand = OpenFileForReading(path);
+    BYTE* bytes = NULL;
+
+    if(fhand == INVALID_HANDLE_VALUE)
+    {
+        return NULL;
+    }
+
+    if(GetFileLength(fhand, size))
+    {
+        bytes = (BYTE*) AllocMemory((size_t) *size + 1);
+
+        if(bytes && !ReadBytesAt(fhand, 0, bytes, (size_t) *size))
+        {
+            FreeMemory(bytes);
+            bytes = NULL;
+        }
+    }
+
+    CloseFileHandle(fhand);
+
+    return bytes;
+}
+
+
+/*******************************************************************
+** WriteWholeFile
+** ==============
+** Replaces a file with the given bytes.
+**
+** Inputs:
+**      const char* path    - the file
+**      const BYTE* bytes   - its new contents
+**      uint64_t size       - how many
+**
+** Outputs:
+**      BOOL                - TRUE on success
+*******************************************************************/
+BOOL WriteWholeFile(const char* path, const BYTE* bytes, uint64_t size)
+{
+    HANDLE fhand = OpenFileForWriting(path);
+    BOOL written = (fhand != INVALID_HANDLE_VALUE)
+        && ((size == 0) || WriteBytes(fhand, bytes, (size_t) size));
+
+    CloseFileHandle(fhand);
+
+    return written;
+}
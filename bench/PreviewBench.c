@@ -0,0 +1,516 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include <stdio.h>
+#include <string.h>
+#include "Bench.h"
+#include "BlobStore.h"
+#include "ClipQueue.h"
+#include "ClipCapture.h"
+#include "ClipSerialize.h"
+
+#define CF_DIBV5            17
+#define QUEUE_ITEMS         5000
+#define COLD_POSITION       20
+#define POPUP_OPENS         20
+#define TEXT_UNITS          2048
+#define DIB_HEADER_SIZE     40
+#define DIB_SIZE            (DIB_HEADER_SIZE + 64 * 64 * 4)
+#define MAX_FILES           9
+#define LABEL_LENGTH        64
+
+static BOOL FillQueue(ClipQueue* cq);
+static BOOL CaptureKind(ClipItem* item, unsigned int seed);
+static size_t WriteText(uint16_t* text, unsigned int seed);
+static size_t WriteDib(BYTE* bytes, unsigned int seed);
+static size_t WriteFileList(BYTE* bytes, unsigned int seed);
+static void FormatLabel(char* label, ClipPreview* preview);
+static void BenchPopup(ClipQueue* cq, BOOL cached);
+static BOOL CheckPreview(ClipItem* item, unsigned int seed);
+static void CheckChanges();
+static void CheckReload(ClipQueue* cq);
+
+static const char* words[] =
+{
+    "queue", "clip", "paste", "copy", "format", "the", "of", "and",
+    "memory", "bitmap", "text", "file", "drop", "rich", "a", "window",
+};
+
+
+//Checks that have failed
+static unsigned int failed_checks = 0;
+
+
+/*******************************************************************
+** RunPreviewBench
+** ===============
+** Fills a long queue with text, file lists and bitmaps, most of
+** them compressed as cold items, and times describing every item
+** for the popup menu: from the payloads, as each popup used to, and
+** from the previews worked out when they were queued.  Checks the
+** previews are right, follow changes to their items, and come back
+** when the queue is loaded from a file.
+**
+** Outputs:
+**      unsigned int        - how many checks failed
+*******************************************************************/
+unsigned int RunPreviewBench()
+{
+    ClipQueue cq;
+
+    queue_policy.cold_position = COLD_POSITION;
+
+    if(CreateQueue(&cq, QUEUE_ITEMS) && FillQueue(&cq))
+    {
+        BenchPopup(&cq, FALSE);
+        BenchPopup(&cq, TRUE);
+        CheckReload(&cq);
+    }
+
+    DestroyQueue(&cq);
+    queue_policy.cold_position = 0;
+
+    CheckChanges();
+
+    return failed_checks;
+}
+
+
+/*******************************************************************
+** FillQueue
+** =========
+** Captures QUEUE_ITEMS items, a third of each kind, and checks the
+** preview of each as it's queued.
+**
+** Outputs:
+**      BOOL                - FALSE if out of memory
+*******************************************************************/
+BOOL FillQueue(ClipQueue* cq)
+{
+    ClipItem item;
+    unsigned int i;
+    BOOL passed = TRUE;
+
+    for(i = 0; i < QUEUE_ITEMS; ++i)
+    {
+        if(!CaptureKind(&item, i))
+        {
+            return FALSE;
+        }
+
+        PushItemFront(cq, &item);
+        passed = passed && CheckPreview(GetItem(cq, 0), i);
+    }
+
+    if(!passed)
+    {
+        printf("  previews on push FAILED\n");
+        ++failed_checks;
+    }
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** CaptureKind
+** ===========
+** Captures one item: UTF-16 text (kept as UTF-8), a file list or a
+** bitmap, depending on the seed.
+**
+** Inputs:
+**      ClipItem* item      - receives the item
+**      unsigned int seed   - picks the kind and contents
+**
+** Outputs:
+**      BOOL                - FALSE if out of memory
+*******************************************************************/
+BOOL CaptureKind(ClipItem* item, unsigned int seed)
+{
+    static uint16_t text[TEXT_UNITS];
+    static BYTE bytes[DIB_SIZE];
+    ClipCapture capture;
+    BOOL added;
+
+    if(!CreateCapture(&capture, 1, GetMicroTicks()))
+    {
+        return FALSE;
+    }
+
+    switch(seed % 3)
+    {
+    case 0:
+        added = AddCaptureText(&capture, text,
+            WriteText(text, seed) * 2, GetMicroTicks());
+        break;
+
+    case 1:
+        added = AddCaptureData(&capture, CF_HDROP, bytes,
+            WriteFileList(bytes, seed), GetMicroTicks());
+        break;
+
+    default:
+        added = AddCaptureData(&capture, (seed & 1) ? CF_DIBV5 : CF_DIB,
+            bytes, WriteDib(bytes, seed), GetMicroTicks());
+        break;
+    }
+
+    if(!added)
+    {
+        DestroyCapture(&capture);
+        return FALSE;
+    }
+
+    return AdoptCapture(&capture, item) > 0;
+}
+
+
+/*******************************************************************
+** WriteText
+** =========
+** Writes a terminated run of words, numbered so no two are alike,
+** with an accented letter in it.
+**
+** Outputs:
+**      size_t              - units written, terminator included
+*******************************************************************/
+size_t WriteText(uint16_t* text, unsigned int seed)
+{
+    char words_text[TEXT_UNITS];
+    size_t length, i;
+    unsigned int count = 20 + seed % 200;
+
+    length = snprintf(words_text, sizeof(words_text), "%u", seed);
+
+    for(i = 0; (i < count) && (length + 16 < sizeof(words_text)); ++i)
+    {
+        length += snprintf(words_text + length, sizeof(words_text) - length,
+            " %s", words[(seed * 31 + i * 7) % 16]);
+    }
+
+    for(i = 0; i <= length; ++i)
+    {
+        text[i] = (BYTE) words_text[i];
+    }
+
+    text[2] = 0x00E9;
+
+    return length + 1;
+}
+
+
+/*******************************************************************
+** WriteDib
+** ========
+** Writes a BITMAPINFOHEADER, sized from the seed, and some pixels.
+**
+** Outputs:
+**      size_t              - bytes written
+*******************************************************************/
+size_t WriteDib(BYTE* bytes, unsigned int seed)
+{
+    int32_t header_size = DIB_HEADER_SIZE;
+    int32_t width = 1 + seed % 4000;
+    int32_t height = (seed & 2) ? -(int32_t) (seed % 3000) : 64;
+    uint16_t planes = 1, bits = 32;
+
+    FillSyntheticBytes(bytes, DIB_SIZE, seed);
+    memcpy(bytes, &header_size, sizeof(header_size));
+    memcpy(bytes + 4, &width, sizeof(width));
+    memcpy(bytes + 8, &height, sizeof(height));
+    memcpy(bytes + 12, &planes, sizeof(planes));
+    memcpy(bytes + 14, &bits, sizeof(bits));
+
+    return DIB_SIZE;
+}
+
+
+/*******************************************************************
+** WriteFileList
+** =============
+** Writes a CF_HDROP of 1 to MAX_FILES UTF-16 paths.
+**
+** Outputs:
+**      size_t              - bytes written
+*******************************************************************/
+size_t WriteFileList(BYTE* bytes, unsigned int seed)
+{
+    uint32_t files = HDROP_HEADER_SIZE, wide = TRUE;
+    unsigned int i, count = 1 + seed % MAX_FILES;
+    size_t length = HDROP_HEADER_SIZE, j;
+    char path[64];
+
+    memset(bytes, 0, HDROP_HEADER_SIZE);
+    memcpy(bytes + HDROP_FILES_OFFSET, &files, sizeof(files));
+    memcpy(bytes + HDROP_WIDE_OFFSET, &wide, sizeof(wide));
+
+    for(i = 0; i < count; ++i)
+    {
+        snprintf(path, sizeof(path), "C:\\Users\\me\\%s\\%u.txt",
+            words[(seed + i) % 16], seed * MAX_FILES + i);
+
+        for(j = 0; j <= strlen(path); ++j)
+        {
+            bytes[length++] = (BYTE) path[j];
+            bytes[length++] = 0;
+        }
+    }
+
+    bytes[length++] = 0;
+    bytes[length++] = 0;
+
+    return length;
+}
+
+
+/*******************************************************************
+** FormatLabel
+** ===========
+** Does what AddClipItemToMenu does with a preview, less the menu.
+**
+** Inputs:
+**      char* label             - LABEL_LENGTH characters for the label
+**      ClipPreview* preview    - the preview; may be NULL
+*******************************************************************/
+void FormatLabel(char* label, ClipPreview* preview)
+{
+    unsigned int i;
+
+    switch(preview ? preview->format : 0)
+    {
+    case CF_UNICODETEXT:
+        for(i = 0; preview->text.wide[i]; ++i)
+        {
+            label[i] = (preview->text.wide[i] < 0x80)
+                ? (char) preview->text.wide[i] : '?';
+        }
+
+        label[i] = '\0';
+        break;
+
+    case CF_HDROP:
+        snprintf(label, LABEL_LENGTH, "[Files (%u)]", preview->files);
+        break;
+
+    case CF_DIB:
+    case CF_DIBV5:
+        snprintf(label, LABEL_LENGTH, "[Bitmap - %dx%dx%u]",
+            (int) preview->width, (int) preview->height, preview->bits);
+        break;
+
+    default:
+        snprintf(label, LABEL_LENGTH, "[Binary Data]");
+        break;
+    }
+}
+
+
+/*******************************************************************
+** BenchPopup
+** ==========
+** Labels every item in the queue POPUP_OPENS times, as opening the
+** popup menu does.
+**
+** Inputs:
+**      ClipQueue* cq       - the queue
+**      BOOL cached         - TRUE to use the items' previews, FALSE
+**                            to work each one out from the payloads
+*******************************************************************/
+void BenchPopup(ClipQueue* cq, BOOL cached)
+{
+    char label[LABEL_LENGTH];
+    ClipItem scratch;
+    unsigned int i, open;
+    double start = GetBenchTime();
+
+    for(open = 0; open < POPUP_OPENS; ++open)
+    {
+        for(i = 0; i < GetQueueLength(cq); ++i)
+        {
+            if(cached)
+            {
+                FormatLabel(label, GetItem(cq, i)->preview);
+                continue;
+            }
+
+            scratch = *GetItem(cq, i);
+            scratch.preview = NULL;
+            UpdateClipPreview(&scratch);
+            FormatLabel(label, scratch.preview);
+            FreeMemory(scratch.preview);
+        }
+    }
+
+    snprintf(label, sizeof(label), "open popup, %u items, %s",
+        QUEUE_ITEMS, cached ? "cached" : "from payloads");
+    ReportRate(label, POPUP_OPENS, 0, GetBenchTime() - start);
+}
+
+
+/*******************************************************************
+** CheckPreview
+** ============
+** Checks an item's preview against what CaptureKind put in it.
+**
+** Inputs:
+**      ClipItem* item      - the item
+**      unsigned int seed   - what it was captured from
+**
+** Outputs:
+**      BOOL                - TRUE if the preview is right
+*******************************************************************/
+BOOL CheckPreview(ClipItem* item, unsigned int seed)
+{
+    static uint16_t text[TEXT_UNITS];
+    static BYTE bytes[DIB_SIZE];
+    ClipPreview* preview = item->preview;
+    int32_t width, height;
+
+    if(!preview)
+    {
+        return FALSE;
+    }
+
+    switch(seed % 3)
+    {
+    case 0:
+        WriteText(text, seed);
+        return (preview->format == CF_UNICODETEXT)
+            && (memcmp(preview->text.wide, text,
+                PREVIEW_TEXT_LENGTH * 2) == 0)
+            && (preview->text.wide[PREVIEW_TEXT_LENGTH] == 0);
+
+    case 1:
+        return (preview->format == CF_HDROP)
+            && (preview->files == 1 + seed % MAX_FILES);
+
+    default:
+        WriteDib(bytes, seed);
+        memcpy(&width, bytes + 4, sizeof(width));
+        memcpy(&height, bytes + 8, sizeof(height));
+
+        return (preview->format == ((seed & 1) ? CF_DIBV5 : CF_DIB))
+            && (preview->width == width) && (preview->height == height)
+            && (preview->bits == 32);
+    }
+}
+
+
+/*******************************************************************
+** CheckChanges
+** ============
+** Checks a preview follows its item: a bitmap merged in front of
+** text is shown instead, the text again once the bitmap is dropped,
+** and a duplicate has a preview of its own.
+*******************************************************************/
+void CheckChanges()
+{
+    ClipQueue cq;
+    ClipItem extra, copy;
+    ClipItem* item;
+    BOOL passed = FALSE;
+
+    if(!CreateQueue(&cq, 4) || !CaptureKind(&extra, 0))
+    {
+        DestroyQueue(&cq);
+        return;
+    }
+
+    PushItemFront(&cq, &extra);
+    item = GetItem(&cq, 0);
+
+    if(CaptureKind(&extra, 2)
+    && AddFormatsToItem(&cq, cq.serial, &extra))
+    {
+        passed = CheckPreview(item, 2);
+        RemoveClipFormat(item, 0);
+        passed = passed && CheckPreview(item, 0);
+
+        if(DuplicateClipItem(&copy, item))
+        {
+            passed = passed && copy.preview
+                && (copy.preview != item->preview) && CheckPreview(&copy, 0);
+            DestroyClipItem(&copy);
+        }
+    }
+
+    if(!passed)
+    {
+        printf("  previews following changes FAILED\n");
+        ++failed_checks;
+    }
+
+    DestroyQueue(&cq);
+}
+
+
+/*******************************************************************
+** CheckReload
+** ===========
+** Saves the queue, loads it back and checks the loaded items have
+** their previews from the start.
+**
+** Inputs:
+**      ClipQueue* cq       - the queue
+*******************************************************************/
+void CheckReload(ClipQueue* cq)
+{
+    const char* path = GetBenchFile("preview.qcl");
+    ClipQueue loaded;
+    HANDLE fhand;
+    unsigned int i;
+    BOOL passed = FALSE;
+
+    fhand = OpenFileForWriting(path);
+
+    if(fhand != INVALID_HANDLE_VALUE)
+    {
+        passed = SaveQueueToFile(cq, fhand);
+        CloseFileHandle(fhand);
+    }
+
+    fhand = passed ? OpenFileForReading(path) : INVALID_HANDLE_VALUE;
+    passed = FALSE;
+
+    if(fhand != INVALID_HANDLE_VALUE)
+    {
+        passed = LoadQueueFromFile(&loaded, fhand);
+        CloseFileHandle(fhand);
+
+        for(i = 0; passed && (i < GetQueueLength(&loaded)); ++i)
+        {
+            passed = CheckPreview(GetItem(&loaded, i), QUEUE_ITEMS - 1 - i);
+        }
+
+        if(passed)
+        {
+            DestroyQueue(&loaded);
+        }
+    }
+
+    remove(path);
+
+    if(!passed)
+    {
+        printf("  previews on load FAILED\n");
+        ++failed_checks;
+    }
+}
@@ -0,0 +1,415 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include <stdio.h>
+#include "Bench.h"
+#include "ClipQueue.h"
+#include "ClipSerialize.h"
+
+#define POOL_SIZE           64      //distinct items, so none are duplicates
+#define QUEUE_SIZE          1000
+#define PUSH_COUNT          200000
+#define RESIZE_ITEMS        3000
+#define RESIZE_CYCLES       2000
+#define DYNAMIC_ITEMS       100000
+#define FILE_ITEMS          10000
+#define POP_BYTES           (64 * 1024 * 1024)  //most to queue for popping
+
+static BOOL CreatePool(ClipItem* pool, unsigned int formats, size_t size);
+static void DestroyPool(ClipItem* pool);
+static void FillQueue(ClipQueue* cq, ClipItem* pool, unsigned int count);
+static void BenchPushFront(unsigned int formats, size_t size);
+static void BenchPopBack(unsigned int formats, size_t size);
+static void BenchResize();
+static void BenchDynamic();
+static void BenchFile(unsigned int formats, size_t size);
+
+
+//Checks that have failed
+static unsigned int failed_checks = 0;
+
+
+/*******************************************************************
+** RunQueueBench
+** =============
+** Drives the queue and the .qcl serializer with synthetic items.
+**
+** Outputs:
+**      unsigned int        - how many checks failed
+*******************************************************************/
+unsigned int RunQueueBench()
+{
+    BenchPushFront(1, 64);
+    BenchPushFront(2, 1024);
+    BenchPushFront(4, 64 * 1024);
+    BenchPopBack(2, 1024);
+    BenchPopBack(4, 64 * 1024);
+    BenchPopBack(1, 1024 * 1024);
+    BenchResize();
+    BenchDynamic();
+    BenchFile(2, 1024);
+    BenchFile(1, 1024 * 1024);
+
+    return failed_checks;
+}
+
+
+/*******************************************************************
+** CreatePool
+** ==========
+** Makes a set of distinct synthetic items to cycle through.
+**
+** Inputs:
+**      ClipItem* pool          - array of POOL_SIZE items
+**      unsigned int formats    - formats per item
+**      size_t size             - bytes per format
+**
+** Outputs:
+**      BOOL                    - TRUE on success
+*******************************************************************/
+BOOL CreatePool(ClipItem* pool, unsigned int formats, size_t size)
+{
+    unsigned int i;
+    BOOL success = TRUE;
+
+    for(i = 0; i < POOL_SIZE; ++i)
+    {
+        pool[i].data = NULL;
+        pool[i].formats = 0;
+        pool[i].preview = NULL;
+    }
+
+    for(i = 0; (i < POOL_SIZE) && success; ++i)
+    {
+        success = MakeSyntheticItem(&pool[i], i, formats, size);
+    }
+
+    if(!success)
+    {
+        DestroyPool(pool);
+    }
+
+    return success;
+}
+
+
+/*******************************************************************
+** DestroyPool
+** ===========
+** Frees the items made by CreatePool.
+**
+** Inputs:
+**      ClipItem* pool          - array of POOL_SIZE items
+*******************************************************************/
+void DestroyPool(ClipItem* pool)
+{
+    unsigned int i;
+
+    SetBenchClipboard(NULL);
+
+    for(i = 0; i < POOL_SIZE; ++i)
+    {
+        DestroyClipItem(&pool[i]);
+    }
+}
+
+
+/*******************************************************************
+** FillQueue
+** =========
+** Pushes items from a pool onto the front of a queue.
+**
+** Inputs:
+**      ClipQueue* cq           - the queue
+**      ClipItem* pool          - array of POOL_SIZE items
+**      unsigned int count      - number of items to push
+*******************************************************************/
+void FillQueue(ClipQueue* cq, ClipItem* pool, unsigned int count)
+{
+    unsigned int i;
+
+    for(i = 0; i < count; ++i)
+    {
+        SetBenchClipboard(&pool[i % POOL_SIZE]);
+        PushFront(cq);
+    }
+}
+
+
+/*******************************************************************
+** BenchPushFront
+** ==============
+** Measures PushFront into a full, fixed size queue, so every push
+** also evicts the oldest item.
+*******************************************************************/
+void BenchPushFront(unsigned int formats, size_t size)
+{
+    ClipItem pool[POOL_SIZE];
+    ClipQueue cq;
+    unsigned int count = PUSH_COUNT;
+    char label[64];
+    double start;
+
+    //Keep big items from taking all day
+    if(size * formats > 64 * 1024)
+    {
+        count /= 20;
+    }
+
+    queue_policy.dynamic_queue = FALSE;
+
+    if(CreatePool(pool, formats, size) && CreateQueue(&cq, QUEUE_SIZE))
+    {
+        FillQueue(&cq, pool, QUEUE_SIZE);
+
+        start = GetBenchTime();
+        FillQueue(&cq, pool, count);
+
+        snprintf(label, sizeof(label), "PushFront %ux%lu B",
+            formats, (unsigned long) size);
+        ReportRate(label, count, (double) count * formats * size,
+            GetBenchTime() - start);
+
+        DestroyQueue(&cq);
+        DestroyPool(pool);
+    }
+}
+
+
+/*******************************************************************
+** BenchPopBack
+** ============
+** Measures PopBack draining a full queue, which hands payloads
+** over, against the copy a peek followed by a discard makes.
+*******************************************************************/
+void BenchPopBack(unsigned int formats, size_t size)
+{
+    ClipItem pool[POOL_SIZE];
+    ClipQueue cq;
+    unsigned int items = QUEUE_SIZE;
+    unsigned int count;
+    unsigned long moves;
+    char label[64];
+    double start;
+
+    queue_policy.dynamic_queue = FALSE;
+
+    if((size_t) items * formats * size > POP_BYTES)
+    {
+        items = (unsigned int) (POP_BYTES / (formats * size));
+    }
+
+    if(CreatePool(pool, formats, size) && CreateQueue(&cq, items))
+    {
+        FillQueue(&cq, pool, items);
+
+        moves = bench_clipboard_moves;
+        count = 0;
+        start = GetBenchTime();
+
+        while(PopBack(&cq) > 0)
+        {
+            ++count;
+        }
+
+        snprintf(label, sizeof(label), "PopBack %ux%lu B",
+            formats, (unsigned long) size);
+        ReportRate(label, count, (double) count * formats * size,
+            GetBenchTime() - start);
+        printf("  %-36s %10lu formats handed over\n", "",
+            bench_clipboard_moves - moves);
+
+        FillQueue(&cq, pool, items);
+
+        count = 0;
+        start = GetBenchTime();
+
+        while(PeekBack(&cq) > 0)
+        {
+            DiscardBack(&cq);
+            ++count;
+        }
+
+        snprintf(label, sizeof(label), "PeekBack+DiscardBack %ux%lu B",
+            formats, (unsigned long) size);
+        ReportRate(label, count, (double) count * formats * size,
+            GetBenchTime() - start);
+
+        DestroyQueue(&cq);
+        DestroyPool(pool);
+    }
+}
+
+
+/*******************************************************************
+** BenchResize
+** ===========
+** Measures ResizeQueue bouncing a partly full queue between two
+** capacities, as CheckDynamicSize does near a boundary.
+*******************************************************************/
+void BenchResize()
+{
+    ClipItem pool[POOL_SIZE];
+    ClipQueue cq;
+    unsigned int i;
+    double start;
+
+    queue_policy.dynamic_queue = FALSE;
+
+    if(CreatePool(pool, 1, 64) && CreateQueue(&cq, RESIZE_ITEMS * 2))
+    {
+        FillQueue(&cq, pool, RESIZE_ITEMS);
+
+        start = GetBenchTime();
+
+        for(i = 0; i < RESIZE_CYCLES; ++i)
+        {
+            ResizeQueue(&cq, (i & 1) ? RESIZE_ITEMS * 2 : RESIZE_ITEMS * 4);
+        }
+
+        ReportRate("ResizeQueue 3000 items", RESIZE_CYCLES, 0,
+            GetBenchTime() - start);
+
+        DestroyQueue(&cq);
+        DestroyPool(pool);
+    }
+}
+
+
+/*******************************************************************
+** BenchDynamic
+** ============
+** Measures a dynamic queue growing from empty and shrinking back,
+** which includes every resize CheckDynamicSize triggers.
+*******************************************************************/
+void BenchDynamic()
+{
+    ClipItem pool[POOL_SIZE];
+    ClipQueue cq;
+    unsigned int i;
+    double start;
+
+    queue_policy.dynamic_queue = TRUE;
+
+    if(CreatePool(pool, 1, 64) && CreateQueue(&cq, 16))
+    {
+        start = GetBenchTime();
+
+        FillQueue(&cq, pool, DYNAMIC_ITEMS);
+
+        for(i = 0; i < DYNAMIC_ITEMS; ++i)
+        {
+            DiscardBack(&cq);
+        }
+
+        ReportRate("Dynamic grow+shrink 64 B", DYNAMIC_ITEMS * 2, 0,
+            GetBenchTime() - start);
+
+        DestroyQueue(&cq);
+        DestroyPool(pool);
+    }
+
+    queue_policy.dynamic_queue = FALSE;
+}
+
+
+/*******************************************************************
+** BenchFile
+** =========
+** Measures SaveQueueToFile and LoadQueueFromFile on a scratch file.
+*******************************************************************/
+void BenchFile(unsigned int formats, size_t size)
+{
+    ClipItem pool[POOL_SIZE];
+    ClipQueue cq, loaded;
+    unsigned int items = FILE_ITEMS;
+    const char* path = GetBenchFile("queue.qcl");
+    double bytes;
+    char label[64];
+    double start;
+    HANDLE fhand;
+
+    if(size * formats > 64 * 1024)
+    {
+        items /= 50;
+    }
+
+    bytes = (double) items * formats * size;
+    queue_policy.dynamic_queue = FALSE;
+    queue_policy.queue_size = 1;
+
+    if(CreatePool(pool, formats, size) && CreateQueue(&cq, items))
+    {
+        FillQueue(&cq, pool, items);
+
+        fhand = OpenFileForWriting(path);
+
+        if(fhand != INVALID_HANDLE_VALUE)
+        {
+            BOOL saved;
+
+            start = GetBenchTime();
+            saved = SaveQueueToFile(&cq, fhand);
+            CloseFileHandle(fhand);
+
+            snprintf(label, sizeof(label), "SaveQueueToFile %ux%lu B",
+                formats, (unsigned long) size);
+            ReportRate(label, items, bytes, GetBenchTime() - start);
+
+            if(!saved)
+            {
+                printf("  SaveQueueToFile FAILED\n");
+                ++failed_checks;
+            }
+        }
+
+        fhand = OpenFileForReading(path);
+
+        if(fhand != INVALID_HANDLE_VALUE)
+        {
+            BOOL loaded_ok;
+
+            start = GetBenchTime();
+            loaded_ok = LoadQueueFromFile(&loaded, fhand);
+            CloseFileHandle(fhand);
+
+            snprintf(label, sizeof(label), "LoadQueueFromFile %ux%lu B",
+                formats, (unsigned long) size);
+            ReportRate(label, items, bytes, GetBenchTime() - start);
+
+            if(!loaded_ok || (GetQueueLength(&loaded) != items)
+            || !CompareClipItems(GetItem(&loaded, 0), GetItem(&cq, 0)))
+            {
+                printf("  LoadQueueFromFile FAILED\n");
+                ++failed_checks;
+            }
+
+            if(loaded_ok)
+            {
+                DestroyQueue(&loaded);
+            }
+        }
+
+        remove(path);
+        DestroyQueue(&cq);
+        DestroyPool(pool);
+    }
+}
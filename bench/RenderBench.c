@@ -0,0 +1,314 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include <stdio.h>
+#include <string.h>
+#include "Bench.h"
+#include "BlobStore.h"
+#include "ClipQueue.h"
+#include "ClipRender.h"
+
+#define NUM_FORMATS         12
+#define PASTE_COUNT         200
+
+//Roughly what a word processor puts on the clipboard for a page with
+//a picture on it; CF_UNICODETEXT is what most pastes end up reading.
+static const UINT office_formats[NUM_FORMATS] = {CF_UNICODETEXT, CF_TEXT,
+    16, 0x0C001, 0x0C002, 0x0C003, 0x0C004, 0x0C005, 0x0C006, 14, CF_DIB,
+    0x0C007};
+static const size_t office_sizes[NUM_FORMATS] = {8 * 1024, 4 * 1024, 4,
+    48 * 1024, 64 * 1024, 256 * 1024, 200, 1024, 96 * 1024, 128 * 1024,
+    1024 * 1024, 300 * 1024};
+
+static BOOL MakeOfficeItem(ClipItem* item);
+static void BenchPaste(ClipItem* item, BOOL delayed);
+static BOOL CheckPaste(ClipItem* item, UINT format);
+static void CheckRendering(ClipItem* item);
+static unsigned int CountRendered();
+
+
+//Checks that have failed
+static unsigned int failed_checks = 0;
+
+
+/*******************************************************************
+** RunRenderBench
+** ==============
+** Compares pasting a many-format item from the queue with every
+** format copied up front, and with delayed rendering, where only
+** the format the program reads gets copied.  Then walks the fake
+** clipboard through announcing, rendering and emptying to check
+** the delayed path.
+**
+** Outputs:
+**      unsigned int        - how many checks failed
+*******************************************************************/
+unsigned int RunRenderBench()
+{
+    ClipItem item;
+
+    if(MakeOfficeItem(&item))
+    {
+        BenchPaste(&item, FALSE);
+        BenchPaste(&item, TRUE);
+        CheckRendering(&item);
+        DestroyClipItem(&item);
+    }
+
+    return failed_checks;
+}
+
+
+/*******************************************************************
+** MakeOfficeItem
+** ==============
+** Builds an item with the formats in office_formats.
+*******************************************************************/
+BOOL MakeOfficeItem(ClipItem* item)
+{
+    unsigned int i;
+
+    item->formats = 0;
+    item->preview = NULL;
+    item->data = (ClipData*) AllocMemory(sizeof(ClipData) * NUM_FORMATS);
+
+    for(i = 0; (i < NUM_FORMATS) && item->data; ++i)
+    {
+        item->data[i].memory = AllocBlob(office_sizes[i]);
+
+        if(!item->data[i].memory)
+        {
+            DestroyClipItem(item);
+            break;
+        }
+
+        FillSyntheticBytes(LockBlob(item->data[i].memory),
+            office_sizes[i], i + 1);
+        UnlockBlob(item->data[i].memory);
+
+        item->data[i].size = office_sizes[i];
+        item->data[i].format = office_formats[i];
+        item->data[i].hash = GetBlobHash(item->data[i].memory);
+        ++(item->formats);
+    }
+
+    return (item->data != NULL);
+}
+
+
+/*******************************************************************
+** BenchPaste
+** ==========
+** Times PeekAt followed by a program reading CF_UNICODETEXT.
+**
+** Inputs:
+**      ClipItem* item      - item to queue and paste
+**      BOOL delayed        - TRUE for delayed rendering
+*******************************************************************/
+void BenchPaste(ClipItem* item, BOOL delayed)
+{
+    ClipQueue cq;
+    size_t copied = 0;
+    unsigned int i;
+    char label[64];
+    double start;
+
+    bench_clipboard_unique = FALSE;
+
+    if(CreateQueue(&cq, 16))
+    {
+        SetBenchClipboard(item);
+        PushFront(&cq);
+        bench_clipboard_delayed = delayed;
+
+        start = GetBenchTime();
+
+        for(i = 0; i < PASTE_COUNT; ++i)
+        {
+            PeekAt(&cq, 0);
+
+            if(delayed && !PasteBenchFormat(CF_UNICODETEXT))
+            {
+                printf("  paste FAILED\n");
+                ++failed_checks;
+                break;
+            }
+        }
+
+        snprintf(label, sizeof(label), "PeekAt + paste text, %s",
+            delayed ? "delayed" : "all formats");
+        ReportRate(label, PASTE_COUNT, 0, GetBenchTime() - start);
+
+        for(i = 0; i < NUM_FORMATS; ++i)
+        {
+            if(!delayed || (office_formats[i] == CF_UNICODETEXT))
+            {
+                copied += office_sizes[i];
+            }
+        }
+
+        printf("  %-36s %10.1f KB copied per paste\n", "",
+            copied / 1024.0);
+
+        ClearBenchClipboard();
+        bench_clipboard_delayed = FALSE;
+        SetBenchClipboard(NULL);
+        DestroyQueue(&cq);
+    }
+
+    bench_clipboard_unique = TRUE;
+}
+
+
+/*******************************************************************
+** CheckPaste
+** ==========
+** Pastes one format off the fake clipboard and compares it with
+** the item it came from.
+**
+** Outputs:
+**      BOOL                - TRUE if the data matches
+*******************************************************************/
+BOOL CheckPaste(ClipItem* item, UINT format)
+{
+    const void* pasted = PasteBenchFormat(format);
+    BOOL match = FALSE;
+    unsigned int i;
+
+    for(i = 0; (i < item->formats) && pasted; ++i)
+    {
+        if(item->data[i].format == format)
+        {
+            match = (memcmp(pasted, LockBlob(item->data[i].memory),
+                item->data[i].size) == 0);
+            UnlockBlob(item->data[i].memory);
+        }
+    }
+
+    return match;
+}
+
+
+/*******************************************************************
+** CheckRendering
+** ==============
+** Steps through the life of a delayed paste on the fake clipboard:
+** formats are announced but not rendered, only the ones asked for
+** get rendered, the data survives the item being popped, the rest
+** can be rendered in one go, and emptying the clipboard lets go of
+** everything.
+*******************************************************************/
+void CheckRendering(ClipItem* item)
+{
+    ClipQueue cq;
+    BlobStoreStats before, after;
+    unsigned int rendered;
+
+    GetBlobStoreStats(&before);
+    bench_clipboard_unique = FALSE;
+    bench_clipboard_delayed = TRUE;
+
+    if(CreateQueue(&cq, 16))
+    {
+        SetBenchClipboard(item);
+        PushFront(&cq);
+
+        if((PeekAt(&cq, 0) != NUM_FORMATS)
+        || (CountPlacedFormats(&rendered) != NUM_FORMATS) || (rendered != 0))
+        {
+            printf("  announcing formats FAILED\n");
+            ++failed_checks;
+        }
+
+        if(!CheckPaste(item, CF_UNICODETEXT)
+        || !CheckPaste(item, CF_UNICODETEXT)
+        || (CountRendered() != 1))
+        {
+            printf("  rendering one format FAILED\n");
+            ++failed_checks;
+        }
+
+        if(PasteBenchFormat(0x0CFFF))
+        {
+            printf("  pasting a missing format FAILED\n");
+            ++failed_checks;
+        }
+
+        //A pop announces the item afresh.  The announced item holds
+        //its own references, so emptying the queue mustn't lose the
+        //data.
+        if((PopFront(&cq) != NUM_FORMATS)
+        || (CountRendered() != 0))
+        {
+            printf("  announcing a pop FAILED\n");
+            ++failed_checks;
+        }
+
+        EmptyQueueAndResize(&cq);
+
+        if(!CheckPaste(item, CF_DIB) || !IsRenderPending())
+        {
+            printf("  rendering after a pop FAILED\n");
+            ++failed_checks;
+        }
+
+        if((RenderAllClipFormats() != NUM_FORMATS - 1)
+        || (CountRendered() != NUM_FORMATS)
+        || IsRenderPending() || !CheckPaste(item, 0x0C007))
+        {
+            printf("  rendering all formats FAILED\n");
+            ++failed_checks;
+        }
+
+        ClearBenchClipboard();
+        DestroyQueue(&cq);
+    }
+
+    bench_clipboard_delayed = FALSE;
+    bench_clipboard_unique = TRUE;
+    SetBenchClipboard(NULL);
+
+    GetBlobStoreStats(&after);
+
+    if((after.blobs != before.blobs)
+    || (after.references != before.references))
+    {
+        printf("  releasing the rendered item FAILED\n");
+        ++failed_checks;
+    }
+}
+
+
+/*******************************************************************
+** CountRendered
+** =============
+** Outputs:
+**      unsigned int        - formats on the fake clipboard that
+**                            have been rendered
+*******************************************************************/
+unsigned int CountRendered()
+{
+    unsigned int rendered;
+
+    CountPlacedFormats(&rendered);
+
+    return rendered;
+}
@@ -0,0 +1,472 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include <stdio.h>
+#include <string.h>
+#include "Bench.h"
+#include "ClipCapture.h"
+
+#define NUM_STEPS           200000
+#define SETTLE_EVERY        64      //steps between pauses in the burst
+#define MAX_SEQUENCE        (NUM_STEPS + 2)
+#define REPLAY_FORMAT       0x0C001
+
+#define WRITE_NONE          0
+#define WRITE_OTHER         1       //another program copied something
+#define WRITE_OWN           2       //QClip pasted something
+
+//A fake clipboard whose contents are just its sequence number, and
+//what happened to each sequence number during a replay
+typedef struct
+{
+    volatile unsigned int   sequence;
+    volatile unsigned int   checked;    //last sequence the snapshot
+                                        //thread looked at
+    volatile unsigned int   stop;
+    unsigned int            taken;      //last sequence taken out of
+                                        //the ring
+    BOOL                    ordered;
+    ClipWatch               watch;
+    unsigned int            details;    //the watch's: the sequence a
+                                        //request was made at
+    unsigned int            begun;      //the last snapshot's details
+    unsigned long           mismatched; //snapshots whose details were
+                                        //ahead of the clipboard, or
+                                        //behind the last snapshot's
+    CaptureRing             ring;
+    BYTE                    written[MAX_SEQUENCE];  //WRITE_OTHER/OWN
+    BYTE                    captured[MAX_SEQUENCE]; //times captured
+    BYTE                    settled[MAX_SEQUENCE];  //left in place
+                                                    //long enough
+    unsigned long           notifications;
+}Replay;
+
+typedef struct
+{
+    unsigned long   captures;
+    unsigned long   doubles;        //sequence numbers captured twice
+    unsigned long   own;            //QClip's own writes captured
+    unsigned long   lost;           //settled writes never captured
+    unsigned long   coalesced;      //superseded before a snapshot
+}ReplayResult;
+
+static Replay replay;
+
+static void ReplaySequenceWatch();
+static void ReplayIgnoreCounter();
+static unsigned int NextStep(unsigned int* state, unsigned int* notify);
+static void SnapshotThread(void* arg);
+static void DrainCaptures();
+static void Settle();
+static void Tally(ReplayResult* result);
+static void ReportReplay(const char* label, ReplayResult* result,
+    double seconds);
+
+
+//Checks that have failed
+static unsigned int failed_checks = 0;
+
+
+/*******************************************************************
+** RunReplayBench
+** ==============
+** Replays a burst of clipboard writes, by other programs and by
+** QClip itself, with notifications that arrive late, twice or not
+** at all, as they do when programs copy in quick succession.  The
+** same trace goes through the sequence number watch and capture
+** thread, and through the old counter of writes to ignore.
+**
+** A write that's replaced before anyone looks at it can't be
+** captured and only counts as coalesced; one left in place until
+** the burst pauses must be captured exactly once.
+**
+** Outputs:
+**      unsigned int        - how many checks failed
+*******************************************************************/
+unsigned int RunReplayBench()
+{
+    ReplaySequenceWatch();
+    ReplayIgnoreCounter();
+
+    return failed_checks;
+}
+
+
+/*******************************************************************
+** ReplaySequenceWatch
+** ===================
+** Replays the trace through a ClipWatch, with a snapshot thread
+** standing in for the capture thread.
+*******************************************************************/
+void ReplaySequenceWatch()
+{
+    ReplayResult result;
+    unsigned int state = 1, notify, step, kind;
+    HANDLE thread;
+    double start;
+
+    memset(&replay, 0, sizeof(replay));
+    replay.ordered = TRUE;
+    InitClipWatch(&replay.watch, 0, &replay.details,
+        sizeof(replay.details));
+    InitCaptureRing(&replay.ring);
+
+    thread = StartThread(SnapshotThread, NULL);
+
+    if(!thread)
+    {
+        printf("  StartThread FAILED\n");
+        ++failed_checks;
+        return;
+    }
+
+    start = GetBenchTime();
+
+    for(step = 1; step <= NUM_STEPS; ++step)
+    {
+        kind = NextStep(&state, &notify);
+
+        if(kind != WRITE_NONE)
+        {
+            unsigned int sequence = replay.sequence + 1;
+
+            replay.written[sequence] = (BYTE) kind;
+
+            //QClip notes its write before closing the clipboard, so
+            //nobody can look at it in between
+            if(kind == WRITE_OWN)
+            {
+                NoteOwnWrite(&replay.watch, sequence);
+            }
+
+            StoreRelease(&replay.sequence, sequence);
+        }
+
+        while(notify-- > 0)
+        {
+            unsigned int asked = replay.sequence;
+
+            RequestSnapshot(&replay.watch, &asked);
+            ++replay.notifications;
+        }
+
+        DrainCaptures();
+
+        if(step % SETTLE_EVERY == 0)
+        {
+            Settle();
+        }
+    }
+
+    Settle();
+
+    StoreRelease(&replay.stop, TRUE);
+    JoinThread(thread);
+    DrainCaptures();
+
+    Tally(&result);
+    ReportReplay("sequence numbers", &result, GetBenchTime() - start);
+
+    if(result.doubles || result.own || result.lost || !replay.ordered
+    || replay.mismatched)
+    {
+        printf("  sequence number replay FAILED\n");
+        ++failed_checks;
+    }
+
+    if(replay.ring.dropped > 0)
+    {
+        printf("  %u captures dropped\n", replay.ring.dropped);
+    }
+}
+
+
+/*******************************************************************
+** ReplayIgnoreCounter
+** ===================
+** Replays the same trace the way QClip used to work: each of its
+** own writes adds one to a counter of notifications to ignore, and
+** every other notification captures whatever is on the clipboard.
+*******************************************************************/
+void ReplayIgnoreCounter()
+{
+    ReplayResult result;
+    unsigned int state = 1, notify, step, kind, ignore = 0;
+    double start;
+
+    memset(&replay, 0, sizeof(replay));
+    start = GetBenchTime();
+
+    for(step = 1; step <= NUM_STEPS; ++step)
+    {
+        kind = NextStep(&state, &notify);
+
+        if(kind != WRITE_NONE)
+        {
+            replay.written[++replay.sequence] = (BYTE) kind;
+
+            if(kind == WRITE_OWN)
+            {
+                ++ignore;
+            }
+        }
+
+        //A pause gets one more notification, as in the other replay
+        if(step % SETTLE_EVERY == 0)
+        {
+            replay.settled[replay.sequence] = TRUE;
+            ++notify;
+        }
+
+        while(notify-- > 0)
+        {
+            ++replay.notifications;
+
+            if(ignore > 0)
+            {
+                --ignore;
+            }
+            else if(replay.captured[replay.sequence] < 255)
+            {
+                ++replay.captured[replay.sequence];
+            }
+        }
+    }
+
+    Tally(&result);
+    ReportReplay("ignore counter", &result, GetBenchTime() - start);
+}
+
+
+/*******************************************************************
+** NextStep
+** ========
+** Makes up the next step of the trace: maybe a write, then some
+** notifications.  Writes outnumber notifications a little, as in a
+** burst, and some notifications come twice.
+**
+** Inputs:
+**      unsigned int* state     - random state; start it at 1
+**      unsigned int* notify    - receives how many notifications
+**                                to deliver after the write
+**
+** Outputs:
+**      unsigned int            - WRITE_NONE, WRITE_OTHER or WRITE_OWN
+*******************************************************************/
+unsigned int NextStep(unsigned int* state, unsigned int* notify)
+{
+    unsigned int kind, random;
+
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    random = *state;
+
+    switch(random & 15)
+    {
+        case 0: case 1:
+            kind = WRITE_OWN;
+            break;
+
+        case 2: case 3: case 4:
+            kind = WRITE_NONE;
+            break;
+
+        default:
+            kind = WRITE_OTHER;
+    }
+
+    switch((random >> 4) & 3)
+    {
+        case 0:
+            *notify = 0;
+            break;
+
+        case 3:
+            *notify = 2;
+            break;
+
+        default:
+            *notify = 1;
+    }
+
+    return kind;
+}
+
+
+/*******************************************************************
+** SnapshotThread
+** ==============
+** Stands in for the capture thread: whenever a snapshot is pending,
+** reads the fake clipboard and captures it if the watch says so.
+** Each request's details are the sequence it was made at, to check
+** they reach the snapshot that serves it.
+*******************************************************************/
+void SnapshotThread(void* arg)
+{
+    ClipCapture capture;
+    unsigned int requested, sequence, asked;
+
+    while(!LoadAcquire(&replay.stop))
+    {
+        if(!BeginSnapshot(&replay.watch, &requested, &asked))
+        {
+            YieldThread();
+            continue;
+        }
+
+        sequence = LoadAcquire(&replay.sequence);
+
+        //The details are the first request's since the last snapshot
+        //began, so they're never ahead of the clipboard or behind
+        //that snapshot's
+        if((asked > sequence) || (asked < replay.begun))
+        {
+            ++replay.mismatched;
+        }
+
+        replay.begun = asked;
+
+        if(IsNewSequence(&replay.watch, sequence)
+        && CreateCapture(&capture, 1, requested))
+        {
+            capture.sequence = sequence;
+
+            if(!AddCaptureData(&capture, REPLAY_FORMAT,
+                &sequence, sizeof(sequence), requested)
+            || !PutCapture(&replay.ring, &capture))
+            {
+                DestroyCapture(&capture);
+            }
+        }
+
+        StoreRelease(&replay.checked, sequence);
+    }
+}
+
+
+/*******************************************************************
+** DrainCaptures
+** =============
+** Takes everything the snapshot thread has captured, as the UI
+** thread does on CAPTURE_MESSAGE, checking it comes out in order.
+*******************************************************************/
+void DrainCaptures()
+{
+    ClipCapture capture;
+
+    while(TakeCapture(&replay.ring, &capture))
+    {
+        replay.ordered = replay.ordered && (capture.sequence > replay.taken);
+        replay.taken = capture.sequence;
+
+        if(replay.captured[capture.sequence] < 255)
+        {
+            ++replay.captured[capture.sequence];
+        }
+
+        DestroyCapture(&capture);
+    }
+}
+
+
+/*******************************************************************
+** Settle
+** ======
+** Pauses the burst: notifies once more and waits for the snapshot
+** thread to look at the clipboard as it is now.  Whatever is there
+** counts as settled.
+*******************************************************************/
+void Settle()
+{
+    unsigned int sequence = replay.sequence;
+
+    RequestSnapshot(&replay.watch, &sequence);
+    ++replay.notifications;
+
+    while(LoadAcquire(&replay.checked) != sequence)
+    {
+        DrainCaptures();
+        YieldThread();
+    }
+
+    DrainCaptures();
+    replay.settled[sequence] = TRUE;
+}
+
+
+/*******************************************************************
+** Tally
+** =====
+** Works out what happened to every write in the replay.
+*******************************************************************/
+void Tally(ReplayResult* result)
+{
+    unsigned int i;
+
+    memset(result, 0, sizeof(ReplayResult));
+
+    for(i = 1; i <= replay.sequence; ++i)
+    {
+        result->captures += replay.captured[i];
+
+        if(replay.captured[i] > 1)
+        {
+            ++(result->doubles);
+        }
+
+        if((replay.written[i] == WRITE_OWN) && replay.captured[i])
+        {
+            ++(result->own);
+        }
+
+        if((replay.written[i] == WRITE_OTHER) && !replay.captured[i])
+        {
+            if(replay.settled[i])
+            {
+                ++(result->lost);
+            }
+            else
+            {
+                ++(result->coalesced);
+            }
+        }
+    }
+}
+
+
+/*******************************************************************
+** ReportReplay
+** ============
+** Prints the outcome of a replay.
+*******************************************************************/
+void ReportReplay(const char* label, ReplayResult* result, double seconds)
+{
+    char line[64];
+
+    snprintf(line, sizeof(line), "replay, %s", label);
+    ReportRate(line, replay.sequence, 0, seconds);
+
+    printf("  %-36s %10lu notifications %8lu captures\n", "",
+        replay.notifications, result->captures);
+    printf("  %-36s %10lu lost %6lu double %6lu own %8lu coalesced\n", "",
+        result->lost, result->doubles, result->own, result->coalesced);
+}
@@ -0,0 +1,602 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include <stdio.h>
+#include <string.h>
+#include "Bench.h"
+#include "Thumbnail.h"
+
+#define THUMBNAIL_HEIGHT    100
+#define SCREEN_WIDTH        1920
+#define SCREEN_HEIGHT       1080
+#define SCALE_PASSES        20
+#define NUM_KINDS           9
+#define NUM_SHAPES          5
+#define V5_HEADER_SIZE      124
+#define BI_BITFIELDS        3
+
+//How a test picture is stored
+typedef struct
+{
+    const char*     name;
+    unsigned int    depth;          //bits of palette index it's drawn with
+    unsigned int    bits;           //bits per stored pixel
+    uint32_t        header_size;
+    uint32_t        compression;
+}DibKind;
+
+//A DIB built from a picture, with what the reference needs to read it
+typedef struct
+{
+    BYTE*           bytes;
+    size_t          size;
+    const DibKind*  kind;
+    int32_t         width;
+    int32_t         height;
+    BOOL            top_down;
+    const BYTE*     palette;
+    const BYTE*     rows;
+    size_t          stride;
+}TestDib;
+
+static const DibKind kinds[NUM_KINDS] =
+{
+    {"1-bit palette",           1,  1,  40,             0},
+    {"4-bit palette",           4,  4,  40,             0},
+    {"8-bit palette",           8,  8,  40,             0},
+    {"24-bit, 8-bit picture",   8,  24, 40,             0},
+    {"32-bit, 8-bit picture",   8,  32, 40,             0},
+    {"32-bit bitfields",        8,  32, 40,             BI_BITFIELDS},
+    {"32-bit DIBV5",            8,  32, V5_HEADER_SIZE, BI_BITFIELDS},
+    {"24-bit, 4-bit picture",   4,  24, 40,             0},
+    {"24-bit, 1-bit picture",   1,  24, 40,             0},
+};
+
+static const int32_t shapes[NUM_SHAPES][2] =
+{
+    {1001, 777}, {333, 101}, {64, 50}, {5, 3000}, {3000, 1},
+};
+
+static BYTE palette[256 * 4];
+
+static void BenchScaling(const DibKind* kind);
+static void CheckScaling();
+static void CheckRejects();
+static BOOL MakeTestDib(TestDib* dib, const DibKind* kind, int32_t width,
+    int32_t height, BOOL top_down);
+static unsigned int GetPictureIndex(int32_t x, int32_t y,
+    unsigned int depth);
+static uint32_t ReadReferencePixel(const TestDib* dib, int32_t x,
+    int32_t y);
+static BOOL ScaleReference(const TestDib* dib, int32_t max_height,
+    ThumbnailImage* image);
+static unsigned int CompareImages(const ThumbnailImage* a,
+    const ThumbnailImage* b, unsigned long* differing);
+
+
+//Checks that have failed
+static unsigned int failed_checks = 0;
+
+
+/*******************************************************************
+** RunScaleBench
+** =============
+** Scales screenshot sized DIBs of each kind down to a menu
+** thumbnail with ScaleDib and with a plain per-pixel reference,
+** then diffs the two over a range of shapes and storage kinds.
+**
+** Outputs:
+**      unsigned int        - how many checks failed
+*******************************************************************/
+unsigned int RunScaleBench()
+{
+    FillSyntheticBytes(palette, sizeof(palette), 20);
+
+    BenchScaling(&kinds[2]);
+    BenchScaling(&kinds[3]);
+    BenchScaling(&kinds[4]);
+    CheckScaling();
+    CheckRejects();
+
+    return failed_checks;
+}
+
+
+/*******************************************************************
+** BenchScaling
+** ============
+** Reports how fast ScaleDib and the reference get through a
+** SCREEN_WIDTH by SCREEN_HEIGHT DIB of one kind.
+**
+** Inputs:
+**      const DibKind* kind     - the kind of DIB
+*******************************************************************/
+void BenchScaling(const DibKind* kind)
+{
+    TestDib dib;
+    ThumbnailImage image, reference;
+    unsigned long differing = 0;
+    unsigned int pass;
+    char label[64];
+    double start;
+
+    if(!MakeTestDib(&dib, kind, SCREEN_WIDTH, SCREEN_HEIGHT, FALSE))
+    {
+        return;
+    }
+
+    start = GetBenchTime();
+
+    for(pass = 0; pass < SCALE_PASSES; ++pass)
+    {
+        ScaleReference(&dib, THUMBNAIL_HEIGHT, &reference);
+        FreeThumbnailImage(&reference);
+    }
+
+    snprintf(label, sizeof(label), "reference, %s", kind->name);
+    ReportRate(label, SCALE_PASSES, (double) SCALE_PASSES * dib.size,
+        GetBenchTime() - start);
+    start = GetBenchTime();
+
+    for(pass = 0; pass < SCALE_PASSES; ++pass)
+    {
+        ScaleDib(dib.bytes, dib.size, THUMBNAIL_HEIGHT, &image);
+        FreeThumbnailImage(&image);
+    }
+
+    snprintf(label, sizeof(label), "ScaleDib, %s", kind->name);
+    ReportRate(label, SCALE_PASSES, (double) SCALE_PASSES * dib.size,
+        GetBenchTime() - start);
+
+    if(!ScaleDib(dib.bytes, dib.size, THUMBNAIL_HEIGHT, &image)
+    || !ScaleReference(&dib, THUMBNAIL_HEIGHT, &reference)
+    || (CompareImages(&image, &reference, &differing) != 0))
+    {
+        printf("  %s screenshot FAILED\n", kind->name);
+        ++failed_checks;
+    }
+
+    FreeThumbnailImage(&image);
+    FreeThumbnailImage(&reference);
+    FreeMemory(dib.bytes);
+}
+
+
+/*******************************************************************
+** CheckScaling
+** ============
+** Diffs ScaleDib against the reference for every kind and shape,
+** stored both ways up, and checks that kinds holding the same
+** picture scale to the same thumbnail.  Reports the worst channel
+** difference and how many pixels differed for each kind.
+*******************************************************************/
+void CheckScaling()
+{
+    TestDib dib;
+    ThumbnailImage image, reference, flipped, expected[NUM_SHAPES];
+    unsigned long differing, kind_differing;
+    unsigned int i, shape, worst, kind_worst;
+    BOOL passed;
+
+    memset(expected, 0, sizeof(expected));
+
+    for(i = 0; i < NUM_KINDS; ++i)
+    {
+        kind_worst = 0;
+        kind_differing = 0;
+        passed = TRUE;
+
+        for(shape = 0; shape < NUM_SHAPES; ++shape)
+        {
+            differing = 0;
+            passed = passed && MakeTestDib(&dib, &kinds[i],
+                shapes[shape][0], shapes[shape][1], FALSE)
+                && ScaleDib(dib.bytes, dib.size, THUMBNAIL_HEIGHT, &image)
+                && ScaleReference(&dib, THUMBNAIL_HEIGHT, &reference);
+
+            if(passed)
+            {
+                worst = CompareImages(&image, &reference, &differing);
+                kind_worst = (worst > kind_worst) ? worst : kind_worst;
+                kind_differing += differing;
+                FreeThumbnailImage(&reference);
+                FreeMemory(dib.bytes);
+            }
+
+            //The same picture stored top-down
+            passed = passed && MakeTestDib(&dib, &kinds[i],
+                shapes[shape][0], shapes[shape][1], TRUE)
+                && ScaleDib(dib.bytes, dib.size, THUMBNAIL_HEIGHT, &flipped);
+
+            if(passed)
+            {
+                worst = CompareImages(&image, &flipped, &differing);
+                kind_worst = (worst > kind_worst) ? worst : kind_worst;
+                kind_differing += differing;
+                FreeThumbnailImage(&flipped);
+                FreeMemory(dib.bytes);
+            }
+
+            //Every kind drawn from the 8-bit picture comes out the
+            //same as the 8-bit palette does
+            if(passed && (kinds[i].depth == 8))
+            {
+                if(!expected[shape].pixels)
+                {
+                    expected[shape] = image;
+                    continue;
+                }
+
+                worst = CompareImages(&image, &expected[shape], &differing);
+                kind_worst = (worst > kind_worst) ? worst : kind_worst;
+                kind_differing += differing;
+            }
+
+            FreeThumbnailImage(&image);
+        }
+
+        printf("  %-36s %10u max diff %10lu pixels differ\n",
+            kinds[i].name, kind_worst, kind_differing);
+
+        if(!passed || kind_worst || kind_differing)
+        {
+            printf("  %s scaling FAILED\n", kinds[i].name);
+            ++failed_checks;
+        }
+    }
+
+    for(shape = 0; shape < NUM_SHAPES; ++shape)
+    {
+        FreeThumbnailImage(&expected[shape]);
+    }
+}
+
+
+/*******************************************************************
+** CheckRejects
+** ============
+** Checks that ScaleDib turns down DIBs it can't read, which
+** Windows then leaves to GDI: cut short, compressed, 16-bit, or
+** with unusual masks.
+*******************************************************************/
+void CheckRejects()
+{
+    static const uint32_t odd_masks[3] = {0xFF, 0xFF00, 0xFF0000};
+    TestDib dib;
+    ThumbnailImage image;
+    uint32_t compression = 1;       //BI_RLE8
+    uint16_t bits = 16;
+    BOOL passed;
+
+    if(!MakeTestDib(&dib, &kinds[5], 64, 64, FALSE))
+    {
+        return;
+    }
+
+    passed = ScaleDib(dib.bytes, dib.size, THUMBNAIL_HEIGHT, &image);
+    FreeThumbnailImage(&image);
+
+    passed = passed
+        && !ScaleDib(dib.bytes, dib.size - 1, THUMBNAIL_HEIGHT, &image)
+        && !ScaleDib(dib.bytes, 39, THUMBNAIL_HEIGHT, &image)
+        && !ScaleDib(dib.bytes, dib.size, 0, &image);
+
+    memcpy(dib.bytes + 40, odd_masks, sizeof(odd_masks));
+    passed = passed
+        && !ScaleDib(dib.bytes, dib.size, THUMBNAIL_HEIGHT, &image);
+
+    memcpy(dib.bytes + 14, &bits, sizeof(bits));
+    passed = passed
+        && !ScaleDib(dib.bytes, dib.size, THUMBNAIL_HEIGHT, &image);
+
+    memcpy(dib.bytes + 16, &compression, sizeof(compression));
+    passed = passed
+        && !ScaleDib(dib.bytes, dib.size, THUMBNAIL_HEIGHT, &image)
+        && (image.pixels == NULL);
+
+    if(!passed)
+    {
+        printf("  rejecting DIBs FAILED\n");
+        ++failed_checks;
+    }
+
+    FreeMemory(dib.bytes);
+}
+
+
+/*******************************************************************
+** MakeTestDib
+** ===========
+** Draws the test picture into a DIB of the given kind.  The picture
+** is a pattern of palette indexes, so the same one can be stored
+** palettized or as the colours themselves.
+**
+** Inputs:
+**      TestDib* dib            - receives the DIB; free its bytes
+**      const DibKind* kind     - how to store it
+**      int32_t width           - size of the picture
+**      int32_t height
+**      BOOL top_down           - TRUE to store the top row first
+**
+** Outputs:
+**      BOOL                    - FALSE if out of memory
+*******************************************************************/
+BOOL MakeTestDib(TestDib* dib, const DibKind* kind, int32_t width,
+    int32_t height, BOOL top_down)
+{
+    static const uint32_t masks[3] = {0xFF0000, 0xFF00, 0xFF};
+    uint16_t planes = 1, bits = (uint16_t) kind->bits;
+    int32_t stored_height = top_down ? -height : height;
+    size_t offset = kind->header_size, colours = 0;
+    unsigned int index, shift;
+    int32_t x, y;
+    BYTE* row;
+
+    if((kind->compression == BI_BITFIELDS) && (kind->header_size == 40))
+    {
+        offset += sizeof(masks);
+    }
+
+    if(kind->bits <= 8)
+    {
+        colours = (size_t) 1 << kind->bits;
+    }
+
+    dib->kind = kind;
+    dib->width = width;
+    dib->height = height;
+    dib->top_down = top_down;
+    dib->stride = ((size_t) width * kind->bits + 31) / 32 * 4;
+    dib->size = offset + colours * 4 + dib->stride * height;
+    dib->bytes = (BYTE*) AllocMemory(dib->size);
+
+    if(!dib->bytes)
+    {
+        return FALSE;
+    }
+
+    memcpy(dib->bytes, &kind->header_size, sizeof(uint32_t));
+    memcpy(dib->bytes + 4, &width, sizeof(width));
+    memcpy(dib->bytes + 8, &stored_height, sizeof(stored_height));
+    memcpy(dib->bytes + 12, &planes, sizeof(planes));
+    memcpy(dib->bytes + 14, &bits, sizeof(bits));
+    memcpy(dib->bytes + 16, &kind->compression, sizeof(uint32_t));
+
+    if(kind->compression == BI_BITFIELDS)
+    {
+        memcpy(dib->bytes + 40, masks, sizeof(masks));
+    }
+
+    memcpy(dib->bytes + offset, palette, colours * 4);
+    dib->palette = palette;
+    dib->rows = dib->bytes + offset + colours * 4;
+
+    for(y = 0; y < height; ++y)
+    {
+        row = (BYTE*) dib->rows
+            + dib->stride * (top_down ? y : height - 1 - y);
+
+        for(x = 0; x < width; ++x)
+        {
+            index = GetPictureIndex(x, y, kind->depth);
+
+            if(kind->bits <= 8)
+            {
+                shift = 8 - kind->bits * (x % (8 / kind->bits) + 1);
+                row[x * kind->bits / 8] |= (BYTE) (index << shift);
+            }
+            else
+            {
+                memcpy(row + x * (kind->bits / 8), palette + index * 4,
+                    kind->bits / 8);
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** GetPictureIndex
+** ===============
+** The test picture: stripes, a gradient and some noise, so blocks
+** average to a spread of values.
+**
+** Inputs:
+**      int32_t x           - column, from the left
+**      int32_t y           - row, from the top
+**      unsigned int depth  - bits of index to use
+**
+** Outputs:
+**      unsigned int        - palette index at that pixel
+*******************************************************************/
+unsigned int GetPictureIndex(int32_t x, int32_t y, unsigned int depth)
+{
+    uint32_t noise = ((uint32_t) x * 73856093u) ^ ((uint32_t) y * 19349663u);
+
+    return ((x / 7 + y / 3 + (noise >> 13)) & 0xFF) >> (8 - depth);
+}
+
+
+/*******************************************************************
+** ReadReferencePixel
+** ==================
+** Reads one pixel of a test DIB, the slow and obvious way.
+**
+** Inputs:
+**      const TestDib* dib  - the DIB
+**      int32_t x           - column, from the left
+**      int32_t y           - row, from the top
+**
+** Outputs:
+**      uint32_t            - the pixel as 0x00RRGGBB
+*******************************************************************/
+uint32_t ReadReferencePixel(const TestDib* dib, int32_t x, int32_t y)
+{
+    unsigned int bits = dib->kind->bits;
+    const BYTE* row = dib->rows
+        + dib->stride * (dib->top_down ? y : dib->height - 1 - y);
+    const BYTE* pixel;
+    unsigned int index;
+
+    if(bits <= 8)
+    {
+        index = (row[x * bits / 8] >> (8 - bits * (x % (8 / bits) + 1)))
+            & ((1u << bits) - 1);
+        pixel = dib->palette + index * 4;
+    }
+    else
+    {
+        pixel = row + x * (bits / 8);
+    }
+
+    return ((uint32_t) pixel[2] << 16) | ((uint32_t) pixel[1] << 8)
+        | pixel[0];
+}
+
+
+/*******************************************************************
+** ScaleReference
+** ==============
+** What ScaleDib should produce: each thumbnail pixel the rounded
+** average of the block of source pixels under it, read one at a
+** time.
+**
+** Inputs:
+**      const TestDib* dib      - the DIB
+**      int32_t max_height      - rows in the thumbnail at most
+**      ThumbnailImage* image   - receives the thumbnail
+**
+** Outputs:
+**      BOOL                    - FALSE if out of memory
+*******************************************************************/
+BOOL ScaleReference(const TestDib* dib, int32_t max_height,
+    ThumbnailImage* image)
+{
+    int32_t x, y, sx, sy, x0, x1, y0, y1;
+    uint32_t sums[3], count, pixel;
+    unsigned int c;
+
+    image->height = (dib->height > max_height) ? max_height : dib->height;
+    image->width = (int32_t) ((int64_t) dib->width * image->height
+        / dib->height);
+    image->width = image->width ? image->width : 1;
+    image->pixels = (uint32_t*) AllocMemory(sizeof(uint32_t)
+        * image->width * image->height);
+
+    if(!image->pixels)
+    {
+        return FALSE;
+    }
+
+    for(y = 0; y < image->height; ++y)
+    {
+        y0 = (int32_t) ((int64_t) y * dib->height / image->height);
+        y1 = (int32_t) ((int64_t) (y + 1) * dib->height / image->height);
+
+        for(x = 0; x < image->width; ++x)
+        {
+            x0 = (int32_t) ((int64_t) x * dib->width / image->width);
+            x1 = (int32_t) ((int64_t) (x + 1) * dib->width / image->width);
+            sums[0] = sums[1] = sums[2] = 0;
+            count = (uint32_t) ((x1 - x0) * (y1 - y0));
+
+            for(sy = y0; sy < y1; ++sy)
+            {
+                for(sx = x0; sx < x1; ++sx)
+                {
+                    pixel = ReadReferencePixel(dib, sx, sy);
+
+                    for(c = 0; c < 3; ++c)
+                    {
+                        sums[c] += (pixel >> (c * 8)) & 0xFF;
+                    }
+                }
+            }
+
+            pixel = 0xFF000000;
+
+            for(c = 0; c < 3; ++c)
+            {
+                pixel |= ((sums[c] + count / 2) / count) << (c * 8);
+            }
+
+            image->pixels[y * image->width + x] = pixel;
+        }
+    }
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** CompareImages
+** =============
+** Diffs two thumbnails.
+**
+** Inputs:
+**      const ThumbnailImage* a         - one thumbnail
+**      const ThumbnailImage* b         - the other
+**      unsigned long* differing        - receives how many pixels
+**                                        differ; all of them if the
+**                                        sizes don't match
+**
+** Outputs:
+**      unsigned int                    - the largest difference in
+**                                        any channel
+*******************************************************************/
+unsigned int CompareImages(const ThumbnailImage* a,
+    const ThumbnailImage* b, unsigned long* differing)
+{
+    unsigned int worst = 0, difference, c;
+    size_t i, count = (size_t) a->width * a->height;
+    int channel_a, channel_b;
+
+    *differing = 0;
+
+    if((a->width != b->width) || (a->height != b->height))
+    {
+        *differing = (unsigned long) count;
+        return 255;
+    }
+
+    for(i = 0; i < count; ++i)
+    {
+        if(a->pixels[i] == b->pixels[i])
+        {
+            continue;
+        }
+
+        ++(*differing);
+
+        for(c = 0; c < 4; ++c)
+        {
+            channel_a = (a->pixels[i] >> (c * 8)) & 0xFF;
+            channel_b = (b->pixels[i] >> (c * 8)) & 0xFF;
+            difference = (unsigned int) ((channel_a > channel_b)
+                ? channel_a - channel_b : channel_b - channel_a);
+            worst = (difference > worst) ? difference : worst;
+        }
+    }
+
+    return worst;
+}
@@ -0,0 +1,320 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include <stdio.h>
+#include <string.h>
+#include "Bench.h"
+#include "ClipQueue.h"
+#include "ClipCapture.h"
+
+#define CORPUS_SIZE         64      //distinct copies
+#define COPIES              3       //times each is copied
+#define MAX_BLOCK_SIZE      8192
+#define BLOCK_GRANULE       16      //what allocations round up to
+
+//A clipboard block: the payload, then slack left by the allocator
+typedef struct
+{
+    UINT            format;
+    BYTE            bytes[MAX_BLOCK_SIZE];
+    size_t          length;     //of the payload itself
+    size_t          size;       //of the whole block
+}ClipBlock;
+
+static void BenchSizing(BOOL trim);
+static void MakeBlock(ClipBlock* block, unsigned int seed,
+    unsigned int copy);
+static size_t WriteText(BYTE* bytes, unsigned int seed, BOOL wide);
+static size_t WriteFileList(BYTE* bytes, unsigned int seed);
+static void CheckLogicalSizes();
+
+static const char* words[] =
+{
+    "queue", "clip", "paste", "copy", "format", "the", "of", "and",
+    "memory", "bitmap", "text", "file", "drop", "rich", "a", "window",
+};
+
+
+//Checks that have failed
+static unsigned int failed_checks = 0;
+
+
+/*******************************************************************
+** RunSizeBench
+** ============
+** Captures a corpus of text and file list copies, each copied a
+** few times in blocks with different amounts of slack, as Windows
+** hands them over.  Compares what the queue stores, and how many
+** copies it recognises as duplicates, with and without trimming the
+** payloads to their logical size.
+**
+** Outputs:
+**      unsigned int        - how many checks failed
+*******************************************************************/
+unsigned int RunSizeBench()
+{
+    BenchSizing(FALSE);
+    BenchSizing(TRUE);
+    CheckLogicalSizes();
+
+    return failed_checks;
+}
+
+
+/*******************************************************************
+** BenchSizing
+** ===========
+** Captures the corpus into a queue that moves duplicates, and
+** reports the payload it holds and the duplicates it found.
+**
+** Inputs:
+**      BOOL trim           - TRUE to capture GetLogicalSize bytes,
+**                            FALSE for the whole block
+*******************************************************************/
+void BenchSizing(BOOL trim)
+{
+    static ClipBlock block;
+
+    ClipQueue cq;
+    ClipCapture capture;
+    ClipItem item;
+    unsigned int i, copy;
+    size_t payload = 0, stored = 0;
+    const char* label = trim ? "logical size" : "block size";
+
+    queue_policy.move_duplicates = TRUE;
+
+    if(!CreateQueue(&cq, CORPUS_SIZE * COPIES))
+    {
+        queue_policy.move_duplicates = FALSE;
+        return;
+    }
+
+    for(copy = 0; copy < COPIES; ++copy)
+    {
+        for(i = 0; i < CORPUS_SIZE; ++i)
+        {
+            MakeBlock(&block, i, copy);
+            payload += block.length;
+
+            if(CreateCapture(&capture, 1, GetMicroTicks())
+            && AddCaptureData(&capture, block.format, block.bytes,
+                trim ? GetLogicalSize(block.format, block.bytes, block.size)
+                : block.size, GetMicroTicks())
+            && AdoptCapture(&capture, &item))
+            {
+                PushItemFront(&cq, &item);
+            }
+        }
+    }
+
+    for(i = 0; i < GetQueueLength(&cq); ++i)
+    {
+        stored += GetClipItemSize(GetItem(&cq, i));
+    }
+
+    printf("  %-36s %10.1f KB stored %4u items %4u duplicates\n", label,
+        stored / 1024.0, GetQueueLength(&cq),
+        CORPUS_SIZE * COPIES - GetQueueLength(&cq));
+
+    if(trim
+    && ((GetQueueLength(&cq) != CORPUS_SIZE)
+    || (stored * COPIES != payload)))
+    {
+        printf("  %s FAILED\n", label);
+        ++failed_checks;
+    }
+
+    DestroyQueue(&cq);
+    queue_policy.move_duplicates = FALSE;
+}
+
+
+/*******************************************************************
+** MakeBlock
+** =========
+** Builds one copy of a corpus entry: ANSI text, UTF-16 text or a
+** file list, depending on the seed.  The block is rounded up to
+** BLOCK_GRANULE and then some, by an amount that depends on the
+** copy, and the slack is filled with junk.
+**
+** Inputs:
+**      ClipBlock* block    - receives the copy
+**      unsigned int seed   - which corpus entry
+**      unsigned int copy   - which copy of it
+*******************************************************************/
+void MakeBlock(ClipBlock* block, unsigned int seed, unsigned int copy)
+{
+    switch(seed % 3)
+    {
+    case 0:
+        block->format = CF_TEXT;
+        block->length = WriteText(block->bytes, seed, FALSE);
+        break;
+
+    case 1:
+        block->format = CF_UNICODETEXT;
+        block->length = WriteText(block->bytes, seed, TRUE);
+        break;
+
+    default:
+        block->format = CF_HDROP;
+        block->length = WriteFileList(block->bytes, seed);
+        break;
+    }
+
+    block->size = (block->length + BLOCK_GRANULE) / BLOCK_GRANULE
+        * BLOCK_GRANULE + copy * BLOCK_GRANULE;
+    FillSyntheticBytes(block->bytes + block->length,
+        block->size - block->length, seed * COPIES + copy + 1);
+}
+
+
+/*******************************************************************
+** WriteText
+** =========
+** Writes a terminated run of words.
+**
+** Inputs:
+**      BYTE* bytes         - where to write it
+**      unsigned int seed   - picks the words and how many
+**      BOOL wide           - TRUE for UTF-16, FALSE for ANSI
+**
+** Outputs:
+**      size_t              - bytes written, terminator included
+*******************************************************************/
+size_t WriteText(BYTE* bytes, unsigned int seed, BOOL wide)
+{
+    char text[2048];
+    unsigned int i, count = 4 + seed * 7 % 200;
+    size_t length = 0, j;
+
+    text[0] = '\0';
+
+    for(i = 0; i < count; ++i)
+    {
+        length += snprintf(text + length, sizeof(text) - length, "%s%s",
+            i ? " " : "", words[(seed * 31 + i * 7) % 16]);
+    }
+
+    if(!wide)
+    {
+        memcpy(bytes, text, length + 1);
+        return length + 1;
+    }
+
+    for(j = 0; j <= length; ++j)
+    {
+        bytes[j * 2] = (BYTE) text[j];
+        bytes[j * 2 + 1] = 0;
+    }
+
+    return (length + 1) * 2;
+}
+
+
+/*******************************************************************
+** WriteFileList
+** =============
+** Writes a CF_HDROP: a DROPFILES header and a UTF-16 list of paths
+** ending in an empty one, as the shell does.
+**
+** Inputs:
+**      BYTE* bytes         - where to write it
+**      unsigned int seed   - picks the paths and how many
+**
+** Outputs:
+**      size_t              - bytes written
+*******************************************************************/
+size_t WriteFileList(BYTE* bytes, unsigned int seed)
+{
+    uint32_t files = HDROP_HEADER_SIZE, wide = TRUE;
+    unsigned int i, count = 1 + seed % 9;
+    size_t length = HDROP_HEADER_SIZE, j;
+    char path[64];
+
+    memset(bytes, 0, HDROP_HEADER_SIZE);
+    memcpy(bytes + HDROP_FILES_OFFSET, &files, sizeof(files));
+    memcpy(bytes + HDROP_WIDE_OFFSET, &wide, sizeof(wide));
+
+    for(i = 0; i < count; ++i)
+    {
+        snprintf(path, sizeof(path), "C:\\Users\\me\\%s\\%s%u.txt",
+            words[(seed + i) % 16], words[(seed * 3 + i) % 16], i);
+
+        for(j = 0; j <= strlen(path); ++j)
+        {
+            bytes[length++] = (BYTE) path[j];
+            bytes[length++] = 0;
+        }
+    }
+
+    bytes[length++] = 0;
+    bytes[length++] = 0;
+
+    return length;
+}
+
+
+/*******************************************************************
+** CheckLogicalSizes
+** =================
+** Checks the cases where GetLogicalSize has to leave a payload
+** alone, or only just find its end.
+*******************************************************************/
+void CheckLogicalSizes()
+{
+    static const BYTE unterminated[4] = {'a', 'b', 'c', 'd'};
+    static const BYTE odd[5] = {'a', 0, 'b', 0, 0};
+    static const BYTE straddled[6] = {'a', 'b', 0, 'c', 0, 0};
+    BYTE hdrop[64];
+    uint32_t files, wide = FALSE;
+    BOOL passed;
+
+    memset(hdrop, 0, sizeof(hdrop));
+    memset(hdrop + HDROP_HEADER_SIZE, 'x', 8);
+    files = HDROP_HEADER_SIZE;
+    memcpy(hdrop + HDROP_FILES_OFFSET, &files, sizeof(files));
+    memcpy(hdrop + HDROP_WIDE_OFFSET, &wide, sizeof(wide));
+    hdrop[HDROP_HEADER_SIZE + 3] = 0;       //"xxx", "xxxx", ""
+
+    passed = (GetLogicalSize(CF_TEXT, unterminated, 4) == 4)
+        && (GetLogicalSize(CF_UNICODETEXT, unterminated, 4) == 4)
+        && (GetLogicalSize(CF_UNICODETEXT, odd, 5) == 5)
+        //A zero byte that straddles two characters isn't a terminator
+        && (GetLogicalSize(CF_UNICODETEXT, straddled, 6) == 6)
+        && (GetLogicalSize(CF_DIB, odd, 5) == 5)
+        && (GetLogicalSize(CF_HDROP, hdrop, 10) == 10)
+        && (GetLogicalSize(CF_HDROP, hdrop, sizeof(hdrop))
+            == HDROP_HEADER_SIZE + 10);
+
+    //A file list that points past its block is left alone
+    files = sizeof(hdrop);
+    memcpy(hdrop + HDROP_FILES_OFFSET, &files, sizeof(files));
+    passed = passed
+        && (GetLogicalSize(CF_HDROP, hdrop, sizeof(hdrop)) == sizeof(hdrop));
+
+    if(!passed)
+    {
+        printf("  logical sizes FAILED\n");
+        ++failed_checks;
+    }
+}
@@ -0,0 +1,311 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include <stdio.h>
+#include "Bench.h"
+#include "BlobStore.h"
+#include "ClipQueue.h"
+
+#define POOL_SIZE           64
+#define TEXT_SIZE           1024
+#define BITMAP_SIZE         (512 * 1024)
+#define SPILL_THRESHOLD     (64 * 1024)
+#define PEEK_PASSES         4
+
+static BOOL CreatePool(ClipItem* pool);
+static void DestroyPool(ClipItem* pool);
+static void RunWorkload(ClipItem* pool, BOOL spill);
+static void ReportSpill(const char* label, size_t pool_bytes);
+static BOOL CheckContents(ClipQueue* cq, ClipItem* pool);
+
+
+//Checks that have failed
+static unsigned int failed_checks = 0;
+
+
+/*******************************************************************
+** RunSpillBench
+** =============
+** Fills a queue with bitmaps (plus a little text each), once with
+** everything in memory and once with the spill file on, and
+** compares memory use, push and peek rates.  Then drops most of
+** the items to see the spill file compacted.
+**
+** Outputs:
+**      unsigned int        - how many checks failed
+*******************************************************************/
+unsigned int RunSpillBench()
+{
+    ClipItem pool[POOL_SIZE];
+
+    if(CreatePool(pool))
+    {
+        RunWorkload(pool, FALSE);
+        RunWorkload(pool, TRUE);
+        DestroyPool(pool);
+    }
+
+    return failed_checks;
+}
+
+
+/*******************************************************************
+** CreatePool
+** ==========
+** Makes POOL_SIZE distinct items, each a short piece of text and a
+** bitmap.  Only the bitmaps are big enough to spill.
+*******************************************************************/
+BOOL CreatePool(ClipItem* pool)
+{
+    static const UINT formats[2] = {CF_UNICODETEXT, CF_DIB};
+    static const size_t sizes[2] = {TEXT_SIZE, BITMAP_SIZE};
+
+    unsigned int i, j;
+    BOOL success = TRUE;
+
+    for(i = 0; (i < POOL_SIZE) && success; ++i)
+    {
+        pool[i].formats = 0;
+        pool[i].preview = NULL;
+        pool[i].data = (ClipData*) AllocMemory(sizeof(ClipData) * 2);
+        success = (pool[i].data != NULL);
+
+        for(j = 0; (j < 2) && success; ++j)
+        {
+            pool[i].data[j].memory = AllocBlob(sizes[j]);
+            success = (pool[i].data[j].memory != NULL);
+
+            if(success)
+            {
+                FillSyntheticBytes(LockBlob(pool[i].data[j].memory),
+                    sizes[j], i * 2 + j);
+                UnlockBlob(pool[i].data[j].memory);
+
+                pool[i].data[j].size = sizes[j];
+                pool[i].data[j].format = formats[j];
+                pool[i].data[j].hash = GetBlobHash(pool[i].data[j].memory);
+                ++(pool[i].formats);
+            }
+        }
+    }
+
+    if(!success)
+    {
+        while(i > 0)
+        {
+            DestroyClipItem(&pool[--i]);
+        }
+    }
+
+    return success;
+}
+
+
+/*******************************************************************
+** DestroyPool
+** ===========
+** Frees the items made by CreatePool.
+*******************************************************************/
+void DestroyPool(ClipItem* pool)
+{
+    unsigned int i;
+
+    SetBenchClipboard(NULL);
+
+    for(i = 0; i < POOL_SIZE; ++i)
+    {
+        DestroyClipItem(&pool[i]);
+    }
+}
+
+
+/*******************************************************************
+** RunWorkload
+** ===========
+** Pushes the whole pool, peeks at every item a few times, checks
+** the contents, then discards three quarters of the queue.
+**
+** Inputs:
+**      ClipItem* pool      - items from CreatePool
+**      BOOL spill          - TRUE to turn the spill file on
+*******************************************************************/
+void RunWorkload(ClipItem* pool, BOOL spill)
+{
+    const char* mode = spill ? "spill on" : "spill off";
+    ClipQueue cq;
+    BlobStoreStats stats;
+    unsigned int i, pass;
+    char label[64];
+    double start;
+
+    queue_policy.dynamic_queue = TRUE;
+    bench_clipboard_unique = FALSE;
+
+    if(spill && !SetBlobSpill(GetBenchFile("spill.tmp"), SPILL_THRESHOLD))
+    {
+        printf("  SetBlobSpill FAILED\n");
+        ++failed_checks;
+        return;
+    }
+
+    if(CreateQueue(&cq, 16))
+    {
+        GetBlobStoreStats(&stats);
+        start = GetBenchTime();
+
+        for(i = 0; i < POOL_SIZE; ++i)
+        {
+            SetBenchClipboard(&pool[i]);
+            PushFront(&cq);
+        }
+
+        snprintf(label, sizeof(label), "PushFront 512 KB bitmap, %s", mode);
+        ReportRate(label, POOL_SIZE,
+            (double) POOL_SIZE * (TEXT_SIZE + BITMAP_SIZE),
+            GetBenchTime() - start);
+        ReportSpill("  after pushes", stats.bytes);
+
+        start = GetBenchTime();
+
+        for(pass = 0; pass < PEEK_PASSES; ++pass)
+        {
+            for(i = 0; i < GetQueueLength(&cq); ++i)
+            {
+                PeekAt(&cq, i);
+            }
+        }
+
+        snprintf(label, sizeof(label), "PeekAt 512 KB bitmap, %s", mode);
+        ReportRate(label, PEEK_PASSES * POOL_SIZE,
+            (double) PEEK_PASSES * POOL_SIZE * (TEXT_SIZE + BITMAP_SIZE),
+            GetBenchTime() - start);
+
+        if(!CheckContents(&cq, pool))
+        {
+            printf("  contents after pushes FAILED\n");
+            ++failed_checks;
+        }
+
+        for(i = 0; i < POOL_SIZE * 3 / 4; ++i)
+        {
+            DiscardBack(&cq);
+        }
+
+        ReportSpill("  after discarding 3/4", stats.bytes);
+
+        if(!CheckContents(&cq, pool))
+        {
+            printf("  contents after discards FAILED\n");
+            ++failed_checks;
+        }
+
+        if(spill)
+        {
+            unsigned long moves = bench_clipboard_moves;
+
+            //A spilled payload is read straight into the block that
+            //goes to the clipboard
+            if((PopBack(&cq) != 2) || (bench_clipboard_moves - moves != 2))
+            {
+                printf("  popping a spilled item FAILED\n");
+                ++failed_checks;
+            }
+
+            GetBlobStoreStats(&stats);
+
+            if(stats.spill_file_bytes > 2 * stats.spilled_bytes)
+            {
+                printf("  spill file compaction FAILED\n");
+                ++failed_checks;
+            }
+
+            //Turning spilling off brings everything back in
+            if(!SetBlobSpill(NULL, 0) || !CheckContents(&cq, pool))
+            {
+                printf("  turning spill off FAILED\n");
+                ++failed_checks;
+            }
+
+            GetBlobStoreStats(&stats);
+
+            if(stats.spilled_bytes != 0)
+            {
+                printf("  turning spill off FAILED\n");
+                ++failed_checks;
+            }
+        }
+
+        DestroyQueue(&cq);
+    }
+
+    SetBlobSpill(NULL, 0);
+    bench_clipboard_unique = TRUE;
+    queue_policy.dynamic_queue = FALSE;
+}
+
+
+/*******************************************************************
+** ReportSpill
+** ===========
+** Prints how much of the queue's payload is in memory and how much
+** is on disk.
+**
+** Inputs:
+**      const char* label   - name of the measurement
+**      size_t pool_bytes   - resident bytes of the source pool, which
+**                            aren't counted
+*******************************************************************/
+void ReportSpill(const char* label, size_t pool_bytes)
+{
+    BlobStoreStats stats;
+
+    GetBlobStoreStats(&stats);
+
+    printf("  %-36s %8.1f MB resident %8.1f MB spilled %8.1f MB file\n",
+        label, (stats.bytes - stats.spilled_bytes - pool_bytes)
+        / (1024.0 * 1024.0),
+        stats.spilled_bytes / (1024.0 * 1024.0),
+        stats.spill_file_bytes / (1024.0 * 1024.0));
+}
+
+
+/*******************************************************************
+** CheckContents
+** =============
+** Compares every queued item, byte for byte, with the pool item it
+** was copied from.  The queue holds the newest pushes, newest
+** first.
+**
+** Outputs:
+**      BOOL                - TRUE if they all match
+*******************************************************************/
+BOOL CheckContents(ClipQueue* cq, ClipItem* pool)
+{
+    unsigned int i;
+    BOOL match = TRUE;
+
+    for(i = 0; (i < GetQueueLength(cq)) && match; ++i)
+    {
+        match = CompareClipItems(GetItem(cq, i), &pool[POOL_SIZE - 1 - i]);
+    }
+
+    return match;
+}
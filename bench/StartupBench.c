@@ -0,0 +1,774 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include <stdio.h>
+#include <string.h>
+#include "Bench.h"
+#include "BlobStore.h"
+#include "ClipQueue.h"
+#include "ClipSerialize.h"
+
+#define ITEM_FORMATS        2
+#define FORMAT_SIZE         (128 * 1024)
+#define ITEM_SIZE           (ITEM_FORMATS * FORMAT_SIZE)
+#define NUM_FILE_SIZES      3
+#define COPY_BUFFER_SIZE    (1024 * 1024)
+
+//Where ClipSerialize.c keeps things in a .qcl file header
+#define FILE_HEADER_SIZE    36
+#define VERSION_OFFSET      4
+#define INDEX_OFFSET        12      //low and high words, then size
+
+//Copies MakeOldCopy can make of a version 1 file
+#define COPY_VERSION_0      0
+#define COPY_DAMAGED_INDEX  1
+#define COPY_CUT_INDEX      2
+
+static const unsigned int file_sizes[NUM_FILE_SIZES] = {16, 64, 256};    //MB
+
+static void BenchStartup(unsigned int megabytes, BOOL check);
+static BOOL SaveSyntheticQueue(const char* path, unsigned int items);
+static BOOL MakeOldCopy(const char* path, const char* copy,
+    unsigned int kind);
+static BOOL StartQueue(ClipQueue* cq, const char* path, const char* label,
+    ClipItem* fresh);
+static BOOL LoadQueue(ClipQueue* cq, const char* path, BOOL map);
+static BOOL CompareQueues(ClipQueue* cq, ClipQueue* reference,
+    unsigned int skip);
+static void CheckFallbacks(const char* path, ClipQueue* reference);
+static void CheckSaveOver(const char* path, ClipQueue* loaded);
+static void BenchCommon(unsigned int megabytes, BOOL check);
+static BOOL UseCommonItems(const char* path, const char* label, BOOL map,
+    unsigned int items);
+static BOOL CheckSyntheticQueue(ClipQueue* cq, unsigned int items);
+static size_t GetPrivateBytes(BlobStoreStats* stats);
+static void CheckMappedFallback(const char* path, unsigned int items);
+static void CheckMappedSaveOver(const char* path, unsigned int items);
+
+
+//Checks that have failed
+static unsigned int failed_checks = 0;
+
+
+/*******************************************************************
+** RunStartupBench
+** ===============
+** Times how long after startup QClip can take its first copy, for
+** autosave files of several sizes in the old format, which has to
+** be read through, and with an index, which lets the payloads stay
+** on disk until they're used.  Checks the two load the same queue.
+** Then does the same for a common items file, with its payloads
+** read as they're used or mapped, and compares the memory each
+** ends up taking.
+**
+** The files were only just written, so they're read from the page
+** cache; from a cold disk reading through costs far more.
+**
+** Outputs:
+**      unsigned int        - how many checks failed
+*******************************************************************/
+unsigned int RunStartupBench()
+{
+    unsigned int i;
+    BOOL dynamic = queue_policy.dynamic_queue;
+
+    //So the first capture adds to the loaded queue
+    queue_policy.dynamic_queue = TRUE;
+
+    for(i = 0; i < NUM_FILE_SIZES; ++i)
+    {
+        BenchStartup(file_sizes[i], i == 0);
+    }
+
+    for(i = 0; i < NUM_FILE_SIZES; ++i)
+    {
+        BenchCommon(file_sizes[i], i == 0);
+    }
+
+    queue_policy.dynamic_queue = dynamic;
+
+    return failed_checks;
+}
+
+
+/*******************************************************************
+** BenchStartup
+** ============
+** Saves a queue of the given size, makes an old format copy, and
+** starts up from each, then checks what the indexed one loaded
+** against the other.
+**
+** Inputs:
+**      unsigned int megabytes  - payload in the file
+**      BOOL check              - TRUE to check the fallbacks too
+*******************************************************************/
+void BenchStartup(unsigned int megabytes, BOOL check)
+{
+    unsigned int items = megabytes * 1024 * 1024 / ITEM_SIZE;
+    const char* indexed_path = GetBenchFile("startup1.qcl");
+    char path[1024], old_path[1024], label[64];
+    ClipQueue indexed, old;
+    ClipItem fresh;
+    BlobStoreStats stats;
+    BOOL passed;
+
+    snprintf(path, sizeof(path), "%s", indexed_path);
+    snprintf(old_path, sizeof(old_path), "%s", GetBenchFile("startup0.qcl"));
+
+    if(!MakeSyntheticItem(&fresh, 0xFFFF, 1, 1024))
+    {
+        return;
+    }
+
+    passed = SaveSyntheticQueue(path, items)
+        && MakeOldCopy(path, old_path, COPY_VERSION_0);
+
+    //The old format, read through, and then dropped so the indexed
+    //one doesn't find its payloads already in memory
+    snprintf(label, sizeof(label), "version 0, %u MB", megabytes);
+    passed = passed && StartQueue(&old, old_path, label, &fresh);
+
+    if(passed)
+    {
+        DestroyQueue(&old);
+    }
+
+    snprintf(label, sizeof(label), "version 1, %u MB", megabytes);
+    passed = passed && StartQueue(&indexed, path, label, &fresh);
+
+    if(passed)
+    {
+        //Loading the old file again reads the indexed queue's
+        //payloads in, to see if they're the same
+        GetBlobStoreStats(&stats);
+        passed = (stats.lazy_bytes == (size_t) items * ITEM_SIZE)
+            && LoadQueue(&old, old_path, FALSE);
+
+        if(passed)
+        {
+            passed = CompareQueues(&indexed, &old, 1);
+
+            if(check)
+            {
+                CheckFallbacks(path, &old);
+            }
+
+            DestroyQueue(&old);
+        }
+
+        if(check)
+        {
+            CheckSaveOver(path, &indexed);
+        }
+
+        DestroyQueue(&indexed);
+    }
+
+    GetBlobStoreStats(&stats);
+
+    if(!passed || (stats.lazy_bytes != 0))
+    {
+        printf("  %u MB startup FAILED\n", megabytes);
+        ++failed_checks;
+    }
+
+    SetBenchClipboard(NULL);
+    DestroyClipItem(&fresh);
+    remove(path);
+    remove(old_path);
+}
+
+
+/*******************************************************************
+** SaveSyntheticQueue
+** ==================
+** Saves a queue of distinct synthetic items.
+**
+** Inputs:
+**      const char* path    - file to save to
+**      unsigned int items  - how many items
+**
+** Outputs:
+**      BOOL                - TRUE on success
+*******************************************************************/
+BOOL SaveSyntheticQueue(const char* path, unsigned int items)
+{
+    ClipQueue cq;
+    ClipItem item;
+    HANDLE fhand;
+    unsigned int i;
+    BOOL saved = FALSE;
+
+    if(!CreateQueue(&cq, items))
+    {
+        return FALSE;
+    }
+
+    for(i = 0; i < items; ++i)
+    {
+        if(MakeSyntheticItem(&item, i, ITEM_FORMATS, FORMAT_SIZE))
+        {
+            PushItemFront(&cq, &item);
+        }
+    }
+
+    fhand = OpenFileForWriting(path);
+
+    if(fhand != INVALID_HANDLE_VALUE)
+    {
+        saved = SaveQueueToFile(&cq, fhand);
+        CloseFileHandle(fhand);
+    }
+
+    DestroyQueue(&cq);
+
+    return saved && (GetQueueLength(&cq) == 0);
+}
+
+
+/*******************************************************************
+** MakeOldCopy
+** ===========
+** Copies a version 1 file as an older version would have saved it:
+** no index, and version 0 in the header.  Or keeps the index, but
+** damages it or cuts it short.
+**
+** Inputs:
+**      const char* path    - the version 1 file
+**      const char* copy    - where to put the copy
+**      unsigned int kind   - COPY_VERSION_0, COPY_DAMAGED_INDEX or
+**                            COPY_CUT_INDEX
+**
+** Outputs:
+**      BOOL                - TRUE on success
+*******************************************************************/
+BOOL MakeOldCopy(const char* path, const char* copy, unsigned int kind)
+{
+    BYTE* buffer = (BYTE*) AllocMemory(COPY_BUFFER_SIZE);
+    HANDLE source = OpenFileForReading(path);
+    HANDLE dest = OpenFileForWriting(copy);
+    uint32_t header[FILE_HEADER_SIZE / 4];
+    uint64_t offset = 0, index = 0, end = 0;
+    size_t length;
+    BOOL success = buffer && (source != INVALID_HANDLE_VALUE)
+        && (dest != INVALID_HANDLE_VALUE)
+        && ReadBytesAt(source, 0, header, FILE_HEADER_SIZE);
+
+    if(success)
+    {
+        index = ((uint64_t) header[INDEX_OFFSET / 4 + 1] << 32)
+            | header[INDEX_OFFSET / 4];
+        end = index + ((kind == COPY_VERSION_0) ? 0
+            : (kind == COPY_CUT_INDEX) ? header[INDEX_OFFSET / 4 + 2] / 2
+            : header[INDEX_OFFSET / 4 + 2]);
+    }
+
+    while(success && (offset < end))
+    {
+        length = (end - offset > COPY_BUFFER_SIZE)
+            ? COPY_BUFFER_SIZE : (size_t) (end - offset);
+        success = ReadBytesAt(source, offset, buffer, length)
+            && WriteBytesAt(dest, offset, buffer, length);
+        offset += length;
+    }
+
+    if(kind == COPY_VERSION_0)
+    {
+        header[VERSION_OFFSET / 4] = 0;
+        memset(header + INDEX_OFFSET / 4, 0, 12);
+        success = success
+            && WriteBytesAt(dest, 0, header, FILE_HEADER_SIZE);
+    }
+    else if(kind == COPY_DAMAGED_INDEX)
+    {
+        header[0] = ~header[0];
+        success = success && WriteBytesAt(dest, index, header, 4);
+    }
+
+    CloseFileHandle(source);
+    CloseFileHandle(dest);
+    FreeMemory(buffer);
+
+    return success;
+}
+
+
+/*******************************************************************
+** StartQueue
+** ==========
+** Does what QClip does at startup, from opening the autosave file
+** to capturing the first copy, and reports how long that took and
+** how much payload it read.
+**
+** Inputs:
+**      ClipQueue* cq       - receives the queue
+**      const char* path    - the autosave file
+**      const char* label   - name of the measurement
+**      ClipItem* fresh     - what's copied
+**
+** Outputs:
+**      BOOL                - TRUE if the queue loaded and took the
+**                            copy
+*******************************************************************/
+BOOL StartQueue(ClipQueue* cq, const char* path, const char* label,
+    ClipItem* fresh)
+{
+    BlobStoreStats before, after;
+    unsigned int length = 0;
+    double start;
+    BOOL loaded;
+
+    GetBlobStoreStats(&before);
+    start = GetBenchTime();
+
+    loaded = LoadQueue(cq, path, FALSE);
+
+    if(loaded)
+    {
+        length = GetQueueLength(cq);
+        SetBenchClipboard(fresh);
+        PushFront(cq);
+    }
+
+    GetBlobStoreStats(&after);
+
+    printf("  %-36s %10.1f ms to first copy %8.1f MB read\n", label,
+        (GetBenchTime() - start) * 1000.0,
+        ((after.bytes - after.lazy_bytes)
+        - (before.bytes - before.lazy_bytes)) / (1024.0 * 1024.0));
+
+    return loaded && (GetQueueLength(cq) == length + 1);
+}
+
+
+/*******************************************************************
+** LoadQueue
+** =========
+** Opens a file, loads a queue from it, and closes it again.
+**
+** Inputs:
+**      ClipQueue* cq       - receives the queue
+**      const char* path    - the file
+**      BOOL map            - TRUE to load it with MapQueueFromFile
+**
+** Outputs:
+**      BOOL                - TRUE if the queue loaded
+*******************************************************************/
+BOOL LoadQueue(ClipQueue* cq, const char* path, BOOL map)
+{
+    HANDLE fhand = OpenFileForReading(path);
+    BOOL loaded;
+
+    if(fhand == INVALID_HANDLE_VALUE)
+    {
+        return FALSE;
+    }
+
+    loaded = map ? MapQueueFromFile(cq, fhand)
+        : LoadQueueFromFile(cq, fhand);
+    CloseFileHandle(fhand);
+
+    return loaded;
+}
+
+
+/*******************************************************************
+** CompareQueues
+** =============
+** Checks two queues hold the same items with the same previews.
+**
+** Inputs:
+**      ClipQueue* cq           - the queue to check
+**      ClipQueue* reference    - what it should hold
+**      unsigned int skip       - items at the front of cq that
+**                                reference doesn't have
+**
+** Outputs:
+**      BOOL                    - TRUE if they match
+*******************************************************************/
+BOOL CompareQueues(ClipQueue* cq, ClipQueue* reference, unsigned int skip)
+{
+    ClipItem* item;
+    ClipItem* expected;
+    unsigned int i;
+    BOOL match = (GetQueueLength(cq) == GetQueueLength(reference) + skip);
+
+    for(i = 0; (i < GetQueueLength(reference)) && match; ++i)
+    {
+        item = GetItem(cq, i + skip);
+        expected = GetItem(reference, i);
+
+        match = CompareClipItems(item, expected)
+            && item->preview && expected->preview
+            && (item->preview->format == expected->preview->format)
+            && (memcmp(&item->preview->text, &expected->preview->text,
+                sizeof(item->preview->text)) == 0)
+            && (item->preview->files == expected->preview->files)
+            && (item->preview->width == expected->preview->width)
+            && (item->preview->height == expected->preview->height)
+            && (item->preview->bits == expected->preview->bits);
+    }
+
+    return match;
+}
+
+
+/*******************************************************************
+** CheckFallbacks
+** ==============
+** Checks that a file whose index is damaged, or cut off, is read
+** through instead.
+**
+** Inputs:
+**      const char* path        - a version 1 file
+**      ClipQueue* reference    - what it holds
+*******************************************************************/
+void CheckFallbacks(const char* path, ClipQueue* reference)
+{
+    static const unsigned int kinds[2] = {COPY_DAMAGED_INDEX,
+        COPY_CUT_INDEX};
+    char damaged[1024];
+    ClipQueue cq;
+    BlobStoreStats stats;
+    unsigned int i;
+    BOOL passed = TRUE;
+
+    snprintf(damaged, sizeof(damaged), "%s", GetBenchFile("damaged.qcl"));
+
+    for(i = 0; (i < 2) && passed; ++i)
+    {
+        passed = MakeOldCopy(path, damaged, kinds[i])
+            && LoadQueue(&cq, damaged, FALSE);
+
+        if(passed)
+        {
+            GetBlobStoreStats(&stats);
+            passed = (stats.lazy_bytes == 0)
+                && CompareQueues(&cq, reference, 0);
+            DestroyQueue(&cq);
+        }
+    }
+
+    if(!passed)
+    {
+        printf("  damaged index FAILED\n");
+        ++failed_checks;
+    }
+
+    remove(damaged);
+}
+
+
+/*******************************************************************
+** CheckSaveOver
+** =============
+** Saves a lazily loaded queue over the file it's loaded from, as
+** the autosave does, and checks nothing was lost.
+**
+** Inputs:
+**      const char* path    - the file
+**      ClipQueue* loaded   - queue loaded from it
+*******************************************************************/
+void CheckSaveOver(const char* path, ClipQueue* loaded)
+{
+    ClipQueue cq;
+    HANDLE fhand;
+    BlobStoreStats stats;
+    BOOL passed = LoadLazyBlobs(TRUE);
+
+    GetBlobStoreStats(&stats);
+    passed = passed && (stats.lazy_bytes == 0);
+    fhand = OpenFileForWriting(path);
+    passed = passed && (fhand != INVALID_HANDLE_VALUE)
+        && SaveQueueToFile(loaded, fhand);
+    CloseFileHandle(fhand);
+
+    passed = passed && LoadQueue(&cq, path, FALSE);
+
+    if(passed)
+    {
+        passed = CompareQueues(&cq, loaded, 0);
+        DestroyQueue(&cq);
+    }
+
+    if(!passed)
+    {
+        printf("  saving over a loaded file FAILED\n");
+        ++failed_checks;
+    }
+}
+
+
+/*******************************************************************
+** BenchCommon
+** ===========
+** Saves a common items file of the given size, then loads it and
+** uses every item, once reading the payloads as they're used and
+** once with them mapped.
+**
+** Inputs:
+**      unsigned int megabytes  - payload in the file
+**      BOOL check              - TRUE to check the fallback and
+**                                saving over the file too
+*******************************************************************/
+void BenchCommon(unsigned int megabytes, BOOL check)
+{
+    unsigned int items = megabytes * 1024 * 1024 / ITEM_SIZE;
+    char path[1024], label[64];
+    BOOL passed;
+
+    snprintf(path, sizeof(path), "%s", GetBenchFile("common.qcl"));
+    passed = SaveSyntheticQueue(path, items);
+
+    snprintf(label, sizeof(label), "common items read, %u MB", megabytes);
+    passed = passed && UseCommonItems(path, label, FALSE, items);
+    snprintf(label, sizeof(label), "common items mapped, %u MB", megabytes);
+    passed = passed && UseCommonItems(path, label, TRUE, items);
+
+    if(passed && check)
+    {
+        CheckMappedFallback(path, items);
+        CheckMappedSaveOver(path, items);
+    }
+
+    if(!passed)
+    {
+        printf("  %u MB common items FAILED\n", megabytes);
+        ++failed_checks;
+    }
+
+    SetBenchClipboard(NULL);
+    remove(path);
+}
+
+
+/*******************************************************************
+** UseCommonItems
+** ==============
+** Loads a common items file, copies every item to the clipboard,
+** as picking each from the menu would, and reports the time taken
+** to load and the private memory taken once they've all been used.
+**
+** Inputs:
+**      const char* path    - the file
+**      const char* label   - name of the measurement
+**      BOOL map            - TRUE to map the payloads
+**      unsigned int items  - items in the file
+**
+** Outputs:
+**      BOOL                - TRUE if the right items loaded, and a
+**                            mapped load took no private memory
+*******************************************************************/
+BOOL UseCommonItems(const char* path, const char* label, BOOL map,
+    unsigned int items)
+{
+    ClipQueue cq;
+    BlobStoreStats before, loaded, used;
+    unsigned int i;
+    double start, load_time;
+    BOOL passed;
+
+    GetBlobStoreStats(&before);
+    start = GetBenchTime();
+    passed = LoadQueue(&cq, path, map);
+    load_time = GetBenchTime() - start;
+
+    if(!passed)
+    {
+        return FALSE;
+    }
+
+    GetBlobStoreStats(&loaded);
+
+    for(i = 0; i < GetQueueLength(&cq); ++i)
+    {
+        PeekAt(&cq, i);
+    }
+
+    GetBlobStoreStats(&used);
+
+    printf("  %-36s %10.2f ms to load %8.1f MB private after use\n",
+        label, load_time * 1000.0,
+        (GetPrivateBytes(&used) - GetPrivateBytes(&before))
+        / (1024.0 * 1024.0));
+
+    passed = CheckSyntheticQueue(&cq, items);
+
+    if(map)
+    {
+        passed = passed && (loaded.mapped_bytes - before.mapped_bytes
+            == (size_t) items * ITEM_SIZE)
+            && (GetPrivateBytes(&used) == GetPrivateBytes(&before));
+    }
+
+    DestroyQueue(&cq);
+
+    return passed;
+}
+
+
+/*******************************************************************
+** CheckSyntheticQueue
+** ===================
+** Checks, byte for byte, that a queue holds what SaveSyntheticQueue
+** saved.
+**
+** Inputs:
+**      ClipQueue* cq       - the queue
+**      unsigned int items  - items saved
+**
+** Outputs:
+**      BOOL                - TRUE if they match
+*******************************************************************/
+BOOL CheckSyntheticQueue(ClipQueue* cq, unsigned int items)
+{
+    ClipItem item;
+    unsigned int i;
+    BOOL match = (GetQueueLength(cq) == items);
+
+    for(i = 0; (i < items) && match; ++i)
+    {
+        match = MakeSyntheticItem(&item, items - 1 - i, ITEM_FORMATS,
+            FORMAT_SIZE);
+
+        if(match)
+        {
+            match = CompareClipItems(GetItem(cq, i), &item);
+            DestroyClipItem(&item);
+        }
+    }
+
+    return match;
+}
+
+
+/*******************************************************************
+** GetPrivateBytes
+** ===============
+** Works out how much payload the blob store holds in memory of its
+** own, leaving out what's on disk or mapped.
+**
+** Inputs:
+**      BlobStoreStats* stats   - the store's stats
+**
+** Outputs:
+**      size_t                  - bytes
+*******************************************************************/
+size_t GetPrivateBytes(BlobStoreStats* stats)
+{
+    return stats->bytes - stats->spilled_bytes - stats->lazy_bytes
+        - stats->mapped_bytes;
+}
+
+
+/*******************************************************************
+** CheckMappedFallback
+** ===================
+** Checks that a common items file without an index is read through
+** instead of mapped.
+**
+** Inputs:
+**      const char* path    - a version 1 file
+**      unsigned int items  - items in it
+*******************************************************************/
+void CheckMappedFallback(const char* path, unsigned int items)
+{
+    char old_path[1024];
+    ClipQueue cq;
+    BlobStoreStats stats;
+    BOOL passed;
+
+    snprintf(old_path, sizeof(old_path), "%s", GetBenchFile("common0.qcl"));
+    passed = MakeOldCopy(path, old_path, COPY_VERSION_0)
+        && LoadQueue(&cq, old_path, TRUE);
+
+    if(passed)
+    {
+        GetBlobStoreStats(&stats);
+        passed = (stats.mapped_bytes == 0) && (stats.lazy_bytes == 0)
+            && CheckSyntheticQueue(&cq, items);
+        DestroyQueue(&cq);
+    }
+
+    if(!passed)
+    {
+        printf("  mapping an old file FAILED\n");
+        ++failed_checks;
+    }
+
+    remove(old_path);
+}
+
+
+/*******************************************************************
+** CheckMappedSaveOver
+** ===================
+** Saves a mapped queue over the file it's mapped from.  The
+** payloads have to be copied out first, which can't be done while
+** one is locked.
+**
+** Inputs:
+**      const char* path    - the file
+**      unsigned int items  - items in it
+*******************************************************************/
+void CheckMappedSaveOver(const char* path, unsigned int items)
+{
+    ClipQueue cq, saved;
+    BlobStoreStats stats;
+    HANDLE fhand;
+    void* locked;
+    BOOL passed = LoadQueue(&cq, path, TRUE);
+
+    if(!passed)
+    {
+        printf("  saving over a mapped file FAILED\n");
+        ++failed_checks;
+        return;
+    }
+
+    locked = GetItem(&cq, items / 2)->data[0].memory;
+    passed = (LockBlob(locked) != NULL) && !LoadLazyBlobs(TRUE);
+    UnlockBlob(locked);
+
+    passed = passed && LoadLazyBlobs(TRUE);
+    GetBlobStoreStats(&stats);
+    passed = passed && (stats.mapped_bytes == 0);
+
+    fhand = OpenFileForWriting(path);
+    passed = passed && (fhand != INVALID_HANDLE_VALUE)
+        && SaveQueueToFile(&cq, fhand);
+    CloseFileHandle(fhand);
+    DestroyQueue(&cq);
+
+    passed = passed && LoadQueue(&saved, path, FALSE);
+
+    if(passed)
+    {
+        passed = CheckSyntheticQueue(&saved, items);
+        DestroyQueue(&saved);
+    }
+
+    if(!passed)
+    {
+        printf("  saving over a mapped file FAILED\n");
+        ++failed_checks;
+    }
+}
@@ -0,0 +1,244 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include <stdio.h>
+#include "Bench.h"
+#include "BlobStore.h"
+#include "ClipQueue.h"
+#include "ClipCapture.h"
+
+#define STORM_MS            5000        //simulated length of a storm
+#define FORMAT_SIZE         (8 * 1024)
+#define NUM_FORMATS         2
+#define BURST_LENGTH        20          //writes, one a millisecond
+#define BURST_PERIOD        100         //ms from one burst to the next
+
+#define PATTERN_SPAM        0           //a write every millisecond
+#define PATTERN_BURSTS      1           //BURST_LENGTH writes, then quiet
+
+typedef struct
+{
+    unsigned int    settle_time;
+    unsigned int    max_rate;
+}StormConfig;
+
+static const StormConfig configs[] =
+{
+    {0,     0},
+    {50,    0},
+    {0,     10},
+    {50,    10},
+};
+
+#define NUM_CONFIGS (sizeof(configs) / sizeof(StormConfig))
+
+static void RunStorm(ClipItem* item, unsigned int pattern,
+    const StormConfig* config);
+static BOOL IsWriteTime(unsigned int pattern, unsigned int now);
+
+
+//Checks that have failed
+static unsigned int failed_checks = 0;
+
+
+/*******************************************************************
+** RunStormBench
+** =============
+** Simulates programs that flood the clipboard - a write every
+** millisecond, or bursts of writes per copy - and feeds the changes
+** through the capture throttle into an unlimited queue, with the
+** settle time and rate limit off and on.  The clock is simulated,
+** so the storm runs as fast as the captures allow; what's measured
+** is the time spent capturing per simulated second, and how much
+** memory the queue ends up holding.
+**
+** Outputs:
+**      unsigned int        - how many checks failed
+*******************************************************************/
+unsigned int RunStormBench()
+{
+    ClipItem item;
+    unsigned int i;
+
+    if(!MakeSyntheticItem(&item, 1, NUM_FORMATS, FORMAT_SIZE))
+    {
+        printf("  MakeSyntheticItem FAILED\n");
+        return 1;
+    }
+
+    queue_policy.dynamic_queue = TRUE;
+    SetBenchClipboard(&item);
+
+    for(i = 0; i < NUM_CONFIGS; ++i)
+    {
+        RunStorm(&item, PATTERN_SPAM, &configs[i]);
+    }
+
+    for(i = 0; i < NUM_CONFIGS; ++i)
+    {
+        RunStorm(&item, PATTERN_BURSTS, &configs[i]);
+    }
+
+    SetBenchClipboard(NULL);
+    queue_policy.dynamic_queue = FALSE;
+    DestroyClipItem(&item);
+
+    return failed_checks;
+}
+
+
+/*******************************************************************
+** RunStorm
+** ========
+** Plays one storm through a throttle, the way QClip's window does:
+** every change is noted and the throttle asked, and when it says to
+** wait, it's asked again once the wait is up, as the timer would.
+**
+** Inputs:
+**      ClipItem* item              - what's on the bench clipboard
+**      unsigned int pattern        - PATTERN_SPAM or PATTERN_BURSTS
+**      const StormConfig* config   - throttle settings
+*******************************************************************/
+void RunStorm(ClipItem* item, unsigned int pattern,
+    const StormConfig* config)
+{
+    CaptureThrottle throttle;
+    ClipQueue cq;
+    BlobStoreStats stats;
+    size_t base_bytes, peak_bytes = 0;
+    unsigned int now, wait, timer = 0, limit;
+    BOOL timer_set = FALSE, poll;
+    double seconds = 0, start;
+    char label[64];
+
+    if(!CreateQueue(&cq, 16))
+    {
+        return;
+    }
+
+    GetBlobStoreStats(&stats);
+    base_bytes = stats.bytes;
+    InitCaptureThrottle(&throttle, config->settle_time, config->max_rate);
+
+    for(now = 1; now <= STORM_MS; ++now)
+    {
+        poll = FALSE;
+
+        if(IsWriteTime(pattern, now))
+        {
+            NoteClipboardChange(&throttle, now);
+            poll = TRUE;
+        }
+
+        if(timer_set && ((int) (now - timer) >= 0))
+        {
+            timer_set = FALSE;
+            poll = TRUE;
+        }
+
+        if(poll)
+        {
+            if(ThrottleCapture(&throttle, now, &wait))
+            {
+                timer_set = FALSE;
+                start = GetBenchTime();
+                PushFront(&cq);
+                seconds += GetBenchTime() - start;
+
+                GetBlobStoreStats(&stats);
+
+                if(stats.bytes - base_bytes > peak_bytes)
+                {
+                    peak_bytes = stats.bytes - base_bytes;
+                }
+            }
+            else if(wait > 0)
+            {
+                timer_set = TRUE;
+                timer = now + wait;
+            }
+        }
+    }
+
+    snprintf(label, sizeof(label), "%s, settle %u ms, %u/s",
+        (pattern == PATTERN_SPAM) ? "1000/s spam" : "bursts",
+        config->settle_time, config->max_rate);
+    printf("  %-36s %6lu changes %6lu captures %5lu limited\n", label,
+        throttle.changes, throttle.captures, throttle.limited);
+    printf("  %-36s %7.3f %% CPU %9.1f MB peak\n", "",
+        seconds * 100 * 1000 / STORM_MS, peak_bytes / (1024.0 * 1024.0));
+
+    //The throttle must hold captures to what it promises
+    limit = STORM_MS;
+
+    if(config->max_rate > 0)
+    {
+        limit = STORM_MS / 1000 * config->max_rate + 1;
+    }
+
+    if((config->settle_time > 0) && (pattern == PATTERN_SPAM)
+    && (limit > STORM_MS / (config->settle_time * 10) + 1))
+    {
+        limit = STORM_MS / (config->settle_time * 10) + 1;
+    }
+
+    if((throttle.captures > limit) || (GetQueueLength(&cq) > limit))
+    {
+        printf("  %lu captures, more than %u FAILED\n",
+            throttle.captures, limit);
+        ++failed_checks;
+    }
+
+    //Settling in between bursts takes each burst as one copy
+    if((pattern == PATTERN_BURSTS) && (config->settle_time > 0)
+    && (config->max_rate == 0)
+    && (throttle.captures != STORM_MS / BURST_PERIOD))
+    {
+        printf("  %lu captures of %u bursts FAILED\n",
+            throttle.captures, STORM_MS / BURST_PERIOD);
+        ++failed_checks;
+    }
+
+    DestroyQueue(&cq);
+}
+
+
+/*******************************************************************
+** IsWriteTime
+** ===========
+** Says whether the storm writes to the clipboard at a given time.
+**
+** Inputs:
+**      unsigned int pattern    - PATTERN_SPAM or PATTERN_BURSTS
+**      unsigned int now        - simulated ms since the start
+**
+** Outputs:
+**      BOOL                    - TRUE to write
+*******************************************************************/
+BOOL IsWriteTime(unsigned int pattern, unsigned int now)
+{
+    if(pattern == PATTERN_SPAM)
+    {
+        return TRUE;
+    }
+
+    return ((now % BURST_PERIOD) < BURST_LENGTH);
+}
@@ -0,0 +1,243 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include <stdio.h>
+#include <string.h>
+#include "Bench.h"
+#include "BlobStore.h"
+#include "ClipQueue.h"
+#include "ClipCapture.h"
+
+#define BITMAP_ITEMS        100
+#define DIB_WIDTH           640
+#define DIB_HEIGHT          480
+#define DIB_HEADER_SIZE     40
+#define DIB_SIZE            (DIB_HEADER_SIZE + DIB_WIDTH * DIB_HEIGHT * 4)
+#define UNCACHED_OPENS      3
+#define CACHED_OPENS        20
+
+static BOOL FillQueue(ClipQueue* cq);
+static void OpenPopups(ClipQueue* cq, const char* label,
+    unsigned int opens, BOOL cached);
+static void CheckEviction(ClipQueue* cq);
+static void CheckChanges(ClipQueue* cq);
+
+
+//Checks that have failed
+static unsigned int failed_checks = 0;
+
+
+/*******************************************************************
+** RunThumbnailBench
+** =================
+** Opens the popup menu over a queue of BITMAP_ITEMS screenshots
+** with bitmap previews on: making every thumbnail afresh each time,
+** as the popup used to, and keeping them with the items.  Checks
+** each thumbnail is made once and freed when its item leaves the
+** queue.
+**
+** Outputs:
+**      unsigned int        - how many checks failed
+*******************************************************************/
+unsigned int RunThumbnailBench()
+{
+    ClipQueue cq;
+    unsigned long made = bench_thumbnails_made;
+
+    if(CreateQueue(&cq, BITMAP_ITEMS) && FillQueue(&cq))
+    {
+        OpenPopups(&cq, "open popup, thumbnails each time",
+            UNCACHED_OPENS, FALSE);
+
+        made = bench_thumbnails_made;
+        OpenPopups(&cq, "open popup, first time", 1, TRUE);
+        OpenPopups(&cq, "open popup, thumbnails kept", CACHED_OPENS, TRUE);
+
+        if(bench_thumbnails_made - made != BITMAP_ITEMS)
+        {
+            printf("  thumbnails made once FAILED\n");
+            ++failed_checks;
+        }
+
+        CheckChanges(&cq);
+        CheckEviction(&cq);
+    }
+
+    DestroyQueue(&cq);
+
+    if(bench_thumbnails_made != bench_thumbnails_released)
+    {
+        printf("  thumbnails freed FAILED\n");
+        ++failed_checks;
+    }
+
+    return failed_checks;
+}
+
+
+/*******************************************************************
+** FillQueue
+** =========
+** Captures BITMAP_ITEMS distinct 32-bit DIBs.
+**
+** Outputs:
+**      BOOL                - FALSE if out of memory
+*******************************************************************/
+BOOL FillQueue(ClipQueue* cq)
+{
+    BYTE* dib = (BYTE*) AllocMemory(DIB_SIZE);
+    int32_t values[3] = {DIB_HEADER_SIZE, DIB_WIDTH, DIB_HEIGHT};
+    uint16_t planes = 1, bits = 32;
+    ClipCapture capture;
+    ClipItem item;
+    unsigned int i;
+    BOOL success = (dib != NULL);
+
+    for(i = 0; (i < BITMAP_ITEMS) && success; ++i)
+    {
+        FillSyntheticBytes(dib, DIB_SIZE, i);
+        memset(dib, 0, DIB_HEADER_SIZE);
+        memcpy(dib, values, sizeof(values));
+        memcpy(dib + 12, &planes, sizeof(planes));
+        memcpy(dib + 14, &bits, sizeof(bits));
+
+        success = CreateCapture(&capture, 1, GetMicroTicks())
+            && AddCaptureData(&capture, CF_DIB, dib, DIB_SIZE,
+                GetMicroTicks())
+            && AdoptCapture(&capture, &item);
+
+        if(success)
+        {
+            PushItemFront(cq, &item);
+        }
+    }
+
+    FreeMemory(dib);
+
+    return success;
+}
+
+
+/*******************************************************************
+** OpenPopups
+** ==========
+** Gets the thumbnail of every item, as AddClipItemToMenu does, a
+** number of times, and reports how long each popup took.
+**
+** Inputs:
+**      ClipQueue* cq       - the queue
+**      const char* label   - name of the measurement
+**      unsigned int opens  - how many popups
+**      BOOL cached         - TRUE to keep thumbnails with the items,
+**                            FALSE to make and free them each time
+*******************************************************************/
+void OpenPopups(ClipQueue* cq, const char* label, unsigned int opens,
+    BOOL cached)
+{
+    ClipItem* item;
+    HANDLE thumbnail;
+    unsigned int open, i;
+    double start = GetBenchTime();
+
+    for(open = 0; open < opens; ++open)
+    {
+        for(i = 0; i < GetQueueLength(cq); ++i)
+        {
+            item = GetItem(cq, i);
+
+            if(cached)
+            {
+                GetItemThumbnail(item);
+                continue;
+            }
+
+            thumbnail = CreateThumbnail(LockBlob(item->data[0].memory),
+                item->data[0].size);
+            UnlockBlob(item->data[0].memory);
+            ReleaseThumbnail(thumbnail);
+        }
+    }
+
+    printf("  %-36s %10.1f us per popup\n", label,
+        (GetBenchTime() - start) * 1000000.0 / opens);
+}
+
+
+/*******************************************************************
+** CheckChanges
+** ============
+** Checks that a duplicate doesn't share its original's thumbnail,
+** and that dropping the bitmap from an item frees it.
+**
+** Inputs:
+**      ClipQueue* cq       - the queue, with thumbnails made
+*******************************************************************/
+void CheckChanges(ClipQueue* cq)
+{
+    ClipItem copy;
+    ClipItem* item = GetItem(cq, 0);
+    unsigned long released = bench_thumbnails_released;
+    BOOL passed = (GetItemThumbnail(item) != NULL);
+
+    if(DuplicateClipItem(&copy, item))
+    {
+        passed = passed && copy.preview && !copy.preview->thumbnail;
+        DestroyClipItem(&copy);
+        passed = passed && (bench_thumbnails_released == released);
+    }
+
+    RemoveClipFormat(item, 0);
+    passed = passed && (bench_thumbnails_released == released + 1)
+        && (GetItemThumbnail(item) == NULL);
+
+    if(!passed)
+    {
+        printf("  thumbnails following changes FAILED\n");
+        ++failed_checks;
+    }
+}
+
+
+/*******************************************************************
+** CheckEviction
+** =============
+** Drops half the queue and checks that exactly those thumbnails
+** are freed.
+**
+** Inputs:
+**      ClipQueue* cq       - the queue, with thumbnails made
+*******************************************************************/
+void CheckEviction(ClipQueue* cq)
+{
+    unsigned long released = bench_thumbnails_released;
+    unsigned int i;
+
+    for(i = 0; i < BITMAP_ITEMS / 2; ++i)
+    {
+        DiscardBack(cq);
+    }
+
+    if(bench_thumbnails_released - released != BITMAP_ITEMS / 2)
+    {
+        printf("  thumbnails freed on eviction FAILED\n");
+        ++failed_checks;
+    }
+}
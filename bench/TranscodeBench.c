@@ -0,0 +1,766 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include <stdio.h>
+#include <string.h>
+#include "Bench.h"
+#include "ClipRender.h"
+#include "ClipCapture.h"
+#include "Transcode.h"
+
+//Windows would convert with MultiByteToWideChar and
+//WideCharToMultiByte; glibc's iconv stands in for them
+#ifdef __GLIBC__
+#include <iconv.h>
+#define SYSTEM_CODEC        "iconv"
+#endif
+
+#define CORPUS_UNITS        (1024 * 1024)
+#define PASSES              8
+#define NUM_CORPORA         3
+#define TEXT_UNITS          4096    //captured by CheckCaptureText
+#define SPEED_TRIES         16      //taken by CheckDecodeSpeed
+
+typedef struct
+{
+    const char*     name;
+    uint16_t*       text;
+    BYTE*           utf8;
+    size_t          utf8_size;
+    BOOL            valid;      //no unpaired surrogates
+}Corpus;
+
+static BOOL CreateCorpora(Corpus* corpora);
+static void DestroyCorpora(Corpus* corpora);
+static void WriteProse(uint16_t* text, size_t units, unsigned int seed);
+static void WriteMixed(uint16_t* text, size_t units, unsigned int seed);
+static void BenchCorpus(Corpus* corpus, BYTE* utf8, uint16_t* utf16);
+static size_t EncodeReference(const uint16_t* text, size_t units,
+    BYTE* dest);
+static size_t DecodeReference(const BYTE* text, size_t size,
+    uint16_t* dest);
+#ifdef SYSTEM_CODEC
+static size_t EncodeSystem(const uint16_t* text, size_t units,
+    BYTE* dest, size_t capacity);
+static size_t DecodeSystem(const BYTE* text, size_t size,
+    uint16_t* dest, size_t capacity);
+#endif
+static void CheckTranscoding(Corpus* corpora, BYTE* utf8,
+    uint16_t* utf16);
+static void CheckDecodeSpeed(Corpus* corpora, uint16_t* utf16);
+static void CheckCaptureText(Corpus* corpora);
+
+static const char* words[] =
+{
+    "queue", "clip", "paste", "copy", "format", "the", "of", "and",
+    "memory", "bitmap", "text", "file", "drop", "rich", "a", "window",
+};
+
+//Cyrillic, Greek, CJK, an accented Latin letter and an emoji
+static const uint16_t foreign[][3] =
+{
+    {0x043F, 0x0440, 0}, {0x03BB, 0x03CC, 0}, {0x6587, 0x5B57, 0},
+    {0x00E9, 0, 0}, {0xD83D, 0xDE00, 0},
+};
+
+
+//Checks that have failed
+static unsigned int failed_checks = 0;
+
+
+/*******************************************************************
+** RunTranscodeBench
+** =================
+** Times the UTF-16 to UTF-8 transcoder that text is kept with,
+** both ways, against a plain one character at a time version and
+** against the system's, on mostly English text, text in a mix of
+** scripts, and random 16-bit units.  Checks they all agree, that
+** anything comes back exactly as it went in, that decoding is no
+** slower than the plain version, and what keeping text as UTF-8
+** saves.
+**
+** Outputs:
+**      unsigned int        - how many checks failed
+*******************************************************************/
+unsigned int RunTranscodeBench()
+{
+    Corpus corpora[NUM_CORPORA];
+    BYTE* utf8 = (BYTE*) AllocMemory(CORPUS_UNITS * 3);
+    uint16_t* utf16 = (uint16_t*) AllocMemory(CORPUS_UNITS * 2);
+    unsigned int i;
+
+    if(utf8 && utf16 && CreateCorpora(corpora))
+    {
+        for(i = 0; i < NUM_CORPORA; ++i)
+        {
+            BenchCorpus(&corpora[i], utf8, utf16);
+        }
+
+        CheckTranscoding(corpora, utf8, utf16);
+        CheckDecodeSpeed(corpora, utf16);
+        CheckCaptureText(corpora);
+        DestroyCorpora(corpora);
+    }
+
+    FreeMemory(utf8);
+    FreeMemory(utf16);
+
+    return failed_checks;
+}
+
+
+/*******************************************************************
+** CreateCorpora
+** =============
+** Writes the three kinds of text, and their UTF-8 from the
+** reference encoder.
+**
+** Outputs:
+**      BOOL                - FALSE if out of memory
+*******************************************************************/
+BOOL CreateCorpora(Corpus* corpora)
+{
+    static const char* names[NUM_CORPORA] = {"prose", "mixed", "random"};
+    unsigned int i;
+    BOOL success = TRUE;
+
+    for(i = 0; i < NUM_CORPORA; ++i)
+    {
+        corpora[i].name = names[i];
+        corpora[i].text = (uint16_t*) AllocMemory(CORPUS_UNITS * 2);
+        corpora[i].utf8 = (BYTE*) AllocMemory(CORPUS_UNITS * 3);
+        corpora[i].valid = (i != 2);
+
+        if(!corpora[i].text || !corpora[i].utf8)
+        {
+            success = FALSE;
+            continue;
+        }
+
+        switch(i)
+        {
+        case 0:
+            WriteProse(corpora[i].text, CORPUS_UNITS, i);
+            break;
+
+        case 1:
+            WriteMixed(corpora[i].text, CORPUS_UNITS, i);
+            break;
+
+        default:
+            FillSyntheticBytes(corpora[i].text, CORPUS_UNITS * 2, i);
+            break;
+        }
+
+        corpora[i].utf8_size = EncodeReference(corpora[i].text,
+            CORPUS_UNITS, corpora[i].utf8);
+    }
+
+    if(!success)
+    {
+        DestroyCorpora(corpora);
+    }
+
+    return success;
+}
+
+
+/*******************************************************************
+** DestroyCorpora
+** ==============
+** Frees what CreateCorpora made.
+*******************************************************************/
+void DestroyCorpora(Corpus* corpora)
+{
+    unsigned int i;
+
+    for(i = 0; i < NUM_CORPORA; ++i)
+    {
+        FreeMemory(corpora[i].text);
+        FreeMemory(corpora[i].utf8);
+        corpora[i].text = NULL;
+        corpora[i].utf8 = NULL;
+    }
+}
+
+
+/*******************************************************************
+** WriteProse
+** ==========
+** Fills a buffer with lines of English-ish words, as most copied
+** text is.
+**
+** Inputs:
+**      uint16_t* text      - the buffer
+**      size_t units        - its length
+**      unsigned int seed   - picks the words
+*******************************************************************/
+void WriteProse(uint16_t* text, size_t units, unsigned int seed)
+{
+    const char* word;
+    size_t i = 0;
+    unsigned int n = seed;
+
+    while(i < units)
+    {
+        n = n * 1103515245 + 12345;
+        word = ((n >> 16) % 12) ? words[(n >> 8) % 16] : "\r\n";
+
+        while(*word && (i < units))
+        {
+            text[i++] = (BYTE) *word++;
+        }
+
+        if(i < units)
+        {
+            text[i++] = ' ';
+        }
+    }
+}
+
+
+/*******************************************************************
+** WriteMixed
+** ==========
+** Like WriteProse, with one word in three from another script,
+** some of them outside the BMP.
+**
+** Inputs:
+**      uint16_t* text      - the buffer
+**      size_t units        - its length
+**      unsigned int seed   - picks the words
+*******************************************************************/
+void WriteMixed(uint16_t* text, size_t units, unsigned int seed)
+{
+    const uint16_t* word;
+    size_t i = 0, j;
+    unsigned int n = seed;
+
+    WriteProse(text, units, seed);
+
+    while(i + 4 < units)
+    {
+        n = n * 1103515245 + 12345;
+        word = foreign[(n >> 16) % 5];
+
+        for(j = 0; word[j]; ++j)
+        {
+            text[i + j] = word[j];
+        }
+
+        i += 3 * (4 + (n >> 8) % 4);
+    }
+}
+
+
+/*******************************************************************
+** BenchCorpus
+** ===========
+** Times encoding and decoding one corpus each way, and reports the
+** UTF-8 size against the UTF-16.
+**
+** Inputs:
+**      Corpus* corpus      - the corpus
+**      BYTE* utf8          - scratch for CORPUS_UNITS * 3 bytes
+**      uint16_t* utf16     - scratch for CORPUS_UNITS units
+*******************************************************************/
+void BenchCorpus(Corpus* corpus, BYTE* utf8, uint16_t* utf16)
+{
+    unsigned int pass;
+    char label[64];
+    double start;
+    double bytes = (double) PASSES * CORPUS_UNITS * 2;
+
+    start = GetBenchTime();
+
+    for(pass = 0; pass < PASSES; ++pass)
+    {
+        EncodeUtf8(corpus->text, CORPUS_UNITS, utf8);
+    }
+
+    snprintf(label, sizeof(label), "encode %s", corpus->name);
+    ReportRate(label, PASSES, bytes, GetBenchTime() - start);
+    start = GetBenchTime();
+
+    for(pass = 0; pass < PASSES; ++pass)
+    {
+        EncodeReference(corpus->text, CORPUS_UNITS, utf8);
+    }
+
+    snprintf(label, sizeof(label), "encode %s, scalar", corpus->name);
+    ReportRate(label, PASSES, bytes, GetBenchTime() - start);
+
+    #ifdef SYSTEM_CODEC
+    if(corpus->valid)
+    {
+        start = GetBenchTime();
+
+        for(pass = 0; pass < PASSES; ++pass)
+        {
+            EncodeSystem(corpus->text, CORPUS_UNITS, utf8,
+                CORPUS_UNITS * 3);
+        }
+
+        snprintf(label, sizeof(label), "encode %s, %s", corpus->name,
+            SYSTEM_CODEC);
+        ReportRate(label, PASSES, bytes, GetBenchTime() - start);
+    }
+    #endif
+
+    start = GetBenchTime();
+
+    for(pass = 0; pass < PASSES; ++pass)
+    {
+        DecodeUtf8(corpus->utf8, corpus->utf8_size, utf16, CORPUS_UNITS);
+    }
+
+    snprintf(label, sizeof(label), "decode %s", corpus->name);
+    ReportRate(label, PASSES, bytes, GetBenchTime() - start);
+    start = GetBenchTime();
+
+    for(pass = 0; pass < PASSES; ++pass)
+    {
+        DecodeReference(corpus->utf8, corpus->utf8_size, utf16);
+    }
+
+    snprintf(label, sizeof(label), "decode %s, scalar", corpus->name);
+    ReportRate(label, PASSES, bytes, GetBenchTime() - start);
+
+    #ifdef SYSTEM_CODEC
+    if(corpus->valid)
+    {
+        start = GetBenchTime();
+
+        for(pass = 0; pass < PASSES; ++pass)
+        {
+            DecodeSystem(corpus->utf8, corpus->utf8_size, utf16,
+                CORPUS_UNITS);
+        }
+
+        snprintf(label, sizeof(label), "decode %s, %s", corpus->name,
+            SYSTEM_CODEC);
+        ReportRate(label, PASSES, bytes, GetBenchTime() - start);
+    }
+    #endif
+
+    //Text is only kept as UTF-8 when that's smaller
+    snprintf(label, sizeof(label), "stored size %s", corpus->name);
+    printf("  %-36s %10.1f KB UTF-16 %10.1f KB UTF-8 %8.1f KB kept\n",
+        label, CORPUS_UNITS * 2 / 1024.0, corpus->utf8_size / 1024.0,
+        ((corpus->utf8_size < CORPUS_UNITS * 2) ? corpus->utf8_size
+        : CORPUS_UNITS * 2) / 1024.0);
+}
+
+
+/*******************************************************************
+** EncodeReference
+** ===============
+** EncodeUtf8 done the obvious way, a unit at a time, to check it
+** against and time it against.
+**
+** Inputs:
+**      const uint16_t* text    - the UTF-16
+**      size_t units            - its length
+**      BYTE* dest              - where to put the UTF-8
+**
+** Outputs:
+**      size_t                  - bytes written
+*******************************************************************/
+size_t EncodeReference(const uint16_t* text, size_t units, BYTE* dest)
+{
+    size_t i, size = 0;
+    uint32_t code;
+
+    for(i = 0; i < units; ++i)
+    {
+        code = text[i];
+
+        if((code >= 0xD800) && (code < 0xDC00) && (i + 1 < units)
+        && (text[i + 1] >= 0xDC00) && (text[i + 1] < 0xE000))
+        {
+            code = 0x10000 + ((code & 0x3FF) << 10) + (text[++i] & 0x3FF);
+        }
+
+        if(code < 0x80)
+        {
+            dest[size++] = (BYTE) code;
+        }
+        else if(code < 0x800)
+        {
+            dest[size++] = (BYTE) (0xC0 | (code >> 6));
+            dest[size++] = (BYTE) (0x80 | (code & 0x3F));
+        }
+        else if(code < 0x10000)
+        {
+            dest[size++] = (BYTE) (0xE0 | (code >> 12));
+            dest[size++] = (BYTE) (0x80 | ((code >> 6) & 0x3F));
+            dest[size++] = (BYTE) (0x80 | (code & 0x3F));
+        }
+        else
+        {
+            dest[size++] = (BYTE) (0xF0 | (code >> 18));
+            dest[size++] = (BYTE) (0x80 | ((code >> 12) & 0x3F));
+            dest[size++] = (BYTE) (0x80 | ((code >> 6) & 0x3F));
+            dest[size++] = (BYTE) (0x80 | (code & 0x3F));
+        }
+    }
+
+    return size;
+}
+
+
+/*******************************************************************
+** DecodeReference
+** ===============
+** DecodeUtf8 done the obvious way.  It trusts its input to be well
+** formed (encoded surrogates included), which DecodeUtf8 can't, so
+** it has the edge where there's little ASCII.
+**
+** Inputs:
+**      const BYTE* text    - the UTF-8
+**      size_t size         - its size
+**      uint16_t* dest      - where to put the UTF-16
+**
+** Outputs:
+**      size_t              - units written
+*******************************************************************/
+size_t DecodeReference(const BYTE* text, size_t size, uint16_t* dest)
+{
+    size_t i = 0, units = 0;
+    uint32_t code;
+
+    while(i < size)
+    {
+        if(text[i] < 0x80)
+        {
+            code = text[i++];
+        }
+        else if(text[i] < 0xE0)
+        {
+            code = ((text[i] & 0x1F) << 6) | (text[i + 1] & 0x3F);
+            i += 2;
+        }
+        else if(text[i] < 0xF0)
+        {
+            code = ((text[i] & 0x0F) << 12) | ((text[i + 1] & 0x3F) << 6)
+                | (text[i + 2] & 0x3F);
+            i += 3;
+        }
+        else
+        {
+            code = ((text[i] & 0x07) << 18) | ((text[i + 1] & 0x3F) << 12)
+                | ((text[i + 2] & 0x3F) << 6) | (text[i + 3] & 0x3F);
+            i += 4;
+        }
+
+        if(code >= 0x10000)
+        {
+            dest[units++] = (uint16_t) (0xD800 + ((code - 0x10000) >> 10));
+            dest[units++] = (uint16_t) (0xDC00 + (code & 0x3FF));
+        }
+        else
+        {
+            dest[units++] = (uint16_t) code;
+        }
+    }
+
+    return units;
+}
+
+
+#ifdef SYSTEM_CODEC
+/*******************************************************************
+** EncodeSystem
+** ============
+** Turns UTF-16 into UTF-8 with the system's converter.
+**
+** Inputs:
+**      const uint16_t* text    - the UTF-16
+**      size_t units            - its length
+**      BYTE* dest              - where to put the UTF-8
+**      size_t capacity         - room at dest
+**
+** Outputs:
+**      size_t                  - bytes written
+*******************************************************************/
+size_t EncodeSystem(const uint16_t* text, size_t units, BYTE* dest,
+    size_t capacity)
+{
+    iconv_t cd = iconv_open("UTF-8", "UTF-16LE");
+    char* in = (char*) text;
+    char* out = (char*) dest;
+    size_t in_left = units * 2, out_left = capacity;
+
+    if(cd == (iconv_t) -1)
+    {
+        return 0;
+    }
+
+    iconv(cd, &in, &in_left, &out, &out_left);
+    iconv_close(cd);
+
+    return capacity - out_left;
+}
+
+
+/*******************************************************************
+** DecodeSystem
+** ============
+** Turns UTF-8 into UTF-16 with the system's converter.
+**
+** Inputs:
+**      const BYTE* text    - the UTF-8
+**      size_t size         - its size
+**      uint16_t* dest      - where to put the UTF-16
+**      size_t capacity     - room at dest, in units
+**
+** Outputs:
+**      size_t              - units written
+*******************************************************************/
+size_t DecodeSystem(const BYTE* text, size_t size, uint16_t* dest,
+    size_t capacity)
+{
+    iconv_t cd = iconv_open("UTF-16LE", "UTF-8");
+    char* in = (char*) text;
+    char* out = (char*) dest;
+    size_t in_left = size, out_left = capacity * 2;
+
+    if(cd == (iconv_t) -1)
+    {
+        return 0;
+    }
+
+    iconv(cd, &in, &in_left, &out, &out_left);
+    iconv_close(cd);
+
+    return capacity - out_left / 2;
+}
+#endif
+
+
+/*******************************************************************
+** CheckTranscoding
+** ================
+** Checks the transcoder against the reference and the system on
+** every corpus, that everything round-trips, that a short buffer
+** never splits a surrogate pair, and that malformed UTF-8 turns
+** into U+FFFD.  The corpora are checked at odd offsets and lengths
+** too, so the ends of the vector loops are covered.
+**
+** Inputs:
+**      Corpus* corpora     - the corpora
+**      BYTE* utf8          - scratch for CORPUS_UNITS * 3 bytes
+**      uint16_t* utf16     - scratch for CORPUS_UNITS units
+*******************************************************************/
+void CheckTranscoding(Corpus* corpora, BYTE* utf8, uint16_t* utf16)
+{
+    static const BYTE malformed[] =
+        {'a', 0xC3, 'b', 0xE6, 0x96, 0xF0, 0x9F, 0x98, 0x80, 0xC0, 0x80,
+        0xFF, 'c'};
+    static const uint16_t repaired[] =
+        {'a', 0xFFFD, 'b', 0xFFFD, 0xFFFD, 0xD83D, 0xDE00, 0xFFFD, 0xFFFD,
+        0xFFFD, 'c'};
+    static const uint16_t pair[] = {'a', 'b', 'c', 'd', 'e', 'f', 0xD83D,
+        0xDE00};
+    Corpus* corpus;
+    size_t size, units, offset, length;
+    unsigned int i;
+    BOOL passed = TRUE;
+
+    for(i = 0; i < NUM_CORPORA; ++i)
+    {
+        corpus = &corpora[i];
+        size = EncodeUtf8(corpus->text, CORPUS_UNITS, utf8);
+        passed = passed && (size == corpus->utf8_size)
+            && (GetUtf8Size(corpus->text, CORPUS_UNITS) == size)
+            && (memcmp(utf8, corpus->utf8, size) == 0);
+
+        units = DecodeUtf8(corpus->utf8, corpus->utf8_size, utf16,
+            CORPUS_UNITS);
+        passed = passed && (units == CORPUS_UNITS)
+            && (GetUtf16Units(corpus->utf8, corpus->utf8_size) == units)
+            && (memcmp(utf16, corpus->text, units * 2) == 0);
+
+        #ifdef SYSTEM_CODEC
+        if(corpus->valid)
+        {
+            passed = passed && (DecodeSystem(corpus->utf8,
+                corpus->utf8_size, utf16, CORPUS_UNITS) == CORPUS_UNITS)
+                && (memcmp(utf16, corpus->text, CORPUS_UNITS * 2) == 0);
+        }
+        #endif
+
+        for(offset = 1; offset < 40; offset += 3)
+        {
+            length = (offset * 7919) % 300;
+            size = EncodeUtf8(corpus->text + offset, length, utf8);
+            passed = passed && (size == EncodeReference(
+                corpus->text + offset, length, utf8 + CORPUS_UNITS * 2))
+                && (memcmp(utf8, utf8 + CORPUS_UNITS * 2, size) == 0)
+                && (DecodeUtf8(utf8, size, utf16, length) == length)
+                && (memcmp(utf16, corpus->text + offset, length * 2) == 0);
+        }
+    }
+
+    size = EncodeUtf8(pair, 8, utf8);
+    passed = passed && (DecodeUtf8(utf8, size, utf16, 7) == 6)
+        && (DecodeUtf8(utf8, size, utf16, 8) == 8);
+
+    units = DecodeUtf8(malformed, sizeof(malformed), utf16, CORPUS_UNITS);
+    passed = passed && (units == sizeof(repaired) / 2)
+        && (GetUtf16Units(malformed, sizeof(malformed)) == units)
+        && (memcmp(utf16, repaired, sizeof(repaired)) == 0);
+
+    if(!passed)
+    {
+        printf("  transcoding FAILED\n");
+        ++failed_checks;
+    }
+}
+
+
+/*******************************************************************
+** CheckDecodeSpeed
+** ================
+** Checks DecodeUtf8 keeps up with the plain decoder on every kind
+** of text, not just the ASCII it takes in blocks.  The two take
+** turns and the best of several tries counts, so the machine being
+** busy for a moment doesn't fail it; the plain one checks nothing,
+** so DecodeUtf8 gets a quarter more time.
+**
+** Inputs:
+**      Corpus* corpora     - the corpora
+**      uint16_t* utf16     - scratch for CORPUS_UNITS units
+*******************************************************************/
+void CheckDecodeSpeed(Corpus* corpora, uint16_t* utf16)
+{
+    unsigned int i, attempt;
+    double start, decode, scalar;
+    double best_decode, best_scalar;
+    BOOL passed = TRUE;
+
+    for(i = 0; i < NUM_CORPORA; ++i)
+    {
+        best_decode = best_scalar = 0;
+
+        for(attempt = 0; attempt < SPEED_TRIES; ++attempt)
+        {
+            start = GetBenchTime();
+            DecodeUtf8(corpora[i].utf8, corpora[i].utf8_size, utf16,
+                CORPUS_UNITS);
+            decode = GetBenchTime() - start;
+            start = GetBenchTime();
+            DecodeReference(corpora[i].utf8, corpora[i].utf8_size, utf16);
+            scalar = GetBenchTime() - start;
+
+            if((attempt == 0) || (decode < best_decode))
+            {
+                best_decode = decode;
+            }
+
+            if((attempt == 0) || (scalar < best_scalar))
+            {
+                best_scalar = scalar;
+            }
+        }
+
+        if(best_decode > best_scalar * 1.25)
+        {
+            printf("  decode %s: %.2f ms against %.2f ms scalar\n",
+                corpora[i].name, best_decode * 1000, best_scalar * 1000);
+            passed = FALSE;
+        }
+    }
+
+    if(!passed)
+    {
+        printf("  decoding as fast as scalar FAILED\n");
+        ++failed_checks;
+    }
+}
+
+
+/*******************************************************************
+** CheckCaptureText
+** ================
+** Captures a piece of each kind of text the way Clipboard.c does,
+** and checks the queue keeps it as UTF-8 only if that's smaller,
+** and pastes it back as the same UTF-16.  Prose gets smaller;
+** random units don't; mixed text may go either way.
+**
+** Inputs:
+**      Corpus* corpora     - text to capture from
+*******************************************************************/
+void CheckCaptureText(Corpus* corpora)
+{
+    ClipCapture capture;
+    ClipItem item;
+    Corpus* corpus;
+    HANDLE block;
+    uint16_t* pasted;
+    size_t units = TEXT_UNITS;
+    unsigned int i;
+    BOOL passed = TRUE, smaller;
+
+    for(i = 0; (i < NUM_CORPORA) && passed; ++i)
+    {
+        corpus = &corpora[i];
+        smaller = (GetUtf8Size(corpus->text, units) < units * 2);
+        passed = (smaller == (i == 0)) || (i == 1);
+
+        passed = passed && CreateCapture(&capture, 1, GetMicroTicks())
+            && AddCaptureText(&capture, corpus->text, units * 2,
+                GetMicroTicks())
+            && AdoptCapture(&capture, &item);
+
+        if(!passed)
+        {
+            break;
+        }
+
+        passed = (item.data[0].format
+                == (smaller ? UTF8_TEXT_FORMAT : CF_UNICODETEXT))
+            && (item.data[0].size <= units * 2)
+            && (GetExportFormat(item.data[0].format) == CF_UNICODETEXT);
+
+        //Whether copying or moving, UTF-8 stays in the item, while
+        //UTF-16 can be handed over, and the clipboard gets UTF-16
+        block = ExportClipData(&item.data[0], FALSE);
+        pasted = (uint16_t*) block;
+        passed = passed && block && item.data[0].memory
+            && (memcmp(pasted, corpus->text, units * 2) == 0);
+        FreeMovable(block);
+
+        block = ExportClipData(&item.data[0], TRUE);
+        pasted = (uint16_t*) block;
+        passed = passed && block && (item.data[0].memory || !smaller)
+            && (memcmp(pasted, corpus->text, units * 2) == 0);
+        FreeMovable(block);
+
+        DestroyClipItem(&item);
+    }
+
+    if(!passed)
+    {
+        printf("  capturing text as UTF-8 FAILED\n");
+        ++failed_checks;
+    }
+}
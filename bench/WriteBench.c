@@ -0,0 +1,524 @@
+/****************************************************************************
+** QClip
+** Copyright 2006 Aaron Curtis
+**
+** This file is part of QClip.
+**
+** QClip is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** QClip is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with QClip. If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include <stdio.h>
+#include <string.h>
+#include "Bench.h"
+#include "BlobStore.h"
+#include "ClipQueue.h"
+#include "ClipSerialize.h"
+
+#define SMALL_ITEMS         10000
+#define SMALL_SIZE          200     //a line or two of text
+#define LARGE_ITEMS         16
+#define LARGE_SIZE          (1024 * 1024 + 123)
+#define MIXED_ITEMS         64
+#define ITEM_HEADER_SIZE    8       //as SaveQueueToFile used to write
+#define DATA_HEADER_SIZE    16      //them, one piece at a time
+#define PATH_LENGTH         512
+#define WRITE_BUFFER_SIZE   (256 * 1024)    //SaveQueueToFile's
+
+static void BenchSave(const char* name, unsigned int items,
+    unsigned int formats, size_t size);
+static BOOL FillQueue(ClipQueue* cq, unsigned int items,
+    unsigned int formats, size_t size);
+static BOOL WritePieces(ClipQueue* cq, HANDLE fhand);
+static void ReportWrites(const char* name, const char* how,
+    unsigned long operations, double bytes, double seconds,
+    unsigned long calls);
+static BOOL CountWriteCalls(unsigned long* calls);
+static void CheckRoundTrip();
+static void CheckAtomicSave();
+static BOOL LoadAndCompare(const char* path, ClipQueue* cq);
+
+
+//Checks that have failed
+static unsigned int failed_checks = 0;
+
+
+/*******************************************************************
+** RunWriteBench
+** =============
+** Saves a queue of many small text items and one of a few large
+** ones three ways: a write per header and payload, as the .qcl
+** writer used to, through SaveQueueToFile's buffered writer, and
+** with SaveQueueToPath, which adds the temporary file, the flush
+** to disk and the rename.  Reports the write calls each makes, on
+** Linux, and the throughput.  Then checks files with payloads of
+** every sort load back, and that a failed save leaves the file it
+** was replacing alone.
+**
+** Outputs:
+**      unsigned int        - how many checks failed
+*******************************************************************/
+unsigned int RunWriteBench()
+{
+    BenchSave("small text", SMALL_ITEMS, 1, SMALL_SIZE);
+    BenchSave("1 MB", LARGE_ITEMS, 1, LARGE_SIZE);
+    CheckRoundTrip();
+    CheckAtomicSave();
+
+    return failed_checks;
+}
+
+
+/*******************************************************************
+** BenchSave
+** =========
+** Fills a queue and saves it each of the three ways.
+**
+** Inputs:
+**      const char* name        - the workload, for the report
+**      unsigned int items      - items in the queue
+**      unsigned int formats    - formats per item
+**      size_t size             - bytes per format
+*******************************************************************/
+void BenchSave(const char* name, unsigned int items,
+    unsigned int formats, size_t size)
+{
+    ClipQueue cq;
+    char path[PATH_LENGTH], temp_path[PATH_LENGTH];
+    double bytes = (double) items * formats * size;
+    unsigned long before = 0, after = 0;
+    double start, seconds;
+    HANDLE fhand;
+    BOOL saved;
+
+    snprintf(path, PATH_LENGTH, "%s", GetBenchFile("write.qcl"));
+    snprintf(temp_path, PATH_LENGTH, "%s", GetBenchFile("write.qcl.tmp"));
+
+    if(!CreateQueue(&cq, items))
+    {
+        return;
+    }
+
+    if(!FillQueue(&cq, items, formats, size))
+    {
+        printf("  %s FillQueue FAILED\n", name);
+        ++failed_checks;
+        DestroyQueue(&cq);
+        return;
+    }
+
+    //Each starts from nothing, rather than a file to truncate
+    remove(path);
+    fhand = OpenFileForWriting(path);
+
+    if(fhand != INVALID_HANDLE_VALUE)
+    {
+        CountWriteCalls(&before);
+        start = GetBenchTime();
+        saved = WritePieces(&cq, fhand);
+        seconds = GetBenchTime() - start;
+        CountWriteCalls(&after);
+        CloseFileHandle(fhand);
+
+        ReportWrites(name, "pieces", items, bytes, seconds, after - before);
+
+        if(!saved)
+        {
+            printf("  %s pieces FAILED\n", name);
+            ++failed_checks;
+        }
+    }
+
+    remove(path);
+    fhand = OpenFileForWriting(path);
+
+    if(fhand != INVALID_HANDLE_VALUE)
+    {
+        CountWriteCalls(&before);
+        start = GetBenchTime();
+        saved = SaveQueueToFile(&cq, fhand);
+        seconds = GetBenchTime() - start;
+        CountWriteCalls(&after);
+        CloseFileHandle(fhand);
+
+        ReportWrites(name, "buffered", items, bytes, seconds,
+            after - before);
+
+        //A call or two per buffer, where there used to be two per format
+        if(!saved || (after - before > 4 + 2 * bytes / WRITE_BUFFER_SIZE))
+        {
+            printf("  %s buffered FAILED\n", name);
+            ++failed_checks;
+        }
+    }
+
+    remove(path);
+    CountWriteCalls(&before);
+    start = GetBenchTime();
+    saved = SaveQueueToPath(&cq, path, temp_path);
+    seconds = GetBenchTime() - start;
+    CountWriteCalls(&after);
+
+    ReportWrites(name, "to path", items, bytes, seconds, after - before);
+
+    if(!saved || !LoadAndCompare(path, &cq))
+    {
+        printf("  %s to path FAILED\n", name);
+        ++failed_checks;
+    }
+
+    remove(path);
+    remove(temp_path);
+    DestroyQueue(&cq);
+}
+
+
+/*******************************************************************
+** FillQueue
+** =========
+** Pushes distinct synthetic items onto a queue.  Their payloads are
+** interned, as captured ones are, so their hashes are at hand when
+** they're saved.
+**
+** Inputs:
+**      ClipQueue* cq           - the queue, with room for them all
+**      unsigned int items      - how many
+**      unsigned int formats    - formats per item
+**      size_t size             - bytes per format
+**
+** Outputs:
+**      BOOL                    - FALSE if out of memory
+*******************************************************************/
+BOOL FillQueue(ClipQueue* cq, unsigned int items, unsigned int formats,
+    size_t size)
+{
+    ClipItem item;
+    unsigned int i, j;
+
+    for(i = 0; i < items; ++i)
+    {
+        if(!MakeSyntheticItem(&item, i, formats, size))
+        {
+            return FALSE;
+        }
+
+        for(j = 0; j < item.formats; ++j)
+        {
+            item.data[j].memory = InternBlob(item.data[j].memory);
+        }
+
+        PushItemFront(cq, &item);
+    }
+
+    return TRUE;
+}
+
+
+/*******************************************************************
+** WritePieces
+** ===========
+** Writes a queue's items the way SaveQueueToFile used to: a write
+** for each item header, and two for each format, its header and
+** then its payload.  The headers are just placeholders; the file
+** is only for counting writes.
+**
+** Inputs:
+**      ClipQueue* cq           - the queue
+**      HANDLE fhand            - a file open for writing
+**
+** Outputs:
+**      BOOL                    - FALSE if writing failed
+*******************************************************************/
+BOOL WritePieces(ClipQueue* cq, HANDLE fhand)
+{
+    BYTE header[DATA_HEADER_SIZE];
+    ClipItem* item;
+    unsigned int i, j;
+    BOOL success = TRUE;
+
+    memset(header, 0, sizeof(header));
+
+    for(i = 0; (i < GetQueueLength(cq)) && success; ++i)
+    {
+        item = GetItem(cq, i);
+        success = WriteBytes(fhand, header, ITEM_HEADER_SIZE);
+
+        for(j = 0; (j < item->formats) && success; ++j)
+        {
+            success = WriteBytes(fhand, header, DATA_HEADER_SIZE)
+                && WriteBytes(fhand, LockBlob(item->data[j].memory),
+                    item->data[j].size);
+            UnlockBlob(item->data[j].memory);
+        }
+    }
+
+    return success;
+}
+
+
+/*******************************************************************
+** ReportWrites
+** ============
+** Prints the rate of a save, then how many write calls it made,
+** if they were counted.
+**
+** Inputs:
+**      const char* name        - the workload
+**      const char* how         - how it was saved
+**      unsigned long operations    - items saved
+**      double bytes            - payload bytes saved
+**      double seconds          - how long it took
+**      unsigned long calls     - write calls it made; 0 if they
+**                                weren't counted
+*******************************************************************/
+void ReportWrites(const char* name, const char* how,
+    unsigned long operations, double bytes, double seconds,
+    unsigned long calls)
+{
+    char label[64];
+
+    snprintf(label, sizeof(label), "save %s, %s", name, how);
+    ReportRate(label, operations, bytes, seconds);
+
+    if(calls > 0)
+    {
+        snprintf(label, sizeof(label), "  %s, write calls", how);
+        printf("  %-36s %10lu calls %8.1f KB/call\n", label, calls,
+            calls ? bytes / calls / 1024.0 : 0.0);
+    }
+}
+
+
+/*******************************************************************
+** CountWriteCalls
+** ===============
+** Reads how many write calls the process has made so far, from
+** /proc/self/io on Linux.  Elsewhere they aren't counted, and the
+** count stays at 0.
+**
+** Inputs:
+**      unsigned long* calls    - receives the count
+**
+** Outputs:
+**      BOOL                    - FALSE if they can't be counted
+*******************************************************************/
+BOOL CountWriteCalls(unsigned long* calls)
+{
+    BOOL found = FALSE;
+
+    #ifdef __linux__
+    char line[128];
+    FILE* file = fopen("/proc/self/io", "r");
+
+    if(file)
+    {
+        while(!found && fgets(line, sizeof(line), file))
+        {
+            found = (sscanf(line, "syscw: %lu", calls) == 1);
+        }
+
+        fclose(file);
+    }
+    #endif
+
+    if(!found)
+    {
+        *calls = 0;
+    }
+
+    return found;
+}
+
+
+/*******************************************************************
+** CheckRoundTrip
+** ==============
+** Saves a queue that mixes payloads too small to fill the buffer,
+** ones big enough to be written around it at every offset, packed
+** ones that are unpacked as they're written, and formats that are
+** saved with their names, and checks it loads back the same.
+*******************************************************************/
+void CheckRoundTrip()
+{
+    static const NameChar html[] =
+        {'H', 'T', 'M', 'L', ' ', 'F', 'o', 'r', 'm', 'a', 't', 0};
+
+    ClipQueue cq;
+    ClipItem item;
+    char path[PATH_LENGTH], temp_path[PATH_LENGTH];
+    unsigned int i;
+    size_t size;
+    BYTE* bytes;
+    BOOL passed;
+
+    snprintf(path, PATH_LENGTH, "%s", GetBenchFile("mixed.qcl"));
+    snprintf(temp_path, PATH_LENGTH, "%s", GetBenchFile("mixed.qcl.tmp"));
+
+    if(!CreateQueue(&cq, MIXED_ITEMS))
+    {
+        return;
+    }
+
+    passed = TRUE;
+
+    for(i = 0; (i < MIXED_ITEMS) && passed; ++i)
+    {
+        //From a few bytes to a few hundred KB, rarely a round number
+        size = (i % 4 == 3) ? (64 * 1024 + i * 4099) : (1 + i * 977);
+        passed = MakeSyntheticItem(&item, 1000 + i, 1 + i % 4, size);
+
+        if(passed && (item.formats == 4))
+        {
+            item.data[3].format = RegisterFormatName(html);
+        }
+
+        if(passed && (i % 6 == 5))
+        {
+            bytes = (BYTE*) LockBlob(item.data[0].memory);
+            memset(bytes + 4, 'q', size - 4);
+            UnlockBlob(item.data[0].memory);
+
+            //Only shared payloads are packed
+            item.data[0].memory = InternBlob(item.data[0].memory);
+            item.data[0].hash = GetBlobHash(item.data[0].memory);
+        }
+
+        if(passed)
+        {
+            PushItemFront(&cq, &item);
+            passed = (i % 6 != 5)
+                || CompressBlob(GetItem(&cq, 0)->data[0].memory);
+        }
+    }
+
+    passed = passed && SaveQueueToPath(&cq, path, temp_path)
+        && LoadAndCompare(path, &cq);
+
+    if(!passed)
+    {
+        printf("  mixed payload round trip FAILED\n");
+        ++failed_checks;
+    }
+
+    remove(path);
+    remove(temp_path);
+    DestroyQueue(&cq);
+}
+
+
+/*******************************************************************
+** CheckAtomicSave
+** ===============
+** Saves a queue, then fails to save a different one over it, once
+** because the temporary file can't be made and once because the
+** save is cancelled part way through.  Either way the first file
+** has to be just as it was.
+*******************************************************************/
+void CheckAtomicSave()
+{
+    ClipQueue cq, other;
+    QueueSnapshot* snapshot;
+    char path[PATH_LENGTH], temp_path[PATH_LENGTH];
+    char missing_path[PATH_LENGTH];
+    BOOL passed;
+
+    snprintf(path, PATH_LENGTH, "%s", GetBenchFile("atomic.qcl"));
+    snprintf(temp_path, PATH_LENGTH, "%s", GetBenchFile("atomic.qcl.tmp"));
+    snprintf(missing_path, PATH_LENGTH, "%s",
+        GetBenchFile("missing/atomic.qcl.tmp"));
+
+    if(!CreateQueue(&cq, MIXED_ITEMS))
+    {
+        return;
+    }
+
+    if(!CreateQueue(&other, MIXED_ITEMS))
+    {
+        DestroyQueue(&cq);
+        return;
+    }
+
+    passed = FillQueue(&cq, MIXED_ITEMS / 2, 2, 4000)
+        && FillQueue(&other, MIXED_ITEMS, 3, 70000)
+        && SaveQueueToPath(&cq, path, temp_path);
+
+    passed = passed
+        && !SaveQueueToPath(&other, path, missing_path)
+        && LoadAndCompare(path, &cq);
+
+    snapshot = passed ? TakeQueueSnapshot(&other) : NULL;
+    passed = (snapshot != NULL);
+
+    if(passed)
+    {
+        CancelQueueSnapshot(snapshot);
+        passed = !WriteQueueSnapshotToPath(snapshot, path, temp_path)
+            && LoadAndCompare(path, &cq);
+        ReleaseQueueSnapshot(snapshot);
+    }
+
+    if(!passed)
+    {
+        printf("  atomic save FAILED\n");
+        ++failed_checks;
+    }
+
+    remove(path);
+    remove(temp_path);
+    DestroyQueue(&other);
+    DestroyQueue(&cq);
+}
+
+
+/*******************************************************************
+** LoadAndCompare
+** ==============
+** Loads a .qcl file and checks it holds the same items as a queue.
+**
+** Inputs:
+**      const char* path        - the file
+**      ClipQueue* cq           - what it should hold
+**
+** Outputs:
+**      BOOL                    - TRUE if it loads and matches
+*******************************************************************/
+BOOL LoadAndCompare(const char* path, ClipQueue* cq)
+{
+    ClipQueue loaded;
+    HANDLE fhand = OpenFileForReading(path);
+    unsigned int i;
+    BOOL match = (fhand != INVALID_HANDLE_VALUE);
+
+    if(match)
+    {
+        match = LoadQueueFromFile(&loaded, fhand);
+
+        if(match)
+        {
+            match = (GetQueueLength(&loaded) == GetQueueLength(cq));
+
+            for(i = 0; (i < GetQueueLength(cq)) && match; ++i)
+            {
+                match = CompareClipItems(GetItem(&loaded, i),
+                    GetItem(cq, i));
+            }
+
+            DestroyQueue(&loaded);
+        }
+
+        CloseFileHandle(fhand);
+    }
+
+    return match;
+}